@@ -0,0 +1,296 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+/*
+ * <h1> Left-Right (Classic variant) </h1>
+ *
+ * This is the C11 version of the Left-Right Classic variant, the same as
+ * LeftRightClassic.h in the C++ folder. Like the Double Instance Locking
+ * in C99/doubleinst, the user has two instances of the data structure, but
+ * here the Readers never wait for anything, they are Wait-Free Population
+ * Oblivious when the ReadIndicator is LR_RI_PER_THREAD, and Lock-Free (or
+ * Wait-Free Population Oblivious on x86) with LR_RI_STRIPED.
+ *
+ * The user keeps the variable that says which instance the Readers should
+ * read (leftRight) and uses it like this:
+ *
+ * - Read-only operation:
+ *     int lvi = lr_arrive(&lr);
+ *     if (atomic_load(&leftRight) == LR_READS_ON_LEFT) {
+ *         readOnlyFunction(leftInstance);
+ *     } else {
+ *         readOnlyFunction(rightInstance);
+ *     }
+ *     lr_depart(&lr, lvi);
+ *
+ * - Mutative operation:
+ *     lr_writer_lock(&lr);
+ *     if (atomic_load(&leftRight) == LR_READS_ON_LEFT) {
+ *         mutativeFunction(rightInstance);
+ *         atomic_store(&leftRight, LR_READS_ON_RIGHT);
+ *         lr_toggle_and_wait(&lr);
+ *         mutativeFunction(leftInstance);
+ *     } else {
+ *         ... same thing with left and right swapped ...
+ *     }
+ *     lr_writer_unlock(&lr);
+ *
+ * There are two ReadIndicators:
+ * LR_RI_PER_THREAD - Each thread has its own padded entry where it stores 1 on
+ *                    arrive and 0 on depart. The writer has to scan all
+ *                    LR_MAX_THREADS entries.
+ * LR_RI_STRIPED    - LR_NUM_STRIPES padded counters, where each thread does a
+ *                    fetch_add() on the counter of its index modulo the number
+ *                    of stripes. Scanning is cheaper for the writer.
+ *
+ * Both need a small index for each thread, which we keep in a thread-local
+ * variable shared by all instances of lr_t. An index is taken the first time
+ * a thread calls lr_arrive() and is given back when the thread exits, so
+ * there can be at most LR_MAX_THREADS threads running at the same time that
+ * have called lr_arrive(). When all the indexes are taken, lr_arrive() fails
+ * with -EAGAIN instead of waiting for a thread to exit.
+ *
+ * lr_arrive()          - Wait-Free Population Oblivious (LR_RI_PER_THREAD),
+ *                        Lock-Free or Wait-Free Population Oblivious on x86 (LR_RI_STRIPED)
+ *                        The very first call on each thread is Wait-Free Bounded by LR_MAX_THREADS
+ * lr_depart()          - Same as lr_arrive()
+ * lr_toggle_and_wait() - Blocking
+ * lr_writer_lock()     - Blocking
+ * lr_writer_unlock()   - Depends on pthread_mutex_unlock()
+ *
+ * http://concurrencyfreaks.com/2013/12/left-right-concurrency-control.html
+ *
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+#include "left_right.h"
+
+#define LR_INVALID_TID   (-1)
+#define LR_NOT_READING   0
+#define LR_READING       1
+
+
+/*
+ * Array of indexes currently in use by running threads, shared by all
+ * instances of lr_t
+ */
+static atomic_int globalTidInUse[LR_MAX_THREADS];
+
+/*
+ * Index of the thread, or LR_INVALID_TID if the thread hasn't called
+ * lr_arrive() yet
+ */
+static _Thread_local int tlThreadIndex = LR_INVALID_TID;
+
+static pthread_key_t globalTidKey;
+static pthread_once_t globalTidKeyOnce = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Called when a thread that has an index exits, so that the index can be re-used
+ */
+static void lr_release_tid(void * arg)
+{
+    atomic_store(&globalTidInUse[(long)arg - 1], 0);
+}
+
+
+static void lr_create_tid_key(void)
+{
+    pthread_key_create(&globalTidKey, lr_release_tid);
+}
+
+
+/*
+ * Returns the index of the calling thread, or LR_INVALID_TID if there are
+ * already LR_MAX_THREADS threads with an index
+ */
+static int lr_get_tid(void)
+{
+    int tid = tlThreadIndex;
+    if (tid != LR_INVALID_TID) return tid;
+    pthread_once(&globalTidKeyOnce, lr_create_tid_key);
+    for (tid = 0; tid < LR_MAX_THREADS; tid++) {
+        int free_idx = 0;
+        if (atomic_load_explicit(&globalTidInUse[tid], memory_order_relaxed) != 0) continue;
+        if (atomic_compare_exchange_strong(&globalTidInUse[tid], &free_idx, 1)) {
+            tlThreadIndex = tid;
+            // We store tid+1 because pthreads doesn't call the destructor on NULL values
+            pthread_setspecific(globalTidKey, (void *)(long)(tid + 1));
+            return tid;
+        }
+    }
+    return LR_INVALID_TID;
+}
+
+
+static int lr_ri_init(lr_readindicator_t * ri, int ri_type)
+{
+    int i;
+    ri->type = ri_type;
+    ri->num_entries = (ri_type == LR_RI_STRIPED) ? LR_NUM_STRIPES : LR_MAX_THREADS;
+    ri->entries = (atomic_long *)malloc(sizeof(atomic_long)*ri->num_entries*LR_CLPAD);
+    if (ri->entries == NULL) return ENOMEM;
+    for (i = 0; i < ri->num_entries; i++) {
+        atomic_store_explicit(&ri->entries[i*LR_CLPAD], LR_NOT_READING, memory_order_relaxed);
+    }
+    return 0;
+}
+
+
+static inline void lr_ri_arrive(lr_readindicator_t * ri, int tid)
+{
+    if (ri->type == LR_RI_PER_THREAD) {
+        atomic_store(&ri->entries[tid*LR_CLPAD], LR_READING);
+    } else {
+        atomic_fetch_add(&ri->entries[(tid % LR_NUM_STRIPES)*LR_CLPAD], 1);
+    }
+}
+
+
+static inline void lr_ri_depart(lr_readindicator_t * ri, int tid)
+{
+    if (ri->type == LR_RI_PER_THREAD) {
+        atomic_store(&ri->entries[tid*LR_CLPAD], LR_NOT_READING);
+    } else {
+        atomic_fetch_add(&ri->entries[(tid % LR_NUM_STRIPES)*LR_CLPAD], -1);
+    }
+}
+
+
+static int lr_ri_is_empty(lr_readindicator_t * ri)
+{
+    int i;
+    for (i = 0; i < ri->num_entries; i++) {
+        if (atomic_load(&ri->entries[i*LR_CLPAD]) != LR_NOT_READING) return 0;
+    }
+    return 1;
+}
+
+
+/**
+ * Initializes the Left-Right with the given type of ReadIndicator, which
+ * must be LR_RI_PER_THREAD or LR_RI_STRIPED.
+ *
+ * @return If successful, returns 0, otherwise an error number
+ */
+int lr_init(lr_t * self, int ri_type)
+{
+    int retval;
+    if (self == NULL) return EINVAL;
+    if (ri_type != LR_RI_PER_THREAD && ri_type != LR_RI_STRIPED) return EINVAL;
+
+    retval = pthread_mutex_init(&self->writers_mutex, NULL);
+    if (retval != 0) return retval;
+    retval = lr_ri_init(&self->readers_version[0], ri_type);
+    if (retval != 0) {
+        pthread_mutex_destroy(&self->writers_mutex);
+        return retval;
+    }
+    retval = lr_ri_init(&self->readers_version[1], ri_type);
+    if (retval != 0) {
+        free(self->readers_version[0].entries);
+        self->readers_version[0].entries = NULL;
+        pthread_mutex_destroy(&self->writers_mutex);
+        return retval;
+    }
+    atomic_store(&self->version_index, 0);
+    return 0;
+}
+
+
+/**
+ * There must be no Readers or Writers when this is called
+ */
+int lr_destroy(lr_t * self)
+{
+    if (self == NULL) return EINVAL;
+    free(self->readers_version[0].entries);
+    free(self->readers_version[1].entries);
+    return pthread_mutex_destroy(&self->writers_mutex);
+}
+
+
+/**
+ * Must be called by a Reader before it reads leftRight. The returned value
+ * must be passed to lr_depart().
+ *
+ * @return The version index (0 or 1), or -EAGAIN if this thread has no index
+ *         and there are already LR_MAX_THREADS threads that have one, in
+ *         which case the Reader must not read and must not call lr_depart()
+ */
+int lr_arrive(lr_t * self)
+{
+    const int tid = lr_get_tid();
+    if (tid == LR_INVALID_TID) return -EAGAIN;
+    const int local_vi = atomic_load(&self->version_index);
+    lr_ri_arrive(&self->readers_version[local_vi], tid);
+    return local_vi;
+}
+
+
+void lr_depart(lr_t * self, int local_vi)
+{
+    lr_ri_depart(&self->readers_version[local_vi], tlThreadIndex);
+}
+
+
+/**
+ * Must be called by the Writer (with the writers_mutex held) after it has
+ * changed leftRight and before it modifies the instance where the Readers
+ * were reading.
+ *
+ * Progress Condition: Blocking
+ */
+void lr_toggle_and_wait(lr_t * self)
+{
+    const int local_vi = atomic_load(&self->version_index);
+    const int prev_vi = local_vi & 0x1;
+    const int next_vi = (local_vi+1) & 0x1;
+
+    // Wait for Readers from next version
+    while (!lr_ri_is_empty(&self->readers_version[next_vi])) sched_yield();
+
+    // Toggle the version_index variable
+    atomic_store(&self->version_index, next_vi);
+
+    // Wait for Readers from previous version
+    while (!lr_ri_is_empty(&self->readers_version[prev_vi])) sched_yield();
+}
+
+
+void lr_writer_lock(lr_t * self)
+{
+    pthread_mutex_lock(&self->writers_mutex);
+}
+
+
+void lr_writer_unlock(lr_t * self)
+{
+    pthread_mutex_unlock(&self->writers_mutex);
+}
@@ -0,0 +1,77 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LEFT_RIGHT_H_
+#define _LEFT_RIGHT_H_
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+
+#define LR_MAX_THREADS    128   // Maximum number of simultaneously running threads that can call lr_arrive()
+#define LR_NUM_STRIPES    16    // Number of counters in the LR_RI_STRIPED ReadIndicator
+#define LR_CLPAD          (128/sizeof(atomic_long))
+
+#define LR_READS_ON_LEFT  0
+#define LR_READS_ON_RIGHT 1
+
+// Types of ReadIndicator
+#define LR_RI_PER_THREAD  0     // One entry per thread, arrive/depart are a single store
+#define LR_RI_STRIPED     1     // Counters shared by threads, arrive/depart are a fetch_add()
+
+
+typedef struct
+{
+    int type;
+    int num_entries;
+    atomic_long * entries;      // num_entries*LR_CLPAD, only one of each LR_CLPAD is used
+} lr_readindicator_t;
+
+
+typedef struct
+{
+    lr_readindicator_t readers_version[2];
+    char padding1[64];
+    atomic_int version_index;
+    char padding2[64];
+    pthread_mutex_t writers_mutex;
+} lr_t;
+
+
+int lr_init(lr_t * self, int ri_type);
+int lr_destroy(lr_t * self);
+int lr_arrive(lr_t * self);
+void lr_depart(lr_t * self, int local_vi);
+void lr_toggle_and_wait(lr_t * self);
+void lr_writer_lock(lr_t * self);
+void lr_writer_unlock(lr_t * self);
+
+#endif /* _LEFT_RIGHT_H_ */
@@ -0,0 +1,151 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+/*
+ * An array list protected with Left-Right, with the same API as the
+ * di_arraylist in C99/doubleinst, so that the two can be compared.
+ * The Readers never block, even when a Writer is adding or removing items.
+ * Like di_arraylist, the array does not grow, so there can be no more than
+ * initialSize items in the list.
+ *
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lr_arraylist.h"
+
+
+/**
+ * riType must be LR_RI_PER_THREAD or LR_RI_STRIPED
+ */
+void lr_arraylist_init(lr_arraylist_t * const self, int initialSize, int riType) {
+    lr_init(&self->lr, riType);
+    atomic_store(&self->leftRight, LR_READS_ON_LEFT);
+    self->arraySize = initialSize;
+    self->usedSize[0] = 0;
+    self->usedSize[1] = 0;
+    self->arrayList[0] = (void **)malloc(sizeof(void *)*self->arraySize);
+    self->arrayList[1] = (void **)malloc(sizeof(void *)*self->arraySize);
+}
+
+
+void lr_arraylist_destroy(lr_arraylist_t * const self) {
+    lr_destroy(&self->lr);
+    free(self->arrayList[0]);
+    free(self->arrayList[1]);
+}
+
+
+static int lr_arraylist_add_instance(lr_arraylist_t * const self, const int inst, void * const item) {
+    if (self->usedSize[inst] == self->arraySize) return 0;
+    self->arrayList[inst][self->usedSize[inst]] = item;
+    self->usedSize[inst]++;
+    return 1;
+}
+
+
+static int lr_arraylist_remove_instance(lr_arraylist_t * const self, const int inst, void * const item) {
+    int index;
+    for (index = 0; index < self->usedSize[inst]; index++) {
+        if (self->arrayList[inst][index] == item) {
+            // Move items to the left to fill empty slot
+            memmove(&self->arrayList[inst][index], &self->arrayList[inst][index+1], sizeof(void *)*(self->usedSize[inst]-index-1));
+            self->usedSize[inst]--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Returns 1 if the item was added, and 0 if the array is full
+ */
+int lr_arraylist_add(lr_arraylist_t * const self, void * const item) {
+    int retValue;
+    lr_writer_lock(&self->lr);
+    const int lr = atomic_load_explicit(&self->leftRight, memory_order_relaxed);
+    // Add item to the instance where no Readers are, then toggle and add to the other
+    retValue = lr_arraylist_add_instance(self, 1-lr, item);
+    if (retValue == 0) {
+        lr_writer_unlock(&self->lr);
+        return retValue;
+    }
+    atomic_store(&self->leftRight, 1-lr);
+    lr_toggle_and_wait(&self->lr);
+    lr_arraylist_add_instance(self, lr, item);
+    lr_writer_unlock(&self->lr);
+    return retValue;
+}
+
+
+/**
+ * Returns 1 if remove was successful, and 0 if item was not found
+ */
+int lr_arraylist_remove(lr_arraylist_t * const self, void * const item) {
+    int retValue;
+    lr_writer_lock(&self->lr);
+    const int lr = atomic_load_explicit(&self->leftRight, memory_order_relaxed);
+    retValue = lr_arraylist_remove_instance(self, 1-lr, item);
+    if (retValue == 0) {
+        // The item is not in the arraylist
+        lr_writer_unlock(&self->lr);
+        return retValue;
+    }
+    atomic_store(&self->leftRight, 1-lr);
+    lr_toggle_and_wait(&self->lr);
+    lr_arraylist_remove_instance(self, lr, item);
+    lr_writer_unlock(&self->lr);
+    return retValue;
+}
+
+
+/**
+ * Returns 1 if item is found, zero if not found, and -EAGAIN if lr_arrive()
+ * failed because there are already LR_MAX_THREADS reader threads
+ *
+ * Progress Condition: same as lr_arrive()
+ */
+int lr_arraylist_contains(lr_arraylist_t * const self, void * const item) {
+    int index, retValue = 0;
+    const int lvi = lr_arrive(&self->lr);
+    if (lvi < 0) return lvi;
+    const int lr = atomic_load(&self->leftRight);
+    void ** const arrayList = self->arrayList[lr];
+    const int usedSize = self->usedSize[lr];
+    for (index = 0; index < usedSize; index++) {
+        if (arrayList[index] == item) {
+            retValue = 1;
+            break;
+        }
+    }
+    lr_depart(&self->lr, lvi);
+    return retValue;
+}
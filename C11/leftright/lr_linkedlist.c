@@ -0,0 +1,150 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+/*
+ * A linked list protected with Left-Right, with the same API as the
+ * di_linkedlist in C99/doubleinst.
+ * Just like in di_linkedlist, the nodes are shared by the two instances and
+ * each node has one "next" for each instance. A node is only freed after it
+ * has been unlinked from both instances, at which point no Reader can have
+ * a reference to it because of the lr_toggle_and_wait() in between.
+ *
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include "lr_linkedlist.h"
+
+
+/**
+ * riType must be LR_RI_PER_THREAD or LR_RI_STRIPED
+ */
+void lr_linkedlist_init(lr_linkedlist_t * const self, int riType) {
+    lr_init(&self->lr, riType);
+    atomic_store(&self->leftRight, LR_READS_ON_LEFT);
+    self->head = (lrll_node_t *)malloc(sizeof(lrll_node_t));
+    self->head->next[0] = NULL;
+    self->head->next[1] = NULL;
+    self->head->item = NULL;
+    self->tail[0] = self->head;
+    self->tail[1] = self->head;
+}
+
+
+/**
+ * There must be no other threads accessing the list
+ */
+void lr_linkedlist_destroy(lr_linkedlist_t * const self) {
+    lrll_node_t * node = self->head;
+    while (node != NULL) {
+        lrll_node_t * next = node->next[0];
+        free(node);
+        node = next;
+    }
+    lr_destroy(&self->lr);
+}
+
+
+int lr_linkedlist_add(lr_linkedlist_t * const self, void * const item) {
+    lrll_node_t * newNode = (lrll_node_t *)malloc(sizeof(lrll_node_t));
+    newNode->next[0] = NULL;
+    newNode->next[1] = NULL;
+    newNode->item = item;
+
+    lr_writer_lock(&self->lr);
+    const int lr = atomic_load_explicit(&self->leftRight, memory_order_relaxed);
+    // Add item to the instance where no Readers are
+    self->tail[1-lr]->next[1-lr] = newNode;
+    self->tail[1-lr] = newNode;
+    atomic_store(&self->leftRight, 1-lr);
+    lr_toggle_and_wait(&self->lr);
+    // Add item to the instance where the Readers were
+    self->tail[lr]->next[lr] = newNode;
+    self->tail[lr] = newNode;
+    lr_writer_unlock(&self->lr);
+    return 0;
+}
+
+
+/**
+ * Returns 1 if remove was successful, and 0 if item was not found
+ */
+int lr_linkedlist_remove(lr_linkedlist_t * const self, void * const item) {
+    lr_writer_lock(&self->lr);
+    const int lr = atomic_load_explicit(&self->leftRight, memory_order_relaxed);
+    const int other = 1-lr;
+    lrll_node_t * prev = self->head;
+    lrll_node_t * node = prev->next[other];
+    while (node != NULL && node->item != item) {
+        prev = node;
+        node = node->next[other];
+    }
+    if (node == NULL) {
+        // The item is not in the linked list
+        lr_writer_unlock(&self->lr);
+        return 0;
+    }
+    // Remove item from the instance where no Readers are
+    prev->next[other] = node->next[other];
+    if (self->tail[other] == node) self->tail[other] = prev;
+    atomic_store(&self->leftRight, other);
+    lr_toggle_and_wait(&self->lr);
+
+    // Remove item from the instance where the Readers were. Both instances
+    // are the same when the writers_mutex is acquired, so prev is the same.
+    prev->next[lr] = node->next[lr];
+    if (self->tail[lr] == node) self->tail[lr] = prev;
+    lr_writer_unlock(&self->lr);
+    free(node);
+    return 1;
+}
+
+
+/**
+ * Returns 1 if item is found, zero if not found, and -EAGAIN if lr_arrive()
+ * failed because there are already LR_MAX_THREADS reader threads
+ *
+ * Progress Condition: same as lr_arrive()
+ */
+int lr_linkedlist_contains(lr_linkedlist_t * const self, void * const item) {
+    int retValue = 0;
+    const int lvi = lr_arrive(&self->lr);
+    if (lvi < 0) return lvi;
+    const int lr = atomic_load(&self->leftRight);
+    lrll_node_t * node = self->head->next[lr];
+    while (node != NULL) {
+        if (node->item == item) {
+            retValue = 1;
+            break;
+        }
+        node = node->next[lr];
+    }
+    lr_depart(&self->lr, lvi);
+    return retValue;
+}
@@ -0,0 +1,55 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LEFT_RIGHT_LINKEDLIST_H_
+#define _LEFT_RIGHT_LINKEDLIST_H_
+
+#include "left_right.h"
+
+
+typedef struct lrll_node_t {
+    struct lrll_node_t * next[2];
+    void * item;
+} lrll_node_t;
+
+typedef struct {
+    lrll_node_t * head;
+    lrll_node_t * tail[2];
+    atomic_int leftRight;
+    char padding[64];
+    lr_t lr;
+} lr_linkedlist_t;
+
+void lr_linkedlist_init(lr_linkedlist_t * const self, int riType);
+void lr_linkedlist_destroy(lr_linkedlist_t * const self);
+int lr_linkedlist_add(lr_linkedlist_t * const self, void * const item);
+int lr_linkedlist_remove(lr_linkedlist_t * const self, void * const item);
+int lr_linkedlist_contains(lr_linkedlist_t * const self, void * const item);
+
+
+#endif // _LEFT_RIGHT_LINKEDLIST_H_
@@ -36,6 +36,8 @@
 #include "rw_arraylist.h"
 #include "di_linkedlist.h"
 #include "rw_linkedlist.h"
+#include "lr_arraylist.h"
+#include "lr_linkedlist.h"
 //#include "crwwp_linkedlist.h"
 
 /*
@@ -54,6 +56,9 @@ di_arraylist_t dial;
 rw_arraylist_t rwal;
 di_linkedlist_t dill;
 rw_linkedlist_t rwll;
+lr_arraylist_t lral;
+lr_arraylist_t lrsal;
+lr_linkedlist_t lrll;
 //crwwp_linkedlist_t crwwpll;
 
 #define TYPE_READER_WRITER_AL       0
@@ -61,6 +66,9 @@ rw_linkedlist_t rwll;
 #define TYPE_READER_WRITER_LL       2
 #define TYPE_DOUBLE_INSTANCE_LL     3
 #define TYPE_CRWWP_LL               4
+#define TYPE_LEFT_RIGHT_AL          5
+#define TYPE_LEFT_RIGHT_STRIPED_AL  6
+#define TYPE_LEFT_RIGHT_LL          7
 
 
 atomic_int g_quit = ATOMIC_VAR_INIT(0);
@@ -125,6 +133,15 @@ void worker_thread(int *tid) {
             } else if (g_which_lock == TYPE_CRWWP_LL) {
                 //crwwp_linkedlist_contains(&crwwpll, item1);
                 //crwwp_linkedlist_contains(&crwwpll, item2);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_AL) {
+                lr_arraylist_contains(&lral, item1);
+                lr_arraylist_contains(&lral, item2);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_STRIPED_AL) {
+                lr_arraylist_contains(&lrsal, item1);
+                lr_arraylist_contains(&lrsal, item2);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_LL) {
+                lr_linkedlist_contains(&lrll, item1);
+                lr_linkedlist_contains(&lrll, item2);
             }
         } else {
             if (g_which_lock == TYPE_READER_WRITER_AL) {
@@ -142,6 +159,15 @@ void worker_thread(int *tid) {
             } else if (g_which_lock == TYPE_CRWWP_LL) {
                 //crwwp_linkedlist_remove(&crwwpll, item1);
                 //crwwp_linkedlist_add(&crwwpll, item1);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_AL) {
+                lr_arraylist_remove(&lral, item1);
+                lr_arraylist_add(&lral, item1);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_STRIPED_AL) {
+                lr_arraylist_remove(&lrsal, item1);
+                lr_arraylist_add(&lrsal, item1);
+            } else if (g_which_lock == TYPE_LEFT_RIGHT_LL) {
+                lr_linkedlist_remove(&lrll, item1);
+                lr_linkedlist_add(&lrll, item1);
             }
         }
         iterations++;
@@ -200,12 +226,18 @@ int main(void) {
     di_arraylist_init(&dial, 2*ARRAY_SIZE);
     rw_linkedlist_init(&rwll);
     di_linkedlist_init(&dill);
+    lr_arraylist_init(&lral, 2*ARRAY_SIZE, LR_RI_PER_THREAD);
+    lr_arraylist_init(&lrsal, 2*ARRAY_SIZE, LR_RI_STRIPED);
+    lr_linkedlist_init(&lrll, LR_RI_PER_THREAD);
     //crwwp_linkedlist_init(&crwwpll);
     for (i = 0; i < ARRAY_SIZE; i++) {
         rw_arraylist_add(&rwal, &array1[i]);
         di_arraylist_add(&dial, &array1[i]);
         rw_linkedlist_add(&rwll, &array1[i]);
         di_linkedlist_add(&dill, &array1[i]);
+        lr_arraylist_add(&lral, &array1[i]);
+        lr_arraylist_add(&lrsal, &array1[i]);
+        lr_linkedlist_add(&lrll, &array1[i]);
         //crwwp_linkedlist_add(&crwwpll, &array1[i]);
     }
 
@@ -221,6 +253,9 @@ int main(void) {
         singleTest(threadList[i], "di_arraylist, sleeping for 10 seconds...\n",     TYPE_DOUBLE_INSTANCE_AL, pthread_list);
         singleTest(threadList[i], "rw_linkedlist_t, sleeping for 10 seconds...\n",  TYPE_READER_WRITER_LL,   pthread_list);
         singleTest(threadList[i], "di_linkedlist, sleeping for 10 seconds...\n",    TYPE_DOUBLE_INSTANCE_LL, pthread_list);
+        singleTest(threadList[i], "lr_arraylist (per-thread RI), sleeping for 10 seconds...\n", TYPE_LEFT_RIGHT_AL, pthread_list);
+        singleTest(threadList[i], "lr_arraylist (striped RI), sleeping for 10 seconds...\n",    TYPE_LEFT_RIGHT_STRIPED_AL, pthread_list);
+        singleTest(threadList[i], "lr_linkedlist (per-thread RI), sleeping for 10 seconds...\n", TYPE_LEFT_RIGHT_LL, pthread_list);
         //singleTest(threadList[i], "crwwp_linkedlist, sleeping for 10 seconds...\n", TYPE_CRWWP_LL,           pthread_list);
     }
 
@@ -229,6 +264,9 @@ int main(void) {
     di_arraylist_destroy(&dial);
     rw_linkedlist_destroy(&rwll);
     di_linkedlist_destroy(&dill);
+    lr_arraylist_destroy(&lral);
+    lr_arraylist_destroy(&lrsal);
+    lr_linkedlist_destroy(&lrll);
     //crwwp_linkedlist_destroy(&crwwpll);
 
     /* Release memory for the array instances and threads */
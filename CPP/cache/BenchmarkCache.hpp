@@ -0,0 +1,276 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+#ifndef _BENCHMARK_CACHE_H_
+#define _BENCHMARK_CACHE_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+#include "LRClockCache.hpp"
+#include "LFClockCache.hpp"
+#include "ZipfGenerator.hpp"
+
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * An LRU cache protected with a single mutex, where every hit moves the entry
+ * to the head of the list. This is what we compare the CLOCK caches against,
+ * both for throughput and for hit rate.
+ */
+class LockedLRUCache {
+    const uint64_t capacity;
+    std::mutex mutex;
+    std::list<std::pair<uint64_t,uint32_t>> lru;
+    std::unordered_map<uint64_t,std::list<std::pair<uint64_t,uint32_t>>::iterator> map;
+
+public:
+    LockedLRUCache(const uint64_t capacity) : capacity{capacity} {
+        map.reserve(capacity);
+    }
+
+    static std::string className() { return "LockedLRUCache"; }
+
+    bool get(const uint64_t key, uint32_t& value, const int tid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = map.find(key);
+        if (it == map.end()) return false;
+        lru.splice(lru.begin(), lru, it->second);
+        value = it->second->second;
+        return true;
+    }
+
+    bool put(const uint64_t key, const uint32_t value, const int tid) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = map.find(key);
+        if (it != map.end()) {
+            it->second->second = value;
+            lru.splice(lru.begin(), lru, it->second);
+            return false;
+        }
+        if (map.size() == capacity) {
+            map.erase(lru.back().first);
+            lru.pop_back();
+        }
+        lru.emplace_front(key, value);
+        map[key] = lru.begin();
+        return true;
+    }
+};
+
+
+/**
+ * This is a micro-benchmark for bounded caches on a Zipfian trace of keys.
+ * Each thread goes over the (shared) trace starting at a different offset and
+ * does a getOrLoad(), where the loader is free, so the cost of a miss is only
+ * the cost of the writer path (insertion plus eviction).
+ * We measure the number of lookups per second and the hit rate.
+ */
+class BenchmarkCache {
+
+public:
+    enum CacheTestCase { LRClock, LFClock, LockedLRU };
+    std::string TestCaseStr[3] = {
+        LRClockCache<uint64_t,uint32_t>::className(),
+        LFClockCache::className(),
+        LockedLRUCache::className()
+    };
+
+    struct Result {
+        long long opsPerSec;
+        double    hitRate;
+    };
+
+private:
+    const int numThreads;
+    const vector<uint64_t>& trace;
+
+public:
+    BenchmarkCache(const int numThreads, const vector<uint64_t>& trace) : numThreads{numThreads}, trace{trace} { }
+
+
+    /**
+     * The cache is warmed up by the main thread with the beginning of the
+     * trace before the worker threads start. Returns the median lookups per
+     * second and the hit rate of that run.
+     */
+    template<typename C, typename... Args>
+    Result benchmark(CacheTestCase tc, const seconds testLengthSeconds, const int numRuns, Args... args) {
+        long long ops[numThreads][numRuns];
+        long long hits[numThreads][numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        C* cache = nullptr;
+        const uint64_t traceSize = trace.size();
+
+        std::cout << "##### " << TestCaseStr[tc] << " #####\n";
+
+        auto cache_lambda = [this,&quit,&startFlag,&cache,traceSize](long long *ops, long long *hits, const int tid) {
+            long long numOps = 0, numHits = 0;
+            uint64_t itrace = (traceSize/numThreads)*tid;
+            uint32_t value;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                for (int i = 0; i < 100; i++) {
+                    const uint64_t key = trace[itrace];
+                    if (++itrace == traceSize) itrace = 0;
+                    if (cache->get(key, value, tid)) {
+                        numHits++;
+                    } else {
+                        cache->put(key, (uint32_t)key, tid);
+                    }
+                }
+                numOps += 100;
+            }
+            *ops = numOps;
+            *hits = numHits;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            cache = new C(args...);
+            uint32_t value;
+            for (uint64_t i = 0; i < traceSize/4; i++) {
+                if (!cache->get(trace[i], value, 0)) cache->put(trace[i], (uint32_t)trace[i], 0);
+            }
+            thread cacheThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) cacheThreads[tid] = thread(cache_lambda, &ops[tid][irun], &hits[tid][irun], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) cacheThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            delete cache;
+        }
+
+        // Accounting
+        vector<pair<long long,double>> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            long long totalOps = 0, totalHits = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                totalOps += ops[tid][irun];
+                totalHits += hits[tid][irun];
+            }
+            agg[irun] = make_pair(totalOps, (totalOps == 0) ? 0 : (100.*totalHits)/totalOps);
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        Result result { agg[numRuns/2].first/testLengthSeconds.count(), agg[numRuns/2].second };
+        cout << "Lookups/sec = " << result.opsPerSec << "   Hit rate = " << result.hitRate << "%\n";
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+    /**
+     * Makes a trace of traceSize keys with a Zipfian distribution over
+     * numKeys keys. The ranks are scrambled so that the popular keys are not
+     * all next to each other (and on the same shard).
+     */
+    static vector<uint64_t> makeZipfTrace(const uint64_t numKeys, const double theta, const uint64_t traceSize) {
+        ZipfGenerator zipf(numKeys, theta);
+        vector<uint64_t> trace(traceSize);
+        uint64_t seed = 1234567890123456781ULL;
+        for (uint64_t i = 0; i < traceSize; i++) {
+            seed = randomLong(seed);
+            const uint64_t rank = zipf.next((seed >> 11)*(1.0/9007199254740992.0));
+            trace[i] = (rank*0x9E3779B97F4A7C15ULL) >> 8;  // Scramble, and keep it away from the reserved keys
+        }
+        return trace;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        vector<uint64_t> capacityList = { 10000, 100000 };  // 1% and 10% of the keys
+        const uint64_t numKeys = 1000000;
+        const double theta = 0.99;
+        const int numRuns = 5;
+        const int numShards = 16;
+        const seconds testLength = 10s;
+        const int NUM_CLASSES = 3;
+        Result res[NUM_CLASSES][capacityList.size()][threadList.size()];
+
+        std::cout << "Generating Zipfian trace over " << numKeys << " keys with theta=" << theta << "\n";
+        const vector<uint64_t> trace = makeZipfTrace(numKeys, theta, 4*numKeys);
+
+        for (unsigned icap = 0; icap < capacityList.size(); icap++) {
+            const uint64_t capacity = capacityList[icap];
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                auto nThreads = threadList[ithread];
+                BenchmarkCache bench(nThreads, trace);
+                std::cout << "\n----- Cache Benchmark   numThreads=" << nThreads << "   capacity=" << capacity << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                res[0][icap][ithread] = bench.benchmark<LRClockCache<uint64_t,uint32_t>>(LRClock, testLength, numRuns, (int)capacity, numShards);
+                res[1][icap][ithread] = bench.benchmark<LFClockCache>(LFClock, testLength, numRuns, capacity, numShards, nThreads);
+                res[2][icap][ithread] = bench.benchmark<LockedLRUCache>(LockedLRU, testLength, numRuns, capacity);
+            }
+        }
+
+        // Show results in csv format
+        for (unsigned icap = 0; icap < capacityList.size(); icap++) {
+            cout << "\n\nResults in lookups per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s,  capacity=" << capacityList[icap] << " \n";
+            cout << "Threads, LRClock, LFClock, LockedLRU\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << res[ic][icap][ithread].opsPerSec << ", ";
+                cout << "\n";
+            }
+            cout << "\nHit rate (%) for capacity=" << capacityList[icap] << " \n";
+            cout << "Threads, LRClock, LFClock, LockedLRU\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << res[ic][icap][ithread].hitRate << ", ";
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,213 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LF_CLOCK_CACHE_H_
+#define _LF_CLOCK_CACHE_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include "LFHashMap.h"
+
+/**
+ * <h1> Lock-Free CLOCK Cache </h1>
+ *
+ * A bounded cache with 64 bit keys and 32 bit values (typically an index or a
+ * handle to the cached object) on top of a single LFHashMap.
+ * The value stored in the hash map packs the user's value with the index of
+ * the slot of the entry, so that a hit is one lock-free find() followed by a
+ * relaxed store on the reference bit of that slot.
+ *
+ * The slots are split in numShards shards, each with its own CLOCK hand and
+ * writersMutex. Inserting a new key (usually after a miss) locks the shard of
+ * the key, takes a free slot or runs the CLOCK sweep to find a victim, removes
+ * the victim from the hash map and inserts the new key. Readers never wait
+ * for the writers.
+ * A reader that gets a slot index just before the entry is evicted may set the
+ * reference bit of the slot after it was given to a new key, which is harmless.
+ *
+ * get()       - Lock-Free
+ * put()       - Blocking
+ * remove()    - Blocking
+ * getOrLoad() - Lock-Free on a hit, Blocking on a miss
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class LFClockCache {
+
+private:
+    static const int MAX_THREADS = 128;
+
+    struct alignas(128) Shard {
+        std::mutex            writersMutex;
+        // These are accessed only with the writersMutex held
+        uint64_t              firstSlot = 0;
+        uint64_t              capacity = 0;
+        uint64_t              hand = 0;
+        std::vector<uint64_t> freeSlots;
+    };
+
+    const int               numShards;
+    const uint64_t          capacity;
+    LFHashMap               map;
+    Shard*                  shards;
+    uint64_t*               slotKey;   // Protected by the writersMutex of the shard that owns the slot
+    std::atomic<uint8_t>*   refBits;
+
+    static inline uint64_t pack(const uint32_t value, const uint64_t slot) {
+        return (slot << 32) | value;
+    }
+
+    inline Shard& shardOf(const uint64_t key) {
+        uint64_t x = key;
+        x ^= (x >> 33);
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= (x >> 33);
+        return shards[x % numShards];
+    }
+
+    // CLOCK sweep over the slots of the shard: skip (and clear) the slots whose reference bit is set
+    uint64_t findVictim(Shard& sh) {
+        while (refBits[sh.firstSlot+sh.hand].load(std::memory_order_relaxed) != 0) {
+            refBits[sh.firstSlot+sh.hand].store(0, std::memory_order_relaxed);
+            sh.hand = (sh.hand+1) % sh.capacity;
+        }
+        const uint64_t victim = sh.firstSlot+sh.hand;
+        sh.hand = (sh.hand+1) % sh.capacity;
+        return victim;
+    }
+
+public:
+    LFClockCache(const uint64_t capacity, const int numShards=16, const int maxThreads=MAX_THREADS)
+        : numShards{numShards}, capacity{((capacity+numShards-1)/numShards)*numShards}, map{maxThreads, 2*capacity} {
+        if (this->capacity >= (1ULL << 30)) throw std::invalid_argument("capacity must be less than 2^30");
+        shards = new Shard[numShards];
+        slotKey = new uint64_t[this->capacity];
+        refBits = new std::atomic<uint8_t>[this->capacity];
+        const uint64_t shardCapacity = this->capacity/numShards;
+        for (int ishard = 0; ishard < numShards; ishard++) {
+            Shard& sh = shards[ishard];
+            sh.firstSlot = ishard*shardCapacity;
+            sh.capacity = shardCapacity;
+            for (uint64_t islot = sh.firstSlot+shardCapacity; islot > sh.firstSlot; islot--) {
+                refBits[islot-1].store(0, std::memory_order_relaxed);
+                sh.freeSlots.push_back(islot-1);
+            }
+        }
+    }
+
+    ~LFClockCache() {
+        delete[] refBits;
+        delete[] slotKey;
+        delete[] shards;
+    }
+
+    static std::string className() { return "LFClockCache"; }
+
+
+    /**
+     * Returns true and copies the value if the key is in the cache
+     *
+     * Progress Condition: Lock-Free
+     */
+    bool get(const uint64_t key, uint32_t& value, const int tid) {
+        uint64_t packed;
+        if (!map.find(key, packed, tid)) return false;
+        value = (uint32_t)packed;
+        std::atomic<uint8_t>& refBit = refBits[packed >> 32];
+        if (refBit.load(std::memory_order_relaxed) == 0) refBit.store(1, std::memory_order_relaxed);
+        return true;
+    }
+
+
+    /**
+     * Inserts or updates the key. If the shard is full, the victim chosen by
+     * the CLOCK sweep is evicted.
+     * Returns true if the key was not in the cache.
+     *
+     * Progress Condition: Blocking
+     */
+    bool put(const uint64_t key, const uint32_t value, const int tid) {
+        Shard& sh = shardOf(key);
+        std::lock_guard<std::mutex> lock(sh.writersMutex);
+        uint64_t packed;
+        // All the writes on this key are done with this writersMutex held
+        if (map.find(key, packed, tid)) {
+            map.insert(key, pack(value, packed >> 32), tid);
+            return false;
+        }
+        uint64_t slot;
+        if (!sh.freeSlots.empty()) {
+            slot = sh.freeSlots.back();
+            sh.freeSlots.pop_back();
+        } else {
+            slot = findVictim(sh);
+            map.erase(slotKey[slot], tid);
+        }
+        slotKey[slot] = key;
+        refBits[slot].store(0, std::memory_order_relaxed);
+        map.insert(key, pack(value, slot), tid);
+        return true;
+    }
+
+
+    /**
+     * Returns true if the key was in the cache
+     *
+     * Progress Condition: Blocking
+     */
+    bool remove(const uint64_t key, const int tid) {
+        Shard& sh = shardOf(key);
+        std::lock_guard<std::mutex> lock(sh.writersMutex);
+        uint64_t packed;
+        if (!map.find(key, packed, tid)) return false;
+        map.erase(key, tid);
+        sh.freeSlots.push_back(packed >> 32);
+        return true;
+    }
+
+
+    /**
+     * Read-through: on a miss, calls loader(key) and puts the result in the cache.
+     * Two threads missing on the same key may both call the loader.
+     */
+    uint32_t getOrLoad(const uint64_t key, const std::function<uint32_t(const uint64_t&)>& loader, const int tid) {
+        uint32_t value;
+        if (get(key, value, tid)) return value;
+        value = loader(key);
+        put(key, value, tid);
+        return value;
+    }
+};
+
+#endif /* _LF_CLOCK_CACHE_H_ */
@@ -0,0 +1,255 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LR_CLOCK_CACHE_H_
+#define _LR_CLOCK_CACHE_H_
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_map>
+#include "LeftRightClassic.h"
+#include "RIAtomicCounter.h"
+
+/**
+ * <h1> Left-Right CLOCK Cache </h1>
+ *
+ * A bounded cache split in numShards shards, where each shard is a pair of
+ * std::unordered_map protected with a Left-Right Classic, and entries are
+ * evicted with the CLOCK algorithm once the shard is at capacity.
+ *
+ * Doing LRU would require moving the entry to the head of a list on every hit,
+ * which is a mutation and would go through the writersMutex. Instead, each slot
+ * of a shard has a reference bit, and a hit (inside the Left-Right read-only
+ * section) just sets that bit with a relaxed store, and only if it is not set
+ * already, so that hot entries don't keep bouncing the cache line.
+ * The CLOCK hand, the free slots and the slot-to-key table are only touched by
+ * the writer path, with the writersMutex of the shard held.
+ * The reference bits are shared by both instances of the map, which means that
+ * a reader still on the old instance can set the bit of a slot that was just
+ * given to a new key. This makes the hint a bit less accurate, nothing more.
+ *
+ * get()       - Progress of RI.arrive()/RI.depart()
+ * put()       - Blocking
+ * remove()    - Blocking
+ * getOrLoad() - Progress of get() on a hit, Blocking on a miss
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename K, typename V, class RI = RIAtomicCounter>
+class LRClockCache {
+
+private:
+    static const int READS_ON_LEFT=0;
+    static const int READS_ON_RIGHT=1;
+
+    struct Entry {
+        V   value;
+        int slot;
+    };
+
+    struct alignas(128) Shard {
+        LeftRight::LeftRightClassic<RI> lrc;
+        std::atomic<int>                leftRight { READS_ON_LEFT };
+        std::unordered_map<K,Entry>     mapLeft;
+        std::unordered_map<K,Entry>     mapRight;
+        // Written by readers with relaxed stores, cleared by the CLOCK sweep
+        std::atomic<uint8_t>*           refBits = nullptr;
+        // These are accessed only with the writersMutex held
+        int                             capacity = 0;
+        int                             hand = 0;
+        std::vector<K>                  slotKey;
+        std::vector<int>                freeSlots;
+    };
+
+    const int numShards;
+    Shard*    shards;
+    std::hash<K> hashFunc;
+
+    inline Shard& shardOf(const K& key) {
+        std::size_t x = hashFunc(key);
+        x ^= (x >> 33);
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= (x >> 33);
+        return shards[x % numShards];
+    }
+
+    // Applies the mutation to both instances. Must be called with the writersMutex held.
+    template<typename F>
+    void applyMutation(Shard& sh, F mutation) {
+        if (sh.leftRight.load(std::memory_order_relaxed) == READS_ON_LEFT) {
+            mutation(sh.mapRight);
+            sh.leftRight.store(READS_ON_RIGHT);
+            sh.lrc.toggleVersionAndWait();
+            mutation(sh.mapLeft);
+        } else {
+            mutation(sh.mapLeft);
+            sh.leftRight.store(READS_ON_LEFT);
+            sh.lrc.toggleVersionAndWait();
+            mutation(sh.mapRight);
+        }
+    }
+
+    // CLOCK sweep: skip (and clear) the slots whose reference bit is set
+    int findVictim(Shard& sh) {
+        while (sh.refBits[sh.hand].load(std::memory_order_relaxed) != 0) {
+            sh.refBits[sh.hand].store(0, std::memory_order_relaxed);
+            sh.hand = (sh.hand+1) % sh.capacity;
+        }
+        const int victim = sh.hand;
+        sh.hand = (sh.hand+1) % sh.capacity;
+        return victim;
+    }
+
+public:
+    LRClockCache(const int capacity, const int numShards=16) : numShards{numShards} {
+        shards = new Shard[numShards];
+        const int shardCapacity = (capacity+numShards-1)/numShards;
+        for (int ishard = 0; ishard < numShards; ishard++) {
+            Shard& sh = shards[ishard];
+            sh.capacity = shardCapacity;
+            sh.refBits = new std::atomic<uint8_t>[shardCapacity];
+            sh.slotKey.resize(shardCapacity);
+            for (int islot = shardCapacity-1; islot >= 0; islot--) {
+                sh.refBits[islot].store(0, std::memory_order_relaxed);
+                sh.freeSlots.push_back(islot);
+            }
+            sh.mapLeft.reserve(shardCapacity);
+            sh.mapRight.reserve(shardCapacity);
+        }
+    }
+
+    ~LRClockCache() {
+        for (int ishard = 0; ishard < numShards; ishard++) delete[] shards[ishard].refBits;
+        delete[] shards;
+    }
+
+    static std::string className() { return "LRClockCache"; }
+
+
+    /**
+     * Returns true and copies the value if the key is in the cache.
+     * The tid is not used, it's here to have the same API as LFClockCache.
+     *
+     * Progress Condition: Progress of RI.arrive() and RI.depart()
+     */
+    bool get(const K& key, V& value, const int tid=0) {
+        Shard& sh = shardOf(key);
+        const int lvi = sh.lrc.arrive();
+        auto& map = (sh.leftRight.load() == READS_ON_LEFT) ? sh.mapLeft : sh.mapRight;
+        auto it = map.find(key);
+        const bool found = (it != map.end());
+        if (found) {
+            value = it->second.value;
+            std::atomic<uint8_t>& refBit = sh.refBits[it->second.slot];
+            if (refBit.load(std::memory_order_relaxed) == 0) refBit.store(1, std::memory_order_relaxed);
+        }
+        sh.lrc.depart(lvi);
+        return found;
+    }
+
+
+    /**
+     * Inserts or updates the key. If the shard is full, the victim chosen by
+     * the CLOCK sweep is evicted in the same mutation.
+     * Returns true if the key was not in the cache.
+     *
+     * Progress Condition: Blocking
+     */
+    bool put(const K& key, const V& value, const int tid=0) {
+        Shard& sh = shardOf(key);
+        sh.lrc.writersLock();
+        // Both instances are the same when the writersMutex is held
+        auto it = sh.mapLeft.find(key);
+        if (it != sh.mapLeft.end()) {
+            const Entry entry { value, it->second.slot };
+            applyMutation(sh, [&key,&entry] (std::unordered_map<K,Entry>& map) { map[key] = entry; });
+            sh.lrc.writersUnlock();
+            return false;
+        }
+        int slot;
+        bool evict = false;
+        K victimKey;
+        if (!sh.freeSlots.empty()) {
+            slot = sh.freeSlots.back();
+            sh.freeSlots.pop_back();
+        } else {
+            slot = findVictim(sh);
+            victimKey = sh.slotKey[slot];
+            evict = true;
+        }
+        sh.slotKey[slot] = key;
+        sh.refBits[slot].store(0, std::memory_order_relaxed);
+        const Entry entry { value, slot };
+        applyMutation(sh, [&key,&entry,evict,&victimKey] (std::unordered_map<K,Entry>& map) {
+            if (evict) map.erase(victimKey);
+            map.insert(std::make_pair(key, entry));
+        });
+        sh.lrc.writersUnlock();
+        return true;
+    }
+
+
+    /**
+     * Returns true if the key was in the cache
+     *
+     * Progress Condition: Blocking
+     */
+    bool remove(const K& key, const int tid=0) {
+        Shard& sh = shardOf(key);
+        sh.lrc.writersLock();
+        auto it = sh.mapLeft.find(key);
+        if (it == sh.mapLeft.end()) {
+            sh.lrc.writersUnlock();
+            return false;
+        }
+        sh.freeSlots.push_back(it->second.slot);
+        applyMutation(sh, [&key] (std::unordered_map<K,Entry>& map) { map.erase(key); });
+        sh.lrc.writersUnlock();
+        return true;
+    }
+
+
+    /**
+     * Read-through: on a miss, calls loader(key) and puts the result in the cache.
+     * Two threads missing on the same key may both call the loader.
+     */
+    V getOrLoad(const K& key, const std::function<V(const K&)>& loader, const int tid=0) {
+        V value;
+        if (get(key, value, tid)) return value;
+        value = loader(key);
+        put(key, value, tid);
+        return value;
+    }
+};
+
+#endif /* _LR_CLOCK_CACHE_H_ */
@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Jun 20, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkCache.hpp"
+
+
+
+int main(void) {
+    BenchmarkCache::allThroughputTests();
+    return 0;
+}
@@ -34,6 +34,7 @@
 #include <thread>
 #include "ReadIndicator.h"
 #include "RIAtomicCounter.h"
+#include "USDTProbes.hpp"
 
 namespace LeftRight {
 
@@ -118,6 +119,7 @@ public:
         const int localVI = _versionIndex.load();
         const int prevVI = localVI & 0x1;
         const int nextVI = (localVI+1) & 0x1;
+        CF_PROBE2(lr_toggle_begin, this, nextVI);
 
         // Wait for Readers from next version
         while (!_readersVersion[nextVI]->isEmpty()) {
@@ -131,6 +133,7 @@ public:
         while (!_readersVersion[prevVI]->isEmpty()) {
             std::this_thread::yield();
         }
+        CF_PROBE2(lr_toggle_end, this, nextVI);
     }
 
 
@@ -0,0 +1,130 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LEFT_RIGHT_CLASSIC_GROUP_H_
+#define _LEFT_RIGHT_CLASSIC_GROUP_H_
+
+#include <atomic>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include "LeftRightClassic.h"
+#include "RIAtomicCounter.h"
+
+namespace LeftRight {
+
+/**
+ * Left-Right Group - Classic variant
+ *
+ * Several data structures (of types Ts...) protected by a single Left-Right,
+ * i.e. they share the same versionIndex, ReadIndicators, leftRight and
+ * writersMutex. There is a left and a right instance of each one of them.
+ *
+ * A mutation is a function that receives a reference to each of the data
+ * structures and can modify all of them, which is done with a single
+ * toggleVersionAndWait(). A read receives a const reference to each of
+ * them and costs a single arrive()/depart(), and sees all the data
+ * structures in the same state, either before or after a given mutation,
+ * never one updated and the other not.
+ *
+ * Just like in LeftRightClassicLambda, each mutation is applied twice, once
+ * on each instance, so it must be deterministic and give the same result
+ * on both. The functions must return a value (not void).
+ *
+ * applyRead()     - Progress of ReadIndicator.arrive()/depart()
+ * applyMutation() - Blocking
+ *
+ * Usage, with an index and a reverse index:
+ *   LeftRightClassicGroup<RIAtomicCounter, std::map<K,V>, std::map<V,K>> group;
+ *   group.applyMutation([k,v] (std::map<K,V>& idx, std::map<V,K>& rev) { idx[k] = v; rev[v] = k; return true; });
+ *   group.applyRead([k] (const std::map<K,V>& idx, const std::map<V,K>& rev) { return rev.at(idx.at(k)) == k; });
+ *
+ * We used the Left-Right pattern described in:
+ http://concurrencyfreaks.com/2013/12/left-right-concurrency-control.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<class RI, typename... Ts>
+class LeftRightClassicGroup {
+
+private:
+    static const int READS_LEFT = 0;
+    static const int READS_RIGHT = 1;
+
+    LeftRightClassic<RI>  _lrc;
+    std::atomic<int>      _leftRight { READS_LEFT };
+    std::tuple<Ts...>     _left;
+    std::tuple<Ts...>     _right;
+
+    template<typename F, std::size_t... I>
+    static auto callOn(F& func, std::tuple<Ts...>& inst, std::index_sequence<I...>) {
+        return func(std::get<I>(inst)...);
+    }
+
+    template<typename F, std::size_t... I>
+    static auto callOn(F& func, const std::tuple<Ts...>& inst, std::index_sequence<I...>) {
+        return func(std::get<I>(inst)...);
+    }
+
+public:
+    LeftRightClassicGroup() { }
+
+    // Both the left and the right instances are copies of the given values
+    LeftRightClassicGroup(const Ts&... values) : _left{values...}, _right{values...} { }
+
+
+    template<typename F>
+    auto applyRead(F readOnlyFunc) {
+        const int lvi = _lrc.arrive();
+        const std::tuple<Ts...>& inst = _leftRight.load() == READS_LEFT ? _left : _right;
+        auto ret = callOn(readOnlyFunc, inst, std::index_sequence_for<Ts...>{});
+        _lrc.depart(lvi);
+        return ret;
+    }
+
+
+    template<typename F>
+    auto applyMutation(F mutativeFunc) {
+        std::lock_guard<std::mutex> lock(_lrc._writersMutex);
+        if (_leftRight.load(std::memory_order_relaxed) == READS_LEFT) {
+            callOn(mutativeFunc, _right, std::index_sequence_for<Ts...>{});
+            _leftRight.store(READS_RIGHT);
+            _lrc.toggleVersionAndWait();
+            return callOn(mutativeFunc, _left, std::index_sequence_for<Ts...>{});
+        } else {
+            callOn(mutativeFunc, _left, std::index_sequence_for<Ts...>{});
+            _leftRight.store(READS_LEFT);
+            _lrc.toggleVersionAndWait();
+            return callOn(mutativeFunc, _right, std::index_sequence_for<Ts...>{});
+        }
+    }
+};
+}
+
+#endif /* _LEFT_RIGHT_CLASSIC_GROUP_H_ */
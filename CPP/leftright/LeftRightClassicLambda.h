@@ -31,6 +31,8 @@
 
 #include <atomic>
 #include <mutex>
+#include <thread>
+#include <utility>
 #include <functional>
 #include "ReadIndicator.h"
 #include "RIAtomicCounter.h"
@@ -70,6 +72,23 @@ private:
     T*                   _rightInst = nullptr;   // TODO: const
     bool                 _outerAlloc { false };
 
+    /*
+     * Constructs two instances from the same range, in parallel if there is
+     * more than one core, otherwise the second one is a copy of the first,
+     * which for the node based std containers is faster than building it again.
+     */
+    template<typename ForwardIt>
+    static void buildTwo(ForwardIt first, ForwardIt last, T*& inst1, T*& inst2) {
+        if (std::thread::hardware_concurrency() > 1) {
+            std::thread th([&first,&last,&inst2] () { inst2 = new T(first, last); });
+            inst1 = new T(first, last);
+            th.join();
+        } else {
+            inst1 = new T(first, last);
+            inst2 = new T(*inst1);
+        }
+    }
+
 public:
 
     LeftRightClassicLambda(T* leftInst, T* rightInst) {
@@ -83,6 +102,16 @@ public:
         _rightInst = new T();
     }
 
+    /**
+     * Bulk-load constructor, the two instances are constructed with T(first, last)
+     * in parallel (see buildTwo()). For a std::map, if the range is sorted by key then each
+     * construction is O(n).
+     */
+    template<typename ForwardIt>
+    LeftRightClassicLambda(ForwardIt first, ForwardIt last) {
+        buildTwo(first, last, _leftInst, _rightInst);
+    }
+
     ~LeftRightClassicLambda() {
         if (!_outerAlloc) {
             delete _leftInst;
@@ -101,6 +130,21 @@ public:
     }
 
 
+    /**
+     * Calls readOnlyFunc(inst, args[i]) for each of the n args, storing the
+     * results in results[], with a single arrive()/depart() for all of them.
+     * If the instance is a std::map, see mapFindBatch() in trees/MapFindBatch.h
+     * for a function that does the n lookups with interleaved tree walks.
+     */
+    template<typename R, typename A>
+    void applyReadBatch(const A* args, const int n, R* results, std::function<R(T*,A)>& readOnlyFunc) {
+        const int lvi = _lrc.arrive();
+        T* inst = _leftRight.load() == READS_LEFT ? _leftInst : _rightInst;
+        for (int i = 0; i < n; i++) results[i] = readOnlyFunc(inst, args[i]);
+        _lrc.depart(lvi);
+    }
+
+
     template<typename R, typename A>
     R applyMutation(A& arg1, std::function<R(T*,A)>& mutativeFunc) {
         std::lock_guard<std::mutex> lock(_lrc._writersMutex);
@@ -116,6 +160,37 @@ public:
             return mutativeFunc(_rightInst, arg1);
         }
     }
+
+
+    /**
+     * Replaces the contents of both instances with T(first, last). The new
+     * instances are built in parallel before taking the writersMutex, and are
+     * then swapped in, which for the std containers is O(1).
+     * Readers see either the old contents or the new ones, never a mix.
+     */
+    template<typename ForwardIt>
+    void replaceAll(ForwardIt first, ForwardIt last) {
+        T* newLeft = nullptr;
+        T* newRight = nullptr;
+        buildTwo(first, last, newLeft, newRight);
+        {
+            std::lock_guard<std::mutex> lock(_lrc._writersMutex);
+            if (_leftRight.load(std::memory_order_relaxed) == READS_LEFT) {
+                std::swap(*_rightInst, *newRight);
+                _leftRight.store(READS_RIGHT);
+                _lrc.toggleVersionAndWait();
+                std::swap(*_leftInst, *newLeft);
+            } else {
+                std::swap(*_leftInst, *newLeft);
+                _leftRight.store(READS_LEFT);
+                _lrc.toggleVersionAndWait();
+                std::swap(*_rightInst, *newRight);
+            }
+        }
+        // Now they hold the old contents
+        delete newLeft;
+        delete newRight;
+    }
 };
 }
 
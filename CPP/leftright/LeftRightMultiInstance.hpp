@@ -0,0 +1,243 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LEFT_RIGHT_MULTI_INSTANCE_H_
+#define _LEFT_RIGHT_MULTI_INSTANCE_H_
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <stdexcept>
+#include <cstdint>
+#include <functional>
+#include "RIStaticPerThread.hpp"
+
+/**
+ * <h1> Left-Right with N instances </h1>
+ *
+ * In the classic Left-Right, a writer has to wait in toggleVersionAndWait()
+ * for all the readers that are still on the instance it wants to modify.
+ * A reader that is descheduled in the middle of its read blocks the writer
+ * (and every writer queued behind it) for as long as it stays descheduled.
+ *
+ * Here we have numInstances >= 2 instances, each with its own ReadIndicator.
+ * Readers arrive on the indicator of the instance they are going to read,
+ * and a writer chooses any instance (other than the current one) whose
+ * indicator is empty, catches it up, applies its mutation and publishes it
+ * as the new current instance. A stalled reader pins only the instance it is
+ * reading, so the writer rotates to another one and blocks only when all
+ * the other numInstances-1 instances are pinned. With numInstances=2 this
+ * degenerates into the classic behavior.
+ *
+ * The catch: after arriving on the indicator of instance i, a reader could
+ * still be about to read instance i after a writer checked that it was
+ * empty, if the reader saw i as current long ago. To prevent that, readers
+ * also arrive on one of two "entry" indicators (selected by versionIndex)
+ * while they choose the instance, and a writer does a toggleVersionAndWait()
+ * on the entry indicators before looking for a free instance, which is
+ * the same reasoning as in the classic Left-Right. The entry indicators
+ * only cover a load and a store, not the read itself, so the writer only
+ * waits for readers that are stalled in those two instructions.
+ *
+ * Instances that were skipped fall behind. Each mutation is kept in a log
+ * until every instance has applied it, and the writer replays the missing
+ * mutations when it picks an instance that is behind. The writer prefers
+ * the most up-to-date free instance, so without stalls it applies two
+ * mutations per write, the same as the classic Left-Right. If an instance
+ * falls more than maxLogSize mutations behind, it is caught up by copying
+ * the current instance instead, with the copy-assignment of C.
+ *
+ * Because the mutations are kept and replayed later, they must capture
+ * their arguments by value, like LeftRightFlatCombiningSet does.
+ *
+ * applyRead()     - Wait-Free Population Oblivious
+ * applyMutation() - Blocking
+ *
+ * Left-Right paper: https://github.com/pramalhe/ConcurrencyFreaks/blob/master/papers/left-right-2014.pdf
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename C, typename R = bool>
+class LeftRightMultiInstance {
+
+private:
+    static const int MAX_THREADS = 128;
+    const int numInstances;
+    const int maxThreads;
+    const uint64_t maxLogSize;
+    // Readers are on one of the entry indicators only while choosing the instance
+    alignas(128) std::atomic<int> versionIndex { 0 };
+    RIStaticPerThread entry[2] { maxThreads, maxThreads };
+    alignas(128) std::atomic<int> current { 0 };
+    RIStaticPerThread** ri;             // One per instance
+    C** inst;
+    // Everything below is protected by the writersMutex
+    alignas(128) std::mutex writersMutex;
+    uint64_t* instVersion;              // Number of mutations applied to each instance
+    uint64_t headVersion { 0 };         // Number of mutations applied to the current instance
+    uint64_t logStart { 0 };            // log[k] is mutation number logStart+k+1
+    std::deque<std::function<R(C*)>> log;
+    std::atomic<long> numRotations { 0 };
+    std::atomic<long> numCopies { 0 };
+
+
+    // Same as the classic Left-Right, but on the entry indicators
+    void toggleVersionAndWait() {
+        const int localVI = versionIndex.load();
+        const int prevVI = localVI & 0x1;
+        const int nextVI = (localVI+1) & 0x1;
+        // Wait for Readers from next version
+        while (!entry[nextVI].isEmpty()) std::this_thread::yield();
+        // Toggle the versionIndex variable
+        versionIndex.store(nextVI);
+        // Wait for Readers from previous version
+        while (!entry[prevVI].isEmpty()) std::this_thread::yield();
+    }
+
+
+    /*
+     * Returns the most up-to-date instance, other than icur, with no readers.
+     * Must be called after toggleVersionAndWait(), from then on no reader can
+     * arrive on an instance other than icur, so once an indicator is seen
+     * empty it stays empty. Spins if all the instances are pinned.
+     */
+    int pickFreeInstance(const int icur) {
+        int newest = -1;
+        for (int i = 0; i < numInstances; i++) {
+            if (i == icur) continue;
+            if (newest == -1 || instVersion[i] > instVersion[newest]) newest = i;
+        }
+        while (true) {
+            int best = -1;
+            for (int i = 0; i < numInstances; i++) {
+                if (i == icur || !ri[i]->isEmpty()) continue;
+                if (best == -1 || instVersion[i] > instVersion[best]) best = i;
+            }
+            if (best != -1) {
+                if (best != newest) numRotations.store(numRotations.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                return best;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+
+    // Brings instance i up to date with the current instance icur
+    void catchUp(const int i, const int icur) {
+        if (instVersion[i] < logStart) {
+            // Too far behind, the log no longer has all the mutations it needs
+            *inst[i] = *inst[icur];
+            numCopies.store(numCopies.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        } else {
+            for (uint64_t v = instVersion[i]; v < headVersion; v++) log[v-logStart](inst[i]);
+        }
+        instVersion[i] = headVersion;
+    }
+
+
+    // Drops the mutations that every instance has already applied, and the oldest beyond maxLogSize
+    void trimLog() {
+        uint64_t minVersion = headVersion;
+        for (int i = 0; i < numInstances; i++) {
+            if (instVersion[i] < minVersion) minVersion = instVersion[i];
+        }
+        if (headVersion - minVersion > maxLogSize) minVersion = headVersion - maxLogSize;
+        while (logStart < minVersion) {
+            log.pop_front();
+            logStart++;
+        }
+    }
+
+
+public:
+    LeftRightMultiInstance(C* instance, const int numInstances=3, const int maxThreads=MAX_THREADS, const uint64_t maxLogSize=1024)
+        : numInstances{numInstances}, maxThreads{maxThreads}, maxLogSize{maxLogSize} {
+        if (numInstances < 2) throw std::invalid_argument("numInstances must be at least 2");
+        ri = new RIStaticPerThread*[numInstances];
+        inst = new C*[numInstances];
+        instVersion = new uint64_t[numInstances];
+        for (int i = 0; i < numInstances; i++) {
+            ri[i] = new RIStaticPerThread(maxThreads);
+            inst[i] = (i == 0) ? instance : new C(*instance); // Make copies for the other instances
+            instVersion[i] = 0;
+        }
+    }
+
+
+    ~LeftRightMultiInstance() {
+        for (int i = 0; i < numInstances; i++) {
+            delete ri[i];
+            delete inst[i];
+        }
+        delete[] ri;
+        delete[] inst;
+        delete[] instVersion;
+    }
+
+
+    // Progress: Blocking (only if all the other instances are pinned by readers)
+    R applyMutation(std::function<R(C*)>& mutativeFunc) {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        const int icur = current.load(std::memory_order_relaxed);
+        toggleVersionAndWait();
+        const int inext = pickFreeInstance(icur);
+        catchUp(inext, icur);
+        R result = mutativeFunc(inst[inext]);
+        log.push_back(mutativeFunc);
+        headVersion++;
+        instVersion[inext] = headVersion;
+        current.store(inext);
+        trimLog();
+        return result;
+    }
+
+
+    // Progress: Wait-Free Population Oblivious
+    R applyRead(std::function<R(C*)>& readFunc, const int tid) {
+        const int localVI = versionIndex.load();
+        entry[localVI].arrive(tid);
+        const int icur = current.load();
+        ri[icur]->arrive(tid);
+        entry[localVI].depart(tid);
+        R result = readFunc(inst[icur]);
+        ri[icur]->depart(tid);
+        return result;
+    }
+
+
+    // Number of writes that could not use the most up-to-date instance because it was pinned
+    long getNumRotations() const { return numRotations.load(); }
+
+    // Number of times an instance fell more than maxLogSize behind and had to be copied
+    long getNumCopies() const { return numCopies.load(); }
+};
+
+#endif /* _LEFT_RIGHT_MULTI_INSTANCE_H_ */
@@ -0,0 +1,171 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TRIPLE_BUFFER_H_
+#define _TRIPLE_BUFFER_H_
+
+#include <atomic>
+#include <thread>
+#include <functional>
+#include "RIStaticPerThread.hpp"
+
+/**
+ * <h1> Triple Buffer </h1>
+ *
+ * A "latest value" for one writer and many readers. Readers always get the
+ * most recently published buffer, and the writer copies each value once,
+ * unlike Left-Right where the writer has to copy it into both instances.
+ *
+ * The writer fills a back buffer, obtained with beginWrite(), and publishes
+ * it with a single exchange on 'current' in publish(). Each of the three
+ * buffers has its own ReadIndicator, and beginWrite() returns a buffer
+ * that is not current and whose ReadIndicator is empty, so the writer never
+ * overwrites a buffer that a reader is using.
+ *
+ * Same as in LeftRightMultiInstance, a reader that loaded 'current' a long
+ * time ago could arrive on the ReadIndicator of a buffer right after the
+ * writer saw it empty. To prevent it, readers are on one of two "entry"
+ * ReadIndicators while they load 'current', and beginWrite() does a
+ * toggleVersionAndWait() on them before looking at the buffers.
+ *
+ * The writer blocks only if both of the other buffers have readers, i.e.
+ * when readers take longer to read a buffer than the writer takes to
+ * publish twice.
+ *
+ * applyRead()  - Wait-Free Population Oblivious
+ * read()       - Wait-Free Population Oblivious
+ * beginWrite() - Blocking
+ * publish()    - Wait-Free Population Oblivious
+ *
+ * There can be only one writer at a time.
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class TripleBuffer {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int NUM_BUFFERS = 3;
+    const int maxThreads;
+    // Readers are on one of the entry indicators only while loading current
+    alignas(128) std::atomic<int> versionIndex { 0 };
+    RIStaticPerThread entry[2] { maxThreads, maxThreads };
+    alignas(128) std::atomic<int> current { 0 };
+    RIStaticPerThread ri[NUM_BUFFERS] { maxThreads, maxThreads, maxThreads };
+    T buffers[NUM_BUFFERS];
+    // Used only by the writer
+    alignas(128) int back { -1 };
+    int prev { 1 };               // The buffer that was current before the last publish()
+
+    // Same as the classic Left-Right, but on the entry indicators
+    void toggleVersionAndWait() {
+        const int localVI = versionIndex.load();
+        const int prevVI = localVI & 0x1;
+        const int nextVI = (localVI+1) & 0x1;
+        // Wait for Readers from next version
+        while (!entry[nextVI].isEmpty()) std::this_thread::yield();
+        // Toggle the versionIndex variable
+        versionIndex.store(nextVI);
+        // Wait for Readers from previous version
+        while (!entry[prevVI].isEmpty()) std::this_thread::yield();
+    }
+
+public:
+    TripleBuffer(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} { }
+
+
+    /**
+     * Returns a buffer where the writer can write the next value. It has the
+     * contents of an older value, not necessarily of the current one.
+     *
+     * Progress Condition: Blocking (only if readers are on both other buffers)
+     */
+    T* beginWrite() {
+        if (back != -1) return &buffers[back];
+        const int icur = current.load(std::memory_order_relaxed);
+        // From now on, readers can only arrive on the indicator of icur
+        toggleVersionAndWait();
+        // The buffer that was current before prev is the least likely to have readers
+        const int older = NUM_BUFFERS - icur - prev;
+        while (true) {
+            if (ri[older].isEmpty()) { back = older; break; }
+            if (ri[prev].isEmpty()) { back = prev; break; }
+            std::this_thread::yield();
+        }
+        return &buffers[back];
+    }
+
+
+    /**
+     * Makes the buffer returned by beginWrite() the current one.
+     *
+     * Progress Condition: Wait-Free Population Oblivious
+     */
+    void publish() {
+        prev = current.exchange(back);
+        back = -1;
+    }
+
+
+    // Progress Condition: Blocking
+    void write(const T& value) {
+        *beginWrite() = value;
+        publish();
+    }
+
+
+    // Progress Condition: Wait-Free Population Oblivious
+    template<typename R>
+    R applyRead(std::function<R(const T*)>& readFunc, const int tid) {
+        const int localVI = versionIndex.load();
+        entry[localVI].arrive(tid);
+        const int icur = current.load();
+        ri[icur].arrive(tid);
+        entry[localVI].depart(tid);
+        R result = readFunc(&buffers[icur]);
+        ri[icur].depart(tid);
+        return result;
+    }
+
+
+    // Copies the current value into 'value'. Progress Condition: Wait-Free Population Oblivious
+    void read(T& value, const int tid) {
+        const int localVI = versionIndex.load();
+        entry[localVI].arrive(tid);
+        const int icur = current.load();
+        ri[icur].arrive(tid);
+        entry[localVI].depart(tid);
+        value = buffers[icur];
+        ri[icur].depart(tid);
+    }
+};
+
+#endif /* _TRIPLE_BUFFER_H_ */
@@ -0,0 +1,298 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _WRITER_READER_PHASER_H_
+#define _WRITER_READER_PHASER_H_
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <limits>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include "RIStaticPerThread.hpp"
+
+
+/**
+ * <h1> WriterReaderPhaser (GT variant) </h1>
+ *
+ * C++ port of the scalable ReadIndicator used in LRTreeSetScalableGT.java,
+ * which is Gil Tene's WriterReaderPhaser with the three epoch counters
+ * (startEpoch, posEndEpoch, negEndEpoch) striped over several cache lines.
+ * The sign of startEpoch is the versionIndex (the "phase").
+ *
+ * The roles are reversed when compared with Left-Right: the "writers" are the
+ * threads that record into the active buffer, and the "reader" is the single
+ * thread that flips the phase so that it can read the inactive buffer.
+ *
+ * writerCriticalSectionEnter() - Wait-Free Population Oblivious on x86 (one FAA)
+ * writerCriticalSectionExit()  - Wait-Free Population Oblivious on x86 (one FAA)
+ * flipPhase()                  - Blocking
+ * readerLock()                 - Blocking
+ * readerUnlock()               - Wait-Free
+ *
+ * Usage pattern for the recording threads:
+ *   lvi = phaser.writerCriticalSectionEnter();
+ *   activeBuffer.load()->record(...);
+ *   phaser.writerCriticalSectionExit(lvi);
+ * Usage pattern for the reporting thread:
+ *   phaser.readerLock();
+ *   inactive->reset(); swap the active and inactive buffers;
+ *   phaser.flipPhase();
+ *   ... read the (now) inactive buffer ...
+ *   phaser.readerUnlock();
+ *
+ * http://stuff-gil-says.blogspot.com/2014/11/writerreaderphaser-story-about-new.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class WriterReaderPhaserGT {
+
+private:
+    static const int CLPAD = 128/sizeof(std::atomic<int64_t>);
+
+    /*
+     * This is a specialization of the Distributed Cache Line Counter.
+     * Notice that we only care if the return value of getAndIncrement() is
+     * positive or negative, so as to determine the versionIndex.
+     */
+    class InnerDCLC {
+        const int numCounters;
+        alignas(128) std::atomic<int64_t>* counters;
+        std::hash<std::thread::id> hashFunc;
+
+        static int highestOneBit(int i) {
+            int hob = 1;
+            while ((i >>= 1) != 0) hob <<= 1;
+            return hob;
+        }
+
+        inline int tid2idx() {
+            std::size_t x = hashFunc(std::this_thread::get_id());
+            x ^= (x << 21);
+            x ^= (x >> 35);
+            x ^= (x << 4);
+            return (int)(((numCounters-1) & x)*CLPAD);
+        }
+
+    public:
+        InnerDCLC(int64_t value) : numCounters{highestOneBit(std::max(1u, std::thread::hardware_concurrency()))<<2} {
+            counters = new std::atomic<int64_t>[numCounters*CLPAD];
+            for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                counters[idx].store(value, std::memory_order_relaxed);
+            }
+        }
+
+        ~InnerDCLC() {
+            delete[] counters;
+        }
+
+        inline int64_t getAndIncrement() {
+            return counters[tid2idx()].fetch_add(1);
+        }
+
+        int64_t sum() {
+            int64_t sum = 0;
+            // Let's start by checking if the versionIndex is positive or negative
+            if (counters[0].load() < 0) {
+                for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                    sum += counters[idx].load() - std::numeric_limits<int64_t>::min();
+                }
+                return std::numeric_limits<int64_t>::min() + sum;
+            } else {
+                for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                    sum += counters[idx].load();
+                }
+                return sum;
+            }
+        }
+
+        void set(int64_t value) {
+            for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                counters[idx].store(value);
+            }
+        }
+
+        // Warning: This is not an atomic getAndSet(). It sets every counter
+        // in the array to 'value' and returns the accumulated delta.
+        int64_t getAndSet(int64_t value) {
+            int64_t sum = 0;
+            if (counters[0].load() < 0) {
+                for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                    sum += counters[idx].exchange(value) - std::numeric_limits<int64_t>::min();
+                }
+                return std::numeric_limits<int64_t>::min() + sum;
+            } else {
+                for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) {
+                    sum += counters[idx].exchange(value);
+                }
+                return sum;
+            }
+        }
+    };
+
+    InnerDCLC  startEpoch  { 0 };
+    InnerDCLC  posEndEpoch { 0 };
+    InnerDCLC  negEndEpoch { std::numeric_limits<int64_t>::min() };
+    std::mutex readerMutex;
+
+public:
+    WriterReaderPhaserGT(const int maxThreads=0) { }
+
+    static std::string className() { return "WriterReaderPhaserGT"; }
+
+    // Progress Condition: Wait-Free Population Oblivious on x86, Lock-Free for other CPUs
+    inline int64_t writerCriticalSectionEnter(const int tid=0) {
+        return startEpoch.getAndIncrement();
+    }
+
+    // Progress Condition: Wait-Free Population Oblivious on x86, Lock-Free for other CPUs
+    inline void writerCriticalSectionExit(const int64_t localVI, const int tid=0) {
+        if (localVI < 0) {
+            negEndEpoch.getAndIncrement();
+        } else {
+            posEndEpoch.getAndIncrement();
+        }
+    }
+
+    void readerLock() {
+        readerMutex.lock();
+    }
+
+    void readerUnlock() {
+        readerMutex.unlock();
+    }
+
+    /**
+     * Waits for all the writers that entered with the previous phase to exit.
+     * Must be called with readerLock() held.
+     *
+     * Progress Condition: Blocking
+     */
+    void flipPhase() {
+        const int64_t localVI = startEpoch.sum();
+        if (localVI < 0) {
+            // This version is negative, so next versionIndex is positive. Reset counter
+            posEndEpoch.set(0);
+            // Toggle versionIndex and count the number of arrives()
+            const int64_t localStartValue = startEpoch.getAndSet(0);
+            // Wait for the writers that did arrive() with a negative versionIndex to depart()
+            while (localStartValue != negEndEpoch.sum()) std::this_thread::yield();
+        } else {
+            // This version is positive, so next versionIndex is negative. Reset counter
+            negEndEpoch.set(std::numeric_limits<int64_t>::min());
+            // Toggle versionIndex and count the number of arrives()
+            const int64_t localStartValue = startEpoch.getAndSet(std::numeric_limits<int64_t>::min());
+            // Wait for the writers that did arrive() with a positive versionIndex to depart()
+            while (localStartValue != posEndEpoch.sum()) std::this_thread::yield();
+        }
+    }
+};
+
+
+
+/**
+ * <h1> WriterReaderPhaser with one entry per thread </h1>
+ *
+ * Same API as WriterReaderPhaserGT but each recording thread has its own
+ * (padded) entry in a RIStaticPerThread, one per phase, just like the
+ * ReadIndicators of the Left-Right Classic variant.
+ * Entering or exiting a writer critical section is a single store on a cache
+ * line owned by the calling thread, with no FAA and no contention with other
+ * writers. The downside is that flipPhase() must scan all maxThreads entries.
+ *
+ * The phase toggle is the same as Left-Right's toggleVersionAndWait(): wait
+ * for the stragglers of the next phase, toggle, wait for the previous phase.
+ *
+ * writerCriticalSectionEnter() - Wait-Free Population Oblivious (one store)
+ * writerCriticalSectionExit()  - Wait-Free Population Oblivious (one store)
+ * flipPhase()                  - Blocking
+ * readerLock()                 - Blocking
+ * readerUnlock()               - Wait-Free
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class WriterReaderPhaser {
+
+private:
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    RIStaticPerThread ri[2] { maxThreads, maxThreads };
+    alignas(128) std::atomic<int> versionIndex { 0 };
+    alignas(128) std::mutex readerMutex;
+
+public:
+    WriterReaderPhaser(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} { }
+
+    static std::string className() { return "WriterReaderPhaser"; }
+
+    // Progress Condition: Wait-Free Population Oblivious
+    inline int64_t writerCriticalSectionEnter(const int tid) {
+        const int localVI = versionIndex.load();
+        ri[localVI].arrive(tid);
+        return localVI;
+    }
+
+    // Progress Condition: Wait-Free Population Oblivious
+    inline void writerCriticalSectionExit(const int64_t localVI, const int tid) {
+        ri[localVI].depart(tid);
+    }
+
+    void readerLock() {
+        readerMutex.lock();
+    }
+
+    void readerUnlock() {
+        readerMutex.unlock();
+    }
+
+    /**
+     * Waits for all the writers that entered with the previous phase to exit.
+     * Must be called with readerLock() held.
+     *
+     * Progress Condition: Blocking
+     */
+    void flipPhase() {
+        const int localVI = versionIndex.load();
+        const int prevVI = localVI & 0x1;
+        const int nextVI = (localVI+1) & 0x1;
+        // Wait for writers from next version
+        while (!ri[nextVI].isEmpty()) std::this_thread::yield();
+        // Toggle the versionIndex variable
+        versionIndex.store(nextVI);
+        // Wait for writers from previous version
+        while (!ri[prevVI].isEmpty()) std::this_thread::yield();
+    }
+};
+
+#endif /* _WRITER_READER_PHASER_H_ */
@@ -0,0 +1,356 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _AWAITABLE_CRWWP_LOCK_H_
+#define _AWAITABLE_CRWWP_LOCK_H_
+
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <stdexcept>
+#include <cstdint>
+#include <string>
+#include "USDTProbes.hpp"
+
+
+/**
+ * <h1> Awaitable C-RW-WP Lock </h1>
+ *
+ * A reader-writer lock for coroutines (C++20) where instead of blocking the
+ * OS thread, a contended acquirer suspends the coroutine:
+ *   int slot = co_await rwlock.sharedLock(tid);
+ *   ... read ...
+ *   rwlock.sharedUnlock(slot);
+ *
+ *   co_await rwlock.exclusiveLock();
+ *   ... write ...
+ *   rwlock.exclusiveUnlock(tid);
+ *
+ * The fast path is the same as in C-RW-WP: a reader arrives on its own
+ * (padded) entry of the ReadIndicator and checks that there is no writer,
+ * a writer does a CAS on the writer state and scans the ReadIndicator.
+ * Unlike RIStaticPerThread, each entry is a counter and not a flag, because
+ * two coroutines running on the same thread may be holding the lock in
+ * shared mode at the same time. The entry used by a reader is returned by
+ * sharedLock() and must be passed to sharedUnlock(), which may be called from
+ * a different thread than the one where sharedLock() was called.
+ *
+ * The writer state is either UNLOCKED, LOCKED, or a pointer to the top of a
+ * lock-free stack (Treiber) of the suspended readers and writers, in which
+ * case it is also locked. Only the owner of the lock in exclusive mode ever
+ * pops from the stack, which it does with a single exchange(), so there is no
+ * ABA problem. The popped waiters are kept in FIFO order in a list which is
+ * owned by whoever holds the lock in exclusive mode.
+ *
+ * When a writer releases the lock, all the readers in the waiters list are
+ * admitted as a single batch: the writer increments the ReadIndicator on their
+ * behalf (one FAA for the whole batch) and resumes them. If there is a writer
+ * in the waiters list, the lock is handed over to it before resuming the
+ * readers and it will be resumed by the last reader of the batch to leave.
+ * This means readers can't starve writers and writers can't starve readers.
+ *
+ * A writer that got the lock but has to wait for the readers to leave
+ * publishes a ticket in pendingTicket and is resumed by the last reader to
+ * depart, i.e. the one that takes the ticket with a CAS. The ticket is unique
+ * for each wait, which means that a thread that took too long to scan the
+ * ReadIndicator can not take the ticket of a newer writer (or of a newer wait
+ * of the same coroutine, whose handle would be the same).
+ *
+ * Suspended coroutines are resumed on the thread that releases the lock or,
+ * if an executor was passed to the constructor, given to that executor.
+ *
+ * sharedLock()      - Lock-Free when uncontended, otherwise Blocking (without blocking the thread)
+ * sharedUnlock()    - Wait-Free Population Oblivious plus a scan of the ReadIndicator if a writer is waiting
+ * exclusiveLock()   - Blocking (without blocking the thread)
+ * exclusiveUnlock() - Lock-Free
+ *
+ * C-RW-WP paper:  http://dl.acm.org/citation.cfm?id=2442532
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class AwaitableCRWWPLock {
+
+private:
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        Waiter*                 next;
+        bool                    isReader;
+        int                     slot;      // For readers: ReadIndicator entry where the writer arrived on our behalf
+    };
+
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(std::atomic<int64_t>);
+    static const uintptr_t UNLOCKED = 0;
+    static const uintptr_t LOCKED = 1;
+
+    const int maxThreads;
+    const std::function<void(std::coroutine_handle<>)> executor;
+    alignas(128) std::atomic<int64_t>* readers;
+    alignas(128) std::atomic<uintptr_t> wstate { UNLOCKED };
+    alignas(128) std::atomic<uint64_t> pendingTicket { 0 };
+    // Only written by the owner of the lock, before publishing its ticket
+    std::coroutine_handle<> pendingHandle;
+    uint64_t lastTicket { 0 };
+    // Waiters in FIFO order. Only accessed by the owner of the lock in exclusive mode.
+    alignas(128) Waiter* fifoHead { nullptr };
+    Waiter* fifoTail { nullptr };
+
+    inline void resume(std::coroutine_handle<> h) {
+        if (executor) executor(h);
+        else h.resume();
+    }
+
+    inline void arrive(const int slot, const int64_t count=1) noexcept {
+        readers[slot*CLPAD].fetch_add(count);
+    }
+
+    bool isEmpty() noexcept {
+        for (int i = 0; i < maxThreads; i++) {
+            if (readers[i*CLPAD].load() != 0) return false;
+        }
+        return true;
+    }
+
+    /*
+     * Publishes the ticket of the writer (which owns the lock) and returns true
+     * if there are no readers, in which case it's up to the caller to continue
+     * or resume the writer. Otherwise, the last reader to leave will resume it.
+     */
+    bool waitForReaders(const uint64_t ticket) {
+        pendingTicket.store(ticket);
+        if (!isEmpty()) return false;
+        uint64_t t = ticket;
+        return pendingTicket.compare_exchange_strong(t, 0);
+    }
+
+    // Called by the owner of the lock in exclusive mode
+    bool waitForReaders(std::coroutine_handle<> h) {
+        pendingHandle = h;
+        return waitForReaders(++lastTicket);
+    }
+
+    /*
+     * Leaves the ReadIndicator and, if there is a writer waiting for the
+     * readers to go away and we're the last one, resumes it.
+     * The first scan may have started before the current writer got the lock
+     * and missed a reader that arrived in the meantime, therefore, after taking
+     * the ticket we have to publish it again and re-scan, which is what
+     * waitForReaders() does.
+     */
+    inline void departAndWake(const int slot) {
+        readers[slot*CLPAD].fetch_add(-1);
+        uint64_t t = pendingTicket.load();
+        if (t == 0) return;
+        if (!isEmpty()) return;
+        if (!pendingTicket.compare_exchange_strong(t, 0)) return;
+        // We have the ticket, nobody else can resume the writer, which means pendingHandle won't change
+        std::coroutine_handle<> h = pendingHandle;
+        if (waitForReaders(t)) resume(h);
+    }
+
+    // Moves whatever is in the lock-free stack to the end of the FIFO list
+    void drainStack() {
+        uintptr_t s = wstate.exchange(LOCKED);
+        if (s == LOCKED) return;
+        // Reverse the stack
+        Waiter* first = nullptr;
+        Waiter* last = (Waiter*)s;
+        for (Waiter* w = (Waiter*)s; w != nullptr; ) {
+            Waiter* next = w->next;
+            w->next = first;
+            first = w;
+            w = next;
+        }
+        if (fifoTail == nullptr) fifoHead = first;
+        else fifoTail->next = first;
+        fifoTail = last;
+    }
+
+public:
+    class SharedAwaiter {
+        AwaitableCRWWPLock& lock;
+        const int tid;
+        Waiter node;
+        bool waited { false };
+    public:
+        SharedAwaiter(AwaitableCRWWPLock& lock, const int tid) : lock{lock}, tid{tid} { node.slot = tid; }
+
+        bool await_ready() noexcept {
+            lock.arrive(tid);
+            if (lock.wstate.load() == UNLOCKED) return true;
+            lock.departAndWake(tid);
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            waited = true;
+            CF_PROBE3(alock_wait_begin, &lock, this, CF_LOCK_WAIT_READER_FOR_WRITER);
+            node.handle = h;
+            node.isReader = true;
+            while (true) {
+                uintptr_t s = lock.wstate.load();
+                if (s == UNLOCKED) {
+                    lock.arrive(tid);
+                    if (lock.wstate.load() == UNLOCKED) {
+                        node.slot = tid;
+                        return false;
+                    }
+                    lock.departAndWake(tid);
+                    continue;
+                }
+                node.next = (s == LOCKED) ? nullptr : (Waiter*)s;
+                if (lock.wstate.compare_exchange_strong(s, (uintptr_t)&node)) return true;
+            }
+        }
+
+        int await_resume() noexcept {
+            if (waited) CF_PROBE3(alock_wait_end, &lock, this, CF_LOCK_WAIT_READER_FOR_WRITER);
+            return node.slot;
+        }
+    };
+
+    class ExclusiveAwaiter {
+        AwaitableCRWWPLock& lock;
+        Waiter node;
+        bool hasCohort { false };
+        int waitKind { -1 };
+    public:
+        ExclusiveAwaiter(AwaitableCRWWPLock& lock) : lock{lock} { }
+
+        bool await_ready() noexcept {
+            uintptr_t unlocked = UNLOCKED;
+            if (lock.wstate.load() != UNLOCKED || !lock.wstate.compare_exchange_strong(unlocked, LOCKED)) return false;
+            hasCohort = true;
+            return lock.isEmpty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> h) {
+            waitKind = hasCohort ? CF_LOCK_WAIT_WRITER_FOR_READERS : CF_LOCK_WAIT_WRITER_FOR_WRITER;
+            CF_PROBE3(alock_wait_begin, &lock, this, waitKind);
+            if (hasCohort) return !lock.waitForReaders(h);
+            node.handle = h;
+            node.isReader = false;
+            while (true) {
+                uintptr_t s = lock.wstate.load();
+                if (s == UNLOCKED) {
+                    if (lock.wstate.compare_exchange_strong(s, LOCKED)) return !lock.waitForReaders(h);
+                    continue;
+                }
+                node.next = (s == LOCKED) ? nullptr : (Waiter*)s;
+                if (lock.wstate.compare_exchange_strong(s, (uintptr_t)&node)) return true;
+            }
+        }
+
+        void await_resume() noexcept {
+            if (waitKind >= 0) CF_PROBE3(alock_wait_end, &lock, this, waitKind);
+        }
+    };
+
+
+    AwaitableCRWWPLock(const int maxThreads=MAX_THREADS, std::function<void(std::coroutine_handle<>)> executor=nullptr)
+        : maxThreads{maxThreads}, executor{executor} {
+        if (maxThreads <= 0) throw std::invalid_argument("maxThreads must be positive");
+        readers = new std::atomic<int64_t>[maxThreads*CLPAD];
+        for (int i = 0; i < maxThreads; i++) readers[i*CLPAD].store(0, std::memory_order_relaxed);
+    }
+
+    ~AwaitableCRWWPLock() {
+        delete[] readers;
+    }
+
+    static std::string className() { return "AwaitableCRWWPLock"; }
+
+    // Use as: int slot = co_await rwlock.sharedLock(tid);
+    SharedAwaiter sharedLock(const int tid) { return SharedAwaiter(*this, tid); }
+
+    // 'slot' is the value returned by co_await sharedLock()
+    void sharedUnlock(const int slot) { departAndWake(slot); }
+
+    // Use as: co_await rwlock.exclusiveLock();
+    ExclusiveAwaiter exclusiveLock() { return ExclusiveAwaiter(*this); }
+
+    /**
+     * Releases the lock in exclusive mode. All the readers waiting for the
+     * lock are admitted as a batch, and if there is a writer waiting, the
+     * lock is handed over to it. 'tid' is only used to choose which entry of
+     * the ReadIndicator is used for the batch of readers.
+     */
+    void exclusiveUnlock(const int tid) {
+        Waiter* batch = nullptr;
+        Waiter* nextWriter = nullptr;
+        int64_t batchSize = 0;
+        while (true) {
+            drainStack();
+            // Move the readers from the FIFO to the batch, keep the writers in the FIFO
+            const int64_t prevBatchSize = batchSize;
+            Waiter* prev = nullptr;
+            for (Waiter* w = fifoHead; w != nullptr; ) {
+                Waiter* next = w->next;
+                if (w->isReader) {
+                    if (prev == nullptr) fifoHead = next;
+                    else prev->next = next;
+                    if (fifoTail == w) fifoTail = prev;
+                    w->slot = tid;
+                    w->next = batch;
+                    batch = w;
+                    batchSize++;
+                } else {
+                    prev = w;
+                }
+                w = next;
+            }
+            // Arrive on behalf of the readers in the batch. They can't do anything until they're resumed.
+            if (batchSize > prevBatchSize) arrive(tid, batchSize-prevBatchSize);
+            if (fifoHead != nullptr) {
+                // Hand over the lock to the first writer. The FIFO now belongs to it.
+                nextWriter = fifoHead;
+                fifoHead = nextWriter->next;
+                if (fifoHead == nullptr) fifoTail = nullptr;
+                break;
+            }
+            uintptr_t locked = LOCKED;
+            if (wstate.compare_exchange_strong(locked, UNLOCKED)) break;
+            // New waiters were pushed onto the stack, go and get them
+        }
+        CF_PROBE3(alock_release, this, batchSize, nextWriter != nullptr);
+        // From here on, we can't touch the FIFO because it belongs to nextWriter (if any)
+        if (nextWriter != nullptr && waitForReaders(nextWriter->handle)) {
+            // There are no readers in the batch, otherwise waitForReaders() would have failed
+            resume(nextWriter->handle);
+            return;
+        }
+        while (batch != nullptr) {
+            Waiter* next = batch->next;  // The waiter is gone after resume()
+            resume(batch->handle);
+            batch = next;
+        }
+    }
+};
+
+#endif /* _AWAITABLE_CRWWP_LOCK_H_ */
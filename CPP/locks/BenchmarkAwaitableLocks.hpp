@@ -0,0 +1,312 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+#ifndef _BENCHMARK_AWAITABLE_LOCKS_H_
+#define _BENCHMARK_AWAITABLE_LOCKS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "AwaitableCRWWPLock.hpp"
+#include "CPUAccounting.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * A minimal thread pool for coroutines: a std::deque of coroutine handles
+ * protected by a mutex, and a condition variable for the idle workers.
+ * co_await pool.schedule() moves the calling coroutine to the pool.
+ */
+class CoroThreadPool {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<std::thread> workers;
+    bool quit { false };
+
+public:
+    static thread_local int tid;
+
+    CoroThreadPool(const int numThreads) {
+        for (int i = 0; i < numThreads; i++) {
+            workers.emplace_back([this,i] () {
+                tid = i;
+                while (true) {
+                    std::coroutine_handle<> h;
+                    {
+                        std::unique_lock<std::mutex> lock(mtx);
+                        cv.wait(lock, [this] { return quit || !ready.empty(); });
+                        if (ready.empty()) return;
+                        h = ready.front();
+                        ready.pop_front();
+                    }
+                    h.resume();
+                }
+            });
+        }
+    }
+
+    ~CoroThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            quit = true;
+        }
+        cv.notify_all();
+        for (auto& th : workers) th.join();
+    }
+
+    void post(std::coroutine_handle<> h) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            ready.push_back(h);
+        }
+        cv.notify_one();
+    }
+
+    struct ScheduleAwaiter {
+        CoroThreadPool& pool;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { pool.post(h); }
+        void await_resume() noexcept { }
+    };
+
+    ScheduleAwaiter schedule() { return ScheduleAwaiter{*this}; }
+};
+
+thread_local int CoroThreadPool::tid = 0;
+
+
+// A fire-and-forget coroutine. The frame is destroyed when it returns.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { }
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+
+/**
+ * Each coroutine does a read or a write in a loop, and every few operations
+ * goes back to the pool with co_await pool.schedule() so that there are always
+ * more coroutines than threads, like on a server.
+ * The data protected by the lock is an array where writers increment all the
+ * entries and readers check that all the entries are the same.
+ *
+ * For the std::shared_mutex, lock()/lock_shared() block the worker thread.
+ * The critical section never spans a suspension point, otherwise the unlock
+ * could happen on a different thread, which std::shared_mutex doesn't allow.
+ * For the AwaitableCRWWPLock, a contended lock suspends the coroutine and the
+ * worker thread goes on to run other coroutines.
+ */
+class BenchmarkAwaitableLocks {
+
+public:
+    enum LockTestCase { AwaitableInline, AwaitableExecutor, StdSharedMutex };
+    std::string TestCaseStr[3] = { "AwaitableCRWWPLock", "AwaitableCRWWPLock-Executor", "std::shared_mutex" };
+
+private:
+    static const int ARRAY_SIZE = 64;
+    static const int OPS_PER_YIELD = 8;
+    const int numThreads;
+    const int numCoroutines;
+    alignas(128) long long data[ARRAY_SIZE];
+    alignas(128) std::atomic<long long> numOps { 0 };
+    std::atomic<long long> numErrors { 0 };
+    std::atomic<int> numDone { 0 };
+    std::atomic<bool> quit { false };
+
+    inline void writeData() {
+        for (int i = 0; i < ARRAY_SIZE; i++) data[i]++;
+    }
+
+    inline void readData() {
+        const long long first = data[0];
+        for (int i = 1; i < ARRAY_SIZE; i++) {
+            if (data[i] != first) { numErrors.fetch_add(1); return; }
+        }
+    }
+
+    DetachedTask awaitableWorker(CoroThreadPool& pool, AwaitableCRWWPLock& rwlock, const int writePerMil, const int icoro) {
+        co_await pool.schedule();
+        long long ops = 0;
+        uint64_t seed = icoro+1234567890123456781ULL;
+        while (!quit.load(std::memory_order_relaxed)) {
+            for (int i = 0; i < OPS_PER_YIELD; i++) {
+                seed = randomLong(seed);
+                if ((int)(seed % 1000) < writePerMil) {
+                    co_await rwlock.exclusiveLock();
+                    writeData();
+                    rwlock.exclusiveUnlock(CoroThreadPool::tid);
+                } else {
+                    const int slot = co_await rwlock.sharedLock(CoroThreadPool::tid);
+                    readData();
+                    rwlock.sharedUnlock(slot);
+                }
+            }
+            ops += OPS_PER_YIELD;
+            co_await pool.schedule();
+        }
+        numOps.fetch_add(ops);
+        numDone.fetch_add(1);
+    }
+
+    DetachedTask sharedMutexWorker(CoroThreadPool& pool, std::shared_mutex& rwlock, const int writePerMil, const int icoro) {
+        co_await pool.schedule();
+        long long ops = 0;
+        uint64_t seed = icoro+1234567890123456781ULL;
+        while (!quit.load(std::memory_order_relaxed)) {
+            for (int i = 0; i < OPS_PER_YIELD; i++) {
+                seed = randomLong(seed);
+                if ((int)(seed % 1000) < writePerMil) {
+                    rwlock.lock();
+                    writeData();
+                    rwlock.unlock();
+                } else {
+                    rwlock.lock_shared();
+                    readData();
+                    rwlock.unlock_shared();
+                }
+            }
+            ops += OPS_PER_YIELD;
+            co_await pool.schedule();
+        }
+        numOps.fetch_add(ops);
+        numDone.fetch_add(1);
+    }
+
+public:
+    BenchmarkAwaitableLocks(const int numThreads) : numThreads{numThreads}, numCoroutines{4*numThreads} { }
+
+
+    /**
+     * Returns the median number of operations per second.
+     * The coroutines migrate between the threads of the pool, so the CPU time
+     * is taken for the whole process, which includes the idle workers of the
+     * pool waiting on the condition variable (they use no CPU).
+     */
+    long long benchmark(LockTestCase tc, const int writePerMil, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numRuns];
+        vector<CPUAccounting> accs(numRuns);
+        std::cout << "##### " << TestCaseStr[tc] << " #####  writes=" << writePerMil/10. << "%\n";
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            for (int i = 0; i < ARRAY_SIZE; i++) data[i] = 0;
+            numOps.store(0);
+            numDone.store(0);
+            quit.store(false);
+            accs[irun].start();
+            const CPUSample cpuStart = CPUSample::process();
+            CoroThreadPool pool(numThreads);
+            AwaitableCRWWPLock* arwlock = nullptr;
+            std::shared_mutex smutex;
+            if (tc == AwaitableInline) arwlock = new AwaitableCRWWPLock(numThreads);
+            if (tc == AwaitableExecutor) arwlock = new AwaitableCRWWPLock(numThreads, [&pool] (std::coroutine_handle<> h) { pool.post(h); });
+            for (int icoro = 0; icoro < numCoroutines; icoro++) {
+                if (tc == StdSharedMutex) sharedMutexWorker(pool, smutex, writePerMil, icoro);
+                else awaitableWorker(pool, *arwlock, writePerMil, icoro);
+            }
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            while (numDone.load() != numCoroutines) this_thread::sleep_for(1ms);
+            ops[irun] = numOps.load();
+            accs[irun].addThread(CPUSample::process() - cpuStart);
+            accs[irun].stop();
+            delete arwlock;
+        }
+        if (numErrors.load() != 0) std::cout << "ERROR: readers saw an inconsistent state " << numErrors.load() << " times\n";
+
+        // Compute the median. numRuns should be an odd number
+        vector<long long> s(ops, ops+numRuns);
+        sort(s.begin(), s.end());
+        const int medianRun = find(ops, ops+numRuns, s[numRuns/2]) - ops;
+        long long result = s[numRuns/2]/testLengthSeconds.count();
+        cout << "Ops/sec = " << result << "   ";
+        accs[medianRun].print(s[numRuns/2], testLengthSeconds.count());
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        vector<int> writeList = { 10, 100, 500 };  // per mil
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int NUM_CLASSES = 3;
+        long long ops[writeList.size()][NUM_CLASSES][threadList.size()];
+
+        for (unsigned iwrite = 0; iwrite < writeList.size(); iwrite++) {
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                auto nThreads = threadList[ithread];
+                BenchmarkAwaitableLocks bench(nThreads);
+                std::cout << "\n----- Awaitable Locks Benchmark   numThreads=" << nThreads << "   numCoroutines=" << 4*nThreads << "   writes=" << writeList[iwrite]/10. << "%   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                ops[iwrite][0][ithread] = bench.benchmark(AwaitableInline, writeList[iwrite], testLength, numRuns);
+                ops[iwrite][1][ithread] = bench.benchmark(AwaitableExecutor, writeList[iwrite], testLength, numRuns);
+                ops[iwrite][2][ithread] = bench.benchmark(StdSharedMutex, writeList[iwrite], testLength, numRuns);
+            }
+        }
+
+        // Show results in csv format
+        for (unsigned iwrite = 0; iwrite < writeList.size(); iwrite++) {
+            cout << "\n\nResults in ops per second for writes=" << writeList[iwrite]/10. << "%,  numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Threads, AwaitableCRWWPLock, AwaitableCRWWPLock-Executor, std::shared_mutex\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[iwrite][ic][ithread] << ", ";
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif
@@ -31,6 +31,7 @@
 #include <iostream>
 #include <atomic>
 #include "DCLCRWLock.h"
+#include "USDTProbes.hpp"
 
 
 /**
@@ -102,9 +103,11 @@ void DCLCRWLock::sharedLock (void)
         } else {
             // A Writer has acquired the lock, must reset to 0 and wait
             readersCounters[idx].fetch_add(-1);
+            CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_READER_FOR_WRITER);
             while (writersMutex.load() == DCLC_RWL_LOCKED) {
                 std::this_thread::yield();
             }
+            CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_READER_FOR_WRITER);
         }
     }
 }
@@ -133,16 +136,26 @@ void DCLCRWLock::exclusiveLock (void)
 {
     int old = DCLC_RWL_UNLOCKED;
     // Try to acquire the write-lock
-    while (!writersMutex.compare_exchange_strong(old, DCLC_RWL_LOCKED)) {
-        std::this_thread::yield();
-        old = DCLC_RWL_UNLOCKED;
+    if (!writersMutex.compare_exchange_strong(old, DCLC_RWL_LOCKED)) {
+        CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_WRITER_FOR_WRITER);
+        do {
+            std::this_thread::yield();
+            old = DCLC_RWL_UNLOCKED;
+        } while (!writersMutex.compare_exchange_strong(old, DCLC_RWL_LOCKED));
+        CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_WRITER_FOR_WRITER);
     }
     // Write-lock was acquired, now wait for any running Readers to finish
+    bool waited = false;
     for (int idx = 0; idx < countersLength; idx += DCLC_COUNTERS_RATIO) {
         while (readersCounters[idx].load() > 0) {
+            if (!waited) {
+                CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_WRITER_FOR_READERS);
+                waited = true;
+            }
             std::this_thread::yield();
         }
     }
+    if (waited) CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_WRITER_FOR_READERS);
 }
 
 
@@ -31,6 +31,7 @@
 #include <iostream>
 #include <atomic>
 #include "FAARWLock.h"
+#include "USDTProbes.hpp"
 
 using namespace std;
 
@@ -73,9 +74,11 @@ void FAARWLock::sharedLock (void)
 		} else {
             // A Writer has acquired the lock, must reset to 0 and wait
 			readers_count.fetch_add(-1);
+            CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_READER_FOR_WRITER);
             while (writers_mutex.load() == FAA_RWL_LOCKED) {
             	this_thread::yield();
             }
+            CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_READER_FOR_WRITER);
 		}
     }
 }
@@ -104,14 +107,22 @@ void FAARWLock::exclusiveLock (void)
 {
 	int old = FAA_RWL_UNLOCKED;
     // Try to acquire the write-lock
-    while (!writers_mutex.compare_exchange_strong(old, FAA_RWL_LOCKED)) {
-    	this_thread::yield();
-    	old = FAA_RWL_UNLOCKED;
+    if (!writers_mutex.compare_exchange_strong(old, FAA_RWL_LOCKED)) {
+        CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_WRITER_FOR_WRITER);
+        do {
+        	this_thread::yield();
+        	old = FAA_RWL_UNLOCKED;
+        } while (!writers_mutex.compare_exchange_strong(old, FAA_RWL_LOCKED));
+        CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_WRITER_FOR_WRITER);
     }
 
     // Write-lock was acquired, now wait for any running Readers to finish
-    while (readers_count.load() > 0) {
-    	this_thread::yield();
+    if (readers_count.load() > 0) {
+        CF_PROBE2(lock_wait_begin, this, CF_LOCK_WAIT_WRITER_FOR_READERS);
+        do {
+        	this_thread::yield();
+        } while (readers_count.load() > 0);
+        CF_PROBE2(lock_wait_end, this, CF_LOCK_WAIT_WRITER_FOR_READERS);
     }
 }
 
@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkAwaitableLocks.hpp"
+
+
+
+int main(void) {
+    BenchmarkAwaitableLocks::allThroughputTests();
+    return 0;
+}
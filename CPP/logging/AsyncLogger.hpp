@@ -0,0 +1,465 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _ASYNC_LOGGER_H_
+#define _ASYNC_LOGGER_H_
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "FAAArrayQueue.hpp"
+
+
+/**
+ * <h1> Asynchronous Logger </h1>
+ *
+ * A logger where the threads that call log() never format text, never take a
+ * lock and never do a system call.
+ * Each producer thread has its own ring of preallocated fixed-size records.
+ * A call to log() writes the id of a (pre-registered) format string, a
+ * timestamp and the arguments in binary form into the next record of the
+ * ring and enqueues a pointer to it in an FAAArrayQueue.
+ * A background thread dequeues the records, formats them into large chunks
+ * of text, marks the records as free, and writes the chunks to the file
+ * descriptor with a single writev() each time the chunks fill up or there
+ * are no more records to format.
+ *
+ * When the consumer can't keep up (for example, the disk is slower than the
+ * producers) the ring of a producer eventually fills up, and log() either
+ * returns false and counts the record as dropped (DROP policy), or waits for
+ * the consumer to free the oldest record (BLOCK policy).
+ *
+ * Because the FAAArrayQueue is linearizable, the records of each producer are
+ * dequeued in the order they were enqueued, thus the records of a ring are
+ * always freed in order.
+ *
+ * Supported argument types are integers, floating point, const char* and
+ * std::string. Strings are copied, and truncated when the record is full.
+ * The format strings must outlive the logger (string literals are fine) and
+ * the conversions follow printf(), ignoring the length modifiers, i.e. "%d"
+ * can be used for any integer. A '*' width or precision consumes an integer
+ * argument, just like in printf().
+ *
+ * log()            - lock-free (progress of FAAArrayQueue::enqueue()) with
+ *                    the DROP policy, blocking with the BLOCK policy
+ * registerFormat() - wait-free, should be called before the producers start
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class AsyncLogger {
+
+public:
+    enum Policy { DROP, BLOCK };
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int MAX_FORMATS = 4096;
+    static const int RECORD_SIZE = 128;
+    static const int NUM_CHUNKS = 16;              // Number of chunks in each writev()
+    static const int CHUNK_SIZE = 64*1024;
+    static const int MAX_LINE = 1024;              // A formatted line never exceeds this size
+
+    enum ArgType : uint8_t { ARG_INT64 = 1, ARG_UINT64 = 2, ARG_DOUBLE = 3, ARG_STRING = 4 };
+
+    struct Record {
+        std::atomic<bool> inUse;
+        uint8_t  numArgs;
+        uint16_t tid;
+        uint32_t fmtId;
+        uint64_t timestamp;
+        char     payload[RECORD_SIZE-16];
+    };
+
+    struct alignas(128) ThreadBuffer {
+        Record*               records { nullptr };  // Only allocated on the first call to log() by this thread
+        uint64_t              next { 0 };
+        std::atomic<uint64_t> dropped { 0 };
+    };
+
+    const int fd;
+    const int maxThreads;
+    const int recordsPerThread;
+    const Policy policy;
+    const std::chrono::steady_clock::time_point startTime;
+    ThreadBuffer* buffers;
+    const char* formats[MAX_FORMATS];
+    alignas(128) std::atomic<int> numFormats { 0 };
+    alignas(128) std::atomic<bool> quit { false };
+    FAAArrayQueue<Record> queue { maxThreads+1 };   // The consumer uses tid=maxThreads
+    // Only the consumer thread touches these
+    char* chunks;
+    struct iovec iov[NUM_CHUNKS];
+    int chunkLen[NUM_CHUNKS];
+    int curChunk = 0;
+    int curOffset = 0;
+    uint64_t numWritev = 0;
+    std::thread consumerThread;
+
+
+    // Encoding of the arguments, done by the producers
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, bool>::type
+    encodeArg(char*& p, const char* end, T arg) {
+        if (p + 9 > end) return false;
+        *p++ = ARG_INT64;
+        const int64_t v = arg;
+        std::memcpy(p, &v, 8);
+        p += 8;
+        return true;
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, bool>::type
+    encodeArg(char*& p, const char* end, T arg) {
+        if (p + 9 > end) return false;
+        *p++ = ARG_UINT64;
+        const uint64_t v = arg;
+        std::memcpy(p, &v, 8);
+        p += 8;
+        return true;
+    }
+
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value, bool>::type
+    encodeArg(char*& p, const char* end, T arg) {
+        if (p + 9 > end) return false;
+        *p++ = ARG_DOUBLE;
+        const double v = arg;
+        std::memcpy(p, &v, 8);
+        p += 8;
+        return true;
+    }
+
+    static bool encodeString(char*& p, const char* end, const char* str, size_t len) {
+        if (p + 3 > end) return false;
+        if (len > (size_t)(end - p - 3)) len = end - p - 3;
+        *p++ = ARG_STRING;
+        const uint16_t l16 = (uint16_t)len;
+        std::memcpy(p, &l16, 2);
+        std::memcpy(p+2, str, len);
+        p += 2 + len;
+        return true;
+    }
+
+    static bool encodeArg(char*& p, const char* end, const char* str) { return encodeString(p, end, str, std::strlen(str)); }
+
+    static bool encodeArg(char*& p, const char* end, const std::string& str) { return encodeString(p, end, str.data(), str.size()); }
+
+    static int encodeArgs(char*& p, const char* end) { return 0; }
+
+    template<typename T, typename... Args>
+    static int encodeArgs(char*& p, const char* end, const T& arg, const Args&... args) {
+        if (!encodeArg(p, end, arg)) return 0;
+        return 1 + encodeArgs(p, end, args...);
+    }
+
+
+    // Width and precision are capped so that they always fit in 'spec' and in a line
+    static inline int clampSpec(const int64_t v) {
+        return (v > MAX_LINE) ? MAX_LINE : ((v < -MAX_LINE) ? -MAX_LINE : (int)v);
+    }
+
+    // Consumes the argument of a '*' width or precision, returns zero if it's missing or not a number
+    static int nextIntArg(const char*& p, int& argsLeft) {
+        if (argsLeft == 0) return 0;
+        argsLeft--;
+        const uint8_t type = (uint8_t)*p++;
+        if (type == ARG_STRING) {
+            uint16_t len;
+            std::memcpy(&len, p, 2);
+            p += 2 + len;
+            return 0;
+        }
+        uint64_t bits;
+        std::memcpy(&bits, p, 8);
+        p += 8;
+        if (type == ARG_DOUBLE) {
+            double d;
+            std::memcpy(&d, &bits, 8);
+            return clampSpec((int64_t)d);
+        }
+        return clampSpec((int64_t)bits);
+    }
+
+
+    /*
+     * Formats one record into 'out' and returns the number of characters.
+     * 'out' must have room for MAX_LINE characters.
+     */
+    int formatRecord(const Record* r, char* out) {
+        char* o = out;
+        char* const oend = out + MAX_LINE - 1;     // Room for the '\n'
+        o += std::snprintf(o, oend - o, "[%llu %u] ", (unsigned long long)r->timestamp, (unsigned)r->tid);
+        const char* f = formats[r->fmtId];
+        const char* p = r->payload;
+        int argsLeft = r->numArgs;
+        char spec[32];
+        while (*f != 0 && o < oend) {
+            if (*f != '%') {
+                *o++ = *f++;
+                continue;
+            }
+            if (f[1] == '%') {
+                *o++ = '%';
+                f += 2;
+                continue;
+            }
+            // Copy the flags, then the width and precision. A '*' takes its value from the next argument, like printf()
+            int ispec = 0;
+            spec[ispec++] = *f++;
+            while (*f != 0 && std::strchr("-+ #0", *f) != nullptr && ispec < 6) spec[ispec++] = *f++;
+            int width = -1;
+            if (*f == '*') {
+                f++;
+                width = nextIntArg(p, argsLeft);
+                if (width < 0) {
+                    spec[ispec++] = '-';
+                    width = -width;
+                }
+            } else {
+                while (*f >= '0' && *f <= '9') width = clampSpec((width < 0 ? 0 : width*10) + (*f++ - '0'));
+            }
+            int precision = -1;            // A negative precision is the same as no precision
+            if (*f == '.') {
+                f++;
+                if (*f == '*') {
+                    f++;
+                    precision = nextIntArg(p, argsLeft);
+                } else {
+                    precision = 0;
+                    while (*f >= '0' && *f <= '9') precision = clampSpec(precision*10 + (*f++ - '0'));
+                }
+            }
+            if (width >= 0) ispec += std::snprintf(spec+ispec, 8, "%d", width);
+            // Skip the length modifiers
+            while (*f != 0 && std::strchr("hlLqjzt", *f) != nullptr) f++;
+            if (*f == 0) break;
+            const char conv = *f++;
+            if (argsLeft == 0) continue;           // Missing argument, skip the conversion
+            argsLeft--;
+            const uint8_t type = (uint8_t)*p++;
+            int n = 0;
+            if (type == ARG_STRING) {
+                uint16_t len;
+                std::memcpy(&len, p, 2);
+                // The string is not null terminated, the precision limits how much of it is printed
+                const int plen = (precision >= 0 && precision < len) ? precision : len;
+                spec[ispec++] = '.';
+                spec[ispec++] = '*';
+                spec[ispec++] = 's';
+                spec[ispec] = 0;
+                n = std::snprintf(o, oend - o, spec, plen, p+2);
+                p += 2 + len;
+            } else {
+                uint64_t bits;
+                std::memcpy(&bits, p, 8);
+                p += 8;
+                if (precision >= 0) ispec += std::snprintf(spec+ispec, 8, ".%d", precision);
+                if (conv == 'f' || conv == 'F' || conv == 'e' || conv == 'E' || conv == 'g' || conv == 'G' || conv == 'a' || conv == 'A') {
+                    double v;
+                    if (type == ARG_DOUBLE) std::memcpy(&v, &bits, 8);
+                    else v = (type == ARG_INT64) ? (double)(int64_t)bits : (double)bits;
+                    spec[ispec++] = conv;
+                    spec[ispec] = 0;
+                    n = std::snprintf(o, oend - o, spec, v);
+                } else if (conv == 'c') {
+                    spec[ispec++] = 'c';
+                    spec[ispec] = 0;
+                    n = std::snprintf(o, oend - o, spec, (int)bits);
+                } else {
+                    long long v;
+                    if (type == ARG_DOUBLE) {
+                        double d;
+                        std::memcpy(&d, &bits, 8);
+                        v = (long long)d;
+                    } else {
+                        v = (long long)bits;
+                    }
+                    spec[ispec++] = 'l';
+                    spec[ispec++] = 'l';
+                    spec[ispec++] = (conv == 's' || conv == 'p') ? 'd' : conv;
+                    spec[ispec] = 0;
+                    n = std::snprintf(o, oend - o, spec, v);
+                }
+            }
+            if (n > 0) o += (n < oend - o) ? n : (oend - o);
+        }
+        *o++ = '\n';
+        return (int)(o - out);
+    }
+
+
+    /*
+     * Writes all the chunks with a single writev(). On a partial write we
+     * keep calling writev() on what is left.
+     */
+    void flush() {
+        int niov = curChunk + ((curOffset > 0) ? 1 : 0);
+        if (niov == 0) return;
+        for (int i = 0; i < niov; i++) {
+            iov[i].iov_base = chunks + (size_t)i*CHUNK_SIZE;
+            iov[i].iov_len = (i == curChunk) ? curOffset : chunkLen[i];
+        }
+        struct iovec* liov = iov;
+        while (niov > 0) {
+            ssize_t written = ::writev(fd, liov, niov);
+            numWritev++;
+            if (written < 0) break;  // Not much we can do about it
+            while (niov > 0 && (size_t)written >= liov->iov_len) {
+                written -= liov->iov_len;
+                liov++;
+                niov--;
+            }
+            if (niov > 0) {
+                liov->iov_base = (char*)liov->iov_base + written;
+                liov->iov_len -= written;
+            }
+        }
+        curChunk = 0;
+        curOffset = 0;
+    }
+
+
+    void consumerLoop() {
+        const int tid = maxThreads;
+        while (true) {
+            Record* r = queue.dequeue(tid);
+            if (r == nullptr) {
+                flush();
+                if (quit.load()) {
+                    r = queue.dequeue(tid);
+                    if (r == nullptr) return;
+                } else {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    continue;
+                }
+            }
+            if (curOffset + MAX_LINE > CHUNK_SIZE) {
+                chunkLen[curChunk++] = curOffset;
+                curOffset = 0;
+                if (curChunk == NUM_CHUNKS) flush();
+            }
+            curOffset += formatRecord(r, chunks + (size_t)curChunk*CHUNK_SIZE + curOffset);
+            r->inUse.store(false, std::memory_order_release);
+        }
+    }
+
+
+public:
+    AsyncLogger(const int fd, const int maxThreads=64, const int recordsPerThread=4096, const Policy policy=BLOCK)
+        : fd{fd}, maxThreads{maxThreads}, recordsPerThread{recordsPerThread}, policy{policy}, startTime{std::chrono::steady_clock::now()} {
+        if (maxThreads >= MAX_THREADS) throw std::invalid_argument("maxThreads must be smaller than 128 because the consumer needs a tid");
+        if (recordsPerThread <= 0) throw std::invalid_argument("recordsPerThread must be positive");
+        buffers = new ThreadBuffer[maxThreads];
+        chunks = new char[(size_t)NUM_CHUNKS*CHUNK_SIZE];
+        consumerThread = std::thread(&AsyncLogger::consumerLoop, this);
+    }
+
+
+    // Flushes everything that was logged before returning
+    ~AsyncLogger() {
+        quit.store(true);
+        consumerThread.join();
+        for (int i = 0; i < maxThreads; i++) delete[] buffers[i].records;
+        delete[] buffers;
+        delete[] chunks;
+    }
+
+
+    static std::string className() { return "AsyncLogger"; }
+
+
+    /**
+     * Returns the id to pass to log(). The format string must outlive the logger.
+     * Should be called only once for each format, before the producers start.
+     */
+    int registerFormat(const char* fmt) {
+        const int id = numFormats.fetch_add(1);
+        if (id >= MAX_FORMATS) throw std::invalid_argument("too many format strings");
+        formats[id] = fmt;
+        return id;
+    }
+
+
+    /**
+     * Logs a record with the format fmtId and the given arguments.
+     * Returns false if the record was dropped, which can only happen with
+     * the DROP policy.
+     *
+     * @param tid The tid must be a UNIQUE index for each thread, in the range 0 to maxThreads-1
+     */
+    template<typename... Args>
+    bool log(const int tid, const int fmtId, const Args&... args) {
+        ThreadBuffer& tb = buffers[tid];
+        if (tb.records == nullptr) {
+            tb.records = new Record[recordsPerThread];
+            for (int i = 0; i < recordsPerThread; i++) tb.records[i].inUse.store(false, std::memory_order_relaxed);
+        }
+        Record* r = &tb.records[tb.next % recordsPerThread];
+        if (r->inUse.load(std::memory_order_acquire)) {
+            if (policy == DROP) {
+                tb.dropped.store(tb.dropped.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                return false;
+            }
+            while (r->inUse.load(std::memory_order_acquire)) std::this_thread::yield();
+        }
+        r->tid = (uint16_t)tid;
+        r->fmtId = fmtId;
+        r->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+        char* p = r->payload;
+        r->numArgs = (uint8_t)encodeArgs(p, r->payload + sizeof(r->payload), args...);
+        r->inUse.store(true, std::memory_order_relaxed);
+        tb.next++;
+        queue.enqueue(r, tid);
+        return true;
+    }
+
+
+    // Total number of records dropped by all the producers
+    uint64_t getDropped() {
+        uint64_t sum = 0;
+        for (int i = 0; i < maxThreads; i++) sum += buffers[i].dropped.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+
+    // Number of writev() calls done so far. Can only be read after the logger stopped.
+    uint64_t getNumWritev() const { return numWritev; }
+};
+
+#endif /* _ASYNC_LOGGER_H_ */
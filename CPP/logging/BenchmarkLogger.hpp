@@ -0,0 +1,265 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_LOGGER_H_
+#define _BENCHMARK_LOGGER_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "AsyncLogger.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * The baseline: each call to log() does an fprintf() on a FILE*, which takes
+ * the lock of the FILE and formats in the calling thread.
+ * Same API as AsyncLogger.
+ */
+class FprintfLogger {
+    static const int MAX_FORMATS = 4096;
+    FILE* file;
+    std::string formats[MAX_FORMATS];
+    std::atomic<int> numFormats { 0 };
+
+public:
+    FprintfLogger(const int fd, const int maxThreads=0, const int recordsPerThread=0, const AsyncLogger::Policy policy=AsyncLogger::BLOCK) {
+        file = fdopen(dup(fd), "w");
+        if (file == nullptr) throw std::invalid_argument("could not open fd");
+    }
+
+    ~FprintfLogger() {
+        fclose(file);
+    }
+
+    static std::string className() { return "FprintfLogger"; }
+
+    int registerFormat(const char* fmt) {
+        const int id = numFormats.fetch_add(1);
+        formats[id] = std::string(fmt) + "\n";
+        return id;
+    }
+
+    template<typename... Args>
+    bool log(const int tid, const int fmtId, const Args&... args) {
+        fprintf(file, formats[fmtId].c_str(), args...);
+        return true;
+    }
+
+    uint64_t getDropped() { return 0; }
+};
+
+
+/**
+ * Measures the cost of a call to log() as seen by the producer threads, and
+ * what happens when the sink is slower than the producers.
+ * There are two sinks: /dev/null, where the consumer is never slowed down by
+ * the writes, and a pipe where a reader thread only reads sinkBytesPerSec,
+ * i.e. a "slow disk".
+ * Each producer times batches of 100 calls to log(), so that we get the
+ * average cost per call and the worst batch, which shows the stalls due to
+ * the BLOCK policy (or to the lock of the FILE in the fprintf() case).
+ */
+class BenchmarkLogger {
+
+public:
+    enum Sink { DevNull, SlowPipe };
+    std::string SinkStr[2] = { "/dev/null", "slow pipe" };
+
+    struct Result {
+        double   nsPerCall;       // Average, over all threads, of the time per call
+        uint64_t maxBatchNs;      // Worst time for a batch of 100 calls
+        double   dropPercent;
+    };
+
+private:
+    static const int BATCH = 100;
+    const int numThreads;
+
+    /*
+     * Opens the sink. For the slow pipe, starts a reader thread that reads
+     * at most bytesPerSec and returns when the write end of the pipe is closed.
+     */
+    int openSink(Sink sink, thread& reader, const long long bytesPerSec) {
+        if (sink == DevNull) return open("/dev/null", O_WRONLY);
+        int fds[2];
+        if (pipe(fds) != 0) throw std::runtime_error("pipe() failed");
+        reader = thread([fds,bytesPerSec] () {
+            char buf[4096];
+            const auto period = nanoseconds(1000000000LL*sizeof(buf)/bytesPerSec);
+            while (read(fds[0], buf, sizeof(buf)) > 0) this_thread::sleep_for(period);
+            close(fds[0]);
+        });
+        return fds[1];
+    }
+
+public:
+    BenchmarkLogger(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Each producer calls log() in a loop for testLengthSeconds.
+     * The time it takes to flush what is left after the producers stop is
+     * not accounted for.
+     */
+    template<typename L>
+    Result benchmark(const Sink sink, const AsyncLogger::Policy policy, const seconds testLengthSeconds, const int numRuns) {
+        long long calls[numThreads][numRuns];
+        long long nanos[numThreads][numRuns];
+        uint64_t maxBatch[numThreads][numRuns];
+        vector<uint64_t> dropped(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        L* logger = nullptr;
+        int fmtId = 0;
+
+        auto prod_lambda = [this,&quit,&startFlag,&logger,&fmtId](long long *calls, long long *nanos, uint64_t *maxBatch, const int tid) {
+            const char* users[4] = { "alice", "bob", "carol", "a_user_with_a_really_long_name" };
+            long long numCalls = 0;
+            uint64_t lmax = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            auto startBeats = steady_clock::now();
+            auto prevBeats = startBeats;
+            while (!quit.load()) {
+                for (int i = 0; i < BATCH; i++) {
+                    seed = randomLong(seed);
+                    logger->log(tid, fmtId, (long long)numCalls+i, users[seed & 3], (double)(seed % 100000)/1000.);
+                }
+                numCalls += BATCH;
+                auto nowBeats = steady_clock::now();
+                const uint64_t batchNs = duration_cast<nanoseconds>(nowBeats - prevBeats).count();
+                if (batchNs > lmax) lmax = batchNs;
+                prevBeats = nowBeats;
+            }
+            *calls = numCalls;
+            *nanos = duration_cast<nanoseconds>(prevBeats - startBeats).count();
+            *maxBatch = lmax;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            thread reader;
+            const int fd = openSink(sink, reader, 4*1024*1024);
+            logger = new L(fd, numThreads, 1024, policy);
+            fmtId = logger->registerFormat("request %lld from user %s took %f ms");
+            thread prodThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) prodThreads[tid] = thread(prod_lambda, &calls[tid][irun], &nanos[tid][irun], &maxBatch[tid][irun], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) prodThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            dropped[irun] = logger->getDropped();
+            delete logger;
+            close(fd);
+            if (reader.joinable()) reader.join();
+        }
+
+        // Accounting, the median of the runs by ns per call
+        vector<Result> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            long long totalCalls = 0;
+            double sumNsPerCall = 0;
+            agg[irun].maxBatchNs = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                totalCalls += calls[tid][irun];
+                sumNsPerCall += (calls[tid][irun] == 0) ? 0 : (double)nanos[tid][irun]/calls[tid][irun];
+                agg[irun].maxBatchNs = std::max(agg[irun].maxBatchNs, maxBatch[tid][irun]);
+            }
+            agg[irun].nsPerCall = sumNsPerCall/numThreads;
+            agg[irun].dropPercent = (totalCalls == 0) ? 0 : (100.*dropped[irun])/totalCalls;
+        }
+        sort(agg.begin(), agg.end(), [](const Result& a, const Result& b) { return a.nsPerCall < b.nsPerCall; });
+        Result result = agg[numRuns/2];
+        cout << "##### " << L::className() << "  sink=" << SinkStr[sink] << "  policy=" << (policy == AsyncLogger::DROP ? "DROP" : "BLOCK");
+        cout << "  ns/log() = " << result.nsPerCall << "  max batch of " << BATCH << " = " << result.maxBatchNs << " ns  dropped = " << result.dropPercent << "% #####\n";
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16 };
+        const int numRuns = 5;
+        const seconds testLength = 5s;
+        const int NUM_CLASSES = 3;
+        Result res[NUM_CLASSES][2][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkLogger bench(nThreads);
+            std::cout << "\n----- Logger Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            for (int isink = 0; isink < 2; isink++) {
+                Sink sink = (Sink)isink;
+                res[0][isink][ithread] = bench.benchmark<AsyncLogger>(sink, AsyncLogger::BLOCK, testLength, numRuns);
+                res[1][isink][ithread] = bench.benchmark<AsyncLogger>(sink, AsyncLogger::DROP, testLength, numRuns);
+                res[2][isink][ithread] = bench.benchmark<FprintfLogger>(sink, AsyncLogger::BLOCK, testLength, numRuns);
+            }
+        }
+
+        // Show results in csv format
+        const char* names[NUM_CLASSES] = { "AsyncBLOCK", "AsyncDROP", "Fprintf" };
+        for (int isink = 0; isink < 2; isink++) {
+            cout << "\n\nResults for sink " << (isink == 0 ? "/dev/null" : "slow pipe") << " with numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Threads, ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << names[ic] << " ns/log, " << names[ic] << " max batch ns, " << names[ic] << " drop%, ";
+            cout << "\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) {
+                    cout << res[ic][isink][ithread].nsPerCall << ", " << res[ic][isink][ithread].maxBatchNs << ", " << res[ic][isink][ithread].dropPercent << ", ";
+                }
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif /* _BENCHMARK_LOGGER_H_ */
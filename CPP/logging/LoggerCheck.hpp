@@ -0,0 +1,110 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LOGGER_CHECK_H_
+#define _LOGGER_CHECK_H_
+
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include "AsyncLogger.hpp"
+
+using namespace std;
+
+
+/**
+ * Checks that the lines written by the AsyncLogger are the same as what
+ * printf() would give for the same format and arguments.
+ * Each check logs a single record to a temporary file, destroys the logger
+ * so that the record is flushed, and compares the line without the
+ * "[timestamp tid] " prefix.
+ */
+class LoggerCheck {
+
+private:
+    template<typename... Args>
+    static int check(const char* fmt, const std::string& expected, const Args&... args) {
+        FILE* file = tmpfile();
+        if (file == nullptr) {
+            cout << "ERROR: could not create a temporary file\n";
+            return 1;
+        }
+        {
+            AsyncLogger logger(fileno(file), 1, 4);
+            const int fmtId = logger.registerFormat(fmt);
+            logger.log(0, fmtId, args...);
+        }
+        char line[2048] = {};
+        rewind(file);
+        if (fgets(line, sizeof(line), file) == nullptr) line[0] = 0;
+        fclose(file);
+        std::string got(line);
+        const auto prefix = got.find("] ");
+        got = (prefix == std::string::npos) ? "" : got.substr(prefix+2);
+        if (!got.empty() && got.back() == '\n') got.pop_back();
+        if (got != expected) {
+            cout << "ERROR: format \"" << fmt << "\" gave \"" << got << "\" instead of \"" << expected << "\"\n";
+            return 1;
+        }
+        return 0;
+    }
+
+public:
+    // Returns the number of failed checks
+    static int allFormatChecks() {
+        int errors = 0;
+        errors += check("%d %s", "42 abc", 42, "abc");
+        errors += check("100%%", "100%");
+        // Precision of a string
+        errors += check("%.3s|", "abc|", "abcdef");
+        errors += check("%.10s|", "abc|", "abc");
+        errors += check("%.0s|", "|", std::string("abc"));
+        errors += check("%8.2s|", "      ab|", "abcdef");
+        // Width of a string
+        errors += check("%-10s|", "abc       |", "abc");
+        errors += check("%10s|", "       abc|", "abc");
+        // Width and precision from the arguments
+        errors += check("%*d|", "   42|", 5, 42);
+        errors += check("%-*d|", "42   |", 5, 42);
+        errors += check("%*d|", "42    |", -6, 42);
+        errors += check("%.*s|", "ab|", 2, "abcdef");
+        errors += check("%.*s|", "abcdef|", -1, "abcdef");
+        errors += check("%*.*f|", "    3.14|", 8, 2, 3.14159);
+        errors += check("%*s %d", "  x 7", 3, "x", 7);
+        // Numbers
+        errors += check("%05d|%-4d|%+d", "00042|7   |+3", 42, 7, 3);
+        errors += check("%.3f %8.1e", "2.500  1.2e+03", 2.5, 1234.5);
+        errors += check("%.4d|%x|%c", "0042|ff|z", 42, 255u, 'z');
+        // Missing arguments are skipped
+        errors += check("a%db%*dc", "a1bc", 1);
+        cout << ((errors == 0) ? "All format checks passed\n" : "Some format checks FAILED\n");
+        return errors;
+    }
+};
+
+#endif /* _LOGGER_CHECK_H_ */
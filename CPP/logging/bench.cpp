@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Jun 26, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkLogger.hpp"
+
+
+
+int main(void) {
+    BenchmarkLogger::allThroughputTests();
+    return 0;
+}
@@ -0,0 +1,13 @@
+/*
+ * check.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include "LoggerCheck.hpp"
+
+
+
+int main(void) {
+    return (LoggerCheck::allFormatChecks() == 0) ? 0 : 1;
+}
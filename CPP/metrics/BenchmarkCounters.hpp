@@ -0,0 +1,217 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_COUNTERS_H_
+#define _BENCHMARK_COUNTERS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "ResLinMonStatisticalCounter.hpp"
+#include "SlidingWindowRateCounter.hpp"
+
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * The simplest rate counter: a single atomic with fetch_add() to increment
+ * and exchange(0) to reset. This is what we compare against.
+ */
+class AtomicRateCounter {
+    alignas(128) std::atomic<uint64_t> counter { 0 };
+
+public:
+    AtomicRateCounter(const int maxThreads=0) { }
+
+    static std::string className() { return "AtomicRateCounter"; }
+
+    inline void increment() { counter.fetch_add(1); }
+
+    uint64_t sum() { return counter.load(); }
+
+    uint64_t getAndReset() { return counter.exchange(0); }
+};
+
+
+/**
+ * Micro-benchmarks for rate counters, with two scenarios:
+ * - Increment: numThreads increment as fast as they can while the main thread
+ *   resets the counter every reportPeriod (or calls tick() on the sliding
+ *   window), accumulating the values. At the end we check that nothing was
+ *   lost or counted twice;
+ * - ResetRead: numThreads increment as fast as they can while the main thread
+ *   does getAndReset() and sum() (or tick() and rate()) in a loop. Here we
+ *   measure the cost of the reporter;
+ */
+class BenchmarkCounters {
+
+public:
+    enum Scenario { Increment, ResetRead };
+
+private:
+    const int numThreads;
+
+    // Returns the number of increments that will no longer be seen by sum()
+    uint64_t takeInterval(AtomicRateCounter* c) { return c->getAndReset(); }
+    uint64_t takeInterval(ResLinMonStatisticalCounter* c) { return c->getAndReset(); }
+    uint64_t takeInterval(SlidingWindowRateCounter* c) { c->tick(); return 0; }
+
+    uint64_t readValue(AtomicRateCounter* c) { return c->sum(); }
+    uint64_t readValue(ResLinMonStatisticalCounter* c) { return c->sum(); }
+    uint64_t readValue(SlidingWindowRateCounter* c) { return (uint64_t)c->rate(); }
+
+    uint64_t remaining(AtomicRateCounter* c) { return c->sum(); }
+    uint64_t remaining(ResLinMonStatisticalCounter* c) { return c->sum(); }
+    uint64_t remaining(SlidingWindowRateCounter* c) { return c->totalSum(); }
+
+public:
+    BenchmarkCounters(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Returns the median of the number of increments per second (Increment
+     * scenario) or of reporter operations per second (ResetRead scenario).
+     */
+    template<typename C>
+    long long benchmark(const Scenario scenario, const milliseconds reportPeriod, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        long long reporterOps[numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        C* counter = nullptr;
+
+        auto inc_lambda = [&quit,&startFlag,&counter](long long *ops, const int tid) {
+            long long numOps = 0;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                for (int i = 0; i < 100; i++) counter->increment();
+                numOps += 100;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            counter = new C();
+            thread incThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) incThreads[tid] = thread(inc_lambda, &ops[tid][irun], tid);
+            uint64_t totalIntervals = 0;
+            long long numReporterOps = 0;
+            startFlag.store(true);
+            auto startBeats = steady_clock::now();
+            while (steady_clock::now() - startBeats < testLengthSeconds) {
+                if (scenario == Increment) {
+                    this_thread::sleep_for(reportPeriod);
+                    totalIntervals += takeInterval(counter);
+                } else {
+                    for (int i = 0; i < 100; i++) {
+                        totalIntervals += takeInterval(counter);
+                        readValue(counter);
+                    }
+                    numReporterOps += 100;
+                }
+            }
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) incThreads[tid].join();
+            totalIntervals += remaining(counter);
+            quit.store(false);
+            startFlag.store(false);
+            reporterOps[irun] = numReporterOps;
+            long long totalOps = 0;
+            for (int tid = 0; tid < numThreads; tid++) totalOps += ops[tid][irun];
+            if ((long long)totalIntervals != totalOps) {
+                cout << "ERROR: did " << totalOps << " increments but counted " << totalIntervals << "\n";
+            }
+            delete counter;
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            if (scenario == Increment) {
+                agg[irun] = 0;
+                for (int tid = 0; tid < numThreads; tid++) agg[irun] += ops[tid][irun];
+            } else {
+                agg[irun] = reporterOps[irun];
+            }
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        if (scenario == Increment) {
+            cout << "##### " << C::className() << "  increment()/sec = " << result << "   ns per increment() per thread = " << (1000000000.*numThreads)/result << "\n";
+        } else {
+            cout << "##### " << C::className() << "  reset+read/sec = " << result << "   ns per reset+read = " << 1000000000./result << "\n";
+        }
+        return result;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64, 128 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const milliseconds reportPeriod = 1000ms;
+        const int NUM_CLASSES = 3;
+        long long ops[2][NUM_CLASSES][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkCounters bench(nThreads);
+            std::cout << "\n----- Counters Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s   reportPeriod=" << reportPeriod.count() << "ms -----\n";
+            for (int isc = 0; isc < 2; isc++) {
+                Scenario sc = (Scenario)isc;
+                ops[isc][0][ithread] = bench.benchmark<ResLinMonStatisticalCounter>(sc, reportPeriod, testLength, numRuns);
+                ops[isc][1][ithread] = bench.benchmark<SlidingWindowRateCounter>(sc, reportPeriod, testLength, numRuns);
+                ops[isc][2][ithread] = bench.benchmark<AtomicRateCounter>(sc, reportPeriod, testLength, numRuns);
+            }
+        }
+
+        // Show results in csv format
+        const char* scenarioStr[2] = { "increment() per second", "reset+read per second (with concurrent increments)" };
+        for (int isc = 0; isc < 2; isc++) {
+            cout << "\n\nResults in " << scenarioStr[isc] << " for numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Threads, ResLinMon, SlidingWindow, AtomicRateCounter\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[isc][ic][ithread] << ", ";
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif
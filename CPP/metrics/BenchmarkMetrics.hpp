@@ -0,0 +1,216 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+#ifndef _BENCHMARK_METRICS_H_
+#define _BENCHMARK_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "IntervalRecorder.hpp"
+
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * The simplest way of doing metrics: one shared array of atomic counters
+ * where each recorded value does a fetch_add(). Taking an interval is done
+ * with an exchange(0) on each bucket, which is not atomic across buckets.
+ * This is what we compare the IntervalRecorder against.
+ */
+class AtomicHistogram {
+    static const int NUM_BUCKETS = IntervalHistogram::NUM_BUCKETS;
+    alignas(128) std::atomic<uint64_t> counts[NUM_BUCKETS];
+    alignas(128) uint64_t snapshot[NUM_BUCKETS];
+
+public:
+    AtomicHistogram(const int maxThreads=0) {
+        for (int i = 0; i < NUM_BUCKETS; i++) counts[i].store(0, std::memory_order_relaxed);
+    }
+
+    static std::string className() { return "AtomicHistogram"; }
+
+    inline void record(const int tid, const uint64_t value) {
+        int ib = (value == 0) ? 0 : 64 - __builtin_clzll(value);
+        if (ib > NUM_BUCKETS-1) ib = NUM_BUCKETS-1;
+        counts[ib].fetch_add(1);
+    }
+
+    uint64_t takeIntervalTotalCount() {
+        uint64_t sum = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            snapshot[i] = counts[i].exchange(0);
+            sum += snapshot[i];
+        }
+        return sum;
+    }
+};
+
+
+/**
+ * This is a micro-benchmark for the cost of recording a value in a histogram
+ * while a reporter thread takes an interval every reportPeriod.
+ * At the end of each run we check that the sum of all intervals matches the
+ * number of recorded values, i.e. that no value was lost across a phase flip.
+ */
+class BenchmarkMetrics {
+
+public:
+    enum MetricsTestCase { RecorderPerThread, RecorderGT, AtomicIncrement };
+    std::string TestCaseStr[3] = {
+        IntervalRecorder<IntervalHistogram,WriterReaderPhaser>::className(),
+        IntervalRecorder<IntervalHistogram,WriterReaderPhaserGT>::className(),
+        AtomicHistogram::className()
+    };
+
+private:
+    const int numThreads;
+
+public:
+    BenchmarkMetrics(const int numThreads) : numThreads{numThreads} { }
+
+
+    template<typename R>
+    uint64_t takeInterval(R* rec) { return rec->getIntervalInstance()->totalCount(); }
+
+    uint64_t takeInterval(AtomicHistogram* rec) { return rec->takeIntervalTotalCount(); }
+
+
+    /**
+     * Each thread records values as fast as it can, the main thread takes an
+     * interval every reportPeriod. Returns the median number of record() per second.
+     */
+    template<typename R>
+    long long benchmark(MetricsTestCase tc, const milliseconds reportPeriod, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        R* rec = nullptr;
+
+        std::cout << "##### " << TestCaseStr[tc] << " #####\n";
+
+        auto rec_lambda = [this,&quit,&startFlag,&rec](long long *ops, const int tid) {
+            long long numOps = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                for (int i = 0; i < 100; i++) {
+                    seed = randomLong(seed);
+                    rec->record(tid, seed >> (seed & 63)); // Values spread over all buckets
+                }
+                numOps += 100;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            rec = new R(numThreads);
+            thread recThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) recThreads[tid] = thread(rec_lambda, &ops[tid][irun], tid);
+            uint64_t totalIntervals = 0;
+            startFlag.store(true);
+            auto startBeats = steady_clock::now();
+            while (steady_clock::now() - startBeats < testLengthSeconds) {
+                this_thread::sleep_for(reportPeriod);
+                totalIntervals += takeInterval(rec);
+            }
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) recThreads[tid].join();
+            totalIntervals += takeInterval(rec);
+            quit.store(false);
+            startFlag.store(false);
+            long long totalOps = 0;
+            for (int tid = 0; tid < numThreads; tid++) totalOps += ops[tid][irun];
+            if ((long long)totalIntervals != totalOps) {
+                cout << "ERROR: recorded " << totalOps << " values but intervals contain " << totalIntervals << "\n";
+            }
+            delete rec;
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            for (int tid = 0; tid < numThreads; tid++) agg[irun] += ops[tid][irun];
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        cout << "record()/sec = " << result << "   ns per record() per thread = " << (1000000000.*numThreads)/result << "\n";
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const milliseconds reportPeriod = 100ms;
+        const int NUM_CLASSES = 3;
+        long long ops[NUM_CLASSES][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkMetrics bench(nThreads);
+            std::cout << "\n----- Metrics Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s   reportPeriod=" << reportPeriod.count() << "ms -----\n";
+            ops[0][ithread] = bench.benchmark<IntervalRecorder<IntervalHistogram,WriterReaderPhaser>>(RecorderPerThread, reportPeriod, testLength, numRuns);
+            ops[1][ithread] = bench.benchmark<IntervalRecorder<IntervalHistogram,WriterReaderPhaserGT>>(RecorderGT, reportPeriod, testLength, numRuns);
+            ops[2][ithread] = bench.benchmark<AtomicHistogram>(AtomicIncrement, reportPeriod, testLength, numRuns);
+        }
+
+        // Show results in csv format
+        cout << "\n\nResults in record() per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Threads, RecorderPerThread, RecorderGT, AtomicIncrement\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            cout << threadList[ithread] << ", ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][ithread] << ", ";
+            cout << "\n";
+        }
+    }
+};
+
+#endif
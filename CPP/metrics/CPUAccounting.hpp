@@ -0,0 +1,233 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _CPU_ACCOUNTING_H_
+#define _CPU_ACCOUNTING_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <iostream>
+#ifdef __linux__
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+
+/**
+ * <h1> CPU Sample </h1>
+ *
+ * CPU time and context switches of the calling thread (or of the whole
+ * process). Take one sample at the start of the measurement and another at
+ * the end, the difference is what the thread spent in that interval.
+ *
+ * Throughput alone doesn't tell the whole story: most of the wait loops in
+ * this repo spin on std::this_thread::yield(), so a lock with good ops/sec
+ * may be doing it by burning every core. Dividing the number of operations
+ * by the CPU time gives ops per CPU-second, which is what we pay for.
+ *
+ * The voluntary context switches are the ones where the thread blocked
+ * (futex, sleep, yield() with other runnable threads) and the involuntary
+ * ones are where it was preempted.
+ * This needs RUSAGE_THREAD, which is Linux only. On other systems (MinGW)
+ * all the samples are zero and the benchmarks show zero ops per CPU-second.
+ */
+struct CPUSample {
+    int64_t cpuNs {0};
+    int64_t volCtxSwitches {0};
+    int64_t involCtxSwitches {0};
+
+#ifdef __linux__
+    // Must be called by the thread being measured
+    static CPUSample thread() {
+        return take(CLOCK_THREAD_CPUTIME_ID, RUSAGE_THREAD);
+    }
+
+    // All threads of this process, including the ones that have exited
+    static CPUSample process() {
+        return take(CLOCK_PROCESS_CPUTIME_ID, RUSAGE_SELF);
+    }
+#else
+    static CPUSample thread() { return CPUSample(); }
+    static CPUSample process() { return CPUSample(); }
+#endif
+
+    CPUSample operator-(const CPUSample& other) const {
+        CPUSample ret;
+        ret.cpuNs = cpuNs - other.cpuNs;
+        ret.volCtxSwitches = volCtxSwitches - other.volCtxSwitches;
+        ret.involCtxSwitches = involCtxSwitches - other.involCtxSwitches;
+        return ret;
+    }
+
+    CPUSample& operator+=(const CPUSample& other) {
+        cpuNs += other.cpuNs;
+        volCtxSwitches += other.volCtxSwitches;
+        involCtxSwitches += other.involCtxSwitches;
+        return *this;
+    }
+
+#ifdef __linux__
+private:
+    static CPUSample take(clockid_t clk, int who) {
+        CPUSample s;
+        struct timespec ts;
+        if (clock_gettime(clk, &ts) == 0) s.cpuNs = ts.tv_sec*1000000000LL + ts.tv_nsec;
+        struct rusage ru;
+        if (getrusage(who, &ru) == 0) {
+            s.volCtxSwitches = ru.ru_nvcsw;
+            s.involCtxSwitches = ru.ru_nivcsw;
+        }
+        return s;
+    }
+#endif
+};
+
+
+/**
+ * <h1> RAPL Energy </h1>
+ *
+ * Package energy as exposed by the Linux powercap sysfs in
+ * /sys/class/powercap/intel-rapl:N/energy_uj, one entry per socket (the
+ * sub-domains like intel-rapl:0:0 are part of the package and are not added).
+ * The counters wrap around at max_energy_range_uj, which takes minutes on a
+ * busy server, so we handle at most one wrap per measurement.
+ *
+ * On most kernels energy_uj is readable only by root, and there is no such
+ * thing on non-Intel/AMD machines or inside VMs. In those cases available()
+ * returns false and the benchmarks don't show ops per joule.
+ * Keep in mind that this is the energy of the whole package, including
+ * whatever else is running on the machine.
+ */
+class RAPLEnergy {
+    struct Domain {
+        std::string path;
+        uint64_t maxRange;
+        uint64_t start;
+    };
+    std::vector<Domain> domains;
+
+    static bool readU64(const std::string& path, uint64_t& value) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (f == nullptr) return false;
+        unsigned long long v;
+        const bool ok = (fscanf(f, "%llu", &v) == 1);
+        fclose(f);
+        if (ok) value = v;
+        return ok;
+    }
+
+public:
+    RAPLEnergy() {
+        for (int ipkg = 0; ; ipkg++) {
+            const std::string dir = "/sys/class/powercap/intel-rapl:" + std::to_string(ipkg);
+            Domain d { dir + "/energy_uj", 0, 0 };
+            uint64_t tmp;
+            if (!readU64(dir + "/max_energy_range_uj", d.maxRange)) break;
+            if (!readU64(d.path, tmp)) break;
+            domains.push_back(d);
+        }
+    }
+
+    bool available() const { return !domains.empty(); }
+
+    void start() {
+        for (auto& d : domains) readU64(d.path, d.start);
+    }
+
+    // Joules used by all packages since start()
+    double stopJoules() {
+        uint64_t sumUJ = 0;
+        for (auto& d : domains) {
+            uint64_t end = d.start;
+            readU64(d.path, end);
+            sumUJ += (end >= d.start) ? end - d.start : d.maxRange - d.start + end;
+        }
+        return sumUJ/1e6;
+    }
+};
+
+
+/**
+ * <h1> CPU Accounting </h1>
+ *
+ * Aggregates the CPUSample deltas of all the worker threads of a run, plus
+ * the package energy when RAPL is available, and shows them next to the
+ * throughput. Usage:
+ *   acc.start();                         // main thread, before the workers start
+ *   acc.addThread(CPUSample::thread()-s) // each worker, at the end
+ *   acc.stop();                          // main thread, after joining the workers
+ *   acc.print(numOps, seconds);
+ * addThread() is not thread-safe, the workers should store their deltas and
+ * the main thread adds them after the join().
+ */
+class CPUAccounting {
+    RAPLEnergy rapl;
+    CPUSample total;
+    double joules {0};
+
+public:
+    void start() {
+        total = CPUSample();
+        joules = 0;
+        rapl.start();
+    }
+
+    void addThread(const CPUSample& delta) { total += delta; }
+
+    void stop() {
+        if (rapl.available()) joules = rapl.stopJoules();
+    }
+
+    const CPUSample& cpu() const { return total; }
+
+    double cpuSeconds() const { return total.cpuNs/1e9; }
+
+    long long opsPerCPUSec(const long long numOps) const {
+        return (total.cpuNs <= 0) ? 0 : (long long)(numOps/cpuSeconds());
+    }
+
+    // Returns zero if RAPL is not available
+    long long opsPerJoule(const long long numOps) const {
+        return (joules <= 0) ? 0 : (long long)(numOps/joules);
+    }
+
+    void print(const long long numOps, const double seconds) const {
+        std::cout << "Ops/CPU-sec = " << opsPerCPUSec(numOps);
+        std::cout << "   CPU-sec/sec = " << cpuSeconds()/seconds;
+        if (rapl.available()) {
+            std::cout << "   Ops/J = " << opsPerJoule(numOps) << "   Watts = " << joules/seconds;
+        } else {
+            std::cout << "   Ops/J = n/a";
+        }
+        std::cout << "   ctxsw vol/invol = " << total.volCtxSwitches << "/" << total.involCtxSwitches << "\n";
+    }
+};
+
+#endif /* _CPU_ACCOUNTING_H_ */
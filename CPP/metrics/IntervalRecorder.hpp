@@ -0,0 +1,242 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _INTERVAL_RECORDER_H_
+#define _INTERVAL_RECORDER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "WriterReaderPhaser.hpp"
+
+
+/**
+ * <h1> Interval Histogram </h1>
+ *
+ * A histogram with 64 power-of-two buckets where each thread has its own
+ * (padded) row of buckets. Because only the owner thread ever writes to its
+ * row, recording a value is a relaxed load plus a relaxed store, no FAA.
+ * Reading the histogram sums all the rows, so it should only be done on an
+ * instance that is quiescent, i.e. the inactive instance of an IntervalRecorder.
+ *
+ * Bucket i holds the values in the range [2^(i-1), 2^i[, bucket 0 holds zero
+ * and the last bucket also holds everything above 2^63.
+ */
+class IntervalHistogram {
+
+public:
+    static const int NUM_BUCKETS = 64;
+
+private:
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    alignas(128) std::atomic<uint64_t>* counts;
+
+    static inline int bucketOf(uint64_t value) {
+        if (value == 0) return 0;
+        const int ib = 64 - __builtin_clzll(value);
+        return (ib > NUM_BUCKETS-1) ? NUM_BUCKETS-1 : ib;
+    }
+
+public:
+    IntervalHistogram(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        counts = new std::atomic<uint64_t>[maxThreads*NUM_BUCKETS];
+        reset();
+    }
+
+    ~IntervalHistogram() {
+        delete[] counts;
+    }
+
+    static std::string className() { return "IntervalHistogram"; }
+
+    // Progress Condition: Wait-Free Population Oblivious
+    inline void record(const int tid, const uint64_t value) {
+        std::atomic<uint64_t>& c = counts[tid*NUM_BUCKETS + bucketOf(value)];
+        c.store(c.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+    }
+
+    // Must be called only on a quiescent instance
+    void reset() {
+        for (int i = 0; i < maxThreads*NUM_BUCKETS; i++) counts[i].store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t bucketCount(const int ibucket) const {
+        uint64_t sum = 0;
+        for (int tid = 0; tid < maxThreads; tid++) sum += counts[tid*NUM_BUCKETS + ibucket].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    uint64_t totalCount() const {
+        uint64_t sum = 0;
+        for (int i = 0; i < maxThreads*NUM_BUCKETS; i++) sum += counts[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Returns the upper bound of the bucket that contains the given percentile (0 to 100)
+    uint64_t valueAtPercentile(const double percentile) const {
+        const uint64_t total = totalCount();
+        if (total == 0) return 0;
+        uint64_t target = (uint64_t)(percentile*total/100.);
+        if (target == 0) target = 1;
+        uint64_t acc = 0;
+        for (int ib = 0; ib < NUM_BUCKETS; ib++) {
+            acc += bucketCount(ib);
+            if (acc >= target) return (ib == 0) ? 0 : (1ULL << ib)-1;
+        }
+        return UINT64_MAX;
+    }
+};
+
+
+/**
+ * <h1> Interval Counters </h1>
+ *
+ * A set of numCounters counters where, just like in IntervalHistogram, each
+ * thread has its own padded row, and incrementing is a load plus a store.
+ */
+class IntervalCounters {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(std::atomic<uint64_t>);
+    const int maxThreads;
+    const int numCounters;
+    const int rowLength;    // numCounters rounded up to a multiple of a cache line
+    alignas(128) std::atomic<uint64_t>* counts;
+
+public:
+    IntervalCounters(const int maxThreads=MAX_THREADS, const int numCounters=CLPAD)
+        : maxThreads{maxThreads}, numCounters{numCounters}, rowLength{((numCounters+CLPAD-1)/CLPAD)*CLPAD} {
+        counts = new std::atomic<uint64_t>[maxThreads*rowLength];
+        reset();
+    }
+
+    ~IntervalCounters() {
+        delete[] counts;
+    }
+
+    static std::string className() { return "IntervalCounters"; }
+
+    // Progress Condition: Wait-Free Population Oblivious
+    inline void record(const int tid, const int icounter, const uint64_t delta=1) {
+        std::atomic<uint64_t>& c = counts[tid*rowLength + icounter];
+        c.store(c.load(std::memory_order_relaxed)+delta, std::memory_order_relaxed);
+    }
+
+    // Must be called only on a quiescent instance
+    void reset() {
+        for (int i = 0; i < maxThreads*rowLength; i++) counts[i].store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t get(const int icounter) const {
+        uint64_t sum = 0;
+        for (int tid = 0; tid < maxThreads; tid++) sum += counts[tid*rowLength + icounter].load(std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+
+/**
+ * <h1> Interval Recorder </h1>
+ *
+ * Holds two instances of B (an IntervalHistogram or IntervalCounters), an
+ * active one where the recording threads write to, and an inactive one which
+ * the reporting thread can read from without stopping the recorders.
+ * It is the same idea as HdrHistogram's Recorder, with the phase flip done by
+ * a WriterReaderPhaser (per-thread entries by default, or the GT variant).
+ *
+ * record()              - Progress of P::writerCriticalSectionEnter()/Exit()
+ * getIntervalInstance() - Blocking
+ *
+ * With the default WriterReaderPhaser, a call to record() does two stores
+ * on the phaser entry of the calling thread plus one load and one store on
+ * the row of the calling thread. No FAA and no shared cache lines.
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename B, typename P = WriterReaderPhaser>
+class IntervalRecorder {
+
+private:
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    P phaser { maxThreads };
+    alignas(128) std::atomic<B*> active;
+    alignas(128) B* inactive;
+
+public:
+    template<typename... Args>
+    IntervalRecorder(const int maxThreads, Args... args) : maxThreads{maxThreads} {
+        active.store(new B(maxThreads, args...), std::memory_order_relaxed);
+        inactive = new B(maxThreads, args...);
+    }
+
+    IntervalRecorder() : IntervalRecorder(MAX_THREADS) { }
+
+    ~IntervalRecorder() {
+        delete active.load();
+        delete inactive;
+    }
+
+    static std::string className() { return "IntervalRecorder<" + B::className() + "," + P::className() + ">"; }
+
+    /**
+     * Records into the active instance. The arguments after the tid are
+     * passed as-is to B::record().
+     */
+    template<typename... Args>
+    inline void record(const int tid, Args... args) {
+        const auto lvi = phaser.writerCriticalSectionEnter(tid);
+        active.load()->record(tid, args...);
+        phaser.writerCriticalSectionExit(lvi, tid);
+    }
+
+    /**
+     * Swaps the active and inactive instances and returns the one that was
+     * active, after all recorders have left it.
+     * The returned instance contains everything recorded since the previous
+     * call to getIntervalInstance() and can be read until the next call.
+     * Only one reporting thread should call this method at a time.
+     *
+     * Progress Condition: Blocking
+     */
+    B* getIntervalInstance() {
+        phaser.readerLock();
+        inactive->reset();
+        B* prevActive = active.exchange(inactive);
+        phaser.flipPhase();
+        inactive = prevActive;
+        phaser.readerUnlock();
+        return prevActive;
+    }
+};
+
+#endif /* _INTERVAL_RECORDER_H_ */
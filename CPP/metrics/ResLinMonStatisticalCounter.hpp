@@ -0,0 +1,170 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _RESLINMON_STATISTICAL_COUNTER_H_
+#define _RESLINMON_STATISTICAL_COUNTER_H_
+
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+
+/**
+ * <h1> Resettable Linearizable Monotonic Statistical Counter </h1>
+ *
+ * C++ port of ResLinMonStatisticalCounter.java.
+ * A statistical counter with atomic counters on different cache lines, where
+ * each thread does a fetch_add() on the counter chosen by a hash of its
+ * thread id, and sum() aggregates all the counters.
+ * It permits only monotonic increments, and the reset() is linearizable with
+ * all the other methods.
+ *
+ * The Java version resets by swapping in a new array and letting the GC take
+ * care of the old one. Here we can't do that without adding a memory
+ * reclamation scheme to increment(), so we use the fact that the counters
+ * are monotonic: a collect (reading all the counters in sequence) of a
+ * counter that is only incremented by one at a time returns a value that the
+ * total had at some instant during the collect, i.e. it is linearizable.
+ * reset() stores the result of a collect in 'base', and sum() returns the
+ * collect minus the base, retrying if the base changed in the meantime.
+ * This way, increment() is a single fetch_add(), and getAndReset() returns
+ * exactly the number of increments since the previous reset, with no
+ * increment lost or counted twice, which is what is needed for rates.
+ *
+ * increment()   - Wait-Free Population Oblivious on x86, Lock-Free otherwise
+ * add()         - Wait-Free Population Oblivious on x86, Lock-Free otherwise
+ * sum()         - Lock-Free, Wait-Free (bounded by the number of cores) without concurrent resets
+ * reset()       - Lock-Free, Wait-Free (bounded by the number of cores) without concurrent resets
+ * getAndReset() - Lock-Free, Wait-Free (bounded by the number of cores) without concurrent resets
+ *
+ * http://concurrencyfreaks.com/2013/08/concurrency-pattern-distributed-cache.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class ResLinMonStatisticalCounter {
+
+private:
+    static const int CLPAD = 128/sizeof(std::atomic<uint64_t>);
+    const int numCounters;
+    alignas(128) std::atomic<uint64_t>* counters;
+    alignas(128) std::atomic<uint64_t> base { 0 };
+    std::hash<std::thread::id> hashFunc;
+
+    static int highestOneBit(int i) {
+        int hob = 1;
+        while ((i >>= 1) != 0) hob <<= 1;
+        return hob;
+    }
+
+    /**
+     * An imprecise but fast hash function (by George Marsaglia)
+     */
+    inline int tid2idx() {
+        std::size_t x = hashFunc(std::this_thread::get_id());
+        x ^= (x << 21);
+        x ^= (x >> 35);
+        x ^= (x << 4);
+        return (int)(((numCounters-1) & x)*CLPAD);
+    }
+
+    // Linearizable because the counters are monotonic
+    inline uint64_t collect() {
+        uint64_t total = 0;
+        for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) total += counters[idx].load();
+        return total;
+    }
+
+public:
+    ResLinMonStatisticalCounter(const int maxThreads=0) : numCounters{highestOneBit(std::max(1u, std::thread::hardware_concurrency()))<<1} {
+        counters = new std::atomic<uint64_t>[numCounters*CLPAD];
+        for (int idx = 0; idx < numCounters*CLPAD; idx += CLPAD) counters[idx].store(0, std::memory_order_relaxed);
+    }
+
+    ~ResLinMonStatisticalCounter() {
+        delete[] counters;
+    }
+
+    static std::string className() { return "ResLinMonStatisticalCounter"; }
+
+
+    // Progress Condition: Wait-Free Population Oblivious on x86
+    inline void increment() {
+        counters[tid2idx()].fetch_add(1);
+    }
+
+
+    /**
+     * Adds delta to the counter. Notice that with delta > 1 the total skips
+     * values, so a concurrent sum() may return a value between two of them.
+     *
+     * Progress Condition: Wait-Free Population Oblivious on x86
+     */
+    inline void add(const uint64_t delta) {
+        counters[tid2idx()].fetch_add(delta);
+    }
+
+
+    /**
+     * Returns the number of increments since the last reset().
+     *
+     * Progress Condition: Lock-Free
+     */
+    uint64_t sum() {
+        while (true) {
+            const uint64_t lbase = base.load();
+            const uint64_t total = collect();
+            if (lbase == base.load()) return total - lbase;
+        }
+    }
+
+
+    /**
+     * Sets the counter to zero and returns the value it had just before.
+     *
+     * Progress Condition: Lock-Free
+     */
+    uint64_t getAndReset() {
+        while (true) {
+            uint64_t lbase = base.load();
+            const uint64_t total = collect();
+            if (base.compare_exchange_strong(lbase, total)) return total - lbase;
+        }
+    }
+
+
+    // Progress Condition: Lock-Free
+    void reset() {
+        getAndReset();
+    }
+};
+
+#endif /* _RESLINMON_STATISTICAL_COUNTER_H_ */
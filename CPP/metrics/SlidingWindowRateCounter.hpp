@@ -0,0 +1,160 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _SLIDING_WINDOW_RATE_COUNTER_H_
+#define _SLIDING_WINDOW_RATE_COUNTER_H_
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include "ResLinMonStatisticalCounter.hpp"
+
+
+/**
+ * <h1> Sliding Window Rate Counter </h1>
+ *
+ * Counts events over a sliding window of the last numSeconds complete
+ * seconds, using numSeconds+1 ResLinMonStatisticalCounters in a ring: one
+ * for the current second and one for each of the seconds in the window.
+ * The 'current' variable is the number of the current second, and increment()
+ * is a load of 'current' followed by the increment() on its counter.
+ *
+ * Nothing in increment() looks at the clock, so someone has to call tick()
+ * once per second, typically the thread that reports the rate. tick() resets
+ * the oldest counter, the one that is leaving the window, and only then
+ * advances 'current' so that it becomes the counter of the new second.
+ * Because getAndReset() is linearizable, an increment() that lands on the
+ * oldest counter is either counted in the second where it read 'current'
+ * (and expires with it), or in the new second if it happens after the reset.
+ * Either way it is counted exactly once, and in a second during which the
+ * increment() was in progress.
+ *
+ * increment()   - Same as ResLinMonStatisticalCounter::increment()
+ * tick()        - Blocking
+ * windowSum()   - Blocking
+ * rate()        - Blocking
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class SlidingWindowRateCounter {
+
+private:
+    const int numSeconds;
+    const int numBuckets;
+    ResLinMonStatisticalCounter* buckets;
+    alignas(128) std::atomic<uint64_t> current { 0 };
+    alignas(128) std::mutex tickMutex;
+    uint64_t expired = 0;       // Sum of all the seconds that left the window
+
+    // Must be called with tickMutex held
+    uint64_t sumLastSeconds(const uint64_t cur, const int n) {
+        uint64_t sum = 0;
+        for (int i = 1; i <= n; i++) sum += buckets[(cur - i) % numBuckets].sum();
+        return sum;
+    }
+
+public:
+    SlidingWindowRateCounter(const int numSeconds=10) : numSeconds{numSeconds}, numBuckets{numSeconds+1} {
+        if (numSeconds < 1) throw std::invalid_argument("numSeconds must be at least 1");
+        buckets = new ResLinMonStatisticalCounter[numBuckets];
+    }
+
+    ~SlidingWindowRateCounter() {
+        delete[] buckets;
+    }
+
+    static std::string className() { return "SlidingWindowRateCounter"; }
+
+
+    // Progress Condition: Wait-Free Population Oblivious on x86
+    inline void increment() {
+        buckets[current.load() % numBuckets].increment();
+    }
+
+
+    // Progress Condition: Wait-Free Population Oblivious on x86
+    inline void add(const uint64_t delta) {
+        buckets[current.load() % numBuckets].add(delta);
+    }
+
+
+    /**
+     * Closes the current second and starts a new one.
+     * Should be called once per second.
+     *
+     * Progress Condition: Blocking
+     */
+    void tick() {
+        std::lock_guard<std::mutex> lock(tickMutex);
+        const uint64_t next = current.load() + 1;
+        expired += buckets[next % numBuckets].getAndReset();
+        current.store(next);
+    }
+
+
+    /**
+     * Returns the number of events in the last numSeconds complete seconds,
+     * i.e. not counting the current second.
+     *
+     * Progress Condition: Blocking
+     */
+    uint64_t windowSum() {
+        std::lock_guard<std::mutex> lock(tickMutex);
+        const uint64_t cur = current.load();
+        return sumLastSeconds(cur, (cur < (uint64_t)numSeconds) ? (int)cur : numSeconds);
+    }
+
+
+    // Average number of events per second over the window
+    double rate() {
+        std::lock_guard<std::mutex> lock(tickMutex);
+        const uint64_t cur = current.load();
+        const int n = (cur < (uint64_t)numSeconds) ? (int)cur : numSeconds;
+        if (n == 0) return 0;
+        return (double)sumLastSeconds(cur, n) / n;
+    }
+
+
+    /**
+     * Returns the total number of events since the counter was created, which
+     * is the sum of all the seconds that have expired plus the ones in the ring.
+     * Only meant for checking that no event was lost, with no concurrent increments.
+     */
+    uint64_t totalSum() {
+        std::lock_guard<std::mutex> lock(tickMutex);
+        uint64_t sum = expired;
+        for (int i = 0; i < numBuckets; i++) sum += buckets[i].sum();
+        return sum;
+    }
+};
+
+#endif /* _SLIDING_WINDOW_RATE_COUNTER_H_ */
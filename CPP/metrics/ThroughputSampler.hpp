@@ -0,0 +1,297 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _THROUGHPUT_SAMPLER_H_
+#define _THROUGHPUT_SAMPLER_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <cstdint>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+
+/**
+ * <h1> Throughput Sampler </h1>
+ *
+ * Turns a benchmark run into a time series: each worker thread bumps its own
+ * (padded) counter after every operation and a sampler thread takes the sum
+ * of all counters every period (10 ms by default), along with the RSS of
+ * the process.
+ * A single number per run hides the periodic stalls, like a Hazard Pointers
+ * scan, a copy in a COW lock, or a list of retired nodes that keeps growing,
+ * and these show up as dips in the time series.
+ *
+ * add()   - Wait-Free Population Oblivious (one relaxed load and one relaxed
+ *           store on a cache line owned by the calling thread)
+ * total() - Wait-Free Bounded (sums maxThreads counters)
+ *
+ * Usage:
+ *   sampler.start(period);  // before the workers start
+ *   sampler.add(tid, 1);    // by each worker, after each operation
+ *   sampler.stop();         // after the workers are done
+ *   sampler.summary().print();
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class ThroughputSampler {
+
+public:
+    struct Sample {
+        int64_t timeNs;        // end of the interval, since start()
+        int64_t intervalNs;    // actual length of the interval, the sampler may oversleep
+        uint64_t ops;          // operations done in this interval
+        long rssKB;            // RSS without the memory taken by the samples themselves
+    };
+
+    /*
+     * A dip is a sequence of consecutive intervals whose throughput is below
+     * dipFraction of the median throughput, the depth is how far below the
+     * median the worst of those intervals went (1.0 means zero operations).
+     */
+    struct Summary {
+        double seconds {0};
+        double medianOpsPerSec {0};
+        double minOpsPerSec {0};
+        double p1OpsPerSec {0};
+        double coefVariation {0};   // stddev/mean of the per-interval throughput
+        double driftPercent {0};    // last 10% of the run versus first 10%
+        long numDips {0};
+        double dipsPerSec {0};
+        double maxDipDepth {0};
+        double meanDipDepth {0};
+        double longestDipMs {0};
+        long rssStartKB {0};
+        long rssEndKB {0};
+        long rssMaxKB {0};
+        double rssDriftKBPerHour {0};
+
+        void print() const {
+            std::cout << "Intervals: median Ops/sec = " << (long long)medianOpsPerSec << "   min = " << (long long)minOpsPerSec;
+            std::cout << "   p1 = " << (long long)p1OpsPerSec << "   CV = " << coefVariation << "   drift = " << driftPercent << "%\n";
+            std::cout << "Dips: count = " << numDips << "   per sec = " << dipsPerSec << "   max depth = " << 100*maxDipDepth;
+            std::cout << "%   mean depth = " << 100*meanDipDepth << "%   longest = " << longestDipMs << " ms\n";
+            std::cout << "RSS: start = " << rssStartKB << " KB   end = " << rssEndKB << " KB   max = " << rssMaxKB;
+            std::cout << " KB   drift = " << (long long)rssDriftKBPerHour << " KB/hour\n";
+        }
+    };
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(std::atomic<uint64_t>);
+    const int maxThreads;
+    std::chrono::nanoseconds period { std::chrono::milliseconds(10) };
+    std::atomic<uint64_t>* counters;
+    std::atomic<bool> quit { false };
+    std::thread* sampler { nullptr };
+    std::vector<Sample> samples;
+
+    void run() {
+        const auto startBeats = std::chrono::steady_clock::now();
+        auto prevBeats = startBeats;
+        auto nextBeats = startBeats;
+        uint64_t prevTotal = 0;
+        while (!quit.load()) {
+            nextBeats += period;
+            std::this_thread::sleep_until(nextBeats);
+            const uint64_t sum = total();
+            const auto nowBeats = std::chrono::steady_clock::now();
+            // Don't count our own samples, otherwise a long run shows up as an RSS drift
+            const long samplesKB = (long)((samples.size()+1)*sizeof(Sample)/1024);
+            samples.push_back({ (nowBeats-startBeats).count(), (nowBeats-prevBeats).count(), sum-prevTotal, readRSSKB()-samplesKB });
+            prevTotal = sum;
+            prevBeats = nowBeats;
+        }
+    }
+
+    static double opsPerSec(const Sample& s) {
+        return (s.intervalNs <= 0) ? 0 : s.ops*1e9/s.intervalNs;
+    }
+
+public:
+    ThroughputSampler(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        counters = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int i = 0; i < maxThreads*CLPAD; i += CLPAD) counters[i].store(0, std::memory_order_relaxed);
+    }
+
+    ~ThroughputSampler() {
+        stop();
+        delete[] counters;
+    }
+
+    static std::string className() { return "ThroughputSampler"; }
+
+    // Progress Condition: Wait-Free Population Oblivious
+    inline void add(const int tid, const uint64_t numOps=1) {
+        std::atomic<uint64_t>& c = counters[tid*CLPAD];
+        c.store(c.load(std::memory_order_relaxed)+numOps, std::memory_order_relaxed);
+    }
+
+    // Progress Condition: Wait-Free Bounded
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (int i = 0; i < maxThreads*CLPAD; i += CLPAD) sum += counters[i].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    /*
+     * Resets the counters and starts the sampler thread, which will take a
+     * sample every samplePeriod.
+     * The samples for expectedLength are allocated up front, so that the
+     * sampler thread doesn't reallocate (and copy) them during the run.
+     * Must not be called while there are workers calling add().
+     */
+    void start(const std::chrono::nanoseconds samplePeriod=std::chrono::milliseconds(10),
+               const std::chrono::nanoseconds expectedLength=std::chrono::seconds(0)) {
+        stop();
+        period = samplePeriod;
+        for (int i = 0; i < maxThreads*CLPAD; i += CLPAD) counters[i].store(0, std::memory_order_relaxed);
+        samples.clear();
+        samples.reserve(expectedLength/samplePeriod + 16);
+        quit.store(false);
+        sampler = new std::thread(&ThroughputSampler::run, this);
+    }
+
+    void stop() {
+        if (sampler == nullptr) return;
+        quit.store(true);
+        sampler->join();
+        delete sampler;
+        sampler = nullptr;
+    }
+
+    // Must be called after stop()
+    const std::vector<Sample>& getSamples() const { return samples; }
+
+    /*
+     * The intervals with no operations at the start and end are not taken into
+     * account, they're from before the workers started or after they finished.
+     * Must be called after stop()
+     */
+    Summary summary(const double dipFraction=0.5) const {
+        Summary sm;
+        int ifirst = 0;
+        int ilast = samples.size();
+        while (ifirst < ilast && samples[ifirst].ops == 0) ifirst++;
+        while (ilast > ifirst && samples[ilast-1].ops == 0) ilast--;
+        if (ifirst == ilast) return sm;
+        const int n = ilast - ifirst;
+        const Sample* series = samples.data() + ifirst;
+        std::vector<double> rates(n);
+        double mean = 0;
+        for (int i = 0; i < n; i++) {
+            rates[i] = opsPerSec(series[i]);
+            mean += rates[i];
+        }
+        mean /= n;
+        std::vector<double> sorted(rates);
+        std::sort(sorted.begin(), sorted.end());
+        sm.seconds = (series[n-1].timeNs - series[0].timeNs + series[0].intervalNs)/1e9;
+        sm.medianOpsPerSec = sorted[n/2];
+        sm.minOpsPerSec = sorted[0];
+        sm.p1OpsPerSec = sorted[n/100];
+        double var = 0;
+        for (int i = 0; i < n; i++) var += (rates[i]-mean)*(rates[i]-mean);
+        sm.coefVariation = (mean == 0) ? 0 : std::sqrt(var/n)/mean;
+        // Long-run degradation of the throughput
+        const int tenth = std::max(1, n/10);
+        double first = 0, last = 0;
+        for (int i = 0; i < tenth; i++) {
+            first += rates[i];
+            last += rates[n-1-i];
+        }
+        sm.driftPercent = (first == 0) ? 0 : 100.*(last-first)/first;
+        // Dips
+        const double threshold = dipFraction*sm.medianOpsPerSec;
+        double sumDepth = 0;
+        for (int i = 0; i < n; ) {
+            if (rates[i] >= threshold || sm.medianOpsPerSec == 0) { i++; continue; }
+            double minRate = rates[i];
+            int64_t dipNs = 0;
+            for (; i < n && rates[i] < threshold; i++) {
+                minRate = std::min(minRate, rates[i]);
+                dipNs += series[i].intervalNs;
+            }
+            const double depth = 1. - minRate/sm.medianOpsPerSec;
+            sm.numDips++;
+            sumDepth += depth;
+            sm.maxDipDepth = std::max(sm.maxDipDepth, depth);
+            sm.longestDipMs = std::max(sm.longestDipMs, dipNs/1e6);
+        }
+        sm.meanDipDepth = (sm.numDips == 0) ? 0 : sumDepth/sm.numDips;
+        sm.dipsPerSec = (sm.seconds == 0) ? 0 : sm.numDips/sm.seconds;
+        // RSS drift is the slope of a least-squares fit, to be less sensitive to the first samples
+        sm.rssStartKB = series[0].rssKB;
+        sm.rssEndKB = series[n-1].rssKB;
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (int i = 0; i < n; i++) {
+            const double x = (series[i].timeNs - series[0].timeNs)/3.6e12;   // hours
+            const double y = series[i].rssKB;
+            sx += x; sy += y; sxx += x*x; sxy += x*y;
+            sm.rssMaxKB = std::max(sm.rssMaxKB, series[i].rssKB);
+        }
+        const double den = n*sxx - sx*sx;
+        sm.rssDriftKBPerHour = (den == 0) ? 0 : (n*sxy - sx*sy)/den;
+        return sm;
+    }
+
+    /*
+     * Shows the time series in csv format, one line per interval.
+     * Must be called after stop()
+     */
+    void printTimeSeries(std::ostream& os=std::cout) const {
+        os << "Time (ms), Ops/sec, RSS (KB)\n";
+        for (auto& s : samples) os << s.timeNs/1000000 << ", " << (long long)opsPerSec(s) << ", " << s.rssKB << "\n";
+    }
+
+    // Resident set size of this process, in KB. Returns zero if not on Linux.
+    static long readRSSKB() {
+#ifdef __linux__
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (f == nullptr) return 0;
+        long pages = 0, rss = 0;
+        const int ret = fscanf(f, "%ld %ld", &pages, &rss);
+        fclose(f);
+        return (ret == 2) ? rss*(sysconf(_SC_PAGESIZE)/1024) : 0;
+#else
+        return 0;
+#endif
+    }
+};
+
+#endif /* _THROUGHPUT_SAMPLER_H_ */
@@ -0,0 +1,18 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Jun 12, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkMetrics.hpp"
+#include "BenchmarkCounters.hpp"
+
+
+
+int main(void) {
+    BenchmarkMetrics::allThroughputTests();
+    BenchmarkCounters::allThroughputTests();
+    return 0;
+}
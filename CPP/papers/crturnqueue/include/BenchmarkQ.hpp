@@ -37,6 +37,8 @@
 #include <cassert>
 #include "MichaelScottQueue.hpp"
 #include "CRTurnQueue.hpp"
+#include "ThroughputSampler.hpp"
+#include "CPUAccounting.hpp"
 //#include "KoganPetrankQueueCHP.hpp"
 
 
@@ -59,6 +61,7 @@ private:
         long long numEnq = 0;
         long long numDeq = 0;
         long long totOpsSec = 0;
+        int irun = 0;           // So that we can find the CPU accounting of the median run
 
         Result() { }
 
@@ -68,6 +71,7 @@ private:
             numEnq = other.numEnq;
             numDeq = other.numDeq;
             totOpsSec = other.totOpsSec;
+            irun = other.irun;
         }
 
         bool operator < (const Result& other) const {
@@ -113,28 +117,41 @@ public:
     /**
      * enqueue-dequeue pairs: in each iteration a thread executes an enqueue followed by a dequeue;
      * the benchmark executes 10^8 pairs partitioned evenly among all threads;
+     * The warmup and measurement phases are sampled every 10 ms and the dips and RSS of the median run
+     * are shown. Because the number of pairs is fixed, the last intervals, when some threads are already
+     * done, will show up as a dip.
+     * The CPU time and context switches of the measurement phase of the median run are shown as
+     * well, see CPUAccounting.
      */
     template<typename Q>
     void enqDeqBenchmark(const long numPairs, const int numRuns) {
         nanoseconds deltas[numThreads][numRuns];
+        CPUSample cpu[numThreads][numRuns];
+        vector<CPUAccounting> accs(numRuns);
+        vector<ThroughputSampler::Summary> summaries(numRuns);
+        ThroughputSampler sampler(numThreads);
         atomic<bool> startFlag = { false };
         Q* queue = nullptr;
 
-        auto enqdeq_lambda = [this,&startFlag,&numPairs,&queue](nanoseconds *delta, const int tid) {
+        auto enqdeq_lambda = [this,&startFlag,&numPairs,&queue,&sampler](nanoseconds *delta, CPUSample *cpu, const int tid) {
             UserData ud(0,0);
             while (!startFlag.load()) {} // Spin until the startFlag is set
             // Warmup phase
             for (long long iter = 0; iter < kNumPairsWarmup/numThreads; iter++) {
                 queue->enqueue(&ud, tid);
                 if (queue->dequeue(tid) == nullptr) cout << "Error at warmup dequeueing iter=" << iter << "\n";
+                sampler.add(tid, 2);
             }
             // Measurement phase
+            const CPUSample cpuStart = CPUSample::thread();
             auto startBeats = steady_clock::now();
             for (long long iter = 0; iter < numPairs/numThreads; iter++) {
                 queue->enqueue(&ud, tid);
                 if (queue->dequeue(tid) == nullptr) cout << "Error at measurement dequeueing iter=" << iter << "\n";
+                sampler.add(tid, 2);
             }
             auto stopBeats = steady_clock::now();
+            *cpu = CPUSample::thread() - cpuStart;
             *delta = stopBeats - startBeats;
         };
 
@@ -142,11 +159,17 @@ public:
             queue = new Q(numThreads);
             if (irun == 0) cout << "##### " << queue->className() << " #####  \n";
             thread enqdeqThreads[numThreads];
-            for (int tid = 0; tid < numThreads; tid++) enqdeqThreads[tid] = thread(enqdeq_lambda, &deltas[tid][irun], tid);
+            for (int tid = 0; tid < numThreads; tid++) enqdeqThreads[tid] = thread(enqdeq_lambda, &deltas[tid][irun], &cpu[tid][irun], tid);
+            sampler.start(10ms, 2s);
+            accs[irun].start();
             startFlag.store(true);
             // Sleep for 2 seconds just to let the threads see the startFlag
             this_thread::sleep_for(2s);
             for (int tid = 0; tid < numThreads; tid++) enqdeqThreads[tid].join();
+            accs[irun].stop();
+            for (int tid = 0; tid < numThreads; tid++) accs[irun].addThread(cpu[tid][irun]);
+            sampler.stop();
+            summaries[irun] = sampler.summary();
             startFlag.store(false);
             delete (Q*)queue;
         }
@@ -161,27 +184,82 @@ public:
         }
 
         // Compute the median. numRuns should be an odd number
-        sort(agg.begin(),agg.end());
+        vector<nanoseconds> sorted(agg);
+        sort(sorted.begin(),sorted.end());
         const long long NSEC_IN_SEC = 1000000000LL;
-        auto median = agg[numRuns/2].count()/numThreads; // Normalize back to per-thread time (mean of time for this run)
+        auto median = sorted[numRuns/2].count()/numThreads; // Normalize back to per-thread time (mean of time for this run)
+        const int medianRun = find(agg.begin(), agg.end(), sorted[numRuns/2]) - agg.begin();
+
+        cout << "Total Ops/sec = " << numPairs*2*NSEC_IN_SEC/median << "   ";
+        accs[medianRun].print(numPairs*2, median/1e9);
+        summaries[medianRun].print();
+    }
+
+
+    /**
+     * enqueue-dequeue pairs for testLength, sampled every samplePeriod.
+     * Used for the soak tests, where we want to see the throughput and the
+     * RSS over a long time, for example to catch the retired nodes growing
+     * without bound or periodic stalls from the Hazard Pointers scans.
+     * Shows a progress line every minute, then the summary and the time series
+     * in csv format.
+     */
+    template<typename Q>
+    void timeSeriesBenchmark(const minutes testLength, const milliseconds samplePeriod) {
+        ThroughputSampler sampler(numThreads);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        Q* queue = new Q(numThreads);
+        cout << "##### " << queue->className() << " #####  \n";
+
+        auto soak_lambda = [&quit,&startFlag,&queue,&sampler](const int tid) {
+            UserData ud(0,0);
+            while (!startFlag.load()) {} // Spin until the startFlag is set
+            while (!quit.load()) {
+                queue->enqueue(&ud, tid);
+                if (queue->dequeue(tid) == nullptr) cout << "Error at dequeueing\n";
+                sampler.add(tid, 2);
+            }
+        };
+
+        thread soakThreads[numThreads];
+        for (int tid = 0; tid < numThreads; tid++) soakThreads[tid] = thread(soak_lambda, tid);
+        sampler.start(samplePeriod, testLength);
+        startFlag.store(true);
+        uint64_t prevTotal = 0;
+        for (int iminute = 1; iminute <= testLength.count(); iminute++) {
+            this_thread::sleep_for(1min);
+            const uint64_t total = sampler.total();
+            cout << "minute " << iminute << "   Ops/sec = " << (total-prevTotal)/60 << "   RSS = " << ThroughputSampler::readRSSKB() << " KB\n";
+            prevTotal = total;
+        }
+        quit.store(true);
+        for (int tid = 0; tid < numThreads; tid++) soakThreads[tid].join();
+        sampler.stop();
+        delete queue;
 
-        cout << "Total Ops/sec = " << numPairs*2*NSEC_IN_SEC/median << "\n";
+        sampler.summary().print();
+        sampler.printTimeSeries();
     }
 
 
 
     /**
      * Start with only enqueues 100K/numThreads, wait for them to finish, then do only dequeues but only 100K/numThreads
+     * The CPU accounting of the median run includes the yield() loops where the threads wait for each round.
      */
     template<typename Q>
     void burstBenchmark(const long long burstSize, const int numIters, const int numRuns) {
         Result results[numThreads][numRuns];
+        CPUSample cpu[numThreads][numRuns];
+        vector<CPUAccounting> accs(numRuns);
+        vector<double> runSeconds(numRuns);
         atomic<bool> startEnq = { false };
         atomic<bool> startDeq = { false };
         atomic<long> barrier = { 0 };
         Q* queue = nullptr;
 
-        auto burst_lambda = [this,&startEnq,&startDeq,&burstSize,&barrier,&numIters,&queue](Result *res, const int tid) {
+        auto burst_lambda = [this,&startEnq,&startDeq,&burstSize,&barrier,&numIters,&queue](Result *res, CPUSample *cpu, const int tid) {
             UserData ud(0,0);
 
             // Warmup
@@ -191,9 +269,11 @@ public:
                 if (queue->dequeue(tid) == nullptr) cout << "ERROR: warmup dequeued nullptr in iter=" << iter << "\n";
             }
             // Measurements
+            CPUSample cpuStart;
             for (int iter=0; iter < numIters; iter++) {
                 // Start with enqueues
                 while (!startEnq.load()) this_thread::yield();
+                if (iter == 0) cpuStart = CPUSample::thread();  // Don't count the wait for the first round
                 auto startBeats = steady_clock::now();
                 for (long long iter = 0; iter < burstSize/numThreads; iter++) {
                     queue->enqueue(&ud, tid);
@@ -216,6 +296,7 @@ public:
                 res->numEnq += burstSize/numThreads;
                 res->numDeq += burstSize/numThreads;
             }
+            *cpu = CPUSample::thread() - cpuStart;
         };
 
         auto startAll = steady_clock::now();
@@ -223,8 +304,10 @@ public:
             queue = new Q(numThreads);
             if (irun == 0) cout << "##### " << queue->className() << " #####  \n";
             thread burstThreads[numThreads];
-            for (int tid = 0; tid < numThreads; tid++) burstThreads[tid] = thread(burst_lambda, &results[tid][irun], tid);
+            for (int tid = 0; tid < numThreads; tid++) burstThreads[tid] = thread(burst_lambda, &results[tid][irun], &cpu[tid][irun], tid);
             this_thread::sleep_for(100ms);
+            accs[irun].start();
+            auto startRun = steady_clock::now();
             for (int iter=0; iter < numIters; iter++) {
                 // enqueue round
                 startEnq.store(true);
@@ -240,6 +323,9 @@ public:
                 if (!barrier.compare_exchange_strong(tmp, 0)) cout << "ERROR: CAS\n";
             }
             for (int tid = 0; tid < numThreads; tid++) burstThreads[tid].join();
+            runSeconds[irun] = duration_cast<nanoseconds>(steady_clock::now()-startRun).count()/1e9;
+            accs[irun].stop();
+            for (int tid = 0; tid < numThreads; tid++) accs[irun].addThread(cpu[tid][irun]);
             delete queue;
         }
         auto endAll = steady_clock::now();
@@ -255,6 +341,7 @@ public:
                 agg[irun].numDeq += results[tid][irun].numDeq;
             }
             agg[irun].totOpsSec = (agg[irun].numEnq+agg[irun].numDeq)*NSEC_IN_SEC/(agg[irun].nsEnq.count()+agg[irun].nsDeq.count());
+            agg[irun].irun = irun;
         }
 
         // Compute the median. numRuns should be an odd number
@@ -267,6 +354,7 @@ public:
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
         cout << "Enq/sec = " << allThreadsEnqPerSec << "   Deq/sec = " << allThreadsDeqPerSec <<
                 "   Total = " << (median.numEnq+median.numDeq) << "   Ops/sec = " << median.totOpsSec << "\n";
+        accs[median.irun].print(median.numEnq+median.numDeq, runSeconds[median.irun]);
 
         // TODO: Print csv values
     }
@@ -348,6 +436,18 @@ public:
 
 public:
 
+    /**
+     * Soak tests: numMinutes per queue, sampled every 100 ms
+     */
+    static void soakTests(const int numMinutes) {
+        const int nThreads = 4;
+        BenchmarkQ bench(nThreads);
+        std::cout << "\n----- Soak Benchmark   numThreads=" << nThreads << "   length=" << numMinutes << " minutes -----\n";
+        bench.timeSeriesBenchmark<MichaelScottQueue<UserData>>(minutes(numMinutes), 100ms);
+        bench.timeSeriesBenchmark<CRTurnQueue<UserData>>(minutes(numMinutes), 100ms);
+    }
+
+
     static void allThroughputTests() {
         vector<int> threadList = { 1, 2, 4, 8, 16, 24, 32 };
         const int numRuns = 5;           // 5 runs for the paper
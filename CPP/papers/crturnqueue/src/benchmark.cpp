@@ -15,6 +15,10 @@ int main(int argc, char *argv[]){
 
     if (argc == 1) {
         BenchmarkQ::allThroughputTests();
+    } else if (std::string(argv[1]) == "soak") {
+        // Soak tests: ./bench soak [minutes], the default is one hour per queue
+        const int numMinutes = (argc > 2) ? std::stoi(argv[2]) : 60;
+        BenchmarkQ::soakTests(numMinutes);
     } else {
         // The FK queue can run one run at a time, so lets do it from the cmdline:
         // First argument is number of threads
@@ -42,6 +42,7 @@
 #include "URCUTwoPhase.hpp"
 #include "URCUGraceVersion.hpp"
 #include "URCUGraceVersionSyncScale.hpp"
+#include "CPUAccounting.hpp"
 #ifdef URCU_BULLET_PROOF_LIB
 #include "urcu-bp.h"
 #endif
@@ -95,8 +96,9 @@ private:
 
     const int numThreads;
 
-    URCUGraceVersion urcurv {numThreads};
-    URCUGraceVersionSyncScale urcurvss {};
+    // benchmark2Readers() uses two extra tids for the reader threads
+    URCUGraceVersion urcurv {numThreads+2};
+    URCUGraceVersionSyncScale urcurvss {numThreads+2};
     URCUTwoPhase<RIEntryPerThread> urcu_tpept {};
     URCUTwoPhase<RIAtomicCounterArray> urcu_tpaca {};
 
@@ -113,22 +115,27 @@ public:
      * When doing "updates" we execute a random removal and if the removal is successful we do an add() of the
      * same item immediately after. This keeps the size of the data structure equal to the original size (minus
      * MAX_THREADS items at most) which gives more deterministic results.
+     * The CPU time and context switches of the median run are shown as well,
+     * because synchronize_rcu() waits for the readers with yield() loops, see CPUAccounting.
      */
     long long benchmark(URCUTestCase tc, const int updateRatio, const seconds testLengthSeconds, const int numRuns) {
         long long ops[numThreads][numRuns];
+        CPUSample cpu[numThreads][numRuns];
+        vector<CPUAccounting> accs(numRuns);
         atomic<bool> quit = { false };
         atomic<bool> startFlag = { false };
 
         std::cout << TestCaseStr[tc] << ":\n";
 
         // Can either be a Reader or a Writer
-        auto rw_lambda = [this,&updateRatio,&quit,&startFlag,&tc](int tid, long long *ops) {
+        auto rw_lambda = [this,&updateRatio,&quit,&startFlag,&tc](int tid, long long *ops, CPUSample *cpu) {
             long long numOps = 0;
             long long sum = 0;
 #ifdef LINUX_URCU
             rcu_register_thread();
 #endif
             while (!startFlag.load()) this_thread::yield();
+            const CPUSample cpuStart = CPUSample::thread();
             while (!quit.load()) {
                 uint64_t seed = 1234567890L;
                 for (int i = 0; i < 100; i++) { // 100 %
@@ -212,6 +219,7 @@ public:
                 }
                 numOps += 100;
             }
+            *cpu = CPUSample::thread() - cpuStart;
             *ops = numOps;
 #ifdef LINUX_URCU
             rcu_unregister_thread();
@@ -220,12 +228,15 @@ public:
 
         for (int irun = 0; irun < numRuns; irun++) {
             thread rwThreads[numThreads];
-            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, tid, &ops[tid][irun]);
+            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, tid, &ops[tid][irun], &cpu[tid][irun]);
+            accs[irun].start();
             startFlag.store(true);
             // Sleep for 20 seconds
             this_thread::sleep_for(testLengthSeconds);
             quit.store(true);
             for (int tid = 0; tid < numThreads; tid++) rwThreads[tid].join();
+            accs[irun].stop();
+            for (int tid = 0; tid < numThreads; tid++) accs[irun].addThread(cpu[tid][irun]);
             quit.store(false);
             startFlag.store(false);
         }
@@ -239,20 +250,26 @@ public:
         }
 
         // Compute the median. numRuns should be an odd number
-        sort(agg.begin(),agg.end());
+        vector<long long> sorted(agg);
+        sort(sorted.begin(),sorted.end());
+        const int medianRun = find(agg.begin(), agg.end(), sorted[numRuns/2]) - agg.begin();
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
-        long long result = agg[numRuns/2]/testLengthSeconds.count();
-        cout << "Ops/sec=" << result << "\n";
+        long long result = sorted[numRuns/2]/testLengthSeconds.count();
+        cout << "Ops/sec=" << result << "   ";
+        accs[medianRun].print(sorted[numRuns/2], testLengthSeconds.count());
         return result;
     }
 
 
     /**
      * In this benchmark there are two threads that are continously reading and the others
-     * are only calling synchronize_rcu. The length of the reading time is somewhat long
+     * are only calling synchronize_rcu. The length of the reading time is somewhat long.
+     * The CPU accounting is only for the updaters, which is where the waiting is done.
      */
     long long benchmark2Readers(URCUTestCase tc, const seconds testLengthSeconds, const int numRuns) {
         long long ops[numThreads][numRuns];
+        CPUSample cpu[numThreads][numRuns];
+        vector<CPUAccounting> accs(numRuns);
         long long opsReaders[numThreads][numRuns];
         atomic<bool> quit = { false };
         atomic<bool> startFlag = { false };
@@ -321,12 +338,13 @@ public:
         };
 
         // Updater (we measure the ops here)
-        auto updater_lambda = [this,&quit,&startFlag,&tc](int tid, long long *ops) {
+        auto updater_lambda = [this,&quit,&startFlag,&tc](int tid, long long *ops, CPUSample *cpu) {
             long long numOps = 0;
 #ifdef LINUX_URCU
             rcu_register_thread();
 #endif
             while (!startFlag.load()) this_thread::yield();
+            const CPUSample cpuStart = CPUSample::thread();
             while (!quit.load()) {
 #if defined(URCU_BULLET_PROOF_LIB) || defined(LINUX_URCU)
                 switch(tc) {
@@ -352,6 +370,7 @@ public:
 #endif
                 numOps++;
             }
+            *cpu = CPUSample::thread() - cpuStart;
             *ops = numOps;
 #ifdef LINUX_URCU
             rcu_unregister_thread();
@@ -362,13 +381,16 @@ public:
             thread readerThreads[2];
             thread updaterThreads[numThreads];
             for (int tid = 0; tid < 2; tid++) readerThreads[tid] = thread(reader_lambda, tid, &opsReaders[tid][irun]);
-            for (int tid = 0; tid < numThreads; tid++) updaterThreads[tid] = thread(updater_lambda, tid+2, &ops[tid][irun]);
+            for (int tid = 0; tid < numThreads; tid++) updaterThreads[tid] = thread(updater_lambda, tid+2, &ops[tid][irun], &cpu[tid][irun]);
+            accs[irun].start();
             startFlag.store(true);
             // Sleep for 100 seconds
             this_thread::sleep_for(testLengthSeconds);
             quit.store(true);
             for (int tid = 0; tid < 2; tid++) readerThreads[tid].join();
             for (int tid = 0; tid < numThreads; tid++) updaterThreads[tid].join();
+            accs[irun].stop();
+            for (int tid = 0; tid < numThreads; tid++) accs[irun].addThread(cpu[tid][irun]);
             quit.store(false);
             startFlag.store(false);
         }
@@ -387,16 +409,25 @@ public:
         }
 
         // Compute the median. numRuns should be an odd number
-        sort(agg.begin(),agg.end());
+        vector<long long> sorted(agg);
+        sort(sorted.begin(),sorted.end());
+        const int medianRun = find(agg.begin(), agg.end(), sorted[numRuns/2]) - agg.begin();
         sort(aggReaders.begin(),aggReaders.end());
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
-        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        long long result = sorted[numRuns/2]/testLengthSeconds.count();
         long long resultReaders = aggReaders[numRuns/2]/testLengthSeconds.count();
         cout << "synchronize_rcu()/sec = " << result << "     readers/sec = " << resultReaders << "\n";
+        accs[medianRun].print(sorted[numRuns/2], testLengthSeconds.count());
         return result;
     }
 
 
+    // RIEntryPerThread has a static number of entries, so skip it when there are too many threads
+    bool canRunEntryPerThread(const int numTids) {
+        return numTids <= RIEntryPerThread::URCU_MAX_THREADS;
+    }
+
+
     /**
      * An imprecise but fast random number generator
      */
@@ -412,7 +443,7 @@ public:
 public:
 
     static void allThroughputTests() {
-    	vector<int> threadList = { 1, 2, 4, 8, 12, 16, 20, 24, 28, 30, 32 };
+        vector<int> threadList = { 1, 2, 4, 8, 12, 16, 20, 24, 28, 30, 32, 48, 64, 96, 128 };
         //vector<int> threadList = { 1, 2, 4 };  // for the laptop
         vector<int> ratioList = { 0, 100 }; // Percentage ratio
         const int numRuns = 5;           // 5 runs for the paper
@@ -435,7 +466,7 @@ public:
 #else
             ops[0][0][ithread] = bench.benchmark2Readers(GraceVersion, testLength, numRuns);
             ops[1][0][ithread] = bench.benchmark2Readers(GraceVersionSyncScale, testLength, numRuns);
-            ops[2][0][ithread] = bench.benchmark2Readers(TwoPhaseEntryPerThread, testLength, numRuns);
+            ops[2][0][ithread] = bench.canRunEntryPerThread(nThreads+2) ? bench.benchmark2Readers(TwoPhaseEntryPerThread, testLength, numRuns) : 0;
             ops[3][0][ithread] = bench.benchmark2Readers(TwoPhaseAtomicCounterArray, testLength, numRuns);
             ops[4][0][ithread] = 0;
 #endif
@@ -473,7 +504,7 @@ public:
 #else
                 ops[0][iratio][ithread] = bench.benchmark(GraceVersion, ratio, testLength, numRuns);
                 ops[1][iratio][ithread] = bench.benchmark(GraceVersionSyncScale, ratio, testLength, numRuns);
-                ops[2][iratio][ithread] = bench.benchmark(TwoPhaseEntryPerThread, ratio, testLength, numRuns);
+                ops[2][iratio][ithread] = bench.canRunEntryPerThread(nThreads) ? bench.benchmark(TwoPhaseEntryPerThread, ratio, testLength, numRuns) : 0;
                 ops[3][iratio][ithread] = bench.benchmark(TwoPhaseAtomicCounterArray, ratio, testLength, numRuns);
                 ops[4][iratio][ithread] = 0;
 #endif
@@ -43,7 +43,11 @@ class RIEntryPerThread {
 
 private:
     enum State { NOT_READING=0, READING=1 };
+
+public:
     static const int URCU_MAX_THREADS = 32;
+
+private:
     static const int URCU_CLPAD = (128/sizeof(std::atomic<uint64_t>));
     std::atomic<long> states[URCU_MAX_THREADS*URCU_CLPAD] alignas(128);
 
@@ -31,6 +31,7 @@
 #define _URCU_GRACE_VERSION_H_
 
 #include <atomic>
+#include "USDTProbes.hpp"
 
 
 // Our own userspace implementation of RCU that allows for concurrent calls to rcu_synchronize(),
@@ -95,11 +96,13 @@ public:
 
     void synchronize_rcu() noexcept {
         const uint64_t waitForVersion = updaterVersion.load()+1;
+        CF_PROBE2(rcu_sync_begin, this, waitForVersion);
         auto tmp = waitForVersion-1;
         updaterVersion.compare_exchange_strong(tmp, waitForVersion);
         for (int i=0; i < maxThreads; i++) {
             while (readersVersion[i*CLPAD].load() < waitForVersion) { } // spin
         }
+        CF_PROBE3(rcu_sync_end, this, waitForVersion, 0);
     }
 };
 
@@ -32,40 +32,63 @@
 
 #include <atomic>
 #include <thread>
+#include <limits>
+#include "USDTProbes.hpp"
 
 
 
 // Our own userspace implementation of RCU that allows for concurrent calls to rcu_synchronize(),
 // in other words, threads calling rcu_synchronize() can "shared the grace period".
+//
+// Unlike URCUGraceVersion, the updaters don't all CAS the same updaterVersion.
+// They are split in groups of groupSize threads (think of one group per socket)
+// and the updaters of a group first combine on the group's requested version,
+// which means that at most one updater per group will CAS the updaterVersion
+// for a given grace period, while the others share it.
+// Readers only read updaterVersion and write to their own readersVersion entry,
+// i.e. two cache lines per rcu_read_lock() regardless of the number of threads.
+// Updaters that see another updater completing a scan for their version (or a
+// later one) return immediately, sharing that grace period as well.
+//
+// rcu_read_lock()   - Wait-Free Population Oblivious
+// rcu_read_unlock() - Wait-Free Population Oblivious
+// synchronize_rcu() - Blocking
 class URCUGraceVersionSyncScale {
 
-    static const int URCU_MAX_THREADS = 32;
+    static const int MAX_THREADS = 128;
+    static const int GROUP_SIZE = 8;
     static const int CLPAD = (128/sizeof(std::atomic<int64_t>));
-    static const int COUNTER_SIZE = 2*URCU_MAX_THREADS; // Alternatively, use std::thread::hardware_concurrency()
     static const int64_t NOT_READING = std::numeric_limits<int64_t>::max();
-    alignas(128) std::atomic<int64_t> updaterVersion[URCU_MAX_THREADS*CLPAD] ;
-    alignas(128) std::atomic<int64_t> readersVersion[URCU_MAX_THREADS*CLPAD];
 
-    const int64_t getUpdaterVersion() const {
-        int64_t sum = 0;
-        for (int i=0; i < URCU_MAX_THREADS; i++) {
-            sum += updaterVersion[i*CLPAD].load(std::memory_order_acquire);
-        }
-        return sum;
-    }
+    const int maxThreads;
+    const int groupSize;
+    alignas(128) std::atomic<int64_t> updaterVersion { 0 };
+    alignas(128) std::atomic<int64_t> completedVersion { 0 };
+    alignas(128) std::atomic<int64_t>* groupVersion;
+    alignas(128) std::atomic<int64_t>* readersVersion;
 
 public:
-    URCUGraceVersionSyncScale() {
-        for (int it=0; it < URCU_MAX_THREADS; it++) {
-            updaterVersion[it*CLPAD].store(0, std::memory_order_relaxed);
+    URCUGraceVersionSyncScale(const int maxThreads=MAX_THREADS, const int groupSize=GROUP_SIZE) : maxThreads{maxThreads}, groupSize{groupSize} {
+        const int numGroups = (maxThreads+groupSize-1)/groupSize;
+        groupVersion = new std::atomic<int64_t>[numGroups*CLPAD];
+        readersVersion = new std::atomic<int64_t>[maxThreads*CLPAD];
+        for (int ig=0; ig < numGroups; ig++) {
+            groupVersion[ig*CLPAD].store(0, std::memory_order_relaxed);
+        }
+        for (int it=0; it < maxThreads; it++) {
             readersVersion[it*CLPAD].store(NOT_READING, std::memory_order_relaxed);
         }
     }
 
+    ~URCUGraceVersionSyncScale() {
+        delete[] groupVersion;
+        delete[] readersVersion;
+    }
+
     void rcu_read_lock(const int tid) {  // rcu_read_lock()
-        const int64_t rv = getUpdaterVersion();
+        const int64_t rv = updaterVersion.load();
         readersVersion[tid*CLPAD].store(rv);
-        const int64_t nrv = getUpdaterVersion();
+        const int64_t nrv = updaterVersion.load();
         if (rv != nrv) readersVersion[tid*CLPAD].store(nrv, std::memory_order_relaxed);
     }
 
@@ -74,12 +97,37 @@ public:
     }
 
     void synchronize_rcu(const int tid) {
-        const int64_t waitForVersion = getUpdaterVersion()+1;
-        auto current = updaterVersion[tid*CLPAD].load(std::memory_order_relaxed);
-        updaterVersion[tid*CLPAD].store(current+1);
-        for (int i=0; i < URCU_MAX_THREADS; i++) {
-            while (readersVersion[i*CLPAD].load() < waitForVersion) { } // spin
+        const int64_t waitForVersion = updaterVersion.load()+1;
+        CF_PROBE2(rcu_sync_begin, this, waitForVersion);
+        std::atomic<int64_t>& gv = groupVersion[(tid/groupSize)*CLPAD];
+        int64_t lgv = gv.load();
+        if (lgv < waitForVersion && gv.compare_exchange_strong(lgv, waitForVersion)) {
+            // We're the one advancing the updaterVersion on behalf of our group.
+            // If the CAS fails it's because another group has already done it.
+            int64_t tmp = waitForVersion-1;
+            updaterVersion.compare_exchange_strong(tmp, waitForVersion);
+        } else {
+            // Another updater of our group is advancing to waitForVersion (or
+            // beyond), so we share its grace period. Help it if it is late.
+            while (updaterVersion.load() < waitForVersion) {
+                std::this_thread::yield();
+                int64_t tmp = waitForVersion-1;
+                if (updaterVersion.compare_exchange_strong(tmp, waitForVersion)) break;
+            }
+        }
+        for (int i=0; i < maxThreads; i++) {
+            while (readersVersion[i*CLPAD].load() < waitForVersion) { // spin
+                if (completedVersion.load() >= waitForVersion) {
+                    // Another updater completed this grace period for us
+                    CF_PROBE3(rcu_sync_end, this, waitForVersion, 1);
+                    return;
+                }
+            }
         }
+        // Let other updaters know that a grace period for waitForVersion has completed
+        int64_t lcv = completedVersion.load();
+        while (lcv < waitForVersion && !completedVersion.compare_exchange_weak(lcv, waitForVersion)) { }
+        CF_PROBE3(rcu_sync_end, this, waitForVersion, 0);
     }
 };
 
@@ -32,6 +32,7 @@
 
 #include <atomic>
 #include <thread>
+#include "USDTProbes.hpp"
 
 
 // Our own userspace implementation of RCU that allows for concurrent calls to rcu_synchronize(),
@@ -60,8 +61,12 @@ public:
     void synchronize_rcu() {
         const int64_t currUV = updaterVersion.load();
         const int64_t nextUV = (currUV+1);
+        CF_PROBE2(rcu_sync_begin, this, nextUV);
         while (!readIndicator[(int)(nextUV&1)].isEmpty()) { // spin
-            if (updaterVersion.load() > nextUV) return;
+            if (updaterVersion.load() > nextUV) {
+                CF_PROBE3(rcu_sync_end, this, nextUV, 1);
+                return;
+            }
             if (updaterVersion.load() == nextUV) break;
         }
         if (updaterVersion.load() == currUV) {
@@ -69,8 +74,12 @@ public:
             updaterVersion.compare_exchange_strong(tmp, nextUV);
         }
         while (!readIndicator[(int)(currUV&1)].isEmpty()) { // spin
-            if (updaterVersion.load() > nextUV) return;
+            if (updaterVersion.load() > nextUV) {
+                CF_PROBE3(rcu_sync_end, this, nextUV, 1);
+                return;
+            }
         }
+        CF_PROBE3(rcu_sync_end, this, nextUV, 0);
     }
 };
 
@@ -0,0 +1,214 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_LEFT_RIGHT_STALLS_H_
+#define _BENCHMARK_LEFT_RIGHT_STALLS_H_
+
+#include "BenchmarkPreemption.hpp"
+
+
+/**
+ * Writer tail latency of Left-Right when readers are descheduled.
+ *
+ * One writer thread (tid 0) does mutations back-to-back while numReaders
+ * threads do reads, and the StallInjector stalls a random reader inside its
+ * read for stallLength every stallPeriod (SleepInCS with the Readers role).
+ * We measure the latency of each mutation.
+ *
+ * With two instances the writer waits for the stalled reader on every stall,
+ * so the tail latency of the writer is the stallLength. With N instances the
+ * writer rotates to another instance and only waits when N-1 readers are
+ * stalled at the same time on different instances, which needs a
+ * stallPeriod shorter than the stallLength.
+ */
+class BenchmarkLeftRightStalls {
+
+public:
+    struct Result {
+        long long writesPerSec {0};
+        long long readsPerSec {0};
+        uint64_t p50 {0};
+        uint64_t p99 {0};
+        uint64_t p999 {0};
+        uint64_t max {0};
+        long numStalls {0};
+        long numRotations {0};
+
+        bool operator < (const Result& other) const {
+            return writesPerSec < other.writesPerSec;
+        }
+    };
+
+private:
+    const int numReaders;
+
+    template<typename A>
+    static long rotationsOf(A* adapter) { return 0; }
+
+    template<int N>
+    static long rotationsOf(LeftRightMultiInstanceAdapter<N>* adapter) { return adapter->getNumRotations(); }
+
+public:
+    BenchmarkLeftRightStalls(const int numReaders) : numReaders{numReaders} { }
+
+
+    /**
+     * Returns the result of the median run (by writes per second)
+     */
+    template<typename A>
+    Result benchmark(const StallInjector::Mode mode, const nanoseconds stallLength, const nanoseconds stallPeriod,
+                     const seconds testLengthSeconds, const int numRuns) {
+        const int numThreads = numReaders+1;
+        vector<Result> results(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        atomic<long> numErrors = { 0 };
+        long long ops[numThreads];
+        LatencyHistogram* hist = new LatencyHistogram();
+        A* adapter = nullptr;
+        StallInjector* stalls = nullptr;
+
+        auto writer_lambda = [&quit,&startFlag,&adapter,&stalls](long long *ops, LatencyHistogram* hist) {
+            long long numOps = 0;
+            stalls->registerThread(0);
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                auto startBeats = steady_clock::now();
+                adapter->write(*stalls, 0);
+                hist->record((steady_clock::now()-startBeats).count());
+                numOps++;
+            }
+            *ops = numOps;
+        };
+
+        auto reader_lambda = [&quit,&startFlag,&numErrors,&adapter,&stalls](long long *ops, const int tid) {
+            long long numOps = 0;
+            stalls->registerThread(tid);
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                if (!adapter->read(*stalls, tid)) numErrors.fetch_add(1);
+                numOps++;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            adapter = new A(numThreads);
+            stalls = new StallInjector(numThreads, mode, StallInjector::Readers, stallLength, stallPeriod);
+            hist->reset();
+            thread workerThreads[numThreads];
+            workerThreads[0] = thread(writer_lambda, &ops[0], hist);
+            for (int tid = 1; tid < numThreads; tid++) workerThreads[tid] = thread(reader_lambda, &ops[tid], tid);
+            stalls->start();
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            stalls->stop();
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) workerThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            // Accounting
+            long long totalReads = 0;
+            for (int tid = 1; tid < numThreads; tid++) totalReads += ops[tid];
+            results[irun].writesPerSec = ops[0]/testLengthSeconds.count();
+            results[irun].readsPerSec = totalReads/testLengthSeconds.count();
+            results[irun].p50 = hist->valueAtPercentile(50.);
+            results[irun].p99 = hist->valueAtPercentile(99.);
+            results[irun].p999 = hist->valueAtPercentile(99.9);
+            results[irun].max = hist->max();
+            results[irun].numStalls = stalls->getNumStalls();
+            results[irun].numRotations = rotationsOf(adapter);
+            delete stalls;
+            delete adapter;
+        }
+        delete hist;
+        if (numErrors.load() != 0) cout << "ERROR: readers saw an inconsistent state " << numErrors.load() << " times\n";
+
+        // Compute the median. numRuns should be an odd number
+        sort(results.begin(), results.end());
+        Result median = results[numRuns/2];
+        cout << A::className() << "   Writes/sec = " << median.writesPerSec << "   Reads/sec = " << median.readsPerSec;
+        cout << "   write p50 = " << median.p50/1000. << " us   p99 = " << median.p99/1000. << " us   p99.9 = " << median.p999/1000.;
+        cout << " us   max = " << median.max/1000. << " us   stalls = " << median.numStalls << "   rotations = " << median.numRotations << "\n";
+        return median;
+    }
+
+
+    template<typename A>
+    void addClass(vector<string>& names, vector<Result>& results, const StallInjector::Mode mode, const nanoseconds stallLength,
+                  const nanoseconds stallPeriod, const seconds testLength, const int numRuns) {
+        names.push_back(A::className());
+        results.push_back(benchmark<A>(mode, stallLength, stallPeriod, testLength, numRuns));
+    }
+
+
+public:
+
+    static void allLatencyTests() {
+        vector<int> readersList = { 1, 2, 4, 8 };
+        const int numRuns = 3;
+        const seconds testLength = 10s;
+        const milliseconds stallLength = 10ms;
+        // No stalls, one stalled reader at a time, and up to four overlapping stalled readers
+        const StallInjector::Mode modes[] = { StallInjector::NoStalls, StallInjector::SleepInCS, StallInjector::SleepInCS };
+        const microseconds stallPeriods[] = { 100ms, 100ms, 2500us };
+        const int NUM_CONFIGS = 3;
+
+        for (int nReaders : readersList) {
+            BenchmarkLeftRightStalls bench(nReaders);
+            vector<string> names[NUM_CONFIGS];
+            vector<Result> results[NUM_CONFIGS];
+            for (int ic = 0; ic < NUM_CONFIGS; ic++) {
+                std::cout << "\n----- Left-Right Writer Latency   numReaders=" << nReaders << "   " << StallInjector::modeName(modes[ic]);
+                if (modes[ic] != StallInjector::NoStalls) std::cout << "   stall=" << stallLength.count() << "ms every " << duration<double,std::milli>(stallPeriods[ic]).count() << "ms";
+                std::cout << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                bench.addClass<LeftRightClassicAdapter>(names[ic], results[ic], modes[ic], stallLength, stallPeriods[ic], testLength, numRuns);
+                bench.addClass<LeftRightFlatCombiningAdapter>(names[ic], results[ic], modes[ic], stallLength, stallPeriods[ic], testLength, numRuns);
+                bench.addClass<LeftRightMultiInstanceAdapter<2>>(names[ic], results[ic], modes[ic], stallLength, stallPeriods[ic], testLength, numRuns);
+                bench.addClass<LeftRightMultiInstanceAdapter<3>>(names[ic], results[ic], modes[ic], stallLength, stallPeriods[ic], testLength, numRuns);
+                bench.addClass<LeftRightMultiInstanceAdapter<4>>(names[ic], results[ic], modes[ic], stallLength, stallPeriods[ic], testLength, numRuns);
+            }
+
+            // Show results in csv format
+            cout << "\n\nResults for numReaders=" << nReaders << ",  numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Class, Stall period (ms), Writes/sec, Reads/sec, Write p50 (us), p99 (us), p99.9 (us), max (us), Rotations\n";
+            for (int ic = 0; ic < NUM_CONFIGS; ic++) {
+                for (unsigned i = 0; i < names[ic].size(); i++) {
+                    const Result& r = results[ic][i];
+                    cout << names[ic][i] << ", ";
+                    if (modes[ic] == StallInjector::NoStalls) cout << "-, ";
+                    else cout << duration<double,std::milli>(stallPeriods[ic]).count() << ", ";
+                    cout << r.writesPerSec << ", " << r.readsPerSec << ", " << r.p50/1000. << ", " << r.p99/1000. << ", ";
+                    cout << r.p999/1000. << ", " << r.max/1000. << ", " << r.numRotations << "\n";
+                }
+            }
+        }
+    }
+};
+
+#endif /* _BENCHMARK_LEFT_RIGHT_STALLS_H_ */
@@ -0,0 +1,572 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_PREEMPTION_H_
+#define _BENCHMARK_PREEMPTION_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include "StallInjector.hpp"
+// Locks
+#include "FAARWLock.h"
+#include "CRWWPFlatCombining.hpp"
+// Left-Right
+#include "LeftRightClassic.h"
+#include "LeftRightClassicLambda.h"
+#include "LeftRightFlatCombining.hpp"
+#include "LeftRightMultiInstance.hpp"
+// URCU
+#include "URCUGraceVersion.hpp"
+#include "URCUGraceVersionSyncScale.hpp"
+// Queues
+#include "MichaelScottQueue.hpp"
+#include "CRTurnQueue.hpp"
+#include "FAAArrayQueue.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * The object protected by each of the locks, Left-Right and URCU.
+ * Writers increment both fields, readers check that they are equal.
+ */
+struct Payload {
+    uint64_t a {0};
+    uint64_t b {0};
+};
+
+
+/*
+ * Adapters with the same interface for all the classes we want to test:
+ *   Adapter(numThreads)
+ *   className()
+ *   read(stalls, tid)   - returns false if the reader saw an inconsistent state
+ *   write(stalls, tid)
+ * The calls to stalls.point() are the instrumented points for SleepInCS.
+ */
+
+class MutexAdapter {
+    std::mutex mtx;
+    Payload data;
+public:
+    MutexAdapter(const int numThreads) { }
+    static std::string className() { return "std::mutex"; }
+    bool read(StallInjector& stalls, const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        stalls.point(false);
+        return data.a == data.b;
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        data.a++;
+        stalls.point(true);
+        data.b++;
+    }
+};
+
+
+class SharedTimedMutexAdapter {
+    std::shared_timed_mutex rwlock;
+    Payload data;
+public:
+    SharedTimedMutexAdapter(const int numThreads) { }
+    static std::string className() { return "std::shared_timed_mutex"; }
+    bool read(StallInjector& stalls, const int tid) {
+        std::shared_lock<std::shared_timed_mutex> lock(rwlock);
+        stalls.point(false);
+        return data.a == data.b;
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::lock_guard<std::shared_timed_mutex> lock(rwlock);
+        data.a++;
+        stalls.point(true);
+        data.b++;
+    }
+};
+
+
+class FAARWLockAdapter {
+    FAARWLock rwlock;
+    Payload data;
+public:
+    FAARWLockAdapter(const int numThreads) { }
+    static std::string className() { return "FAARWLock"; }
+    bool read(StallInjector& stalls, const int tid) {
+        rwlock.sharedLock();
+        stalls.point(false);
+        const bool ret = (data.a == data.b);
+        rwlock.sharedUnlock();
+        return ret;
+    }
+    void write(StallInjector& stalls, const int tid) {
+        rwlock.exclusiveLock();
+        data.a++;
+        stalls.point(true);
+        data.b++;
+        rwlock.exclusiveUnlock();
+    }
+};
+
+
+/*
+ * A stalled combiner blocks all the writers and all the readers.
+ * The stall happens on the thread that executes the function, which for a
+ * mutation is the combiner and not necessarily the thread that called write().
+ */
+class CRWWPFlatCombiningAdapter {
+    CRWWPFlatCombining<Payload> crwwp;
+public:
+    CRWWPFlatCombiningAdapter(const int numThreads) : crwwp{new Payload(), numThreads} { }
+    static std::string className() { return "CRWWPFlatCombining"; }
+    bool read(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> readFunc = [&stalls] (Payload* p) { stalls.point(false); return p->a == p->b; };
+        return crwwp.applyRead(readFunc, tid);
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> writeFunc = [&stalls] (Payload* p) { p->a++; stalls.point(true); p->b++; return true; };
+        crwwp.applyMutation(writeFunc, tid);
+    }
+};
+
+
+// A stalled reader blocks the writer in toggleVersionAndWait(), and all the other writers behind it
+class LeftRightClassicAdapter {
+    LeftRight::LeftRightClassicLambda<Payload> lr;
+public:
+    LeftRightClassicAdapter(const int numThreads) { }
+    static std::string className() { return "LeftRightClassic"; }
+    bool read(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*,StallInjector*)> readFunc = [] (Payload* p, StallInjector* st) { st->point(false); return p->a == p->b; };
+        StallInjector* st = &stalls;
+        return lr.applyRead(st, readFunc);
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*,StallInjector*)> writeFunc = [] (Payload* p, StallInjector* st) { p->a++; st->point(true); p->b++; return true; };
+        StallInjector* st = &stalls;
+        lr.applyMutation(st, writeFunc);
+    }
+};
+
+
+class LeftRightFlatCombiningAdapter {
+    LeftRightFlatCombining<Payload> lr;
+public:
+    LeftRightFlatCombiningAdapter(const int numThreads) : lr{new Payload(), numThreads} { }
+    static std::string className() { return "LeftRightFlatCombining"; }
+    bool read(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> readFunc = [&stalls] (Payload* p) { stalls.point(false); return p->a == p->b; };
+        return lr.applyRead(readFunc, tid);
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> writeFunc = [&stalls] (Payload* p) { p->a++; stalls.point(true); p->b++; return true; };
+        lr.applyMutation(writeFunc, tid);
+    }
+};
+
+
+// A stalled reader pins only one instance, the writer waits only if all the other N-1 are pinned
+template<int N>
+class LeftRightMultiInstanceAdapter {
+    LeftRightMultiInstance<Payload> lr;
+public:
+    LeftRightMultiInstanceAdapter(const int numThreads) : lr{new Payload(), N, numThreads} { }
+    static std::string className() { return "LeftRightMultiInstance-" + std::to_string(N); }
+    bool read(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> readFunc = [&stalls] (Payload* p) { stalls.point(false); return p->a == p->b; };
+        return lr.applyRead(readFunc, tid);
+    }
+    void write(StallInjector& stalls, const int tid) {
+        std::function<bool(Payload*)> writeFunc = [&stalls] (Payload* p) { p->a++; stalls.point(true); p->b++; return true; };
+        lr.applyMutation(writeFunc);
+    }
+    long getNumRotations() const { return lr.getNumRotations(); }
+};
+
+
+/*
+ * Writers make a copy of the Payload, swap it in, and wait for a grace period
+ * before deleting the old one. A stalled reader blocks synchronize_rcu().
+ */
+template<typename U>
+class URCUAdapter {
+    U urcu;
+    std::atomic<Payload*> data { new Payload() };
+
+    void readLock(URCUGraceVersion& u, const int tid) { u.read_lock(tid); }
+    void readUnlock(URCUGraceVersion& u, const int tid) { u.read_unlock(tid); }
+    void synchronize(URCUGraceVersion& u, const int tid) { u.synchronize_rcu(); }
+    void readLock(URCUGraceVersionSyncScale& u, const int tid) { u.rcu_read_lock(tid); }
+    void readUnlock(URCUGraceVersionSyncScale& u, const int tid) { u.rcu_read_unlock(tid); }
+    void synchronize(URCUGraceVersionSyncScale& u, const int tid) { u.synchronize_rcu(tid); }
+
+public:
+    URCUAdapter(const int numThreads) : urcu{numThreads} { }
+    ~URCUAdapter() { delete data.load(); }
+    static std::string className() { return std::is_same<U,URCUGraceVersion>::value ? "URCUGraceVersion" : "URCUGraceVersionSyncScale"; }
+    bool read(StallInjector& stalls, const int tid) {
+        readLock(urcu, tid);
+        Payload* p = data.load();
+        stalls.point(false);
+        const bool ret = (p->a == p->b);
+        readUnlock(urcu, tid);
+        return ret;
+    }
+    void write(StallInjector& stalls, const int tid) {
+        Payload* p = new Payload();
+        readLock(urcu, tid);
+        *p = *data.load();
+        readUnlock(urcu, tid);
+        p->a++;
+        p->b++;
+        Payload* old = data.exchange(p);
+        stalls.point(true);
+        synchronize(urcu, tid);
+        delete old;
+    }
+};
+
+
+// For the queues every operation is an enqueue followed by a dequeue
+template<typename Q>
+class QueueAdapter {
+    Q queue;
+    Payload item;
+public:
+    QueueAdapter(const int numThreads) : queue{numThreads} { }
+    static std::string className() { return Q(1).className(); }
+    bool read(StallInjector& stalls, const int tid) {
+        queue.enqueue(&item, tid);
+        stalls.point(false);
+        return queue.dequeue(tid) != nullptr;
+    }
+    void write(StallInjector& stalls, const int tid) { read(stalls, tid); }
+};
+
+
+// A std::queue protected by a std::mutex, the stall is with the lock held
+class MutexQueueAdapter {
+    std::mutex mtx;
+    std::queue<Payload*> queue;
+    Payload item;
+public:
+    MutexQueueAdapter(const int numThreads) { }
+    static std::string className() { return "MutexQueue"; }
+    bool read(StallInjector& stalls, const int tid) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push(&item);
+            stalls.point(false);
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        if (queue.empty()) return false;
+        queue.pop();
+        return true;
+    }
+    void write(StallInjector& stalls, const int tid) { read(stalls, tid); }
+};
+
+
+/**
+ * A latency histogram with 8 sub-buckets per power of two, i.e. a precision
+ * of 12.5%, which is good enough for tail latencies.
+ * One per thread, no atomics.
+ */
+class LatencyHistogram {
+    static const int SUB_BITS = 3;
+    static const int SUB = 1 << SUB_BITS;
+    static const int NUM_BUCKETS = (64-SUB_BITS+1)*SUB;
+    uint64_t counts[NUM_BUCKETS];
+    uint64_t maxValue {0};
+
+    static int bucketOf(uint64_t v) {
+        if (v < SUB) return (int)v;
+        const int lg = 63 - __builtin_clzll(v);
+        return (lg-SUB_BITS+1)*SUB + (int)((v >> (lg-SUB_BITS)) & (SUB-1));
+    }
+
+    // Largest value that goes into bucket ib
+    static uint64_t upperOf(int ib) {
+        if (ib < SUB) return ib;
+        const int lg = ib/SUB + SUB_BITS - 1;
+        const uint64_t lower = (uint64_t)(SUB + ib%SUB) << (lg-SUB_BITS);
+        return lower + (1ULL << (lg-SUB_BITS)) - 1;
+    }
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        for (int i = 0; i < NUM_BUCKETS; i++) counts[i] = 0;
+        maxValue = 0;
+    }
+
+    inline void record(const uint64_t ns) {
+        counts[bucketOf(ns)]++;
+        if (ns > maxValue) maxValue = ns;
+    }
+
+    void add(const LatencyHistogram& other) {
+        for (int i = 0; i < NUM_BUCKETS; i++) counts[i] += other.counts[i];
+        maxValue = std::max(maxValue, other.maxValue);
+    }
+
+    uint64_t max() const { return maxValue; }
+
+    // Returns the upper bound of the bucket that contains the given percentile (0 to 100)
+    uint64_t valueAtPercentile(const double percentile) const {
+        uint64_t total = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) total += counts[i];
+        if (total == 0) return 0;
+        uint64_t target = (uint64_t)(percentile*total/100.);
+        if (target == 0) target = 1;
+        uint64_t acc = 0;
+        for (int ib = 0; ib < NUM_BUCKETS; ib++) {
+            acc += counts[ib];
+            if (acc >= target) return std::min(upperOf(ib), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+
+/**
+ * Preemption-tolerance benchmark.
+ *
+ * Each thread does reads and writes (writePerMil of them are writes) on one
+ * of the classes above, while a StallInjector stalls one random thread for
+ * stallLength every stallPeriod. We measure the throughput and the latency
+ * of each operation, and compare them with a run without stalls.
+ *
+ * A blocking design collapses because every other thread ends up waiting for
+ * the stalled one: the writers of Left-Right and URCU wait for a stalled
+ * reader, and everyone waits for a stalled lock holder or flat combiner.
+ * A lock-free design only loses the throughput of the stalled thread.
+ *
+ * Keep in mind that a stalled thread is not doing operations, so even a
+ * perfect design will lose stallLength/(stallPeriod*numThreads) of the
+ * throughput.
+ */
+class BenchmarkPreemption {
+
+public:
+    struct Result {
+        long long opsPerSec {0};
+        uint64_t p50 {0};
+        uint64_t p99 {0};
+        uint64_t p999 {0};
+        uint64_t max {0};
+        long numStalls {0};
+
+        bool operator < (const Result& other) const {
+            return opsPerSec < other.opsPerSec;
+        }
+    };
+
+private:
+    const int numThreads;
+    const nanoseconds stallLength;
+    const nanoseconds stallPeriod;
+
+public:
+    BenchmarkPreemption(const int numThreads, const nanoseconds stallLength, const nanoseconds stallPeriod)
+        : numThreads{numThreads}, stallLength{stallLength}, stallPeriod{stallPeriod} { }
+
+
+    /**
+     * Returns the result of the median run (by throughput)
+     */
+    template<typename A>
+    Result benchmark(const StallInjector::Mode mode, const StallInjector::Role role, const int writePerMil,
+                     const seconds testLengthSeconds, const int numRuns) {
+        vector<Result> results(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        atomic<long> numErrors = { 0 };
+        long long ops[numThreads];
+        LatencyHistogram* hists = new LatencyHistogram[numThreads];
+        A* adapter = nullptr;
+        StallInjector* stalls = nullptr;
+
+        auto worker_lambda = [this,&quit,&startFlag,&numErrors,&adapter,&stalls,writePerMil](long long *ops, LatencyHistogram* hist, const int tid) {
+            long long numOps = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            stalls->registerThread(tid);
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                seed = randomLong(seed);
+                auto startBeats = steady_clock::now();
+                if ((int)(seed % 1000) < writePerMil) {
+                    adapter->write(*stalls, tid);
+                } else {
+                    if (!adapter->read(*stalls, tid)) numErrors.fetch_add(1);
+                }
+                hist->record((steady_clock::now()-startBeats).count());
+                numOps++;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            adapter = new A(numThreads);
+            stalls = new StallInjector(numThreads, mode, role, stallLength, stallPeriod);
+            for (int tid = 0; tid < numThreads; tid++) hists[tid].reset();
+            thread workerThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) workerThreads[tid] = thread(worker_lambda, &ops[tid], &hists[tid], tid);
+            stalls->start();
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            stalls->stop();
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) workerThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            // Accounting
+            LatencyHistogram agg;
+            long long totalOps = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                agg.add(hists[tid]);
+                totalOps += ops[tid];
+            }
+            results[irun].opsPerSec = totalOps/testLengthSeconds.count();
+            results[irun].p50 = agg.valueAtPercentile(50.);
+            results[irun].p99 = agg.valueAtPercentile(99.);
+            results[irun].p999 = agg.valueAtPercentile(99.9);
+            results[irun].max = agg.max();
+            results[irun].numStalls = stalls->getNumStalls();
+            delete stalls;
+            delete adapter;
+        }
+        delete[] hists;
+        if (numErrors.load() != 0) cout << "ERROR: readers saw an inconsistent state " << numErrors.load() << " times\n";
+
+        // Compute the median. numRuns should be an odd number
+        sort(results.begin(), results.end());
+        Result median = results[numRuns/2];
+        cout << StallInjector::modeName(mode) << "(" << StallInjector::roleName(role) << ")   Ops/sec = " << median.opsPerSec;
+        cout << "   p50 = " << median.p50/1000. << " us   p99 = " << median.p99/1000. << " us   p99.9 = " << median.p999/1000.;
+        cout << " us   max = " << median.max/1000. << " us   stalls = " << median.numStalls << "\n";
+        return median;
+    }
+
+
+    /*
+     * Runs without stalls, with stalls inside the critical sections of the
+     * readers and of the writers, and with signals at arbitrary points.
+     * For the queues there is no critical section, only the signals make sense.
+     */
+    template<typename A>
+    void allModes(vector<string>& names, vector<vector<Result>>& results, const int writePerMil,
+                  const seconds testLength, const int numRuns, const bool isQueue) {
+        cout << "##### " << A::className() << " #####\n";
+        vector<Result> res;
+        names.push_back(A::className());
+        res.push_back(benchmark<A>(StallInjector::NoStalls, StallInjector::AnyRole, writePerMil, testLength, numRuns));
+        if (isQueue) {
+            res.push_back(Result());
+            res.push_back(Result());
+        } else {
+            res.push_back(benchmark<A>(StallInjector::SleepInCS, StallInjector::Readers, writePerMil, testLength, numRuns));
+            res.push_back(benchmark<A>(StallInjector::SleepInCS, StallInjector::Writers, writePerMil, testLength, numRuns));
+        }
+        res.push_back(benchmark<A>(StallInjector::Signal, StallInjector::AnyRole, writePerMil, testLength, numRuns));
+        results.push_back(res);
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 2, 4, 8, 16 };
+        const int writePerMil = 100;                    // 10% writes
+        const int numRuns = 3;
+        const seconds testLength = 10s;
+        const milliseconds stallLength = 10ms;          // Typical of a vCPU being descheduled
+        const milliseconds stallPeriod = 100ms;
+        const string modeNames[] = { "NoStalls", "SleepInCS(Readers)", "SleepInCS(Writers)", "Signal" };
+
+        for (int nThreads : threadList) {
+            BenchmarkPreemption bench(nThreads, stallLength, stallPeriod);
+            vector<string> names;
+            vector<vector<Result>> results;
+            std::cout << "\n----- Preemption Benchmark   numThreads=" << nThreads << "   writes=" << writePerMil/10. << "%   stall=";
+            std::cout << stallLength.count() << "ms every " << stallPeriod.count() << "ms   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            // Locks
+            bench.allModes<MutexAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<SharedTimedMutexAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<FAARWLockAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<CRWWPFlatCombiningAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            // Left-Right
+            bench.allModes<LeftRightClassicAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<LeftRightFlatCombiningAdapter>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<LeftRightMultiInstanceAdapter<3>>(names, results, writePerMil, testLength, numRuns, false);
+            // URCU
+            bench.allModes<URCUAdapter<URCUGraceVersion>>(names, results, writePerMil, testLength, numRuns, false);
+            bench.allModes<URCUAdapter<URCUGraceVersionSyncScale>>(names, results, writePerMil, testLength, numRuns, false);
+            // Queues
+            bench.allModes<MutexQueueAdapter>(names, results, writePerMil, testLength, numRuns, true);
+            bench.allModes<QueueAdapter<MichaelScottQueue<Payload>>>(names, results, writePerMil, testLength, numRuns, true);
+            bench.allModes<QueueAdapter<CRTurnQueue<Payload>>>(names, results, writePerMil, testLength, numRuns, true);
+            bench.allModes<QueueAdapter<FAAArrayQueue<Payload>>>(names, results, writePerMil, testLength, numRuns, true);
+
+            // Show results in csv format. The ratio is the throughput with stalls over the throughput without stalls
+            cout << "\n\nResults for numThreads=" << nThreads << ",  numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Class, Mode, Ops/sec, Ratio, p99 (us), p99.9 (us), max (us)\n";
+            for (unsigned ic = 0; ic < names.size(); ic++) {
+                for (unsigned im = 0; im < results[ic].size(); im++) {
+                    const Result& r = results[ic][im];
+                    if (r.opsPerSec == 0) continue;
+                    cout << names[ic] << ", " << modeNames[im] << ", " << r.opsPerSec << ", " << (double)r.opsPerSec/results[ic][0].opsPerSec << ", ";
+                    cout << r.p99/1000. << ", " << r.p999/1000. << ", " << r.max/1000. << "\n";
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,240 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _STALL_INJECTOR_H_
+#define _STALL_INJECTOR_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+
+/**
+ * <h1> Stall Injector </h1>
+ *
+ * Simulates a thread being descheduled, for example on a VM whose vCPU was
+ * preempted by the hypervisor. Every stallPeriod an injector thread chooses
+ * one of the worker threads at random and stalls it for stallLength.
+ * There are two ways of doing it:
+ *
+ * - SleepInCS: the injector leaves a request for the chosen thread, and the
+ *   thread sleeps the next time it goes through an instrumented point, i.e.
+ *   a call to point(), which the benchmark places inside the critical
+ *   sections. The role says whether to stall only inside the critical
+ *   sections of readers, of writers, or of both. Because the request is
+ *   consumed by the thread that calls point(), a flat combiner executing
+ *   the mutation of another thread is the one that stalls.
+ *
+ * - Signal: the injector sends SIGUSR1 to the chosen thread with
+ *   pthread_kill() and the signal handler sleeps, which stops the thread at
+ *   an arbitrary point, inside or outside of a critical section, or in the
+ *   middle of a lock-free operation. This is as close as we can get to
+ *   SIGSTOP/SIGCONT, which can only be sent to a whole process, not a thread.
+ *
+ * Each worker thread must call registerThread() before start() is called.
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class StallInjector {
+
+public:
+    enum Mode { NoStalls, SleepInCS, Signal };
+    enum Role { AnyRole, Readers, Writers };
+
+    static std::string modeName(Mode mode) {
+        static const std::string names[] = { "NoStalls", "SleepInCS", "Signal" };
+        return names[mode];
+    }
+
+    static std::string roleName(Role role) {
+        static const std::string names[] = { "Any", "Readers", "Writers" };
+        return names[role];
+    }
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(std::atomic<int64_t>);
+    const int numThreads;
+    const Mode mode;
+    const Role role;
+    const std::chrono::nanoseconds stallLength;
+    const std::chrono::nanoseconds stallPeriod;
+    std::atomic<int64_t>* requests;   // Stall length in nanoseconds, zero if no request, one per cache line
+    pthread_t* handles;
+    std::atomic<int> numRegistered { 0 };
+    std::atomic<long> numStalls { 0 };
+    std::atomic<bool> quit { false };
+    std::thread* injector { nullptr };
+
+    /*
+     * Function-local statics instead of static members, so that this header
+     * can be included from more than one translation unit (no inline
+     * variables in C++14). All of them are constant-initialized, which means
+     * there is no guard on the first call and they're safe to use from the
+     * signal handler.
+     */
+
+    // Index of the calling thread, set by registerThread()
+    static int& tid() {
+        static thread_local int t = 0;
+        return t;
+    }
+
+    // Used by the signal handler, which has no way to know which instance sent the signal
+    static std::atomic<int64_t>& signalStallNs() {
+        static std::atomic<int64_t> ns { 0 };
+        return ns;
+    }
+
+    static std::atomic<long>& signalNumStalls() {
+        static std::atomic<long> n { 0 };
+        return n;
+    }
+
+    static void sleepNs(int64_t ns) {
+        struct timespec ts;
+        ts.tv_sec = ns / 1000000000LL;
+        ts.tv_nsec = ns % 1000000000LL;
+        while (nanosleep(&ts, &ts) != 0) { } // Interrupted, sleep the remaining time
+    }
+
+    // nanosleep() and lock-free atomics are async-signal-safe
+    static void signalHandler(int) {
+        sleepNs(signalStallNs().load());
+        signalNumStalls().fetch_add(1);
+    }
+
+    void run() {
+        uint64_t seed = 1234567890123456781ULL;
+        auto nextBeats = std::chrono::steady_clock::now();
+        while (!quit.load()) {
+            nextBeats += stallPeriod;
+            std::this_thread::sleep_until(nextBeats);
+            if (quit.load()) return;
+            seed = randomLong(seed);
+            const int itid = seed % numThreads;
+            if (mode == SleepInCS) {
+                requests[itid*CLPAD].store(stallLength.count());
+            } else if (mode == Signal) {
+                pthread_kill(handles[itid], SIGUSR1);
+            }
+        }
+    }
+
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+public:
+    StallInjector(const int numThreads, const Mode mode, const Role role,
+                  const std::chrono::nanoseconds stallLength, const std::chrono::nanoseconds stallPeriod)
+        : numThreads{numThreads}, mode{mode}, role{role}, stallLength{stallLength}, stallPeriod{stallPeriod} {
+        if (numThreads > MAX_THREADS) throw std::invalid_argument("numThreads must not be larger than MAX_THREADS");
+        requests = new std::atomic<int64_t>[numThreads*CLPAD];
+        for (int i = 0; i < numThreads; i++) requests[i*CLPAD].store(0, std::memory_order_relaxed);
+        handles = new pthread_t[numThreads];
+        if (mode == Signal) {
+            signalStallNs().store(stallLength.count());
+            struct sigaction sa;
+            sa.sa_handler = signalHandler;
+            sigemptyset(&sa.sa_mask);
+            sa.sa_flags = SA_RESTART;
+            if (sigaction(SIGUSR1, &sa, nullptr) != 0) throw std::runtime_error("sigaction() failed");
+        }
+    }
+
+    ~StallInjector() {
+        stop();
+        delete[] requests;
+        delete[] handles;
+    }
+
+    // Must be called by each worker thread, with a unique tid in [0, numThreads)
+    void registerThread(const int itid) {
+        tid() = itid;
+        handles[itid] = pthread_self();
+        numRegistered.fetch_add(1);
+    }
+
+    /*
+     * Waits for all the workers to register and starts the injector thread.
+     * Does nothing if the mode is NoStalls.
+     */
+    void start() {
+        if (mode == NoStalls) return;
+        while (numRegistered.load() != numThreads) std::this_thread::yield();
+        signalNumStalls().store(0);
+        quit.store(false);
+        injector = new std::thread(&StallInjector::run, this);
+    }
+
+    /*
+     * Must be called before the worker threads exit, otherwise we could send
+     * a signal to a thread that no longer exists.
+     */
+    void stop() {
+        if (injector == nullptr) return;
+        quit.store(true);
+        injector->join();
+        delete injector;
+        injector = nullptr;
+    }
+
+    /*
+     * An instrumented point inside a critical section. If the injector chose
+     * this thread and the role matches, sleep for stallLength.
+     * When there is no request it's a single relaxed load.
+     */
+    inline void point(const bool isWriter) {
+        std::atomic<int64_t>& req = requests[tid()*CLPAD];
+        if (req.load(std::memory_order_relaxed) == 0) return;
+        if ((role == Readers && isWriter) || (role == Writers && !isWriter)) return;
+        const int64_t ns = req.exchange(0);
+        if (ns == 0) return;
+        sleepNs(ns);
+        numStalls.fetch_add(1);
+    }
+
+    // Number of stalls that actually happened
+    long getNumStalls() const {
+        return (mode == Signal) ? signalNumStalls().load() : numStalls.load();
+    }
+};
+
+#endif /* _STALL_INJECTOR_H_ */
@@ -0,0 +1,16 @@
+/*
+ * bench-lr.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkLeftRightStalls.hpp"
+
+
+
+int main(void) {
+    BenchmarkLeftRightStalls::allLatencyTests();
+    return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkPreemption.hpp"
+
+
+
+int main(void) {
+    BenchmarkPreemption::allThroughputTests();
+    return 0;
+}
@@ -0,0 +1,251 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_DEQUE_H_
+#define _BENCHMARK_DEQUE_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include "MichaelDeque.hpp"
+#include "CRDoubleLinkQueue.hpp"
+#include "CPUAccounting.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * A std::deque protected by a std::mutex, with the same API as MichaelDeque
+ */
+template<typename T>
+class MutexDeque {
+    std::mutex mtx;
+    std::deque<T*> deq;
+
+public:
+    MutexDeque(int maxThreads=0) { }
+
+    std::string className() { return "MutexDeque"; }
+
+    void pushRight(T* item, const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        deq.push_back(item);
+    }
+
+    void pushLeft(T* item, const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        deq.push_front(item);
+    }
+
+    T* popRight(const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (deq.empty()) return nullptr;
+        T* item = deq.back();
+        deq.pop_back();
+        return item;
+    }
+
+    T* popLeft(const int tid) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (deq.empty()) return nullptr;
+        T* item = deq.front();
+        deq.pop_front();
+        return item;
+    }
+
+    inline void enqueue(T* item, const int tid) { pushRight(item, tid); }
+
+    inline T* dequeue(const int tid) { return popLeft(tid); }
+};
+
+
+/**
+ * This is a micro-benchmark for the deques.
+ * There are two workloads, both made of pairs where each thread does a push
+ * followed by a pop, which means a pop never sees an empty deque:
+ * - FIFO: enqueue()/dequeue(), which lets us compare with the queues;
+ * - Deque: push and pop on a random end, a mix of LIFO and FIFO;
+ */
+class BenchmarkDeque {
+
+private:
+    int numThreads;
+
+public:
+    struct UserData  {
+        long long seq;
+        int tid;
+        UserData(long long lseq, int ltid) {
+            this->seq = lseq;
+            this->tid = ltid;
+        }
+    };
+
+    BenchmarkDeque(int numThreads) {
+        this->numThreads = numThreads;
+    }
+
+
+    template<typename Q>
+    long long fifoBenchmark(const seconds testLengthSeconds, const int numRuns) {
+        auto pair_lambda = [](Q* queue, UserData* ud, uint64_t seed, const int tid) {
+            queue->enqueue(ud, tid);
+            return queue->dequeue(tid) != nullptr;
+        };
+        return pairsBenchmark<Q>(pair_lambda, testLengthSeconds, numRuns);
+    }
+
+
+    template<typename Q>
+    long long dequeBenchmark(const seconds testLengthSeconds, const int numRuns) {
+        auto pair_lambda = [](Q* deque, UserData* ud, uint64_t seed, const int tid) {
+            if (seed & 1) deque->pushLeft(ud, tid); else deque->pushRight(ud, tid);
+            if (seed & 2) return deque->popLeft(tid) != nullptr;
+            return deque->popRight(tid) != nullptr;
+        };
+        return pairsBenchmark<Q>(pair_lambda, testLengthSeconds, numRuns);
+    }
+
+
+    /**
+     * Each thread does pairs of push/pop, given by pair_lambda, until the
+     * test ends. Returns the median of the number of operations per second.
+     * The CPU time and context switches of the workers (and the energy, if
+     * available) of the median run are shown as well, see CPUAccounting.
+     */
+    template<typename Q, typename F>
+    long long pairsBenchmark(F& pair_lambda, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        CPUSample cpu[numThreads][numRuns];
+        vector<CPUAccounting> accs(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        Q* queue = nullptr;
+
+        auto run_lambda = [&pair_lambda,&quit,&startFlag,&queue](long long *ops, CPUSample *cpu, const int tid) {
+            UserData ud(0,tid);
+            long long numOps = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            const CPUSample cpuStart = CPUSample::thread();
+            while (!quit.load()) {
+                seed = randomLong(seed);
+                if (!pair_lambda(queue, &ud, seed, tid)) cout << "ERROR: popped nullptr at iter=" << numOps/2 << "\n";
+                numOps += 2;
+            }
+            *cpu = CPUSample::thread() - cpuStart;
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            queue = new Q(numThreads);
+            if (irun == 0) cout << "##### " << queue->className() << " #####  \n";
+            thread runThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid] = thread(run_lambda, &ops[tid][irun], &cpu[tid][irun], tid);
+            accs[irun].start();
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid].join();
+            accs[irun].stop();
+            for (int tid = 0; tid < numThreads; tid++) accs[irun].addThread(cpu[tid][irun]);
+            quit.store(false);
+            startFlag.store(false);
+            delete queue;
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            for (int tid = 0; tid < numThreads; tid++) agg[irun] += ops[tid][irun];
+        }
+
+        // Compute the median. numRuns should be an odd number
+        vector<long long> s(agg);
+        sort(s.begin(),s.end());
+        const int medianRun = find(agg.begin(), agg.end(), s[numRuns/2]) - agg.begin();
+        long long result = s[numRuns/2]/testLengthSeconds.count();
+        cout << "Ops/sec = " << result << "   ";
+        accs[medianRun].print(s[numRuns/2], testLengthSeconds.count());
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int NUM_CLASSES = 5;
+        long long ops[NUM_CLASSES][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkDeque bench(nThreads);
+            std::cout << "\n----- Deque Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            std::cout << "FIFO:\n";
+            ops[0][ithread] = bench.fifoBenchmark<MichaelDeque<UserData>>(testLength, numRuns);
+            ops[1][ithread] = bench.fifoBenchmark<MutexDeque<UserData>>(testLength, numRuns);
+            ops[2][ithread] = bench.fifoBenchmark<CRDoubleLinkQueue<UserData>>(testLength, numRuns);
+            std::cout << "Deque (random ends):\n";
+            ops[3][ithread] = bench.dequeBenchmark<MichaelDeque<UserData>>(testLength, numRuns);
+            ops[4][ithread] = bench.dequeBenchmark<MutexDeque<UserData>>(testLength, numRuns);
+        }
+
+        // Show results in csv format
+        cout << "\n\nResults in ops per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Threads, MichaelDeque-FIFO, MutexDeque-FIFO, CRDoubleLinkQueue-FIFO, MichaelDeque-Deque, MutexDeque-Deque\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            cout << threadList[ithread] << ", ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][ithread] << ", ";
+            cout << "\n";
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,240 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_HANDOFF_H_
+#define _BENCHMARK_HANDOFF_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "MichaelScottQueue.hpp"
+#include "SchererScottDualQueue.hpp"
+#include "CPUAccounting.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/*
+ * Adapters with the same interface for the three ways of handing off items:
+ *   put(item, tid)
+ *   get(tid)       - blocks until there is an item
+ */
+
+// Consumers call dequeue() in a loop, with a yield() between attempts
+template<typename T>
+class PollingMSQueue {
+    MichaelScottQueue<T> q;
+public:
+    PollingMSQueue(const int maxThreads) : q{maxThreads} { }
+    static std::string className() { return "MichaelScottQueue-polling"; }
+    void put(T* item, const int tid) { q.enqueue(item, tid); }
+    T* get(const int tid) {
+        T* item;
+        while ((item = q.dequeue(tid)) == nullptr) std::this_thread::yield();
+        return item;
+    }
+};
+
+template<typename T>
+class DualQueueOffer {
+    SchererScottDualQueue<T> q;
+public:
+    DualQueueOffer(const int maxThreads) : q{maxThreads} { }
+    static std::string className() { return "SchererScottDualQueue-offer"; }
+    void put(T* item, const int tid) { q.offer(item, tid); }
+    T* get(const int tid) { return q.take(tid); }
+};
+
+template<typename T>
+class DualQueueTransfer {
+    SchererScottDualQueue<T> q;
+public:
+    DualQueueTransfer(const int maxThreads) : q{maxThreads} { }
+    static std::string className() { return "SchererScottDualQueue-transfer"; }
+    void put(T* item, const int tid) { q.transfer(item, tid); }
+    T* get(const int tid) { return q.take(tid); }
+};
+
+
+/**
+ * Hand-off latency benchmark, for thread pools where the consumers are
+ * usually idle, waiting for work.
+ *
+ * Each producer puts an item with a timestamp every interArrival, and each
+ * consumer measures how long it took from the put() until it got the item.
+ * With polling, the consumers burn the CPU while the queue is empty, which
+ * is why we show the CPU time as well (see CPUAccounting). With the dual
+ * queue the waiting consumers park, and the producer hands the item
+ * directly to the oldest one.
+ */
+class BenchmarkHandoff {
+
+public:
+    struct Item {
+        steady_clock::time_point start;
+    };
+
+    struct Result {
+        long long handoffsPerSec {0};
+        uint64_t p50 {0};
+        uint64_t p99 {0};
+        uint64_t max {0};
+        double cpuSecPerSec {0};
+
+        bool operator < (const Result& other) const {
+            return p50 < other.p50;
+        }
+    };
+
+private:
+    const int numProducers;
+    const int numConsumers;
+
+public:
+    BenchmarkHandoff(const int numProducers, const int numConsumers) : numProducers{numProducers}, numConsumers{numConsumers} { }
+
+
+    /**
+     * Returns the result of the median run (by p50 latency)
+     */
+    template<typename A>
+    Result benchmark(const microseconds interArrival, const seconds testLengthSeconds, const int numRuns) {
+        const int numThreads = numProducers+numConsumers+1;  // The last one is the main thread, which puts the poison items
+        vector<Result> results(numRuns);
+        vector<CPUAccounting> accs(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        vector<vector<uint64_t>> lats(numConsumers);
+        Item poison;
+        A* adapter = nullptr;
+
+        auto prod_lambda = [&quit,&startFlag,&adapter,interArrival](const int tid) {
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                Item* item = new Item();
+                item->start = steady_clock::now();
+                adapter->put(item, tid);
+                this_thread::sleep_for(interArrival);
+            }
+        };
+
+        auto cons_lambda = [&adapter,&poison](vector<uint64_t>* lat, const int tid) {
+            while (true) {
+                Item* item = adapter->get(tid);
+                if (item == &poison) return;
+                lat->push_back((steady_clock::now()-item->start).count());
+                delete item;
+            }
+        };
+
+        cout << "##### " << A::className() << " #####\n";
+        for (int irun = 0; irun < numRuns; irun++) {
+            adapter = new A(numThreads);
+            for (auto& lat : lats) lat.clear();
+            thread prodThreads[numProducers];
+            thread consThreads[numConsumers];
+            for (int i = 0; i < numConsumers; i++) consThreads[i] = thread(cons_lambda, &lats[i], numProducers+i);
+            for (int i = 0; i < numProducers; i++) prodThreads[i] = thread(prod_lambda, i);
+            const CPUSample cpuStart = CPUSample::process();
+            accs[irun].start();
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int i = 0; i < numProducers; i++) prodThreads[i].join();
+            // Items are taken in order, so each consumer gets its poison after the real items
+            for (int i = 0; i < numConsumers; i++) adapter->put(&poison, numThreads-1);
+            for (int i = 0; i < numConsumers; i++) consThreads[i].join();
+            accs[irun].addThread(CPUSample::process() - cpuStart);
+            accs[irun].stop();
+            quit.store(false);
+            startFlag.store(false);
+            delete adapter;
+            // Accounting
+            vector<uint64_t> all;
+            for (auto& lat : lats) all.insert(all.end(), lat.begin(), lat.end());
+            sort(all.begin(), all.end());
+            if (all.size() == 0) continue;
+            results[irun].handoffsPerSec = all.size()/testLengthSeconds.count();
+            results[irun].p50 = all[all.size()/2];
+            results[irun].p99 = all[(all.size()*99)/100];
+            results[irun].max = all.back();
+            results[irun].cpuSecPerSec = accs[irun].cpuSeconds()/testLengthSeconds.count();
+        }
+
+        // Compute the median. numRuns should be an odd number
+        vector<Result> s(results);
+        sort(s.begin(), s.end());
+        const Result median = s[numRuns/2];
+        int medianRun = 0;
+        while (results[medianRun].p50 != median.p50) medianRun++;
+        cout << "Handoffs/sec = " << median.handoffsPerSec << "   p50 = " << median.p50/1000. << " us   p99 = " << median.p99/1000.;
+        cout << " us   max = " << median.max/1000. << " us   ";
+        accs[medianRun].print(median.handoffsPerSec*testLengthSeconds.count(), testLengthSeconds.count());
+        return median;
+    }
+
+
+public:
+
+    static void allLatencyTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16 };  // Number of producers and of consumers
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const microseconds interArrival = 100us;
+        const int NUM_CLASSES = 3;
+        vector<Result> results[NUM_CLASSES];
+
+        for (int nThreads : threadList) {
+            BenchmarkHandoff bench(nThreads, nThreads);
+            std::cout << "\n----- Handoff Benchmark   producers=" << nThreads << "   consumers=" << nThreads << "   interArrival=" << interArrival.count();
+            std::cout << "us   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            results[0].push_back(bench.benchmark<PollingMSQueue<Item>>(interArrival, testLength, numRuns));
+            results[1].push_back(bench.benchmark<DualQueueOffer<Item>>(interArrival, testLength, numRuns));
+            results[2].push_back(bench.benchmark<DualQueueTransfer<Item>>(interArrival, testLength, numRuns));
+        }
+
+        // Show results in csv format
+        const string names[NUM_CLASSES] = { PollingMSQueue<Item>::className(), DualQueueOffer<Item>::className(), DualQueueTransfer<Item>::className() };
+        cout << "\n\nResults for numRuns=" << numRuns << ",  length=" << testLength.count() << "s,  interArrival=" << interArrival.count() << "us \n";
+        cout << "Threads, Class, Handoffs/sec, p50 (us), p99 (us), max (us), CPU-sec/sec\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            for (int ic = 0; ic < NUM_CLASSES; ic++) {
+                const Result& r = results[ic][ithread];
+                cout << threadList[ithread] << ", " << names[ic] << ", " << r.handoffsPerSec << ", " << r.p50/1000. << ", ";
+                cout << r.p99/1000. << ", " << r.max/1000. << ", " << r.cpuSecPerSec << "\n";
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_RELAXED_QUEUES_H_
+#define _BENCHMARK_RELAXED_QUEUES_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "BenchmarkDeque.hpp"
+#include "MichaelScottQueue.hpp"
+#include "MichaelScottQueueRelaxed.hpp"
+#include "BitNextQueue.hpp"
+#include "BitNextQueueRelaxed.hpp"
+#include "CRTurnQueue.hpp"
+#include "CRTurnQueueRelaxed.hpp"
+#include "FAAArrayQueue.hpp"
+#include "FAAArrayQueueRelaxed.hpp"
+#include "LinearArrayQueue.hpp"
+#include "LinearArrayQueueRelaxed.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Compares each queue with its *Relaxed variant, using the same workload of
+ * enqueue()/dequeue() pairs as the FIFO test in BenchmarkDeque.
+ * On x86 the only difference we can expect is from the seq_cst stores that
+ * became release or relaxed (no more MFENCE/XCHG), loads are the same
+ * instruction regardless of the memory order. On ARM and POWER the acquire
+ * loads and release CAS are cheaper than the seq_cst ones as well.
+ */
+class BenchmarkRelaxedQueues {
+
+public:
+    static void allThroughputTests() {
+        typedef BenchmarkDeque::UserData UserData;
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int NUM_CLASSES = 10;
+        long long ops[NUM_CLASSES][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkDeque bench(nThreads);
+            std::cout << "\n----- Relaxed Queues Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            ops[0][ithread] = bench.fifoBenchmark<MichaelScottQueue<UserData>>(testLength, numRuns);
+            ops[1][ithread] = bench.fifoBenchmark<MichaelScottQueueRelaxed<UserData>>(testLength, numRuns);
+            ops[2][ithread] = bench.fifoBenchmark<BitNextQueue<UserData>>(testLength, numRuns);
+            ops[3][ithread] = bench.fifoBenchmark<BitNextQueueRelaxed<UserData>>(testLength, numRuns);
+            ops[4][ithread] = bench.fifoBenchmark<CRTurnQueue<UserData>>(testLength, numRuns);
+            ops[5][ithread] = bench.fifoBenchmark<CRTurnQueueRelaxed<UserData>>(testLength, numRuns);
+            ops[6][ithread] = bench.fifoBenchmark<FAAArrayQueue<UserData>>(testLength, numRuns);
+            ops[7][ithread] = bench.fifoBenchmark<FAAArrayQueueRelaxed<UserData>>(testLength, numRuns);
+            ops[8][ithread] = bench.fifoBenchmark<LinearArrayQueue<UserData>>(testLength, numRuns);
+            ops[9][ithread] = bench.fifoBenchmark<LinearArrayQueueRelaxed<UserData>>(testLength, numRuns);
+        }
+
+        // Show results in csv format
+        cout << "\n\nResults in ops per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Threads, MichaelScottQueue, MichaelScottQueueRelaxed, BitNextQueue, BitNextQueueRelaxed, CRTurnQueue, CRTurnQueueRelaxed, ";
+        cout << "FAAArrayQueue, FAAArrayQueueRelaxed, LinearArrayQueue, LinearArrayQueueRelaxed\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            cout << threadList[ithread] << ", ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][ithread] << ", ";
+            cout << "\n";
+        }
+    }
+};
+
+#endif
@@ -33,6 +33,7 @@
 #include <atomic>
 #include <vector>
 #include <iostream>
+#include "USDTProbes.hpp"
 
 
 template<typename T>
@@ -132,6 +133,7 @@ public:
     void retire(T* ptr, const int tid) {
         retiredList[tid*CLPAD].push_back(ptr);
         if (retiredList[tid*CLPAD].size() < HP_THRESHOLD_R) return;
+        CF_PROBE2(hp_scan_begin, tid, retiredList[tid*CLPAD].size());
         for (unsigned iret = 0; iret < retiredList[tid*CLPAD].size();) {
             auto obj = retiredList[tid*CLPAD][iret];
             bool canDelete = true;
@@ -150,6 +152,7 @@ public:
             }
             iret++;
         }
+        CF_PROBE2(hp_scan_end, tid, retiredList[tid*CLPAD].size());
     }
 };
 
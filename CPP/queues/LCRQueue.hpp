@@ -32,6 +32,7 @@
 
 #include <atomic>
 #include "HazardPointers.hpp"
+#include "USDTProbes.hpp"
 
 // CAS2 macro
 
@@ -221,10 +222,12 @@ public:
                 newNode->array[0].idx.store(0, std::memory_order_relaxed);
                 Node* nullnode = nullptr;
                 if (ltail->next.compare_exchange_strong(nullnode, newNode)) {// Insert new ring
+                    CF_PROBE2(lcrq_crq_alloc, this, tid);
                     tail.compare_exchange_strong(ltail, newNode); // Advance the tail
                     hp.clear(tid);
                     return;
                 }
+                CF_PROBE2(lcrq_crq_discard, this, tid);
                 delete newNode;
                 continue;
             }
@@ -241,7 +244,10 @@ public:
                     }
                 }
             }
-            if (((int64_t)(tailticket - ltail->head.load()) >= (int64_t)RING_SIZE) && close_crq(ltail, tailticket, ++try_close)) continue;
+            if (((int64_t)(tailticket - ltail->head.load()) >= (int64_t)RING_SIZE) && close_crq(ltail, tailticket, ++try_close)) {
+                CF_PROBE4(lcrq_crq_close, this, tid, tailticket, try_close);
+                continue;
+            }
         }
     }
 
@@ -283,7 +289,11 @@ public:
                             break;
                     } else if (t < headticket + 1 || r > 200000 || crq_closed) {
                         if (CAS2((void**)cell, val, idx, val, headticket + RING_SIZE)) {
-                            if (r > 200000 && tt > RING_SIZE) BIT_TEST_AND_SET(&lhead->tail, 63);
+                            if (r > 200000 && tt > RING_SIZE) {
+                                // Dequeuer was starved by enqueuers, close the CRQ
+                                BIT_TEST_AND_SET(&lhead->tail, 63);
+                                CF_PROBE4(lcrq_crq_close_starving, this, tid, tail_index(tt), r);
+                            }
                             break;
                         }
                     } else {
@@ -0,0 +1,303 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _MICHAEL_DEQUE_HP_H_
+#define _MICHAEL_DEQUE_HP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include "HazardPointers.hpp"
+
+
+/**
+ * <h1> Michael's Deque </h1>
+ *
+ * A lock-free double-ended queue that is Multi-Producer-Multi-Consumer,
+ * based on the paper by Maged Michael "CAS-Based Lock-Free Algorithm for
+ * Shared Deques" http://www.research.ibm.com/people/m/michael/europar-2003.pdf
+ *
+ * <p>
+ * The nodes form a double linked list and the pointers to both ends are kept
+ * in a single 16 byte anchor, along with a status that tells whether the last
+ * push left one of the ends with a dangling link (RPUSH or LPUSH) that must be
+ * fixed (stabilized) before any other operation can complete.
+ * All operations are a single CAS on the anchor when uncontended, plus one
+ * CAS on the neighbour's link for the pushes.
+ * The anchor is updated with a double-width CAS (cmpxchg16b), which means
+ * this code is x86-64 only, just like LCRQueue. The status is stored on the
+ * two lower bits of the right pointer.
+ * <p>
+ * pushLeft/pushRight algorithm: Michael's deque push + stabilize
+ * popLeft/popRight algorithm: Michael's deque pop
+ * Consistency: Linearizable
+ * push progress: lock-free
+ * pop progress: lock-free
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ * Uncontended push: 2 CAS2 + 1 CAS + 2 HP (plus the reads of the anchor)
+ * Uncontended pop: 1 CAS2 + 1 HP (plus the reads of the anchor)
+ * Reading the anchor atomically is also done with a cmpxchg16b.
+ * <p>
+ * enqueue() is pushRight() and dequeue() is popLeft(), so that it can be used
+ * wherever one of the FIFO queues in this folder is used.
+ *
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class MichaelDeque {
+
+private:
+    struct Node {
+        T* item;
+        std::atomic<Node*> left;
+        std::atomic<Node*> right;
+        Node(T* item) : item{item}, left{nullptr}, right{nullptr} { }
+    };
+
+    // Left pointer and right pointer with the status on its two lower bits
+    struct alignas(16) Anchor {
+        Node* left;
+        uintptr_t right;
+    };
+
+    static const uintptr_t STABLE = 0;
+    static const uintptr_t RPUSH = 1;
+    static const uintptr_t LPUSH = 2;
+    static const uintptr_t STATUS_MASK = 3;
+
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+
+    alignas(128) Anchor anchor;
+
+    // We need two hazard pointers, one for the node at the end and one for its neighbour
+    HazardPointers<Node> hp {2, maxThreads};
+    const int kHpEnd = 0;
+    const int kHpPrev = 1;
+
+
+    static inline Node* rightOf(const Anchor& a) { return (Node*)(a.right & ~STATUS_MASK); }
+
+    static inline uintptr_t statusOf(const Anchor& a) { return a.right & STATUS_MASK; }
+
+    static inline bool equals(const Anchor& a, const Anchor& b) { return a.left == b.left && a.right == b.right; }
+
+    /*
+     * Double-width CAS on the anchor. On failure, 'expected' gets the current value.
+     */
+    bool casAnchor(Anchor& expected, const Anchor& desired) {
+        bool ret;
+        asm volatile("lock cmpxchg16b %1; setz %0"
+                     : "=q"(ret), "+m"(anchor), "+a"(expected.left), "+d"(expected.right)
+                     : "b"(desired.left), "c"(desired.right)
+                     : "cc", "memory");
+        return ret;
+    }
+
+    /*
+     * An atomic 16 byte load. If the anchor is {nullptr,0} it is overwritten
+     * with the same value, otherwise the CAS fails and returns the anchor.
+     */
+    Anchor loadAnchor() {
+        Anchor a {nullptr, 0};
+        casAnchor(a, a);
+        return a;
+    }
+
+
+    /*
+     * Links the node previous to the rightmost node to the rightmost node and
+     * sets the status back to STABLE
+     */
+    void stabilizeRight(const Anchor& a, const int tid) {
+        Node* lright = hp.protectPtr(kHpEnd, rightOf(a), tid);
+        if (!equals(loadAnchor(), a)) return;
+        Node* lprev = hp.protectPtr(kHpPrev, lright->left.load(), tid);
+        if (!equals(loadAnchor(), a)) return;
+        Node* lprevnext = lprev->right.load();
+        if (lprevnext != lright) {
+            if (!equals(loadAnchor(), a)) return;
+            if (!lprev->right.compare_exchange_strong(lprevnext, lright)) return;
+        }
+        Anchor expected = a;
+        casAnchor(expected, {a.left, (uintptr_t)lright});
+    }
+
+
+    /*
+     * Links the node next to the leftmost node to the leftmost node and
+     * sets the status back to STABLE
+     */
+    void stabilizeLeft(const Anchor& a, const int tid) {
+        Node* lleft = hp.protectPtr(kHpEnd, a.left, tid);
+        if (!equals(loadAnchor(), a)) return;
+        Node* lprev = hp.protectPtr(kHpPrev, lleft->right.load(), tid);
+        if (!equals(loadAnchor(), a)) return;
+        Node* lprevnext = lprev->left.load();
+        if (lprevnext != lleft) {
+            if (!equals(loadAnchor(), a)) return;
+            if (!lprev->left.compare_exchange_strong(lprevnext, lleft)) return;
+        }
+        Anchor expected = a;
+        casAnchor(expected, {lleft, (uintptr_t)rightOf(a)});
+    }
+
+
+    void stabilize(const Anchor& a, const int tid) {
+        if (statusOf(a) == RPUSH) {
+            stabilizeRight(a, tid);
+        } else {
+            stabilizeLeft(a, tid);
+        }
+    }
+
+
+public:
+    MichaelDeque(int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        anchor.left = nullptr;
+        anchor.right = 0;
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+
+    ~MichaelDeque() {
+        while (popLeft(0) != nullptr); // Drain the deque
+    }
+
+    std::string className() { return "MichaelDeque"; }
+
+
+    void pushRight(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        Node* newNode = new Node(item);
+        while (true) {
+            Anchor a = loadAnchor();
+            Node* lright = rightOf(a);
+            if (lright == nullptr) {
+                if (casAnchor(a, {newNode, (uintptr_t)newNode})) break;
+            } else if (statusOf(a) == STABLE) {
+                newNode->left.store(lright, std::memory_order_relaxed);
+                const Anchor na = {a.left, (uintptr_t)newNode | RPUSH};
+                if (casAnchor(a, na)) {
+                    stabilizeRight(na, tid);
+                    break;
+                }
+            } else {
+                stabilize(a, tid);
+            }
+        }
+        hp.clear(tid);
+    }
+
+
+    void pushLeft(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        Node* newNode = new Node(item);
+        while (true) {
+            Anchor a = loadAnchor();
+            if (a.left == nullptr) {
+                if (casAnchor(a, {newNode, (uintptr_t)newNode})) break;
+            } else if (statusOf(a) == STABLE) {
+                newNode->right.store(a.left, std::memory_order_relaxed);
+                const Anchor na = {newNode, a.right | LPUSH};
+                if (casAnchor(a, na)) {
+                    stabilizeLeft(na, tid);
+                    break;
+                }
+            } else {
+                stabilize(a, tid);
+            }
+        }
+        hp.clear(tid);
+    }
+
+
+    T* popRight(const int tid) {
+        Node* lright;
+        while (true) {
+            Anchor a = loadAnchor();
+            lright = rightOf(a);
+            if (lright == nullptr) {      // Check if deque is empty
+                hp.clear(tid);
+                return nullptr;
+            }
+            if (lright == a.left) {
+                if (casAnchor(a, {nullptr, 0})) break;
+            } else if (statusOf(a) == STABLE) {
+                hp.protectPtr(kHpEnd, lright, tid);
+                if (!equals(loadAnchor(), a)) continue;
+                Node* lprev = lright->left.load();
+                if (casAnchor(a, {a.left, (uintptr_t)lprev})) break;
+            } else {
+                stabilize(a, tid);
+            }
+        }
+        // Once it's out of the anchor, the node is ours
+        T* item = lright->item;
+        hp.clear(tid);
+        hp.retire(lright, tid);
+        return item;
+    }
+
+
+    T* popLeft(const int tid) {
+        Node* lleft;
+        while (true) {
+            Anchor a = loadAnchor();
+            lleft = a.left;
+            if (lleft == nullptr) {       // Check if deque is empty
+                hp.clear(tid);
+                return nullptr;
+            }
+            if (lleft == rightOf(a)) {
+                if (casAnchor(a, {nullptr, 0})) break;
+            } else if (statusOf(a) == STABLE) {
+                hp.protectPtr(kHpEnd, lleft, tid);
+                if (!equals(loadAnchor(), a)) continue;
+                Node* lnext = lleft->right.load();
+                if (casAnchor(a, {lnext, a.right})) break;
+            } else {
+                stabilize(a, tid);
+            }
+        }
+        // Once it's out of the anchor, the node is ours
+        T* item = lleft->item;
+        hp.clear(tid);
+        hp.retire(lleft, tid);
+        return item;
+    }
+
+
+    inline void enqueue(T* item, const int tid) { pushRight(item, tid); }
+
+    inline T* dequeue(const int tid) { return popLeft(tid); }
+};
+
+#endif /* _MICHAEL_DEQUE_HP_H_ */
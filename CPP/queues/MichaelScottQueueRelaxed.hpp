@@ -0,0 +1,169 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _MICHAEL_SCOTT_QUEUE_RELAXED_HP_H_
+#define _MICHAEL_SCOTT_QUEUE_RELAXED_HP_H_
+
+#include <atomic>
+#include <stdexcept>
+#include "HazardPointers.hpp"
+
+
+/**
+ * <h1> Michael-Scott Queue (relaxed atomics) </h1>
+ *
+ * Same algorithm as MichaelScottQueue.hpp but where each atomic access uses
+ * the weakest memory order that keeps the queue correct. The justification
+ * for each one is next to it. There are two kinds of accesses that must
+ * remain seq_cst:
+ * - The publication of a hazard pointer and the re-check of the pointer it
+ *   protects (done inside HazardPointers). This is a store-load (Dekker)
+ *   pattern with the unlink-then-scan of retire();
+ * - The CAS that unlinks a node before it is passed to retire(), which is
+ *   the other half of the same Dekker pattern.
+ * Everything else is acquire/release for publishing a node (or an item) and
+ * relaxed when the value is only a hint that gets re-validated.
+ *
+ * enqueue algorithm: MS enqueue
+ * dequeue algorithm: MS dequeue
+ * Consistency: Linearizable
+ * enqueue() progress: lock-free
+ * dequeue() progress: lock-free
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ *
+ * http://concurrencyfreaks.com/2014/05/relaxed-atomics-optimizations-for.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class MichaelScottQueueRelaxed {
+
+private:
+    struct Node {
+        T* item;
+        std::atomic<Node*> next;
+
+        Node(T* userItem) : item{userItem}, next{nullptr} { }
+
+        // release: publishes the item and the nullptr next of the new node
+        // to whoever reads this next with acquire
+        bool casNext(Node *cmp, Node *val) {
+            return next.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+        }
+    };
+
+    // release: a thread that reads the tail (acquire) may dereference it, and
+    // the node was made visible to us by an acquire load of next
+    bool casTail(Node *cmp, Node *val) {
+        return tail.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // seq_cst: this unlinks the node that is about to be retired, and it must
+    // not be re-ordered with the loads of the hazard pointers done in retire()
+    bool casHead(Node *cmp, Node *val) {
+        return head.compare_exchange_strong(cmp, val);
+    }
+
+    // Pointers to head and tail of the list
+    alignas(128) std::atomic<Node*> head;
+    alignas(128) std::atomic<Node*> tail;
+
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+
+    // We need two hazard pointers for dequeue()
+    HazardPointers<Node> hp {2, maxThreads};
+    const int kHpTail = 0;
+    const int kHpHead = 0;
+    const int kHpNext = 1;
+
+public:
+    MichaelScottQueueRelaxed(int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        Node* sentinelNode = new Node(nullptr);
+        head.store(sentinelNode, std::memory_order_relaxed);
+        tail.store(sentinelNode, std::memory_order_relaxed);
+    }
+
+
+    ~MichaelScottQueueRelaxed() {
+        while (dequeue(0) != nullptr); // Drain the queue
+        delete head.load();            // Delete the last node
+    }
+
+    std::string className() { return "MichaelScottQueueRelaxed"; }
+
+    void enqueue(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        Node* newNode = new Node(item);
+        while (true) {
+            // relaxed: this is only the value to protect, it is validated below
+            Node* ltail = hp.protectPtr(kHpTail, tail.load(std::memory_order_relaxed), tid);
+            // seq_cst: validation of the hazard pointer. On success it also
+            // reads-from a release CAS on tail, which makes ltail's fields visible
+            if (ltail == tail.load()) {
+                // acquire: we may advance tail to lnext, and others will dereference it
+                Node* lnext = ltail->next.load(std::memory_order_acquire);
+                if (lnext == nullptr) {
+                    // It seems this is the last node, so add the newNode here
+                    // and try to move the tail to the newNode
+                    if (ltail->casNext(nullptr, newNode)) {
+                        casTail(ltail, newNode);
+                        hp.clear(tid);
+                        return;
+                    }
+                } else {
+                    casTail(ltail, lnext);
+                }
+            }
+        }
+    }
+
+
+    T* dequeue(const int tid) {
+        Node* node = hp.protect(kHpHead, head, tid);
+        // acquire: if we see that tail has moved then we must also see the
+        // node it points to, and this can't move above the (seq_cst) load of head
+        while (node != tail.load(std::memory_order_acquire)) {
+            // The loads in protect() are seq_cst, which includes the acquire
+            // needed to read lnext->item after it was published by casNext()
+            Node* lnext = hp.protect(kHpNext, node->next, tid);
+            if (casHead(node, lnext)) {
+                T* item = lnext->item;  // Another thread may clean up lnext after we do hp.clear()
+                hp.clear(tid);
+                hp.retire(node, tid);
+                return item;
+            }
+            node = hp.protect(kHpHead, head, tid);
+        }
+        hp.clear(tid);
+        return nullptr;                  // Queue is empty
+    }
+};
+
+#endif /* _MICHAEL_SCOTT_QUEUE_RELAXED_HP_H_ */
@@ -0,0 +1,253 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _QUEUE_STRESS_H_
+#define _QUEUE_STRESS_H_
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "MichaelScottQueue.hpp"
+#include "MichaelScottQueueRelaxed.hpp"
+#include "BitNextQueue.hpp"
+#include "BitNextQueueRelaxed.hpp"
+#include "CRTurnQueue.hpp"
+#include "CRTurnQueueRelaxed.hpp"
+#include "FAAArrayQueue.hpp"
+#include "FAAArrayQueueRelaxed.hpp"
+#include "LinearArrayQueue.hpp"
+#include "LinearArrayQueueRelaxed.hpp"
+#include "SchererScottDualQueue.hpp"
+
+using namespace std;
+
+
+/**
+ * Stress tests for the queues, mostly meant to validate the memory orders of
+ * the *Relaxed variants, but they run on the originals as well.
+ * Each test is a "litmus" of a property that a linearizable MPMC queue must
+ * have and that a missing acquire/release would break:
+ * - Exactly-once: every enqueued item is dequeued once, no losses, no duplicates;
+ * - Per-producer FIFO: items from the same producer are dequeued in the order
+ *   they were enqueued, as seen by each consumer;
+ * - Message passing: the plain (non-atomic) fields of an item, written before
+ *   enqueue(), are seen by the consumer that dequeues it;
+ * - Pairs: a thread that does enqueue() followed by dequeue() never gets a
+ *   nullptr, because its own item is in the queue;
+ * - Empty at the end: once all the items were dequeued, dequeue() returns nullptr;
+ * Run these with -fsanitize=address and/or -fsanitize=thread as well, and on a
+ * machine with a weak memory model (ARM, POWER) if you have one.
+ */
+class QueueStress {
+
+public:
+    struct Item {
+        int  tid;           // Producer's tid
+        long long seq;      // Sequence number for this producer
+        long long payload;  // Written before enqueue(), checked after dequeue()
+    };
+
+private:
+    const int numProducers;
+    const int numConsumers;
+    const long long numItems;      // Per producer
+
+    static long long payloadOf(const int tid, const long long seq) {
+        return (seq * 2685821657736338717LL) ^ tid;
+    }
+
+public:
+    QueueStress(const int numProducers, const int numConsumers, const long long numItems)
+        : numProducers{numProducers}, numConsumers{numConsumers}, numItems{numItems} { }
+
+
+    /**
+     * Producers enqueue numItems each while the consumers dequeue until they
+     * have all been consumed. Checks exactly-once, per-producer FIFO, message
+     * passing and that the queue is empty at the end.
+     * Returns the number of errors found.
+     */
+    template<typename Q>
+    long long mpmcTest() {
+        const int numThreads = numProducers + numConsumers;
+        Q* queue = new Q(numThreads);
+        Item* items = new Item[numProducers*numItems];
+        std::atomic<int>* seen = new std::atomic<int>[numProducers*numItems];
+        for (long long i = 0; i < numProducers*numItems; i++) seen[i].store(0, std::memory_order_relaxed);
+        atomic<long long> totalDequeued = { 0 };
+        atomic<long long> errors = { 0 };
+        atomic<bool> startFlag = { false };
+
+        auto prod_lambda = [this,&queue,&items,&startFlag](const int tid) {
+            while (!startFlag.load()) { } // spin
+            for (long long seq = 0; seq < numItems; seq++) {
+                Item* item = &items[tid*numItems + seq];
+                item->tid = tid;
+                item->seq = seq;
+                item->payload = payloadOf(tid, seq);
+                queue->enqueue(item, tid);
+            }
+        };
+
+        auto cons_lambda = [this,&queue,&seen,&totalDequeued,&errors,&startFlag](const int tid) {
+            vector<long long> lastSeq(numProducers, -1);
+            const long long total = numProducers*numItems;
+            while (!startFlag.load()) { } // spin
+            while (totalDequeued.load() < total) {
+                Item* item = queue->dequeue(tid);
+                if (item == nullptr) continue;
+                totalDequeued.fetch_add(1);
+                if (item->tid < 0 || item->tid >= numProducers || item->seq < 0 || item->seq >= numItems) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: garbage item tid=" << item->tid << " seq=" << item->seq << "\n";
+                    continue;
+                }
+                if (item->payload != payloadOf(item->tid, item->seq)) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: payload not visible for tid=" << item->tid << " seq=" << item->seq << "\n";
+                }
+                if (item->seq <= lastSeq[item->tid]) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: FIFO violation for producer " << item->tid << ": seq=" << item->seq << " after " << lastSeq[item->tid] << "\n";
+                }
+                lastSeq[item->tid] = item->seq;
+                if (seen[item->tid*numItems + item->seq].fetch_add(1) != 0) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: duplicate item tid=" << item->tid << " seq=" << item->seq << "\n";
+                }
+            }
+        };
+
+        thread prodThreads[numProducers];
+        thread consThreads[numConsumers];
+        for (int i = 0; i < numProducers; i++) prodThreads[i] = thread(prod_lambda, i);
+        for (int i = 0; i < numConsumers; i++) consThreads[i] = thread(cons_lambda, numProducers+i);
+        startFlag.store(true);
+        for (int i = 0; i < numProducers; i++) prodThreads[i].join();
+        for (int i = 0; i < numConsumers; i++) consThreads[i].join();
+
+        for (long long i = 0; i < numProducers*numItems; i++) {
+            if (seen[i].load() != 1) {
+                errors.fetch_add(1);
+                cout << "ERROR: item tid=" << i/numItems << " seq=" << i%numItems << " was dequeued " << seen[i].load() << " times\n";
+            }
+        }
+        if (queue->dequeue(0) != nullptr) {
+            errors.fetch_add(1);
+            cout << "ERROR: queue is not empty at the end\n";
+        }
+        delete queue;
+        delete[] seen;
+        delete[] items;
+        return errors.load();
+    }
+
+
+    /**
+     * All the threads do pairs of enqueue()/dequeue(). Because each thread's
+     * own item is in the queue, dequeue() must never return nullptr.
+     * The item we get may be from another thread, and it must have its payload.
+     * Returns the number of errors found.
+     */
+    template<typename Q>
+    long long pairsTest() {
+        const int numThreads = numProducers + numConsumers;
+        Q* queue = new Q(numThreads);
+        Item* items = new Item[numThreads*numItems];
+        atomic<long long> errors = { 0 };
+        atomic<bool> startFlag = { false };
+
+        auto pair_lambda = [this,&queue,&items,&errors,&startFlag](const int tid) {
+            while (!startFlag.load()) { } // spin
+            for (long long seq = 0; seq < numItems; seq++) {
+                Item* myItem = &items[tid*numItems + seq];
+                myItem->tid = tid;
+                myItem->seq = seq;
+                myItem->payload = payloadOf(tid, seq);
+                queue->enqueue(myItem, tid);
+                Item* item = queue->dequeue(tid);
+                if (item == nullptr) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: dequeue() returned nullptr after an enqueue() at seq=" << seq << "\n";
+                } else if (item->payload != payloadOf(item->tid, item->seq)) {
+                    errors.fetch_add(1);
+                    cout << "ERROR: payload not visible for tid=" << item->tid << " seq=" << item->seq << "\n";
+                }
+            }
+        };
+
+        thread pairThreads[numThreads];
+        for (int i = 0; i < numThreads; i++) pairThreads[i] = thread(pair_lambda, i);
+        startFlag.store(true);
+        for (int i = 0; i < numThreads; i++) pairThreads[i].join();
+        if (queue->dequeue(0) != nullptr) {
+            errors.fetch_add(1);
+            cout << "ERROR: queue is not empty at the end\n";
+        }
+        delete queue;
+        delete[] items;
+        return errors.load();
+    }
+
+
+    template<typename Q>
+    long long runAll() {
+        long long errors = mpmcTest<Q>() + pairsTest<Q>();
+        cout << Q(1).className() << ":  producers=" << numProducers << "  consumers=" << numConsumers << "  items=" << numItems << "  errors=" << errors << "\n";
+        return errors;
+    }
+
+
+public:
+
+    static long long allStressTests(const long long numItems=200000) {
+        vector<int> threadList = { 1, 2, 4, 8 };
+        long long errors = 0;
+        for (int nThreads : threadList) {
+            QueueStress stress(nThreads, nThreads, numItems/nThreads);
+            std::cout << "\n----- Queue Stress   producers=" << nThreads << "   consumers=" << nThreads << " -----\n";
+            errors += stress.runAll<MichaelScottQueue<Item>>();
+            errors += stress.runAll<MichaelScottQueueRelaxed<Item>>();
+            errors += stress.runAll<BitNextQueue<Item>>();
+            errors += stress.runAll<BitNextQueueRelaxed<Item>>();
+            errors += stress.runAll<CRTurnQueue<Item>>();
+            errors += stress.runAll<CRTurnQueueRelaxed<Item>>();
+            errors += stress.runAll<FAAArrayQueue<Item>>();
+            errors += stress.runAll<FAAArrayQueueRelaxed<Item>>();
+            errors += stress.runAll<LinearArrayQueue<Item>>();
+            errors += stress.runAll<LinearArrayQueueRelaxed<Item>>();
+            errors += stress.runAll<SchererScottDualQueue<Item>>();  // offer()/poll()
+        }
+        cout << "\nTotal errors: " << errors << "\n";
+        return errors;
+    }
+};
+
+#endif
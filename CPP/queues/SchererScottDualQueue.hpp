@@ -0,0 +1,272 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _SCHERER_SCOTT_DUAL_QUEUE_HP_H_
+#define _SCHERER_SCOTT_DUAL_QUEUE_HP_H_
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include "HazardPointers.hpp"
+
+
+/**
+ * <h1> Scherer-Scott Dual Queue </h1>
+ *
+ * A Michael-Scott queue where the nodes are either data or reservations,
+ * and the queue holds only one kind at a time.
+ * A consumer that finds the queue empty (or holding reservations) appends a
+ * reservation node and waits on it, first spinning and then parking. A
+ * producer that finds reservations fulfills the oldest one with a CAS on
+ * its item, moves the head forward, and wakes up the consumer. Otherwise the
+ * producer appends a data node, and with transfer() it waits until a
+ * consumer takes it, while with offer() it returns immediately.
+ * This is the same algorithm as the TransferQueue in Java's SynchronousQueue,
+ * without the timeouts and cancellations.
+ *
+ * The item of a data node goes from the user's item to nullptr when it is
+ * taken, and the item of a reservation node goes from nullptr to the user's
+ * item when it is fulfilled, so a node has been matched when
+ * isData == (item == nullptr).
+ *
+ * To park, each thread has a mutex and a condition variable. The waiting
+ * thread sets its 'parked' flag before checking the item one last time, and
+ * the thread that did the match checks the flag after its CAS on the item,
+ * so only waiters that may be parked are signaled.
+ *
+ * offer() progress: lock-free
+ * transfer() progress: blocking (waits for a consumer)
+ * take() progress: blocking (waits for a producer)
+ * poll() progress: lock-free
+ * Consistency: Linearizable
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ *
+ * Nonblocking Concurrent Data Structures with Condition Synchronization,
+ * by William N. Scherer III and Michael L. Scott:
+ * http://www.cs.rochester.edu/u/scott/papers/2004_DISC_dual_DS.pdf
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class SchererScottDualQueue {
+
+private:
+    struct Node {
+        std::atomic<T*> item;
+        std::atomic<Node*> next;
+        const bool isData;
+        const int waiter;       // tid of the thread that inserted the node
+
+        Node(T* userItem, bool isData, int tid) : item{userItem}, next{nullptr}, isData{isData}, waiter{tid} { }
+
+        bool casNext(Node *cmp, Node *val) {
+            return next.compare_exchange_strong(cmp, val);
+        }
+    };
+
+    struct Parker {
+        alignas(128) std::atomic<bool> parked { false };
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    bool casTail(Node *cmp, Node *val) {
+        return tail.compare_exchange_strong(cmp, val);
+    }
+
+    bool casHead(Node *cmp, Node *val) {
+        return head.compare_exchange_strong(cmp, val);
+    }
+
+    // Pointers to head and tail of the list
+    alignas(128) std::atomic<Node*> head;
+    alignas(128) std::atomic<Node*> tail;
+
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    const int maxSpins;
+    Parker* parkers;
+
+    // We need four hazard pointers, the last one is for the node we wait on
+    HazardPointers<Node> hp {4, maxThreads};
+    const int kHpTail = 0;
+    const int kHpHead = 1;
+    const int kHpNext = 2;
+    const int kHpNode = 3;
+
+
+    // Spins and then parks until the item of s is no longer e. Returns the new item.
+    T* awaitMatch(Node* s, T* e, const int tid) {
+        for (int i = 0; i < maxSpins; i++) {
+            T* x = s->item.load();
+            if (x != e) return x;
+        }
+        Parker& p = parkers[tid];
+        std::unique_lock<std::mutex> lock(p.mtx);
+        p.parked.store(true);
+        while (s->item.load() == e) p.cv.wait(lock);
+        p.parked.store(false);
+        return s->item.load();
+    }
+
+
+    void wake(Node* m) {
+        Parker& p = parkers[m->waiter];
+        if (!p.parked.load()) return;
+        std::lock_guard<std::mutex> lock(p.mtx);
+        p.cv.notify_one();
+    }
+
+
+    /*
+     * Puts (isData) or takes (!isData) an item. If there is nothing to match,
+     * appends a node and, if 'wait' is true, waits for it to be matched.
+     * A poll() has nothing to append, so it returns nullptr instead.
+     * Returns the taken item, or the given item for producers.
+     */
+    T* xfer(T* e, const bool isData, const bool wait, const int tid) {
+        Node* s = nullptr;
+        while (true) {
+            Node* t = hp.protect(kHpTail, tail, tid);
+            Node* h = hp.protect(kHpHead, head, tid);
+            if (h == t || t->isData == isData) {
+                // Empty or same mode, append a node
+                Node* tn = t->next.load();
+                if (t != tail.load()) continue;
+                if (tn != nullptr) {
+                    casTail(t, tn);
+                    continue;
+                }
+                if (!isData && !wait) {
+                    hp.clear(tid);
+                    delete s;
+                    return nullptr;
+                }
+                if (s == nullptr) {
+                    s = new Node(e, isData, tid);
+                    hp.protectPtr(kHpNode, s, tid); // Before it's reachable, it can't have been retired
+                }
+                if (!t->casNext(nullptr, s)) continue;
+                casTail(t, s);
+                if (!wait) {
+                    hp.clear(tid);
+                    return e;
+                }
+                T* x = awaitMatch(s, e, tid);
+                // The matcher may have not moved the head yet, help it
+                if (head.load() == t && casHead(t, s)) hp.retire(t, tid);
+                hp.clear(tid);
+                return isData ? e : x;
+            } else {
+                // Complementary mode, match the oldest node
+                Node* m = hp.protect(kHpNext, h->next, tid);
+                if (t != tail.load() || m == nullptr || h != head.load()) continue;
+                T* x = m->item.load();
+                if (isData == (x != nullptr) || !m->item.compare_exchange_strong(x, isData ? e : nullptr)) {
+                    // Already matched by someone else, move the head forward and retry
+                    if (casHead(h, m)) hp.retire(h, tid);
+                    continue;
+                }
+                if (casHead(h, m)) hp.retire(h, tid);
+                wake(m);
+                hp.clear(tid);
+                delete s;  // Allocated but never inserted, if the mode changed
+                return isData ? e : x;
+            }
+        }
+    }
+
+
+public:
+    SchererScottDualQueue(int maxThreads=MAX_THREADS) : maxThreads{maxThreads},
+        maxSpins{std::thread::hardware_concurrency() > 1 ? 512 : 0} { // Don't spin on a single core
+        parkers = new Parker[maxThreads];
+        Node* sentinelNode = new Node(nullptr, true, 0);
+        head.store(sentinelNode, std::memory_order_relaxed);
+        tail.store(sentinelNode, std::memory_order_relaxed);
+    }
+
+
+    ~SchererScottDualQueue() {
+        // The items belong to the user, delete only the nodes
+        Node* node = head.load();
+        while (node != nullptr) {
+            Node* next = node->next.load();
+            delete node;
+            node = next;
+        }
+        delete[] parkers;
+    }
+
+    std::string className() { return "SchererScottDualQueue"; }
+
+
+    /*
+     * Hands item to a waiting consumer, or if there is none, enqueues it and
+     * waits until a consumer takes it.
+     */
+    void transfer(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        xfer(item, true, true, tid);
+    }
+
+
+    /*
+     * Hands item to a waiting consumer, or if there is none, enqueues it.
+     */
+    void offer(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        xfer(item, true, false, tid);
+    }
+
+    inline void enqueue(T* item, const int tid) { offer(item, tid); }
+
+
+    /*
+     * Takes the oldest item, or if there is none, waits for a producer.
+     */
+    T* take(const int tid) {
+        return xfer(nullptr, false, true, tid);
+    }
+
+
+    /*
+     * Takes the oldest item, or returns nullptr if there is none.
+     */
+    T* poll(const int tid) {
+        return xfer(nullptr, false, false, tid);
+    }
+
+    inline T* dequeue(const int tid) { return poll(tid); }
+};
+
+#endif /* _SCHERER_SCOTT_DUAL_QUEUE_HP_H_ */
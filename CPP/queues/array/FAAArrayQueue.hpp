@@ -32,6 +32,7 @@
 #include <atomic>
 #include <stdexcept>
 #include "HazardPointers.hpp"
+#include "USDTProbes.hpp"
 
 
 /**
@@ -154,10 +155,12 @@ public:
                 if (lnext == nullptr) {
                     Node* newNode = new Node(item);
                     if (ltail->casNext(nullptr, newNode)) {
+                        CF_PROBE2(faaq_segment_alloc, this, tid);
                         casTail(ltail, newNode);
                         hp.clear(tid);
                         return;
                     }
+                    CF_PROBE2(faaq_segment_discard, this, tid);
                     delete newNode;
                 } else {
                     casTail(ltail, lnext);
@@ -0,0 +1,198 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _FAA_ARRAY_QUEUE_RELAXED_HP_H_
+#define _FAA_ARRAY_QUEUE_RELAXED_HP_H_
+
+#include <atomic>
+#include <stdexcept>
+#include "HazardPointers.hpp"
+
+
+/**
+ * <h1> Fetch-And-Add Array Queue (relaxed atomics) </h1>
+ *
+ * Same algorithm as FAAArrayQueue.hpp but where each atomic access uses the
+ * weakest memory order that keeps the queue correct, with the justification
+ * next to each one. What remains seq_cst is the hazard pointer publication
+ * and validation (inside HazardPointers) and the CAS on head that unlinks a
+ * node before retiring it, because these two form a store-load pattern.
+ *
+ * The indexes enqidx and deqidx only hand out unique entries of items[], the
+ * item itself is published by the release CAS on items[idx] and consumed by
+ * the acquire exchange, so all accesses to the indexes are relaxed.
+ * Reading a stale index can only make dequeue() see an empty node, which is
+ * fine for the same reason as in the original: by coherence, an index can't
+ * be older than one written by an operation that happens-before this one.
+ *
+ * Enqueue algorithm: FAA + CAS(null,item)
+ * Dequeue algorithm: FAA + CAS(item,taken)
+ * Consistency: Linearizable
+ * enqueue() progress: lock-free
+ * dequeue() progress: lock-free
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ * Uncontended enqueue: 1 FAA + 1 CAS + 1 HP
+ * Uncontended dequeue: 1 FAA + 1 CAS + 1 HP
+ *
+ * http://concurrencyfreaks.com/2014/05/relaxed-atomics-optimizations-for.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class FAAArrayQueueRelaxed {
+    static const long BUFFER_SIZE = 1024;  // 1024
+
+private:
+    struct Node {
+        std::atomic<int>   deqidx;
+        std::atomic<T*>    items[BUFFER_SIZE];
+        std::atomic<int>   enqidx;
+        std::atomic<Node*> next;
+
+        // Start with the first entry pre-filled and enqidx at 1
+        Node(T* item) : deqidx{0}, enqidx{1}, next{nullptr} {
+            items[0].store(item, std::memory_order_relaxed);
+            for (long i = 1; i < BUFFER_SIZE; i++) {
+                items[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // release: publishes the node, including the pre-filled items[0]
+        bool casNext(Node *cmp, Node *val) {
+            return next.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+        }
+    };
+
+    // release: whoever loads the tail will dereference it
+    bool casTail(Node *cmp, Node *val) {
+        return tail.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // seq_cst: unlinks the node that is retired next, must not be re-ordered
+    // with the loads of the hazard pointers in retire()
+    bool casHead(Node *cmp, Node *val) {
+        return head.compare_exchange_strong(cmp, val);
+    }
+
+    // Pointers to head and tail of the list
+    alignas(128) std::atomic<Node*> head;
+    alignas(128) std::atomic<Node*> tail;
+
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+
+    T* taken = (T*)new int();  // Muuuahahah !
+
+    // We need just one hazard pointer
+    HazardPointers<Node> hp {1, maxThreads};
+    const int kHpTail = 0;
+    const int kHpHead = 0;
+
+public:
+    FAAArrayQueueRelaxed(int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        Node* sentinelNode = new Node(nullptr);
+        sentinelNode->enqidx.store(0, std::memory_order_relaxed);
+        head.store(sentinelNode, std::memory_order_relaxed);
+        tail.store(sentinelNode, std::memory_order_relaxed);
+    }
+
+
+    ~FAAArrayQueueRelaxed() {
+        while (dequeue(0) != nullptr); // Drain the queue
+        delete head.load();            // Delete the last node
+        delete (int*)taken;
+    }
+
+
+    std::string className() { return "FAAArrayQueueRelaxed"; }
+
+
+    void enqueue(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        while (true) {
+            Node* ltail = hp.protect(kHpTail, tail, tid);
+            // relaxed: only hands out a unique index, and it can't move above
+            // the seq_cst (acquire) loads in protect()
+            const int idx = ltail->enqidx.fetch_add(1, std::memory_order_relaxed);
+            if (idx > BUFFER_SIZE-1) { // This node is full
+                // relaxed: just a hint, ltail is already protected
+                if (ltail != tail.load(std::memory_order_relaxed)) continue;
+                // acquire: we may advance tail to lnext and others will dereference it
+                Node* lnext = ltail->next.load(std::memory_order_acquire);
+                if (lnext == nullptr) {
+                    Node* newNode = new Node(item);
+                    if (ltail->casNext(nullptr, newNode)) {
+                        casTail(ltail, newNode);
+                        hp.clear(tid);
+                        return;
+                    }
+                    delete newNode;
+                } else {
+                    casTail(ltail, lnext);
+                }
+                continue;
+            }
+            T* itemnull = nullptr;
+            // release: publishes the contents of item to the dequeuer.
+            // relaxed on failure: a dequeuer took this entry, try another one
+            if (ltail->items[idx].compare_exchange_strong(itemnull, item, std::memory_order_release, std::memory_order_relaxed)) {
+                hp.clear(tid);
+                return;
+            }
+        }
+    }
+
+
+    T* dequeue(const int tid) {
+        while (true) {
+            Node* lhead = hp.protect(kHpHead, head, tid);
+            // relaxed: these three are only used to detect an empty queue, see comment at the top
+            if (lhead->deqidx.load(std::memory_order_relaxed) >= lhead->enqidx.load(std::memory_order_relaxed) &&
+                lhead->next.load(std::memory_order_relaxed) == nullptr) break;
+            // relaxed: only hands out a unique index
+            const int idx = lhead->deqidx.fetch_add(1, std::memory_order_relaxed);
+            if (idx > BUFFER_SIZE-1) { // This node has been drained, check if there is another one
+                // acquire: we advance head to lnext and others will dereference it
+                Node* lnext = lhead->next.load(std::memory_order_acquire);
+                if (lnext == nullptr) break;  // No more nodes in the queue
+                if (casHead(lhead, lnext)) hp.retire(lhead, tid);
+                continue;
+            }
+            // acquire: pairs with the release CAS in enqueue(), to see the contents of item
+            T* item = lhead->items[idx].exchange(taken, std::memory_order_acquire);
+            if (item == nullptr) continue;
+            hp.clear(tid);
+            return item;
+        }
+        hp.clear(tid);
+        return nullptr;
+    }
+};
+
+#endif /* _FAA_ARRAY_QUEUE_RELAXED_HP_H_ */
@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LINEAR_ARRAY_QUEUE_RELAXED_HP_H_
+#define _LINEAR_ARRAY_QUEUE_RELAXED_HP_H_
+
+#include <atomic>
+#include <stdexcept>
+#include "HazardPointers.hpp"
+
+
+/**
+ * <h1> Linear Array Queue (relaxed atomics) </h1>
+ *
+ * Same algorithm as LinearArrayQueue.hpp but where each atomic access uses
+ * the weakest memory order that keeps the queue correct, with the
+ * justification next to each one. What remains seq_cst is the hazard pointer
+ * publication and validation (inside HazardPointers) and the CAS on head that
+ * unlinks a node before retiring it, because these two form a store-load pattern.
+ *
+ * The loads done while searching items[] are relaxed because they are only a
+ * hint of where to do the CAS, and the CAS always sees the latest value.
+ *
+ * Enqueue algorithm: Linear array search with CAS(nullptr,item)
+ * Dequeue algorithm: Linear array search with CAS(item,taken)
+ * Consistency: Linearizable
+ * enqueue() progress: lock-free
+ * dequeue() progress: lock-free
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ * Uncontended enqueue: 1 CAS + 1 HP
+ * Uncontended dequeue: 1 CAS + 1 HP
+ *
+ * http://concurrencyfreaks.com/2014/05/relaxed-atomics-optimizations-for.html
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename T>
+class LinearArrayQueueRelaxed {
+    static const long BUFFER_SIZE = 1024;
+
+private:
+    struct Node {
+        std::atomic<T*>    items[BUFFER_SIZE];
+        std::atomic<Node*> next;
+
+        Node(T* item) : next{nullptr} {
+            items[0].store(item, std::memory_order_relaxed);
+            for (long i = 1; i < BUFFER_SIZE; i++) {
+                items[i].store(nullptr, std::memory_order_relaxed);
+            }
+        }
+
+        // release: publishes the node, including the pre-filled items[0]
+        bool casNext(Node *cmp, Node *val) {
+            return next.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+        }
+    };
+
+    // release: whoever loads the tail will dereference it
+    bool casTail(Node *cmp, Node *val) {
+        return tail.compare_exchange_strong(cmp, val, std::memory_order_release, std::memory_order_relaxed);
+    }
+
+    // seq_cst: unlinks the node that is retired next, must not be re-ordered
+    // with the loads of the hazard pointers in retire()
+    bool casHead(Node *cmp, Node *val) {
+        return head.compare_exchange_strong(cmp, val);
+    }
+
+    // Pointers to head and tail of the list
+    alignas(128) std::atomic<Node*> head;
+    alignas(128) std::atomic<Node*> tail;
+
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+
+    T* taken = (T*)new int();  // Muuuahahah !
+
+    // We need just one hazard pointer
+    HazardPointers<Node> hp {1, maxThreads};
+    const int kHpTail = 0;
+    const int kHpHead = 0;
+
+public:
+    LinearArrayQueueRelaxed(int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        Node* sentinelNode = new Node(nullptr);
+        head.store(sentinelNode, std::memory_order_relaxed);
+        tail.store(sentinelNode, std::memory_order_relaxed);
+    }
+
+
+    ~LinearArrayQueueRelaxed() {
+        while (dequeue(0) != nullptr); // Drain the queue
+        delete head.load();            // Delete the last node
+        delete (int*)taken;
+    }
+
+
+    std::string className() { return "LinearArrayQueueRelaxed"; }
+
+
+    void enqueue(T* item, const int tid) {
+        if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
+        while (true) {
+            Node* ltail = hp.protect(kHpTail, tail, tid);
+            // relaxed: a hint, if it is stale then all the CAS in the loop below will fail
+            if (ltail->items[BUFFER_SIZE-1].load(std::memory_order_relaxed) != nullptr) { // This node is full
+                // relaxed: just a hint, ltail is already protected
+                if (ltail != tail.load(std::memory_order_relaxed)) continue;
+                // acquire: we may advance tail to lnext and others will dereference it
+                Node* lnext = ltail->next.load(std::memory_order_acquire);
+                if (lnext == nullptr) {
+                    Node* newNode = new Node(item);
+                    if (ltail->casNext(nullptr, newNode)) {
+                        casTail(ltail, newNode);
+                        hp.clear(tid);
+                        return;
+                    }
+                    delete newNode;
+                } else {
+                    casTail(ltail, lnext);
+                }
+                continue;
+            }
+            // Find the first null entry in items[] and try to CAS from null to item
+            for (long i = 0; i < BUFFER_SIZE; i++) {
+                // relaxed: only a hint of where to do the CAS
+                if (ltail->items[i].load(std::memory_order_relaxed) != nullptr) continue;
+                T* itemnull = nullptr;
+                // release: publishes the contents of item to the dequeuer
+                if (ltail->items[i].compare_exchange_strong(itemnull, item, std::memory_order_release, std::memory_order_relaxed)) {
+                    hp.clear(tid);
+                    return;
+                }
+                // relaxed: just a hint to go back and re-read the tail
+                if (ltail != tail.load(std::memory_order_relaxed)) break;
+            }
+        }
+    }
+
+
+    T* dequeue(const int tid) {
+        while (true) {
+            Node* lhead = hp.protect(kHpHead, head, tid);
+            // relaxed: if it is stale we will scan the node and find out it is drained
+            if (lhead->items[BUFFER_SIZE-1].load(std::memory_order_relaxed) == taken) { // This node has been drained, check if there is another one
+                // acquire: we advance head to lnext and others will dereference it
+                Node* lnext = lhead->next.load(std::memory_order_acquire);
+                if (lnext == nullptr) { // No more nodes in the queue
+                    hp.clear(tid);
+                    return nullptr;
+                }
+                if (casHead(lhead, lnext)) hp.retire(lhead, tid);
+                continue;
+            }
+            // Find the first non taken entry in items[] and try to CAS from item to taken
+            for (long i = 0; i < BUFFER_SIZE; i++) {
+                // relaxed: the item is only dereferenced after the acquire CAS
+                // below, and by coherence this load can't miss an item whose
+                // enqueue() happens-before this dequeue()
+                T* item = lhead->items[i].load(std::memory_order_relaxed);
+                if (item == nullptr) {
+                    hp.clear(tid);
+                    return nullptr;            // This node is empty
+                }
+                if (item == taken) continue;
+                // acquire: pairs with the release CAS in enqueue(), to see the contents of item
+                if (lhead->items[i].compare_exchange_strong(item, taken, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    hp.clear(tid);
+                    return item;
+                }
+                // relaxed: just a hint to go back and re-read the head
+                if (lhead != head.load(std::memory_order_relaxed)) break;
+            }
+        }
+    }
+};
+
+#endif /* _LINEAR_ARRAY_QUEUE_RELAXED_HP_H_ */
@@ -0,0 +1,18 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Jun 26, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkDeque.hpp"
+#include "BenchmarkRelaxedQueues.hpp"
+
+
+
+int main(void) {
+    BenchmarkDeque::allThroughputTests();
+    BenchmarkRelaxedQueues::allThroughputTests();
+    return 0;
+}
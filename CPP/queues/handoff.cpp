@@ -0,0 +1,16 @@
+/*
+ * handoff.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkHandoff.hpp"
+
+
+
+int main(void) {
+    BenchmarkHandoff::allLatencyTests();
+    return 0;
+}
@@ -0,0 +1,15 @@
+/*
+ * stress.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "QueueStress.hpp"
+
+
+
+int main(void) {
+    return (QueueStress::allStressTests() == 0) ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_SNAPSHOTS_H_
+#define _BENCHMARK_SNAPSHOTS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+#include "TripleBuffer.hpp"
+#include "LeftRightClassic.h"
+#include "LeftRightClassicLambda.h"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * A snapshot of SIZE bytes. The writer sets all the words to the same
+ * sequence number, so a reader can tell if it got a torn copy.
+ */
+template<int SIZE>
+struct Snapshot {
+    static const int NUM_WORDS = SIZE/sizeof(uint64_t);
+    uint64_t words[NUM_WORDS];
+
+    void fill(const uint64_t seq) {
+        for (int i = 0; i < NUM_WORDS; i++) words[i] = seq;
+    }
+
+    bool isConsistent() const {
+        return words[0] == words[NUM_WORDS/2] && words[0] == words[NUM_WORDS-1];
+    }
+};
+
+
+/**
+ * A sequence lock, where the protected words are relaxed atomics so that the
+ * racy copy done by the readers is allowed by the C++ memory model, as
+ * described in "Can Seqlocks Get Along With Programming Language Memory
+ * Models?" by Hans Boehm.
+ * Readers retry if a write started or finished while they were copying.
+ *
+ * read()  - Lock-Free (readers can starve if the writer keeps writing)
+ * write() - Wait-Free Population Oblivious, single writer
+ */
+template<int SIZE>
+class SeqLock {
+    static const int NUM_WORDS = SIZE/sizeof(uint64_t);
+    alignas(128) std::atomic<uint64_t> seq { 0 };
+    alignas(128) std::atomic<uint64_t> words[NUM_WORDS];
+
+public:
+    SeqLock() {
+        for (int i = 0; i < NUM_WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+    }
+
+    void write(const Snapshot<SIZE>& value) {
+        const uint64_t lseq = seq.load(std::memory_order_relaxed);
+        seq.store(lseq+1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int i = 0; i < NUM_WORDS; i++) words[i].store(value.words[i], std::memory_order_relaxed);
+        seq.store(lseq+2, std::memory_order_release);
+    }
+
+    // Returns the number of retries
+    long read(Snapshot<SIZE>& value) {
+        long retries = 0;
+        while (true) {
+            const uint64_t seq1 = seq.load(std::memory_order_acquire);
+            if ((seq1 & 1) == 0) {
+                for (int i = 0; i < NUM_WORDS; i++) value.words[i] = words[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq.load(std::memory_order_relaxed) == seq1) return retries;
+            }
+            retries++;
+        }
+    }
+};
+
+
+/*
+ * Adapters with the same interface for all the classes we want to test:
+ *   className()
+ *   write(seq)               - only one writer thread
+ *   read(snapshot, tid)      - returns the number of retries
+ */
+template<int SIZE>
+class TripleBufferAdapter {
+    TripleBuffer<Snapshot<SIZE>> tb;
+public:
+    TripleBufferAdapter(const int maxThreads) : tb{maxThreads} { }
+    static std::string className() { return "TripleBuffer"; }
+    void write(const uint64_t seq) {
+        tb.beginWrite()->fill(seq);
+        tb.publish();
+    }
+    long read(Snapshot<SIZE>& value, const int tid) {
+        tb.read(value, tid);
+        return 0;
+    }
+};
+
+// The writer has to fill both instances
+template<int SIZE>
+class LeftRightClassicAdapter {
+    LeftRight::LeftRightClassicLambda<Snapshot<SIZE>> lr;
+public:
+    LeftRightClassicAdapter(const int maxThreads) { }
+    static std::string className() { return "LeftRightClassic"; }
+    void write(uint64_t seq) {
+        std::function<bool(Snapshot<SIZE>*,uint64_t)> writeFunc = [] (Snapshot<SIZE>* s, uint64_t lseq) { s->fill(lseq); return true; };
+        lr.applyMutation(seq, writeFunc);
+    }
+    long read(Snapshot<SIZE>& value, const int tid) {
+        std::function<bool(Snapshot<SIZE>*,Snapshot<SIZE>*)> readFunc = [] (Snapshot<SIZE>* s, Snapshot<SIZE>* out) { *out = *s; return true; };
+        Snapshot<SIZE>* out = &value;
+        lr.applyRead(out, readFunc);
+        return 0;
+    }
+};
+
+// The writer fills a local snapshot and then copies it into the seqlock
+template<int SIZE>
+class SeqLockAdapter {
+    SeqLock<SIZE> sl;
+    Snapshot<SIZE> local;
+public:
+    SeqLockAdapter(const int maxThreads) { }
+    static std::string className() { return "SeqLock"; }
+    void write(const uint64_t seq) {
+        local.fill(seq);
+        sl.write(local);
+    }
+    long read(Snapshot<SIZE>& value, const int tid) {
+        return sl.read(value);
+    }
+};
+
+
+/**
+ * Latest-value snapshot benchmark.
+ *
+ * One writer publishes snapshots of SIZE bytes back-to-back while the
+ * readers copy the latest snapshot and check that it is not torn.
+ * We measure the reads and writes per second, and for the seqlock, how many
+ * times the readers had to retry.
+ */
+class BenchmarkSnapshots {
+
+public:
+    struct Result {
+        long long readsPerSec {0};
+        long long writesPerSec {0};
+        double retriesPerRead {0};
+
+        bool operator < (const Result& other) const {
+            return readsPerSec < other.readsPerSec;
+        }
+    };
+
+private:
+    const int numReaders;
+
+public:
+    BenchmarkSnapshots(const int numReaders) : numReaders{numReaders} { }
+
+
+    /**
+     * Returns the result of the median run (by reads per second)
+     */
+    template<typename A, int SIZE>
+    Result benchmark(const seconds testLengthSeconds, const int numRuns) {
+        const int numThreads = numReaders+1;
+        vector<Result> results(numRuns);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        atomic<long> numErrors = { 0 };
+        long long ops[numThreads];
+        long retries[numThreads];
+        A* adapter = nullptr;
+
+        auto writer_lambda = [&quit,&startFlag,&adapter](long long *ops) {
+            uint64_t seq = 0;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) adapter->write(++seq);
+            *ops = seq;
+        };
+
+        auto reader_lambda = [&quit,&startFlag,&numErrors,&adapter](long long *ops, long* retries, const int tid) {
+            long long numOps = 0;
+            long numRetries = 0;
+            Snapshot<SIZE>* value = new Snapshot<SIZE>();
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                numRetries += adapter->read(*value, tid);
+                if (!value->isConsistent()) numErrors.fetch_add(1);
+                numOps++;
+            }
+            delete value;
+            *ops = numOps;
+            *retries = numRetries;
+        };
+
+        cout << "##### " << A::className() << "   size=" << SIZE << " bytes #####\n";
+        for (int irun = 0; irun < numRuns; irun++) {
+            adapter = new A(numThreads);
+            thread workerThreads[numThreads];
+            workerThreads[0] = thread(writer_lambda, &ops[0]);
+            for (int tid = 1; tid < numThreads; tid++) workerThreads[tid] = thread(reader_lambda, &ops[tid], &retries[tid], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) workerThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            delete adapter;
+            // Accounting
+            long long totalReads = 0;
+            long totalRetries = 0;
+            for (int tid = 1; tid < numThreads; tid++) {
+                totalReads += ops[tid];
+                totalRetries += retries[tid];
+            }
+            results[irun].readsPerSec = totalReads/testLengthSeconds.count();
+            results[irun].writesPerSec = ops[0]/testLengthSeconds.count();
+            results[irun].retriesPerRead = (totalReads == 0) ? 0 : (double)totalRetries/totalReads;
+        }
+        if (numErrors.load() != 0) cout << "ERROR: readers saw a torn snapshot " << numErrors.load() << " times\n";
+
+        // Compute the median. numRuns should be an odd number
+        sort(results.begin(), results.end());
+        Result median = results[numRuns/2];
+        cout << "Reads/sec = " << median.readsPerSec << "   Writes/sec = " << median.writesPerSec << "   Retries/read = " << median.retriesPerRead << "\n";
+        return median;
+    }
+
+
+    template<int SIZE>
+    void allClasses(vector<string>& names, vector<Result>& results, const seconds testLength, const int numRuns) {
+        const string size = to_string(SIZE/1024) + "KB";
+        names.push_back(TripleBufferAdapter<SIZE>::className() + ", " + size);
+        results.push_back(benchmark<TripleBufferAdapter<SIZE>,SIZE>(testLength, numRuns));
+        names.push_back(LeftRightClassicAdapter<SIZE>::className() + ", " + size);
+        results.push_back(benchmark<LeftRightClassicAdapter<SIZE>,SIZE>(testLength, numRuns));
+        names.push_back(SeqLockAdapter<SIZE>::className() + ", " + size);
+        results.push_back(benchmark<SeqLockAdapter<SIZE>,SIZE>(testLength, numRuns));
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> readersList = { 1, 2, 4, 8, 16, 32 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+
+        for (int nReaders : readersList) {
+            BenchmarkSnapshots bench(nReaders);
+            vector<string> names;
+            vector<Result> results;
+            std::cout << "\n----- Snapshots Benchmark   numReaders=" << nReaders << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            bench.allClasses<4*1024>(names, results, testLength, numRuns);
+            bench.allClasses<64*1024>(names, results, testLength, numRuns);
+
+            // Show results in csv format
+            cout << "\n\nResults for numReaders=" << nReaders << ",  numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Class, Size, Reads/sec, Writes/sec, Retries/read\n";
+            for (unsigned i = 0; i < names.size(); i++) {
+                cout << names[i] << ", " << results[i].readsPerSec << ", " << results[i].writesPerSec << ", " << results[i].retriesPerRead << "\n";
+            }
+        }
+    }
+};
+
+#endif
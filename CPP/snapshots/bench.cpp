@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkSnapshots.hpp"
+
+
+
+int main(void) {
+    BenchmarkSnapshots::allThroughputTests();
+    return 0;
+}
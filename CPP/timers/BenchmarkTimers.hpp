@@ -0,0 +1,290 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_TIMERS_H_
+#define _BENCHMARK_TIMERS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <iostream>
+#include "TimerWheel.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * The usual way of doing timers: a std::multimap ordered by expiration time,
+ * protected by a std::mutex, plus a hash map from timer id to the entry so
+ * that cancel() doesn't need to search. A single thread fires the timers.
+ * Same API as TimerWheel.
+ */
+class MutexTimerMultimap {
+
+private:
+    struct Entry {
+        TimerCallback func;
+        void*         arg;
+        uint64_t      id;
+    };
+    std::mutex mtx;
+    std::multimap<steady_clock::time_point,Entry> timers;
+    std::unordered_map<uint64_t,std::multimap<steady_clock::time_point,Entry>::iterator> byId;
+    uint64_t nextId { 0 };
+    const nanoseconds tickDuration;
+    std::atomic<uint64_t> numFired { 0 };
+    std::atomic<bool> quit { false };
+    std::thread th;
+
+    void ownerLoop() {
+        vector<Entry> batch;
+        while (!quit.load()) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                const auto now = steady_clock::now();
+                auto it = timers.begin();
+                while (it != timers.end() && it->first <= now) {
+                    batch.push_back(it->second);
+                    byId.erase(it->second.id);
+                    it = timers.erase(it);
+                }
+            }
+            for (auto& e : batch) e.func(e.arg);
+            numFired.store(numFired.load(std::memory_order_relaxed)+batch.size(), std::memory_order_relaxed);
+            batch.clear();
+            this_thread::sleep_for(tickDuration);
+        }
+    }
+
+public:
+    typedef uint64_t TimerHandle;
+
+    MutexTimerMultimap(const int maxThreads=0, const int numShards=1, const nanoseconds tickDuration=milliseconds(1))
+        : tickDuration{tickDuration} {
+        th = std::thread(&MutexTimerMultimap::ownerLoop, this);
+    }
+
+    ~MutexTimerMultimap() {
+        quit.store(true);
+        th.join();
+    }
+
+    static std::string className() { return "MutexTimerMultimap"; }
+
+    TimerHandle schedule(const int tid, const nanoseconds delay, TimerCallback func, void* arg) {
+        const auto expiry = steady_clock::now() + delay;
+        std::lock_guard<std::mutex> lock(mtx);
+        const uint64_t id = nextId++;
+        byId[id] = timers.insert(make_pair(expiry, Entry{func, arg, id}));
+        return id;
+    }
+
+    bool cancel(const int tid, const TimerHandle id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = byId.find(id);
+        if (it == byId.end()) return false;
+        timers.erase(it->second);
+        byId.erase(it);
+        return true;
+    }
+
+    uint64_t getNumFired() const { return numFired.load(std::memory_order_relaxed); }
+};
+
+
+/**
+ * Benchmarks for the timers, with two workloads:
+ * - Insert/Cancel: like connection timeouts, where nearly every timer is
+ *   cancelled before it expires. Each producer keeps a window of
+ *   WINDOW timers with a long delay, and for each new one it cancels the oldest;
+ * - Expiry: each producer keeps up to WINDOW timers in flight with a random
+ *   delay of 0 to 10 ms, and schedules a new one whenever one fires;
+ * The TimerWheel is tested with one shard, and with one shard per 8 producers.
+ */
+class BenchmarkTimers {
+
+private:
+    static const int WINDOW = 1024;
+    const int numThreads;
+
+    struct alignas(128) InFlight {
+        std::atomic<uint64_t> fired { 0 };
+    };
+
+    static void countFired(void* arg) {
+        std::atomic<uint64_t>* fired = (std::atomic<uint64_t>*)arg;
+        fired->store(fired->load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+    }
+
+    static void noop(void* arg) { }
+
+public:
+    enum TestCase { InsertCancel, Expiry };
+
+    BenchmarkTimers(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Returns the median of the number of operations per second, which are
+     * schedule()+cancel() pairs for InsertCancel and fired timers for Expiry.
+     */
+    template<typename W>
+    long long benchmark(const TestCase tc, const int numShards, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        long long fired[numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        W* wheel = nullptr;
+        InFlight* inFlight = nullptr;
+
+        auto cancel_lambda = [&quit,&startFlag,&wheel](long long *ops, const int tid) {
+            vector<typename W::TimerHandle> handles(WINDOW);
+            for (int i = 0; i < WINDOW; i++) handles[i] = wheel->schedule(tid, seconds(3600), noop, nullptr);
+            long long numOps = 0;
+            int idx = 0;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                if (!wheel->cancel(tid, handles[idx])) cout << "ERROR: could not cancel a pending timer\n";
+                handles[idx] = wheel->schedule(tid, seconds(3600), noop, nullptr);
+                idx = (idx+1) % WINDOW;
+                numOps++;
+            }
+            for (int i = 0; i < WINDOW; i++) wheel->cancel(tid, handles[i]);
+            *ops = numOps;
+        };
+
+        auto expiry_lambda = [&quit,&startFlag,&wheel,&inFlight](long long *ops, const int tid) {
+            long long numScheduled = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                if (numScheduled - (long long)inFlight[tid].fired.load(std::memory_order_relaxed) >= WINDOW) {
+                    this_thread::yield();
+                    continue;
+                }
+                seed = randomLong(seed);
+                wheel->schedule(tid, microseconds(seed % 10000), countFired, &inFlight[tid].fired);
+                numScheduled++;
+            }
+            *ops = numScheduled;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            wheel = new W(numThreads, numShards);
+            inFlight = new InFlight[numThreads];
+            if (irun == 0) cout << "##### " << W::className() << "  shards=" << numShards << "  " << (tc == InsertCancel ? "Insert/Cancel" : "Expiry") << " #####  \n";
+            thread runThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) {
+                if (tc == InsertCancel) runThreads[tid] = thread(cancel_lambda, &ops[tid][irun], tid);
+                else runThreads[tid] = thread(expiry_lambda, &ops[tid][irun], tid);
+            }
+            this_thread::sleep_for(milliseconds(100));  // Let the producers fill their windows
+            const uint64_t firedBefore = wheel->getNumFired();
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            fired[irun] = wheel->getNumFired() - firedBefore;
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            delete wheel;
+            delete[] inFlight;
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            if (tc == Expiry) {
+                agg[irun] = fired[irun];
+            } else {
+                for (int tid = 0; tid < numThreads; tid++) agg[irun] += ops[tid][irun];
+            }
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        cout << (tc == InsertCancel ? "schedule()+cancel()/sec = " : "fired/sec = ") << result << "\n";
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int NUM_CLASSES = 6;
+        long long ops[NUM_CLASSES][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            const int numShards = (nThreads+7)/8;
+            BenchmarkTimers bench(nThreads);
+            std::cout << "\n----- Timers Benchmark   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            ops[0][ithread] = bench.benchmark<TimerWheel>(InsertCancel, 1, testLength, numRuns);
+            ops[1][ithread] = bench.benchmark<TimerWheel>(InsertCancel, numShards, testLength, numRuns);
+            ops[2][ithread] = bench.benchmark<MutexTimerMultimap>(InsertCancel, 1, testLength, numRuns);
+            ops[3][ithread] = bench.benchmark<TimerWheel>(Expiry, 1, testLength, numRuns);
+            ops[4][ithread] = bench.benchmark<TimerWheel>(Expiry, numShards, testLength, numRuns);
+            ops[5][ithread] = bench.benchmark<MutexTimerMultimap>(Expiry, 1, testLength, numRuns);
+        }
+
+        // Show results in csv format
+        cout << "\n\nResults in operations per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Threads, TimerWheel-InsertCancel, TimerWheel-Sharded-InsertCancel, MutexTimerMultimap-InsertCancel, ";
+        cout << "TimerWheel-Expiry, TimerWheel-Sharded-Expiry, MutexTimerMultimap-Expiry\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            cout << threadList[ithread] << ", ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][ithread] << ", ";
+            cout << "\n";
+        }
+    }
+};
+
+#endif /* _BENCHMARK_TIMERS_H_ */
@@ -0,0 +1,434 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TIMER_WHEEL_H_
+#define _TIMER_WHEEL_H_
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstdint>
+
+
+/**
+ * <h1> Intrusive MPSC queue </h1>
+ *
+ * Dmitry Vyukov's intrusive MPSC queue, the same one used in C11/locks/mpsc_mutex.c
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/intrusive-mpsc-node-based-queue
+ * The link is the member Next of T, which lets the same node be in several
+ * queues at the same time, as long as each one uses a different member.
+ *
+ * push() - Wait-Free Population Oblivious (one exchange and one store)
+ * pop()  - Blocking, only one thread (the consumer) can call it. It returns
+ *          nullptr if a producer is between the exchange and the store of
+ *          push(), even if there are more nodes after it
+ */
+template<typename T, std::atomic<T*> T::*Next>
+class MPSCIntrusiveQueue {
+
+private:
+    alignas(128) std::atomic<T*> tail;
+    alignas(128) T* head;
+    T stub;
+
+public:
+    MPSCIntrusiveQueue() {
+        (stub.*Next).store(nullptr, std::memory_order_relaxed);
+        head = &stub;
+        tail.store(&stub);
+    }
+
+    inline void push(T* node) {
+        (node->*Next).store(nullptr, std::memory_order_relaxed);
+        T* prev = tail.exchange(node);
+        (prev->*Next).store(node, std::memory_order_release);
+    }
+
+    T* pop() {
+        T* lhead = head;
+        T* next = (lhead->*Next).load(std::memory_order_acquire);
+        if (lhead == &stub) {
+            if (next == nullptr) return nullptr;
+            head = next;
+            lhead = next;
+            next = (next->*Next).load(std::memory_order_acquire);
+        }
+        if (next != nullptr) {
+            head = next;
+            return lhead;
+        }
+        if (lhead != tail.load()) return nullptr;  // A producer is in the middle of push()
+        // lhead is the last node, put the stub behind it so that we can take it
+        push(&stub);
+        next = (lhead->*Next).load(std::memory_order_acquire);
+        if (next != nullptr) {
+            head = next;
+            return lhead;
+        }
+        return nullptr;
+    }
+};
+
+
+typedef void (*TimerCallback)(void* arg);
+
+
+/**
+ * <h1> Concurrent Hierarchical Timer Wheel </h1>
+ *
+ * A hierarchical timing wheel with 4 levels of 256 slots each, in the style of
+ * the (pre-4.8) Linux kernel timers: a timer that expires within 256 ticks
+ * goes into level 0, within 2^16 ticks into level 1, and so on, and every
+ * 256 ticks one slot of the level above is cascaded down. The maximum delay
+ * is 2^32-1 ticks, anything above that is clamped.
+ * Varghese and Lauck, "Hashed and Hierarchical Timing Wheels", SOSP 1987.
+ *
+ * The wheels are not shared: each shard has its own wheel and an owner thread
+ * which is the only one to touch it. Other threads hand their requests to the
+ * owner through two intrusive MPSC queues (inboxes), one for inserts and one
+ * for cancels, where the nodes are the timers themselves, so there are no
+ * allocations. Each producer thread (tid) sends its timers to shard
+ * tid % numShards.
+ *
+ * The timers are allocated in chunks by each producer thread and are never
+ * deleted until the destructor. When the owner is done with a timer it gives it
+ * back to the producer that allocated it, through another MPSC queue, which
+ * means that a producer reuses its own timers without any contention.
+ * Because the memory is never freed, a TimerHandle can be used after the timer
+ * has fired or was reused: the state of each timer has a generation counter
+ * and cancel() only succeeds if the generation matches and the timer is still
+ * pending. Whoever changes the state first, the owner (fired) or a call to
+ * cancel(), wins. The callback is never called for a timer whose cancel()
+ * returned true.
+ *
+ * The owner thread wakes up every tick, drains the inboxes, advances the
+ * wheel up to the current tick, and only then calls the callbacks of the
+ * expired timers, one batch per wake-up. The callbacks run on the owner
+ * thread, so they must be short. They may call schedule() and cancel().
+ *
+ * schedule() - Wait-Free (when the producer has free timers, otherwise it allocates a new chunk)
+ * cancel()   - Wait-Free Population Oblivious
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class TimerWheel {
+
+private:
+    static const int      MAX_THREADS = 128;
+    static const int      NUM_LEVELS = 4;
+    static const int      SLOT_BITS = 8;
+    static const int      NUM_SLOTS = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = NUM_SLOTS - 1;
+    static const uint64_t MAX_DELTA = (1ULL << (SLOT_BITS*NUM_LEVELS)) - 1;
+    static const int      TIMER_CHUNK = 1024;
+
+    // The two lowest bits of the state, the rest is the generation
+    static const uint64_t FREE = 0;
+    static const uint64_t PENDING = 1;
+    static const uint64_t FIRED = 2;
+    static const uint64_t CANCELLED = 3;
+
+public:
+    struct Timer {
+        std::atomic<uint64_t> state { FREE };
+        std::atomic<Timer*>   inboxNext { nullptr };     // Link for the insert inbox and for the return queue
+        std::atomic<Timer*>   cancelNext { nullptr };    // Link for the cancel inbox
+        // Everything below is written by the producer before push() and then only used by the owner
+        Timer*        prev { nullptr };        // Links in the slot of the wheel, also the free list of the producer
+        Timer*        next { nullptr };
+        Timer**       slotHead { nullptr };
+        uint64_t      expiry { 0 };            // In ticks
+        TimerCallback func { nullptr };
+        void*         arg { nullptr };
+        int           producerTid { 0 };
+        int           shard { 0 };
+        bool          linked { false };        // Is in a slot of the wheel
+        bool          insertSeen { false };    // The owner has taken it from the insert inbox
+        bool          cancelSeen { false };    // The owner has taken it from the cancel inbox
+    };
+
+    struct TimerHandle {
+        Timer*   timer;
+        uint64_t gen;
+    };
+
+private:
+    struct alignas(128) Shard {
+        MPSCIntrusiveQueue<Timer,&Timer::inboxNext>  inbox;
+        MPSCIntrusiveQueue<Timer,&Timer::cancelNext> cancels;
+        Timer*                slots[NUM_LEVELS][NUM_SLOTS];
+        uint64_t              curTick { 0 };   // The next tick to process
+        std::vector<Timer*>   batch;
+        std::atomic<uint64_t> numFired { 0 };
+        std::atomic<uint64_t> numCancelled { 0 };
+        std::thread           th;
+    };
+
+    struct alignas(128) Producer {
+        Timer*                 freeList { nullptr };
+        MPSCIntrusiveQueue<Timer,&Timer::inboxNext> returned;
+        std::vector<Timer*>    chunks;
+    };
+
+    const int  maxThreads;
+    const int  numShards;
+    const std::chrono::nanoseconds tickDuration;
+    const std::chrono::steady_clock::time_point startTime;
+    Shard*     shards;
+    Producer*  producers;
+    alignas(128) std::atomic<bool> quit { false };
+
+
+    inline uint64_t nowTicks() const {
+        return (std::chrono::steady_clock::now() - startTime) / tickDuration;
+    }
+
+    Timer* allocTimer(const int tid) {
+        Producer& p = producers[tid];
+        if (p.freeList == nullptr) {
+            Timer* t;
+            while ((t = p.returned.pop()) != nullptr) {
+                t->prev = p.freeList;
+                p.freeList = t;
+            }
+            if (p.freeList == nullptr) {
+                Timer* chunk = new Timer[TIMER_CHUNK];
+                p.chunks.push_back(chunk);
+                for (int i = 0; i < TIMER_CHUNK; i++) {
+                    chunk[i].producerTid = tid;
+                    chunk[i].prev = p.freeList;
+                    p.freeList = &chunk[i];
+                }
+            }
+        }
+        Timer* t = p.freeList;
+        p.freeList = t->prev;
+        return t;
+    }
+
+    // Owner only. Bumps the generation and gives the timer back to its producer
+    void releaseTimer(Timer* t) {
+        const uint64_t gen = t->state.load(std::memory_order_relaxed) >> 2;
+        t->state.store(((gen+1) << 2) | FREE, std::memory_order_relaxed);
+        producers[t->producerTid].returned.push(t);
+    }
+
+    // Owner only. Puts the timer in the slot of the level that matches its distance to curTick
+    void addToWheel(Shard& sh, Timer* t) {
+        uint64_t expiry = t->expiry;
+        if (expiry < sh.curTick) expiry = sh.curTick;
+        if (expiry - sh.curTick > MAX_DELTA) expiry = sh.curTick + MAX_DELTA;
+        t->expiry = expiry;
+        const uint64_t delta = expiry - sh.curTick;
+        int level = 0;
+        while (level < NUM_LEVELS-1 && delta >= (1ULL << (SLOT_BITS*(level+1)))) level++;
+        Timer** head = &sh.slots[level][(expiry >> (SLOT_BITS*level)) & SLOT_MASK];
+        t->slotHead = head;
+        t->prev = nullptr;
+        t->next = *head;
+        if (*head != nullptr) (*head)->prev = t;
+        *head = t;
+        t->linked = true;
+    }
+
+    // Owner only, O(1)
+    void unlink(Timer* t) {
+        if (t->prev != nullptr) t->prev->next = t->next; else *t->slotHead = t->next;
+        if (t->next != nullptr) t->next->prev = t->prev;
+        t->linked = false;
+    }
+
+    void drainInboxes(Shard& sh) {
+        Timer* t;
+        while ((t = sh.inbox.pop()) != nullptr) {
+            t->insertSeen = true;
+            if ((t->state.load() & 3) == CANCELLED) {
+                // Cancelled before we got to insert it
+                if (t->cancelSeen) {
+                    sh.numCancelled.store(sh.numCancelled.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                    releaseTimer(t);
+                }
+                continue;
+            }
+            addToWheel(sh, t);
+        }
+        while ((t = sh.cancels.pop()) != nullptr) {
+            t->cancelSeen = true;
+            if (t->linked) unlink(t);
+            // If the insert is still in the inbox, we release it when we take it from there
+            if (t->insertSeen) {
+                sh.numCancelled.store(sh.numCancelled.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                releaseTimer(t);
+            }
+        }
+    }
+
+    // Owner only. Cascades the higher levels if needed and moves the expired timers of curTick to the batch
+    void processTick(Shard& sh) {
+        const uint64_t tick = sh.curTick;
+        for (int level = 1; level < NUM_LEVELS; level++) {
+            if ((tick & ((1ULL << (SLOT_BITS*level)) - 1)) != 0) break;
+            Timer** head = &sh.slots[level][(tick >> (SLOT_BITS*level)) & SLOT_MASK];
+            Timer* t = *head;
+            *head = nullptr;
+            while (t != nullptr) {
+                Timer* next = t->next;
+                addToWheel(sh, t);
+                t = next;
+            }
+        }
+        Timer** head = &sh.slots[0][tick & SLOT_MASK];
+        Timer* t = *head;
+        *head = nullptr;
+        while (t != nullptr) {
+            Timer* next = t->next;
+            t->linked = false;
+            uint64_t state = t->state.load();
+            if ((state & 3) == PENDING && t->state.compare_exchange_strong(state, (state & ~3ULL) | FIRED)) {
+                sh.batch.push_back(t);
+            } else if (t->cancelSeen) {
+                // The cancel() won the race, and we already took it from the cancel inbox
+                sh.numCancelled.store(sh.numCancelled.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+                releaseTimer(t);
+            }
+            t = next;
+        }
+    }
+
+    void ownerLoop(const int ishard) {
+        Shard& sh = shards[ishard];
+        sh.curTick = nowTicks();
+        while (!quit.load()) {
+            drainInboxes(sh);
+            const uint64_t now = nowTicks();
+            while (sh.curTick <= now) {
+                processTick(sh);
+                sh.curTick++;
+            }
+            // Dispatch the callbacks of this batch
+            for (Timer* t : sh.batch) {
+                t->func(t->arg);
+                releaseTimer(t);
+            }
+            sh.numFired.store(sh.numFired.load(std::memory_order_relaxed)+sh.batch.size(), std::memory_order_relaxed);
+            sh.batch.clear();
+            std::this_thread::sleep_for(tickDuration);
+        }
+    }
+
+public:
+    TimerWheel(const int maxThreads=MAX_THREADS, const int numShards=1,
+               const std::chrono::nanoseconds tickDuration=std::chrono::milliseconds(1))
+        : maxThreads{maxThreads}, numShards{numShards}, tickDuration{tickDuration},
+          startTime{std::chrono::steady_clock::now()} {
+        if (maxThreads < 1 || maxThreads > MAX_THREADS) throw std::invalid_argument("maxThreads must be between 1 and 128");
+        if (numShards < 1 || numShards > maxThreads) throw std::invalid_argument("numShards must be between 1 and maxThreads");
+        if (tickDuration.count() <= 0) throw std::invalid_argument("tickDuration must be positive");
+        producers = new Producer[maxThreads];
+        shards = new Shard[numShards];
+        for (int is = 0; is < numShards; is++) {
+            for (int level = 0; level < NUM_LEVELS; level++) {
+                for (int islot = 0; islot < NUM_SLOTS; islot++) shards[is].slots[level][islot] = nullptr;
+            }
+        }
+        for (int is = 0; is < numShards; is++) shards[is].th = std::thread(&TimerWheel::ownerLoop, this, is);
+    }
+
+    // Timers that have not yet fired are dropped without calling their callbacks
+    ~TimerWheel() {
+        quit.store(true);
+        for (int is = 0; is < numShards; is++) shards[is].th.join();
+        for (int tid = 0; tid < maxThreads; tid++) {
+            for (Timer* chunk : producers[tid].chunks) delete[] chunk;
+        }
+        delete[] shards;
+        delete[] producers;
+    }
+
+    static std::string className() { return "TimerWheel"; }
+
+
+    /**
+     * Schedules func(arg) to be called on the owner thread of this tid's shard
+     * after delay, rounded up to the next tick boundary. It never fires early,
+     * but may fire up to one tick (plus the owner's wake-up latency) late.
+     */
+    TimerHandle schedule(const int tid, const std::chrono::nanoseconds delay, TimerCallback func, void* arg) {
+        Timer* t = allocTimer(tid);
+        const uint64_t gen = t->state.load(std::memory_order_relaxed) >> 2;
+        const uint64_t delayTicks = (delay.count() <= 0) ? 0 : (delay + tickDuration - std::chrono::nanoseconds(1)) / tickDuration;
+        // nowTicks() is rounded down, so we add one tick to never fire before the delay
+        t->expiry = nowTicks() + delayTicks + 1;
+        t->func = func;
+        t->arg = arg;
+        t->shard = tid % numShards;
+        t->linked = false;
+        t->insertSeen = false;
+        t->cancelSeen = false;
+        // Release: whoever acquires the PENDING state (cancel()) will see the fields above
+        t->state.store((gen << 2) | PENDING, std::memory_order_release);
+        shards[t->shard].inbox.push(t);
+        return TimerHandle{t, gen};
+    }
+
+
+    /**
+     * Cancels the timer. Returns true if it was still pending, in which case
+     * its callback will not be called, and false if it already fired (or its
+     * callback is about to be called) or was already cancelled.
+     * Can be called by any thread, tid is not used.
+     */
+    bool cancel(const int tid, const TimerHandle& handle) {
+        uint64_t expected = (handle.gen << 2) | PENDING;
+        if (!handle.timer->state.compare_exchange_strong(expected, (handle.gen << 2) | CANCELLED)) return false;
+        shards[handle.timer->shard].cancels.push(handle.timer);
+        return true;
+    }
+
+
+    // Number of callbacks called so far. Approximate while the wheel is running
+    uint64_t getNumFired() const {
+        uint64_t sum = 0;
+        for (int is = 0; is < numShards; is++) sum += shards[is].numFired.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Number of cancelled timers that were released by the owners so far
+    uint64_t getNumCancelled() const {
+        uint64_t sum = 0;
+        for (int is = 0; is < numShards; is++) sum += shards[is].numCancelled.load(std::memory_order_relaxed);
+        return sum;
+    }
+};
+
+#endif /* _TIMER_WHEEL_H_ */
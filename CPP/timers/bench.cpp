@@ -0,0 +1,16 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkTimers.hpp"
+
+
+
+int main(void) {
+    BenchmarkTimers::allThroughputTests();
+    return 0;
+}
@@ -0,0 +1,153 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TRACE_ADAPTERS_H_
+#define _TRACE_ADAPTERS_H_
+
+#include <cstdint>
+#include <string>
+#include "TraceFile.hpp"
+
+
+/*
+ * Adapters between the records of a trace and the data structures in this
+ * repository. Each adapter is constructed with (numThreads, keySpace) and has:
+ *   void prefill(numKeys)                           - called before the replay, single-threaded
+ *   bool apply(const TraceRecord& r, const int tid) - does the operation of the record
+ *   std::string className()
+ */
+
+
+/**
+ * For sets with the API add(T*,tid)/remove(T*,tid)/contains(T*,tid), like
+ * the ones in papers/hazarderas or the *Set wrappers of the universal constructs.
+ * Because these sets store pointers to the keys, there is one (immutable)
+ * uint64_t for each key of the trace.
+ */
+template<typename S>
+class SetAdapter {
+    S set;
+    const uint64_t keySpace;
+    uint64_t* keys;
+
+public:
+    SetAdapter(const int numThreads, const uint64_t keySpace) : set{numThreads}, keySpace{keySpace} {
+        keys = new uint64_t[keySpace];
+        for (uint64_t i = 0; i < keySpace; i++) keys[i] = i;
+    }
+
+    ~SetAdapter() {
+        delete[] keys;
+    }
+
+    std::string className() { return set.className(); }
+
+    void prefill(const uint64_t numKeys) {
+        for (uint64_t i = 0; i < numKeys && i < keySpace; i++) set.add(&keys[i], 0);
+    }
+
+    inline bool apply(const TraceRecord& r, const int tid) {
+        uint64_t* key = &keys[r.key % keySpace];
+        switch (r.op) {
+        case TRACE_INSERT: return set.add(key, tid);
+        case TRACE_REMOVE: return set.remove(key, tid);
+        default:           return set.contains(key, tid);
+        }
+    }
+};
+
+
+/**
+ * For maps with uint64_t keys and values with the API of LFHashMap:
+ * insert(key,value,tid)/erase(key,tid)/find(key,value&,tid).
+ * The value that is inserted is the valueSize of the record.
+ */
+template<typename M>
+class MapAdapter {
+    M map;
+    const uint64_t keySpace;
+
+public:
+    MapAdapter(const int numThreads, const uint64_t keySpace) : map{numThreads}, keySpace{keySpace} { }
+
+    std::string className() { return map.className(); }
+
+    void prefill(const uint64_t numKeys) {
+        for (uint64_t i = 0; i < numKeys && i < keySpace; i++) map.insert(i, i, 0);
+    }
+
+    inline bool apply(const TraceRecord& r, const int tid) {
+        const uint64_t key = r.key % keySpace;
+        switch (r.op) {
+        case TRACE_INSERT: return map.insert(key, r.valueSize, tid);
+        case TRACE_REMOVE: return map.erase(key, tid);
+        default: {
+            uint64_t value;
+            return map.find(key, value, tid);
+        }
+        }
+    }
+};
+
+
+/**
+ * For queues and deques with the API enqueue(T*,tid)/dequeue(tid).
+ * Inserts are enqueues, and both removes and reads are dequeues.
+ */
+template<typename Q>
+class QueueAdapter {
+    Q queue;
+    const uint64_t keySpace;
+    uint64_t* keys;
+
+public:
+    QueueAdapter(const int numThreads, const uint64_t keySpace) : queue{numThreads}, keySpace{keySpace} {
+        keys = new uint64_t[keySpace];
+        for (uint64_t i = 0; i < keySpace; i++) keys[i] = i;
+    }
+
+    ~QueueAdapter() {
+        delete[] keys;
+    }
+
+    std::string className() { return queue.className(); }
+
+    void prefill(const uint64_t numKeys) {
+        for (uint64_t i = 0; i < numKeys && i < keySpace; i++) queue.enqueue(&keys[i], 0);
+    }
+
+    inline bool apply(const TraceRecord& r, const int tid) {
+        if (r.op == TRACE_INSERT) {
+            queue.enqueue(&keys[r.key % keySpace], tid);
+            return true;
+        }
+        return queue.dequeue(tid) != nullptr;
+    }
+};
+
+#endif /* _TRACE_ADAPTERS_H_ */
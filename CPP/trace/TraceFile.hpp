@@ -0,0 +1,175 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TRACE_FILE_H_
+#define _TRACE_FILE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+/*
+ * Binary trace format:
+ * - One TraceHeader of 64 bytes;
+ * - numRecords TraceRecord of 24 bytes each, sorted by timestamp;
+ * Everything is in the native byte order (little-endian on x86).
+ */
+enum TraceOp : uint8_t { TRACE_READ = 0, TRACE_INSERT = 1, TRACE_REMOVE = 2 };
+
+struct TraceRecord {
+    uint64_t timestamp;   // Nanoseconds since the start of the trace
+    uint64_t key;
+    uint32_t valueSize;
+    uint16_t thread;
+    uint8_t  op;          // One of TraceOp
+    uint8_t  pad;
+};
+
+struct TraceHeader {
+    char     magic[8];    // "CFTRACE1"
+    uint32_t version;
+    uint32_t numThreads;
+    uint64_t numRecords;
+    uint64_t keySpace;    // All keys are in [0, keySpace[
+    uint64_t reserved[4];
+};
+
+static_assert(sizeof(TraceRecord) == 24, "TraceRecord must be 24 bytes");
+static_assert(sizeof(TraceHeader) == 64, "TraceHeader must be 64 bytes");
+
+
+/**
+ * <h1> Trace File </h1>
+ *
+ * A read-only view of a trace file, mapped in memory with mmap() so that
+ * replaying a trace with hundreds of millions of records does not need to
+ * read it all into the heap first.
+ * Throws std::runtime_error if the file can not be opened or is not a valid
+ * trace, which includes a header with zero (or more than 128) threads or an
+ * empty key space.
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class TraceFile {
+
+private:
+    static constexpr const char* MAGIC = "CFTRACE1";
+    static const uint32_t VERSION = 1;
+    static const uint32_t MAX_THREADS = 128;  // Same as the data structures being replayed
+
+    int fd = -1;
+    size_t length = 0;
+    void* base = nullptr;
+    const TraceHeader* header = nullptr;
+    const TraceRecord* recs = nullptr;
+
+public:
+    TraceFile(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("can not open trace file " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TraceHeader)) {
+            ::close(fd);
+            throw std::runtime_error("trace file is too small " + path);
+        }
+        length = st.st_size;
+        base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("can not mmap trace file " + path);
+        }
+        header = (const TraceHeader*)base;
+        recs = (const TraceRecord*)((const char*)base + sizeof(TraceHeader));
+        if (std::memcmp(header->magic, MAGIC, 8) != 0 || header->version != VERSION ||
+            header->numRecords != (length - sizeof(TraceHeader))/sizeof(TraceRecord) ||
+            length != sizeof(TraceHeader) + header->numRecords*sizeof(TraceRecord)) {
+            munmap(base, length);
+            ::close(fd);
+            throw std::runtime_error("invalid trace file " + path);
+        }
+        // The replay does 'thread % numThreads' and the adapters do 'key % keySpace'
+        if (header->numThreads == 0 || header->numThreads > MAX_THREADS || header->keySpace == 0) {
+            const std::string msg = "invalid trace header in " + path + ": numThreads=" + std::to_string(header->numThreads) +
+                                    " keySpace=" + std::to_string(header->keySpace);
+            munmap(base, length);
+            ::close(fd);
+            throw std::runtime_error(msg);
+        }
+        madvise(base, length, MADV_SEQUENTIAL);
+    }
+
+    ~TraceFile() {
+        munmap(base, length);
+        ::close(fd);
+    }
+
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    uint64_t numRecords() const { return header->numRecords; }
+
+    int numThreads() const { return header->numThreads; }
+
+    uint64_t keySpace() const { return header->keySpace; }
+
+    const TraceRecord& operator[](const uint64_t i) const { return recs[i]; }
+
+
+    /**
+     * Writes a trace file with the given records, which must already be
+     * sorted by timestamp.
+     */
+    static void write(const std::string& path, const int numThreads, const uint64_t keySpace, const std::vector<TraceRecord>& records) {
+        if (numThreads <= 0 || numThreads > (int)MAX_THREADS) throw std::invalid_argument("numThreads must be between 1 and 128");
+        if (keySpace == 0) throw std::invalid_argument("keySpace must be positive");
+        TraceHeader h;
+        std::memset(&h, 0, sizeof(h));
+        std::memcpy(h.magic, MAGIC, 8);
+        h.version = VERSION;
+        h.numThreads = numThreads;
+        h.numRecords = records.size();
+        h.keySpace = keySpace;
+        FILE* f = std::fopen(path.c_str(), "wb");
+        if (f == nullptr) throw std::runtime_error("can not create trace file " + path);
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        if (ok && !records.empty()) ok = std::fwrite(records.data(), sizeof(TraceRecord), records.size(), f) == records.size();
+        if (std::fclose(f) != 0 || !ok) throw std::runtime_error("error writing trace file " + path);
+    }
+};
+
+#endif /* _TRACE_FILE_H_ */
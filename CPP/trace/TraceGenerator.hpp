@@ -0,0 +1,140 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TRACE_GENERATOR_H_
+#define _TRACE_GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "TraceFile.hpp"
+#include "ZipfGenerator.hpp"
+
+
+/**
+ * <h1> Trace Generator </h1>
+ *
+ * Makes synthetic traces that look more like production traffic than the
+ * uniform workloads of our micro-benchmarks:
+ * - Keys follow a Zipfian distribution, scrambled so that the popular keys
+ *   are not next to each other (like YCSB's scrambled Zipfian);
+ * - Each thread re-uses its previous key with probability repeatPercent;
+ * - The arrival rate has bursts: in the first burstDutyPercent of every
+ *   burstPeriodNs the rate is multiplied by burstFactor;
+ * Everything is deterministic for a given seed, so the same trace file can
+ * be re-generated on another machine and replayed against every implementation.
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class TraceGenerator {
+
+public:
+    struct Params {
+        uint64_t numRecords       = 2000000;
+        int      numThreads       = 8;
+        uint64_t keySpace         = 1000000;
+        double   theta            = 0.99;      // Zipfian skew, must be in ]0,1[
+        int      readPercent      = 90;        // Of the remaining, half are inserts and half are removes
+        int      repeatPercent    = 10;        // Probability of re-using the previous key of the same thread
+        uint64_t opsPerSecond     = 10000000;  // Aggregate arrival rate outside of the bursts
+        uint64_t burstPeriodNs    = 100000000; // 100 ms
+        int      burstDutyPercent = 10;
+        int      burstFactor      = 10;
+        uint32_t minValueSize     = 8;         // Value sizes are powers of two in [minValueSize, maxValueSize]
+        uint32_t maxValueSize     = 4096;
+        uint64_t seed             = 1234567890123456781ULL;
+    };
+
+    static std::vector<TraceRecord> generate(const Params& p) {
+        ZipfGenerator zipf(p.keySpace, p.theta);
+        std::vector<TraceRecord> records(p.numRecords);
+        std::vector<uint64_t> lastKey(p.numThreads, 0);
+        const uint64_t burstNs = p.burstPeriodNs*p.burstDutyPercent/100;
+        int numSizes = 0;
+        while ((p.minValueSize << numSizes) <= p.maxValueSize) numSizes++;
+        uint64_t seed = p.seed;
+        double ts = 0;
+        for (uint64_t i = 0; i < p.numRecords; i++) {
+            TraceRecord& r = records[i];
+            r.timestamp = (uint64_t)ts;
+            seed = randomLong(seed);
+            r.thread = (uint16_t)(seed % p.numThreads);
+            seed = randomLong(seed);
+            if ((int)(seed % 100) < p.repeatPercent) {
+                r.key = lastKey[r.thread];
+            } else {
+                seed = randomLong(seed);
+                r.key = scramble(zipf.next((seed >> 11) * (1.0/9007199254740992.0))) % p.keySpace;
+            }
+            lastKey[r.thread] = r.key;
+            seed = randomLong(seed);
+            const int dice = (int)(seed % 100);
+            if (dice < p.readPercent) {
+                r.op = TRACE_READ;
+            } else {
+                r.op = (dice & 1) ? TRACE_INSERT : TRACE_REMOVE;
+            }
+            seed = randomLong(seed);
+            r.valueSize = p.minValueSize << (seed % numSizes);
+            r.pad = 0;
+            // Advance the clock with the rate of the current phase
+            const bool inBurst = (p.burstPeriodNs != 0) && (r.timestamp % p.burstPeriodNs) < burstNs;
+            const double rate = (double)p.opsPerSecond * (inBurst ? p.burstFactor : 1);
+            ts += 1e9/rate;
+        }
+        return records;
+    }
+
+    static void generateFile(const std::string& path, const Params& p) {
+        TraceFile::write(path, p.numThreads, p.keySpace, generate(p));
+    }
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+    // FNV-1a on the 8 bytes of the rank
+    static uint64_t scramble(uint64_t rank) {
+        uint64_t h = 14695981039346656037ULL;
+        for (int i = 0; i < 8; i++) {
+            h ^= (rank >> (i*8)) & 0xFF;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+};
+
+#endif /* _TRACE_GENERATOR_H_ */
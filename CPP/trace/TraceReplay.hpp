@@ -0,0 +1,205 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TRACE_REPLAY_H_
+#define _TRACE_REPLAY_H_
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "TraceFile.hpp"
+#include "TraceAdapters.hpp"
+#include "IntervalRecorder.hpp"
+#include "BenchmarkUniversal.hpp"
+#include "LFHashMap.h"
+#include "MichaelScottQueue.hpp"
+#include "CRTurnQueue.hpp"
+#include "MichaelDeque.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Replays a trace against an adapter (see TraceAdapters.hpp) and measures
+ * the throughput and the latency of each operation.
+ * Each thread of the trace is replayed by its own thread, in the order of
+ * the trace. There are two modes:
+ * - Fast: the records are issued back-to-back, and the latency is the
+ *   duration of the operation;
+ * - Paced: each record is issued at its recorded timestamp (relative to the
+ *   start of the replay), and the latency is measured from that timestamp,
+ *   which means that when an implementation can't keep up with a burst the
+ *   time the operations spend waiting is accounted for (no coordinated omission);
+ * Latencies are recorded in an IntervalHistogram, so the percentiles are the
+ * upper bound of a power of two bucket.
+ */
+class TraceReplay {
+
+public:
+    struct Result {
+        long long opsPerSec = 0;
+        double    successPercent = 0;  // Percentage of operations that returned true
+        uint64_t  p50 = 0;
+        uint64_t  p99 = 0;
+        uint64_t  p999 = 0;
+        uint64_t  pmax = 0;
+
+        bool operator < (const Result& other) const {
+            return opsPerSec < other.opsPerSec;
+        }
+    };
+
+private:
+    const TraceFile& trace;
+    const int numThreads;
+    vector<vector<uint64_t>> perThread;  // Indexes of the records of each thread
+
+public:
+    TraceReplay(const TraceFile& trace) : trace{trace}, numThreads{trace.numThreads()}, perThread(trace.numThreads()) {
+        for (uint64_t i = 0; i < trace.numRecords(); i++) perThread[trace[i].thread % numThreads].push_back(i);
+    }
+
+
+    template<typename A>
+    Result replay(const bool paced, const int numRuns) {
+        assert(numRuns >= 1);
+        vector<Result> results(numRuns);
+        atomic<bool> startFlag = { false };
+        steady_clock::time_point startTime;
+        const uint64_t t0 = (trace.numRecords() == 0) ? 0 : trace[0].timestamp;
+        A* adapter = nullptr;
+        IntervalHistogram* hist = nullptr;
+        steady_clock::time_point endTimes[numThreads];
+        uint64_t numSuccess[numThreads];
+        uint64_t maxLatency[numThreads];
+
+        auto replay_lambda = [this,paced,t0,&startFlag,&startTime,&adapter,&hist](steady_clock::time_point* endTime, uint64_t* success, uint64_t* maxLat, const int tid) {
+            uint64_t lsuccess = 0;
+            uint64_t lmax = 0;
+            while (!startFlag.load()) { } // spin
+            const auto lstart = startTime;
+            for (uint64_t i : perThread[tid]) {
+                const TraceRecord& r = trace[i];
+                steady_clock::time_point begin;
+                if (paced) {
+                    begin = lstart + nanoseconds(r.timestamp - t0);
+                    auto now = steady_clock::now();
+                    if (begin - now > 100us) this_thread::sleep_for(begin - now - 50us);
+                    while (steady_clock::now() < begin) { } // spin
+                } else {
+                    begin = steady_clock::now();
+                }
+                if (adapter->apply(r, tid)) lsuccess++;
+                const uint64_t lat = duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+                hist->record(tid, lat);
+                if (lat > lmax) lmax = lat;
+            }
+            *endTime = steady_clock::now();
+            *success = lsuccess;
+            *maxLat = lmax;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            adapter = new A(numThreads, trace.keySpace());
+            adapter->prefill(trace.keySpace()/2);
+            hist = new IntervalHistogram(numThreads);
+            if (irun == 0) cout << "##### " << adapter->className() << " #####  \n";
+            thread replayThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) {
+                replayThreads[tid] = thread(replay_lambda, &endTimes[tid], &numSuccess[tid], &maxLatency[tid], tid);
+            }
+            startTime = steady_clock::now() + 10ms;  // Give time for all threads to see the startFlag
+            startFlag.store(true);
+            for (int tid = 0; tid < numThreads; tid++) replayThreads[tid].join();
+            startFlag.store(false);
+            // Accounting
+            Result& res = results[irun];
+            auto lastEnd = startTime;
+            uint64_t totalSuccess = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                if (endTimes[tid] > lastEnd) lastEnd = endTimes[tid];
+                totalSuccess += numSuccess[tid];
+                if (maxLatency[tid] > res.pmax) res.pmax = maxLatency[tid];
+            }
+            const long long elapsedNs = max(1LL, (long long)duration_cast<nanoseconds>(lastEnd - startTime).count());
+            res.opsPerSec = (long long)(trace.numRecords()*1000000000.0/elapsedNs);
+            res.successPercent = (trace.numRecords() == 0) ? 0 : 100.*totalSuccess/trace.numRecords();
+            // The upper bound of a bucket may be above the highest latency we saw
+            res.p50 = min(hist->valueAtPercentile(50), res.pmax);
+            res.p99 = min(hist->valueAtPercentile(99), res.pmax);
+            res.p999 = min(hist->valueAtPercentile(99.9), res.pmax);
+            delete hist;
+            delete adapter;
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(results.begin(), results.end());
+        Result median = results[numRuns/2];
+        cout << "Ops/sec = " << median.opsPerSec << "   success = " << median.successPercent << "%   latency (ns) p50 < " << median.p50
+             << "   p99 < " << median.p99 << "   p99.9 < " << median.p999 << "   max = " << median.pmax << "\n";
+        return median;
+    }
+
+
+public:
+
+    static void allReplayTests(const std::string& path, const bool paced, const int numRuns) {
+        TraceFile trace(path);
+        TraceReplay tr(trace);
+        const double lengthSec = (trace.numRecords() == 0) ? 0 : (trace[trace.numRecords()-1].timestamp - trace[0].timestamp)/1e9;
+        cout << "\n----- Trace Replay   trace=" << path << "   records=" << trace.numRecords() << "   threads=" << trace.numThreads()
+             << "   keySpace=" << trace.keySpace() << "   recordedLength=" << lengthSec << "s   mode=" << (paced ? "paced" : "fast")
+             << "   numRuns=" << numRuns << " -----\n";
+        vector<string> names;
+        vector<Result> res;
+        auto run = [&](Result r, std::string name) { res.push_back(r); names.push_back(name); };
+        run(tr.replay<SetAdapter<CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>>>(paced, numRuns), CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className());
+        run(tr.replay<SetAdapter<LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>>>(paced, numRuns), LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className());
+        run(tr.replay<SetAdapter<CXMutationSet<StdSet<uint64_t>,uint64_t>>>(paced, numRuns), CXMutationSet<StdSet<uint64_t>,uint64_t>::className());
+        run(tr.replay<MapAdapter<LFHashMap>>(paced, numRuns), LFHashMap::className());
+        run(tr.replay<QueueAdapter<MichaelScottQueue<uint64_t>>>(paced, numRuns), "MichaelScottQueue");
+        run(tr.replay<QueueAdapter<CRTurnQueue<uint64_t>>>(paced, numRuns), "CRTurnQueue");
+        run(tr.replay<QueueAdapter<MichaelDeque<uint64_t>>>(paced, numRuns), "MichaelDeque");
+
+        // Show results in csv format
+        cout << "\n\nResults for trace=" << path << "   mode=" << (paced ? "paced" : "fast") << "\n";
+        cout << "Class, Ops/sec, Success%, p50 (ns), p99 (ns), p99.9 (ns), max (ns)\n";
+        for (unsigned i = 0; i < res.size(); i++) {
+            cout << names[i] << ", " << res[i].opsPerSec << ", " << res[i].successPercent << ", " << res[i].p50 << ", "
+                 << res[i].p99 << ", " << res[i].p999 << ", " << res[i].pmax << "\n";
+        }
+    }
+};
+
+#endif /* _TRACE_REPLAY_H_ */
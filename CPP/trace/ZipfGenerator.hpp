@@ -0,0 +1,70 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _ZIPF_GENERATOR_H_
+#define _ZIPF_GENERATOR_H_
+
+#include <cstdint>
+#include <cmath>
+
+
+/**
+ * Zipfian distribution over [0, numItems[ with the algorithm from
+ * "Quickly Generating Billion-Record Synthetic Databases" by Gray et al.,
+ * the same one used by YCSB. Rank 0 is the most popular item.
+ */
+class ZipfGenerator {
+    const uint64_t numItems;
+    const double   theta;
+    double alpha, zetan, eta;
+
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; i++) sum += 1.0/std::pow((double)i, theta);
+        return sum;
+    }
+
+public:
+    ZipfGenerator(const uint64_t numItems, const double theta) : numItems{numItems}, theta{theta} {
+        const double zeta2 = zeta(2, theta);
+        zetan = zeta(numItems, theta);
+        alpha = 1.0/(1.0-theta);
+        eta = (1.0-std::pow(2.0/numItems, 1.0-theta))/(1.0-zeta2/zetan);
+    }
+
+    // u must be uniform in [0,1[
+    uint64_t next(const double u) const {
+        const double uz = u*zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0+std::pow(0.5, theta)) return 1;
+        uint64_t rank = (uint64_t)(numItems*std::pow(eta*u-eta+1.0, alpha));
+        return (rank >= numItems) ? numItems-1 : rank;
+    }
+};
+
+#endif /* _ZIPF_GENERATOR_H_ */
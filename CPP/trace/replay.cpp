@@ -0,0 +1,62 @@
+/*
+ * replay.cpp
+ *
+ *  Created on: Jul 3, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+
+#include "TraceGenerator.hpp"
+#include "TraceReplay.hpp"
+
+
+static void usage() {
+    std::cout << "Usage:\n";
+    std::cout << "  replay gen <file> [numThreads] [numRecords] [keySpace] [theta]\n";
+    std::cout << "  replay run <file> [fast|paced] [numRuns]\n";
+    std::cout << "  numRuns is an integer from 1 to 1000 (default 5)\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        usage();
+        return 1;
+    }
+    try {
+        if (std::strcmp(argv[1], "gen") == 0) {
+            TraceGenerator::Params p;
+            if (argc > 3) p.numThreads = std::atoi(argv[3]);
+            if (argc > 4) p.numRecords = std::strtoull(argv[4], nullptr, 10);
+            if (argc > 5) p.keySpace = std::strtoull(argv[5], nullptr, 10);
+            if (argc > 6) p.theta = std::atof(argv[6]);
+            TraceGenerator::generateFile(argv[2], p);
+            std::cout << "Generated " << argv[2] << " with " << p.numRecords << " records for " << p.numThreads << " threads\n";
+        } else if (std::strcmp(argv[1], "run") == 0) {
+            if (argc > 3 && std::strcmp(argv[3], "fast") != 0 && std::strcmp(argv[3], "paced") != 0) {
+                usage();
+                return 1;
+            }
+            const bool paced = (argc > 3) && std::strcmp(argv[3], "paced") == 0;
+            long numRuns = 5;
+            if (argc > 4) {
+                char* end = nullptr;
+                numRuns = std::strtol(argv[4], &end, 10);
+                if (end == argv[4] || *end != '\0' || numRuns < 1 || numRuns > 1000) {
+                    usage();
+                    return 1;
+                }
+            }
+            TraceReplay::allReplayTests(argv[2], paced, numRuns);
+        } else {
+            usage();
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cout << "ERROR: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_BULK_LOAD_H_
+#define _BENCHMARK_BULK_LOAD_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <functional>
+#include <iostream>
+#include "LRClassicMap.h"
+#include "LeftRightClassic.h"
+#include "LeftRightClassicLambda.h"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Measures the time it takes to load numKeys sorted entries into a
+ * LRClassicMap and into a LeftRightClassicLambda<std::map>, one insert() at a
+ * time (each one takes the writersMutex, does two O(log n) inserts and one
+ * toggleVersionAndWait()) versus the bulk-load constructor and replaceAll().
+ * This is single-threaded, it's the startup time of an application.
+ */
+class BenchmarkBulkLoad {
+
+private:
+    typedef std::map<long long,long long> StdMap;
+
+    static long long elapsedMs(const steady_clock::time_point start) {
+        return duration_cast<milliseconds>(steady_clock::now()-start).count();
+    }
+
+public:
+    /**
+     * Returns the time in milliseconds for each of the NUM_CASES ways of loading the maps
+     */
+    static vector<long long> bulkLoadTest(const long long numKeys) {
+        vector<pair<long long,long long>> entries;
+        entries.reserve(numKeys);
+        for (long long i = 0; i < numKeys; i++) entries.push_back(make_pair(i, 2*i));
+        vector<long long> times;
+
+        cout << "\n----- Bulk Load Benchmark   numKeys=" << numKeys << " -----\n";
+
+        auto start = steady_clock::now();
+        LRClassicMap<long long,long long>* lrcMap = new LRClassicMap<long long,long long>();
+        for (auto& e : entries) lrcMap->insert(e);
+        times.push_back(elapsedMs(start));
+        cout << "LRClassicMap insert() one at a time:      " << times.back() << " ms   size=" << lrcMap->size() << "\n";
+
+        start = steady_clock::now();
+        LRClassicMap<long long,long long>* lrcBulk = new LRClassicMap<long long,long long>(entries.begin(), entries.end());
+        times.push_back(elapsedMs(start));
+        cout << "LRClassicMap bulk-load constructor:       " << times.back() << " ms   size=" << lrcBulk->size() << "\n";
+
+        start = steady_clock::now();
+        lrcMap->replaceAll(entries.begin(), entries.end());
+        times.push_back(elapsedMs(start));
+        cout << "LRClassicMap replaceAll() on a full map:  " << times.back() << " ms   size=" << lrcMap->size() << "\n";
+        delete lrcMap;
+        delete lrcBulk;
+
+        std::function<bool(StdMap*,pair<long long,long long>)> insertLambda =
+            [](StdMap* _map, pair<long long,long long> _pair) { _map->insert(_pair); return true; };
+        start = steady_clock::now();
+        LeftRight::LeftRightClassicLambda<StdMap>* lrcLambda = new LeftRight::LeftRightClassicLambda<StdMap>();
+        for (auto& e : entries) lrcLambda->applyMutation(e, insertLambda);
+        times.push_back(elapsedMs(start));
+        cout << "LRCLambda applyMutation() one at a time:  " << times.back() << " ms\n";
+
+        start = steady_clock::now();
+        LeftRight::LeftRightClassicLambda<StdMap>* lrcLambdaBulk = new LeftRight::LeftRightClassicLambda<StdMap>(entries.begin(), entries.end());
+        times.push_back(elapsedMs(start));
+        cout << "LRCLambda bulk-load constructor:          " << times.back() << " ms\n";
+
+        start = steady_clock::now();
+        lrcLambda->replaceAll(entries.begin(), entries.end());
+        times.push_back(elapsedMs(start));
+        cout << "LRCLambda replaceAll() on a full map:     " << times.back() << " ms\n";
+        delete lrcLambda;
+        delete lrcLambdaBulk;
+
+        return times;
+    }
+
+
+    static void allTests() {
+        vector<long long> keysList = { 1000000LL, 10000000LL };
+        vector<vector<long long>> times;
+        for (auto numKeys : keysList) times.push_back(bulkLoadTest(numKeys));
+
+        // Show results in csv format
+        cout << "\n\nResults in milliseconds\n";
+        cout << "Keys, LRClassicMap-insert, LRClassicMap-bulk, LRClassicMap-replaceAll, LRCLambda-insert, LRCLambda-bulk, LRCLambda-replaceAll\n";
+        for (unsigned ikeys = 0; ikeys < keysList.size(); ikeys++) {
+            cout << keysList[ikeys] << ", ";
+            for (auto t : times[ikeys]) cout << t << ", ";
+            cout << "\n";
+        }
+    }
+};
+
+#endif /* _BENCHMARK_BULK_LOAD_H_ */
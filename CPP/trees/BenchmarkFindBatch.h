@@ -0,0 +1,186 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_FIND_BATCH_H_
+#define _BENCHMARK_FIND_BATCH_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "LRClassicMap.h"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Micro-benchmark for LRClassicMap::findBatch() versus a loop of find().
+ * The map has numKeys entries (the even keys) and the lookups are uniformly
+ * random over twice that range, so about half of them are misses. With
+ * 10^7 keys the tree is much larger than the last level cache and each level
+ * of the walk is a cache miss, which is what findBatch() tries to overlap.
+ * We do a batch of lookups at a time, like a request handler would.
+ */
+class BenchmarkFindBatch {
+
+private:
+    typedef LRClassicMap<long long,long long> Map;
+    static const int MAX_BATCH = 64;
+    const int numThreads;
+
+public:
+    BenchmarkFindBatch(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Each thread does batches of batchSize lookups until the test ends.
+     * Returns the median number of keys looked up per second.
+     */
+    long long benchmark(Map* map, const long long numKeys, const int batchSize, const bool useBatch, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        long long hits[numThreads][numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+
+        auto run_lambda = [&quit,&startFlag,&map,numKeys,batchSize,useBatch](long long *ops, long long *hits, const int tid) {
+            long long keys[MAX_BATCH];
+            long long values[MAX_BATCH];
+            bool found[MAX_BATCH];
+            long long numOps = 0;
+            long long numHits = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                for (int i = 0; i < batchSize; i++) {
+                    seed = randomLong(seed);
+                    keys[i] = (long long)(seed % (2*numKeys));
+                }
+                if (useBatch) {
+                    numHits += map->findBatch(keys, batchSize, values, found);
+                } else {
+                    // One arrive()/depart() and one std::map::find() per key, with the value copied inside the critical section
+                    for (int i = 0; i < batchSize; i++) {
+                        found[i] = map->findCopy(keys[i], values[i]);
+                        if (found[i]) numHits++;
+                    }
+                }
+                numOps += batchSize;
+            }
+            *ops = numOps;
+            *hits = numHits;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            thread runThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid] = thread(run_lambda, &ops[tid][irun], &hits[tid][irun], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        long long totalOps = 0, totalHits = 0;
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                agg[irun] += ops[tid][irun];
+                totalOps += ops[tid][irun];
+                totalHits += hits[tid][irun];
+            }
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        cout << (useBatch ? "findBatch()  " : "loop find()  ") << "batch=" << batchSize << "   keys/sec = " << result;
+        cout << "   hit ratio = " << (totalOps == 0 ? 0. : (double)totalHits/totalOps) << "\n";
+        return result;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests(const long long numKeys=10000000LL) {
+        vector<int> threadList = { 1, 2, 4, 8, 16 };
+        vector<int> batchList = { 8, 16, 32, 64 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        long long ops[2][batchList.size()][threadList.size()];
+
+        cout << "Filling up LRClassicMap with " << numKeys << " keys...\n";
+        Map* map = new Map();
+        for (long long i = 0; i < numKeys; i++) map->insert(std::make_pair(2*i, i));
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkFindBatch bench(nThreads);
+            std::cout << "\n----- FindBatch Benchmark   numThreads=" << nThreads << "   numKeys=" << numKeys << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+            for (unsigned ibatch = 0; ibatch < batchList.size(); ibatch++) {
+                ops[0][ibatch][ithread] = bench.benchmark(map, numKeys, batchList[ibatch], false, testLength, numRuns);
+                ops[1][ibatch][ithread] = bench.benchmark(map, numKeys, batchList[ibatch], true, testLength, numRuns);
+            }
+        }
+        delete map;
+
+        // Show results in csv format
+        cout << "\n\nResults in keys per second for numKeys=" << numKeys << ", numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Threads, ";
+        for (unsigned ibatch = 0; ibatch < batchList.size(); ibatch++) {
+            cout << "find-" << batchList[ibatch] << ", findBatch-" << batchList[ibatch] << ", ";
+        }
+        cout << "\n";
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            cout << threadList[ithread] << ", ";
+            for (unsigned ibatch = 0; ibatch < batchList.size(); ibatch++) {
+                cout << ops[0][ibatch][ithread] << ", " << ops[1][ibatch][ithread] << ", ";
+            }
+            cout << "\n";
+        }
+    }
+};
+
+#endif /* _BENCHMARK_FIND_BATCH_H_ */
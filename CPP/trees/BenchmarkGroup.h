@@ -0,0 +1,263 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_GROUP_H_
+#define _BENCHMARK_GROUP_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <iostream>
+#include "LRClassicMap.h"
+#include "LeftRightClassicGroup.h"
+
+using namespace std;
+using namespace chrono;
+
+
+/*
+ * An index (key -> value) and a reverse index (value -> key), with the
+ * same interface for both ways of keeping them in sync:
+ *   update(key, value)  - the key gets a new value, the old value is removed from the reverse index
+ *   check(key)          - returns false if the reverse of the value of key is not key
+ */
+
+// Two LRClassicMaps and an outer mutex for the writers. Readers do two independent lookups.
+class PerMapIndex {
+    LRClassicMap<uint64_t,uint64_t> idx;
+    LRClassicMap<uint64_t,uint64_t> rev;
+    std::mutex writersMutex;
+
+public:
+    PerMapIndex(const uint64_t numKeys) {
+        for (uint64_t k = 0; k < numKeys; k++) {
+            idx.insert(std::make_pair(k, k));
+            rev.insert(std::make_pair(k, k));
+        }
+    }
+
+    static std::string className() { return "LRClassicMap x2 + mutex"; }
+
+    void update(const uint64_t key, const uint64_t value) {
+        std::lock_guard<std::mutex> lock(writersMutex);
+        uint64_t oldValue;
+        bool found;
+        idx.findBatch(&key, 1, &oldValue, &found);
+        idx.erase(key);
+        idx.insert(std::make_pair(key, value));
+        rev.erase(oldValue);
+        rev.insert(std::make_pair(value, key));
+    }
+
+    bool check(const uint64_t key) {
+        uint64_t value, rkey;
+        bool found;
+        if (idx.findBatch(&key, 1, &value, &found) == 0) return false;
+        if (rev.findBatch(&value, 1, &rkey, &found) == 0) return false;
+        return rkey == key;
+    }
+};
+
+
+// Both maps in one LeftRightClassicGroup. One toggle per update and one arrive()/depart() per check.
+class GroupIndex {
+    typedef std::map<uint64_t,uint64_t> Map;
+    LeftRight::LeftRightClassicGroup<RIAtomicCounter,Map,Map> group;
+
+    static Map identity(const uint64_t numKeys) {
+        Map m;
+        for (uint64_t k = 0; k < numKeys; k++) m.emplace_hint(m.end(), k, k);
+        return m;
+    }
+
+public:
+    GroupIndex(const uint64_t numKeys) : group{identity(numKeys), identity(numKeys)} { }
+
+    static std::string className() { return "LeftRightClassicGroup"; }
+
+    void update(const uint64_t key, const uint64_t value) {
+        group.applyMutation([key,value] (Map& idx, Map& rev) {
+            auto it = idx.find(key);
+            const uint64_t oldValue = it->second;
+            it->second = value;
+            rev.erase(oldValue);
+            rev.emplace(value, key);
+            return oldValue;
+        });
+    }
+
+    bool check(const uint64_t key) {
+        return group.applyRead([key] (const Map& idx, const Map& rev) {
+            auto it = idx.find(key);
+            if (it == idx.end()) return false;
+            auto rit = rev.find(it->second);
+            return rit != rev.end() && rit->second == key;
+        });
+    }
+};
+
+
+/**
+ * Micro-benchmark for keeping an index and a reverse index in sync.
+ * Each thread does check() on random keys, and writePerMil of the operations
+ * are update() of a random key to a new value. The values are unique, made
+ * of the key and a per-thread counter, so the reverse index is a bijection.
+ * With the two LRClassicMaps a reader can see the index already updated and
+ * the reverse index not yet (or the other way around), which we count as
+ * inconsistent reads. With the group that should never happen.
+ */
+class BenchmarkGroup {
+
+public:
+    struct Result {
+        long long opsPerSec {0};
+        long long inconsistent {0};
+
+        bool operator < (const Result& other) const {
+            return opsPerSec < other.opsPerSec;
+        }
+    };
+
+private:
+    const int numThreads;
+
+public:
+    BenchmarkGroup(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Returns the result of the median run (by operations per second)
+     */
+    template<typename I>
+    Result benchmark(const uint64_t numKeys, const int writePerMil, const seconds testLengthSeconds, const int numRuns) {
+        vector<Result> results(numRuns);
+        long long ops[numThreads];
+        long long inconsistent[numThreads];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        I* index = nullptr;
+
+        auto run_lambda = [&quit,&startFlag,&index,numKeys,writePerMil](long long *ops, long long *inconsistent, const int tid) {
+            long long numOps = 0;
+            long long numInconsistent = 0;
+            uint64_t counter = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                seed = randomLong(seed);
+                const uint64_t key = seed % numKeys;
+                if ((int)((seed >> 32) % 1000) < writePerMil) {
+                    // Unique value: key in the lower 32 bits, the tid and a counter in the upper bits
+                    index->update(key, ((++counter*256 + tid) << 32) | key);
+                } else {
+                    if (!index->check(key)) numInconsistent++;
+                }
+                numOps++;
+            }
+            *ops = numOps;
+            *inconsistent = numInconsistent;
+        };
+
+        cout << "##### " << I::className() << " #####\n";
+        for (int irun = 0; irun < numRuns; irun++) {
+            index = new I(numKeys);
+            thread runThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid] = thread(run_lambda, &ops[tid], &inconsistent[tid], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            delete index;
+            long long totalOps = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                totalOps += ops[tid];
+                results[irun].inconsistent += inconsistent[tid];
+            }
+            results[irun].opsPerSec = totalOps/testLengthSeconds.count();
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(results.begin(), results.end());
+        Result median = results[numRuns/2];
+        cout << "Ops/sec = " << median.opsPerSec << "   inconsistent reads = " << median.inconsistent << "\n";
+        return median;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests(const uint64_t numKeys=10000) {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32 };
+        vector<int> writeList = { 10, 100, 500 };   // 1%, 10% and 50% writes
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        Result res[2][writeList.size()][threadList.size()];
+
+        for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+            auto nThreads = threadList[ithread];
+            BenchmarkGroup bench(nThreads);
+            for (unsigned iwrite = 0; iwrite < writeList.size(); iwrite++) {
+                std::cout << "\n----- Group Benchmark   numThreads=" << nThreads << "   numKeys=" << numKeys << "   writes=" << writeList[iwrite]/10. << "%";
+                std::cout << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                res[0][iwrite][ithread] = bench.benchmark<PerMapIndex>(numKeys, writeList[iwrite], testLength, numRuns);
+                res[1][iwrite][ithread] = bench.benchmark<GroupIndex>(numKeys, writeList[iwrite], testLength, numRuns);
+            }
+        }
+
+        // Show results in csv format
+        cout << "\n\nResults in ops per second for numKeys=" << numKeys << ", numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+        cout << "Writes (%), Threads, PerMapIndex, PerMapIndex inconsistent, GroupIndex, GroupIndex inconsistent\n";
+        for (unsigned iwrite = 0; iwrite < writeList.size(); iwrite++) {
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << writeList[iwrite]/10. << ", " << threadList[ithread] << ", ";
+                for (int ic = 0; ic < 2; ic++) cout << res[ic][iwrite][ithread].opsPerSec << ", " << res[ic][iwrite][ithread].inconsistent << ", ";
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif /* _BENCHMARK_GROUP_H_ */
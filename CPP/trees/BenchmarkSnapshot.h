@@ -0,0 +1,248 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_SNAPSHOT_H_
+#define _BENCHMARK_SNAPSHOT_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "LRClassicMap.h"
+#include "LRSnapshotMap.h"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Benchmarks for LRSnapshotMap:
+ * - Time to first read: from process start until the first lookup returns,
+ *   when rebuilding a LRClassicMap from a flat dump of sorted pairs (bulk-load)
+ *   versus mapping a snapshot file. Before each measurement we ask the kernel
+ *   to drop the file from the page cache with posix_fadvise(), which doesn't
+ *   need root, though it only works if no one else has the file mapped;
+ * - Steady-state lookups: lookups per second on the snapshot, on the
+ *   snapshot after promotion, and on a LRClassicMap, at 1 to 16 threads.
+ */
+class BenchmarkSnapshot {
+
+private:
+    typedef LRClassicMap<long long,long long> Map;
+    typedef LRSnapshotMap<long long,long long> SnapMap;
+    const int numThreads;
+
+    static void dropFromPageCache(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+
+    static long long elapsedUs(const steady_clock::time_point start) {
+        return duration_cast<microseconds>(steady_clock::now()-start).count();
+    }
+
+public:
+    BenchmarkSnapshot(const int numThreads) : numThreads{numThreads} { }
+
+
+    /**
+     * Each thread does random lookups (about half of them are misses) until
+     * the test ends. Returns the median number of lookups per second.
+     */
+    template<typename M>
+    long long lookupBenchmark(M* map, const long long numKeys, const string& name, const seconds testLengthSeconds, const int numRuns) {
+        long long ops[numThreads][numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+
+        auto run_lambda = [this,&quit,&startFlag,&map,numKeys](long long *ops, const int tid) {
+            long long numOps = 0;
+            long long value;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                for (int i = 0; i < 100; i++) {
+                    seed = randomLong(seed);
+                    lookup(map, (long long)(seed % (2*numKeys)), value);
+                }
+                numOps += 100;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            thread runThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid] = thread(run_lambda, &ops[tid][irun], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) runThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+        }
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            for (int tid = 0; tid < numThreads; tid++) agg[irun] += ops[tid][irun];
+        }
+
+        // Compute the median. numRuns should be an odd number
+        sort(agg.begin(),agg.end());
+        long long result = agg[numRuns/2]/testLengthSeconds.count();
+        cout << name << "   lookups/sec = " << result << "   ns per lookup per thread = " << (1000000000.*numThreads)/result << "\n";
+        return result;
+    }
+
+    static inline bool lookup(Map* map, const long long key, long long& value) {
+        bool found;
+        map->findBatch(&key, 1, &value, &found);
+        return found;
+    }
+
+    static inline bool lookup(SnapMap* map, const long long key, long long& value) {
+        return map->find(key, value);
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+    /**
+     * Returns the time to first read in microseconds, first when rebuilding
+     * from the dump and then when mapping the snapshot
+     */
+    static pair<long long,long long> firstReadTest(const long long numKeys, const string& dumpPath, const string& snapPath) {
+        cout << "\n----- Snapshot Time To First Read   numKeys=" << numKeys << " -----\n";
+        // Prepare the dump (the even keys) and the snapshot
+        vector<pair<long long,long long>> entries;
+        entries.reserve(numKeys);
+        for (long long i = 0; i < numKeys; i++) entries.push_back(make_pair(2*i, i));
+        FILE* f = fopen(dumpPath.c_str(), "wb");
+        if (f == nullptr) throw std::runtime_error("BenchmarkSnapshot: could not create " + dumpPath);
+        fwrite(entries.data(), sizeof(entries[0]), numKeys, f);
+        fclose(f);
+        Map* map = new Map(entries.begin(), entries.end());
+        SnapMap::writeSnapshot(*map, snapPath);
+        delete map;
+        vector<pair<long long,long long>>().swap(entries);
+        long long value;
+
+        dropFromPageCache(dumpPath);
+        auto start = steady_clock::now();
+        entries.resize(numKeys);
+        f = fopen(dumpPath.c_str(), "rb");
+        if (fread(entries.data(), sizeof(entries[0]), numKeys, f) != (size_t)numKeys) cout << "ERROR: short read on dump\n";
+        fclose(f);
+        map = new Map(entries.begin(), entries.end());
+        if (!lookup(map, 2*(numKeys/2), value)) cout << "ERROR: key not found in LRClassicMap\n";
+        const long long rebuildUs = elapsedUs(start);
+        cout << "LRClassicMap from dump (bulk-load):  " << rebuildUs << " us\n";
+        delete map;
+        vector<pair<long long,long long>>().swap(entries);
+
+        dropFromPageCache(snapPath);
+        start = steady_clock::now();
+        SnapMap* snap = new SnapMap(snapPath);
+        if (!lookup(snap, 2*(numKeys/2), value)) cout << "ERROR: key not found in LRSnapshotMap\n";
+        const long long snapUs = elapsedUs(start);
+        cout << "LRSnapshotMap mmap of snapshot:      " << snapUs << " us\n";
+        delete snap;
+        return make_pair(rebuildUs, snapUs);
+    }
+
+
+public:
+
+    static void allTests(const string& dir=".") {
+        vector<long long> keysList = { 1000000LL, 10000000LL };
+        vector<int> threadList = { 1, 2, 4, 8, 16 };
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const string dumpPath = dir + "/lrsnapshot.dump";
+        const string snapPath = dir + "/lrsnapshot.snap";
+        vector<pair<long long,long long>> firstRead;
+        long long ops[keysList.size()][3][threadList.size()];
+
+        for (unsigned ikeys = 0; ikeys < keysList.size(); ikeys++) {
+            const long long numKeys = keysList[ikeys];
+            firstRead.push_back(firstReadTest(numKeys, dumpPath, snapPath));
+            SnapMap* snap = new SnapMap(snapPath);
+            SnapMap* promoted = new SnapMap(snapPath);
+            Map* map = promoted->promote();   // The same map, without the indirection of LRSnapshotMap
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                BenchmarkSnapshot bench(threadList[ithread]);
+                cout << "\n----- Snapshot Lookups   numKeys=" << numKeys << "   numThreads=" << threadList[ithread] << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                ops[ikeys][0][ithread] = bench.lookupBenchmark(snap, numKeys, "LRSnapshotMap (snapshot)", testLength, numRuns);
+                ops[ikeys][1][ithread] = bench.lookupBenchmark(promoted, numKeys, "LRSnapshotMap (promoted)", testLength, numRuns);
+                ops[ikeys][2][ithread] = bench.lookupBenchmark(map, numKeys, "LRClassicMap            ", testLength, numRuns);
+            }
+            delete snap;
+            delete promoted;
+        }
+        unlink(dumpPath.c_str());
+        unlink(snapPath.c_str());
+
+        // Show results in csv format
+        cout << "\n\nTime to first read in microseconds\n";
+        cout << "Keys, LRClassicMap-from-dump, LRSnapshotMap-mmap\n";
+        for (unsigned ikeys = 0; ikeys < keysList.size(); ikeys++) {
+            cout << keysList[ikeys] << ", " << firstRead[ikeys].first << ", " << firstRead[ikeys].second << "\n";
+        }
+        for (unsigned ikeys = 0; ikeys < keysList.size(); ikeys++) {
+            cout << "\nResults in lookups per second for numKeys=" << keysList[ikeys] << ", numRuns=" << numRuns << ",  length=" << testLength.count() << "s \n";
+            cout << "Threads, LRSnapshotMap-snapshot, LRSnapshotMap-promoted, LRClassicMap\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < 3; ic++) cout << ops[ikeys][ic][ithread] << ", ";
+                cout << "\n";
+            }
+        }
+    }
+};
+
+#endif /* _BENCHMARK_SNAPSHOT_H_ */
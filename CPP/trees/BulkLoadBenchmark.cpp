@@ -0,0 +1,16 @@
+/*
+ * BulkLoadBenchmark.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkBulkLoad.h"
+
+
+
+int main(void) {
+    BenchmarkBulkLoad::allTests();
+    return 0;
+}
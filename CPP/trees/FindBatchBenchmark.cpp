@@ -0,0 +1,16 @@
+/*
+ * FindBatchBenchmark.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkFindBatch.h"
+
+
+
+int main(void) {
+    BenchmarkFindBatch::allThroughputTests();
+    return 0;
+}
@@ -0,0 +1,16 @@
+/*
+ * GroupBenchmark.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkGroup.h"
+
+
+
+int main(void) {
+    BenchmarkGroup::allThroughputTests();
+    return 0;
+}
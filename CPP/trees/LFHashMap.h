@@ -0,0 +1,447 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LF_HASH_MAP_H_
+#define _LF_HASH_MAP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include "HazardPointers.hpp"
+
+/**
+ * <h1> Lock-Free Linear Probing Hash Map </h1>
+ *
+ * An open-addressing hash map with 64 bit keys and 62 bit values, where each
+ * slot is a key word and a value word, both modified with CAS.
+ * The design follows Cliff Click's non-blocking hash table:
+ * - A key is never removed from a slot (of a given table). Removing a key
+ *   sets its value to TOMBSTONE, and the slot is re-used if the same key is
+ *   inserted again. Tombstones are cleaned up when the table is resized;
+ * - Resizing allocates a new table and links it from the old one. Threads
+ *   that come across a table that is being resized help migrate it, one chunk
+ *   of CHUNK_SIZE slots at a time, so that the cost of the resize is spread
+ *   amongst all threads (incremental and cooperative);
+ * - To migrate a slot, its value is first "primed" (frozen), then copied to
+ *   the new table, and then replaced with MOVED. A writer that sees a primed
+ *   or moved value helps the copy of that slot and retries in the new table.
+ *   Migrating an empty slot replaces its key with KEY_MOVED, so that no key
+ *   can be inserted in it afterwards;
+ * - Old tables are retired with Hazard Pointers once fully migrated.
+ *
+ * The top two bits of the values are reserved, as are the keys ~0 and ~0-1,
+ * and inserting any of those throws std::invalid_argument.
+ *
+ * Consistency: Linearizable
+ * find()   progress: lock-free (wait-free when no resize is in progress)
+ * insert() progress: lock-free
+ * erase()  progress: lock-free
+ * Memory Reclamation: Hazard Pointers (lock-free)
+ *
+ * Cliff Click's talk: http://www.azulsystems.com/events/javaone_2007/2007_LockFreeHash.pdf
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+class LFHashMap {
+
+public:
+    static const uint64_t KEY_EMPTY = ~0ULL;
+    static const uint64_t KEY_MOVED = ~0ULL-1;        // Empty slot that was migrated
+    static const uint64_t MAX_VALUE = (1ULL << 62)-1;
+
+private:
+    static const uint64_t VAL_EMPTY = 1ULL << 62;     // Never written
+    static const uint64_t TOMBSTONE = VAL_EMPTY | 1;  // Removed (or key claimed but value not yet written)
+    static const uint64_t MOVED     = VAL_EMPTY | 2;  // Copied to the next table
+    static const uint64_t PRIME     = 1ULL << 63;     // Frozen, being copied to the next table
+
+    static const int      MAX_THREADS = 128;
+    static const uint64_t MIN_CAPACITY = 16;
+    static const uint64_t CHUNK_SIZE = 1024;
+    static const int      REPROBE_LIMIT = 32;
+
+    struct Slot {
+        std::atomic<uint64_t> key;
+        std::atomic<uint64_t> val;
+    };
+
+    struct Table {
+        const uint64_t        capacity;          // Always a power of two
+        Slot*                 slots;
+        std::atomic<Table*>   next {nullptr};
+        alignas(128) std::atomic<uint64_t> claimed {0};   // Number of slots with a key
+        alignas(128) std::atomic<uint64_t> copyIdx {0};   // Next chunk to migrate
+        alignas(128) std::atomic<uint64_t> copyDone {0};  // Number of slots already MOVED
+
+        Table(uint64_t capacity) : capacity{capacity} {
+            slots = new Slot[capacity];
+            for (uint64_t i = 0; i < capacity; i++) {
+                slots[i].key.store(KEY_EMPTY, std::memory_order_relaxed);
+                slots[i].val.store(VAL_EMPTY, std::memory_order_relaxed);
+            }
+        }
+
+        ~Table() {
+            delete[] slots;
+        }
+    };
+
+    alignas(128) std::atomic<Table*> head;
+    const int maxThreads;
+    // Current table, next table, and two for copying down the chain of tables
+    HazardPointers<Table> hp {4, maxThreads};
+    static const int kHpTab = 0;
+    static const int kHpNext = 1;
+    static const int kHpCopy = 2;
+
+
+    static inline uint64_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    static inline bool isAbsent(uint64_t val) {
+        return val == VAL_EMPTY || val == TOMBSTONE;
+    }
+
+    /*
+     * Protects tab->next with the hazard pointer ihp. Returns nullptr if the
+     * next table may have been retired, in which case the caller must restart
+     * from the head. The next table can only be retired after tab has been
+     * fully migrated and the head has moved past both of them.
+     */
+    Table* protectNext(Table* tab, const int ihp, const int tid) {
+        Table* nxt = hp.protectPtr(ihp, tab->next.load(), tid);
+        if (tab->copyDone.load() == tab->capacity) {
+            Table* lhead = head.load();
+            if (lhead != tab && lhead != nxt) return nullptr;
+        }
+        return nxt;
+    }
+
+    /*
+     * Makes sure there is a next table, allocating it if needed.
+     * When tab is the head, the new capacity is computed from the number of
+     * live entries, which means that a table full of tombstones is resized to
+     * the same capacity. When tab is still receiving entries from a previous
+     * table, the live count means nothing and we just double the capacity.
+     */
+    void startResize(Table* tab) {
+        if (tab->next.load() != nullptr) return;
+        uint64_t newCap = MIN_CAPACITY;
+        if (head.load() == tab) {
+            uint64_t live = 0;
+            for (uint64_t i = 0; i < tab->capacity; i++) {
+                uint64_t val = tab->slots[i].val.load(std::memory_order_relaxed);
+                if (!isAbsent(val) && val != MOVED) live++;
+            }
+            while (newCap < 2*live) newCap <<= 1;
+        } else {
+            newCap = 2*tab->capacity;
+        }
+        Table* newTab = new Table(newCap);
+        Table* tmp = nullptr;
+        if (!tab->next.compare_exchange_strong(tmp, newTab)) delete newTab;
+    }
+
+    /*
+     * Inserts the frozen value of a slot of the old table in the next table,
+     * unless a value is already there. No writer touches the key in the next
+     * table until the old slot is MOVED, so VAL_EMPTY means "not yet copied".
+     * If the next table is itself being migrated (or is full), the value goes
+     * to the table after it. While the old slot is not MOVED, the old table can
+     * not be fully migrated, and therefore none of the tables after it can be
+     * retired, which is why the hazard pointers here need no further validation.
+     */
+    void copyToNext(std::atomic<uint64_t>& oldVal, Table* nxt, const uint64_t key, const uint64_t val, const int tid) {
+        Table* cur = nxt;
+        int ihp = kHpCopy;
+        while (true) {
+            const uint64_t mask = cur->capacity-1;
+            uint64_t idx = hash(key) & mask;
+            uint64_t iprobe = 0;
+            for (; iprobe < cur->capacity; iprobe++, idx = (idx+1) & mask) {
+                Slot& slot = cur->slots[idx];
+                uint64_t k = slot.key.load();
+                if (k == KEY_EMPTY) {
+                    if (slot.key.compare_exchange_strong(k, key)) {
+                        if (cur->claimed.fetch_add(1)+1 > cur->capacity*3/4) startResize(cur);
+                        k = key;
+                    }
+                }
+                if (k == KEY_MOVED) break;
+                if (k != key) continue;
+                uint64_t expected = VAL_EMPTY;
+                if (slot.val.compare_exchange_strong(expected, val)) return;
+                if (expected != MOVED) return;  // Already copied by another thread
+                break;
+            }
+            if (iprobe == cur->capacity) startResize(cur);
+            cur = hp.protectPtr(ihp, cur->next.load(), tid);
+            if (oldVal.load() == MOVED) return;
+            ihp = (ihp == kHpCopy) ? kHpCopy+1 : kHpCopy;
+        }
+    }
+
+    /*
+     * Migrates a single slot of tab to nxt.
+     * Returns true if this thread was the one to set the slot to MOVED.
+     */
+    bool copySlot(Table* tab, Table* nxt, uint64_t idx, const int tid) {
+        Slot& slot = tab->slots[idx];
+        uint64_t key = slot.key.load();
+        if (key == KEY_EMPTY) {
+            if (slot.key.compare_exchange_strong(key, KEY_MOVED)) return true;
+        }
+        if (key == KEY_MOVED) return false;
+        uint64_t val = slot.val.load();
+        // Freeze the value
+        while (val != MOVED && (val & PRIME) == 0) {
+            if (isAbsent(val)) {
+                if (slot.val.compare_exchange_strong(val, MOVED)) return true;
+            } else {
+                if (slot.val.compare_exchange_strong(val, val | PRIME)) {
+                    val |= PRIME;
+                    break;
+                }
+            }
+        }
+        if (val == MOVED) return false;
+        copyToNext(slot.val, nxt, key, val & ~PRIME, tid);
+        return slot.val.compare_exchange_strong(val, MOVED);
+    }
+
+    // Tries to make the next table the new head once all slots have been MOVED
+    void tryPromote(Table* tab, Table* nxt, const int tid) {
+        if (tab->copyDone.load() != tab->capacity) return;
+        Table* tmp = tab;
+        if (head.compare_exchange_strong(tmp, nxt)) hp.retire(tab, tid);
+    }
+
+    /*
+     * Migrates one chunk of tab, if there are chunks left to claim.
+     * Operations don't depend on the migration being complete, they copy the
+     * slot of their own key when they find it primed or moved, therefore a
+     * thread that stalls in the middle of a chunk only delays the promotion of
+     * the next table to head, and with it the retirement of the old table.
+     */
+    void helpCopy(Table* tab, Table* nxt, const int tid) {
+        if (tab->copyIdx.load() < tab->capacity) {
+            uint64_t done = 0;
+            const uint64_t start = tab->copyIdx.fetch_add(CHUNK_SIZE);
+            const uint64_t end = std::min(start+CHUNK_SIZE, tab->capacity);
+            for (uint64_t i = start; i < end; i++) if (copySlot(tab, nxt, i, tid)) done++;
+            if (done != 0) tab->copyDone.fetch_add(done);
+        }
+        tryPromote(tab, nxt, tid);
+    }
+
+    /*
+     * Common code to insert and erase.
+     * Sets the value of key to newVal and returns the previous value.
+     * newVal is TOMBSTONE for an erase.
+     */
+    uint64_t putVal(const uint64_t key, const uint64_t newVal, const int tid) {
+        if (key == KEY_EMPTY || key == KEY_MOVED) throw std::invalid_argument("key can not be ~0 or ~0-1");
+        Table* tab = hp.protect(kHpTab, head, tid);
+        while (true) {
+            Table* nxt = tab->next.load();
+            if (nxt != nullptr) {
+                nxt = protectNext(tab, kHpNext, tid);
+                if (nxt == nullptr) { tab = hp.protect(kHpTab, head, tid); continue; }
+                helpCopy(tab, nxt, tid);
+            }
+            const uint64_t mask = tab->capacity-1;
+            uint64_t idx = hash(key) & mask;
+            uint64_t k = KEY_EMPTY;
+            uint64_t iprobe = 0;
+            for (; iprobe < tab->capacity; iprobe++, idx = (idx+1) & mask) {
+                Slot& s = tab->slots[idx];
+                k = s.key.load();
+                if (k == KEY_EMPTY) {
+                    // No need to claim a slot to erase a key that isn't there
+                    if (newVal == TOMBSTONE) {
+                        hp.clear(tid);
+                        return TOMBSTONE;
+                    }
+                    if (iprobe >= REPROBE_LIMIT) break;
+                    if (s.key.compare_exchange_strong(k, key)) {
+                        if (tab->claimed.fetch_add(1)+1 > tab->capacity*3/4) startResize(tab);
+                        k = key;
+                    }
+                }
+                if (k == key || k == KEY_MOVED) break;
+            }
+            if (k != key && k != KEY_MOVED) {
+                // Too many reprobes, the table is too full. Insert in the next
+                // table, but first move the empty slot so that find() goes there too.
+                startResize(tab);
+                nxt = protectNext(tab, kHpNext, tid);
+                if (nxt == nullptr) { tab = hp.protect(kHpTab, head, tid); continue; }
+                if (iprobe != tab->capacity) {
+                    if (copySlot(tab, nxt, idx, tid)) tab->copyDone.fetch_add(1);
+                    // Someone claimed the slot before it was moved. Search again
+                    if (tab->slots[idx].key.load() != KEY_MOVED) continue;
+                }
+                tab = hp.protectPtr(kHpTab, nxt, tid);
+                continue;
+            }
+            if (k == key) {
+                Slot& slot = tab->slots[idx];
+                uint64_t val = slot.val.load();
+                while (val != MOVED && (val & PRIME) == 0) {
+                    if (slot.val.compare_exchange_strong(val, newVal)) {
+                        hp.clear(tid);
+                        return val;
+                    }
+                }
+            }
+            // The slot is being migrated: help copy it and retry in the next table
+            nxt = protectNext(tab, kHpNext, tid);
+            if (nxt == nullptr) { tab = hp.protect(kHpTab, head, tid); continue; }
+            if (copySlot(tab, nxt, idx, tid)) tab->copyDone.fetch_add(1);
+            tab = hp.protectPtr(kHpTab, nxt, tid);
+        }
+    }
+
+
+public:
+    LFHashMap(const int maxThreads=MAX_THREADS, const uint64_t initialCapacity=MIN_CAPACITY) : maxThreads{maxThreads} {
+        uint64_t cap = MIN_CAPACITY;
+        while (cap < initialCapacity) cap <<= 1;
+        head.store(new Table(cap), std::memory_order_relaxed);
+    }
+
+    ~LFHashMap() {
+        Table* tab = head.load();
+        while (tab != nullptr) {
+            Table* nxt = tab->next.load();
+            delete tab;
+            tab = nxt;
+        }
+    }
+
+    static std::string className() { return "LFHashMap"; }
+
+
+    /**
+     * Returns true if the key is in the map and stores its value in 'value'
+     *
+     * Progress Condition: lock-free
+     */
+    bool find(const uint64_t key, uint64_t& value, const int tid) {
+        Table* tab = hp.protect(kHpTab, head, tid);
+        while (true) {
+            const uint64_t mask = tab->capacity-1;
+            uint64_t idx = hash(key) & mask;
+            // If the table is full and the key isn't there, it may be in the next table
+            uint64_t val = (tab->next.load() == nullptr) ? VAL_EMPTY : MOVED;
+            for (uint64_t iprobe = 0; iprobe < tab->capacity; iprobe++, idx = (idx+1) & mask) {
+                Slot& s = tab->slots[idx];
+                const uint64_t k = s.key.load();
+                if (k == key) {
+                    val = s.val.load();
+                    break;
+                }
+                if (k == KEY_EMPTY || k == KEY_MOVED) {
+                    val = (k == KEY_EMPTY) ? VAL_EMPTY : MOVED;
+                    break;
+                }
+            }
+            if (val != MOVED) {
+                hp.clear(tid);
+                if (isAbsent(val)) return false;
+                value = val & ~PRIME;  // A primed value is still the current value
+                return true;
+            }
+            Table* nxt = protectNext(tab, kHpNext, tid);
+            if (nxt == nullptr) { tab = hp.protect(kHpTab, head, tid); continue; }
+            tab = hp.protectPtr(kHpTab, nxt, tid);
+        }
+    }
+
+
+    // Progress Condition: lock-free
+    bool contains(const uint64_t key, const int tid) {
+        uint64_t value;
+        return find(key, value, tid);
+    }
+
+
+    /**
+     * Inserts the key with the given value, or replaces the value if the key
+     * is already in the map. Returns true if the key was not in the map.
+     *
+     * Progress Condition: lock-free
+     */
+    bool insert(const uint64_t key, const uint64_t value, const int tid) {
+        if (value > MAX_VALUE) throw std::invalid_argument("value can not use the two most significant bits");
+        return isAbsent(putVal(key, value, tid));
+    }
+
+
+    /**
+     * Returns true if the key was in the map
+     *
+     * Progress Condition: lock-free
+     */
+    bool erase(const uint64_t key, const int tid) {
+        return !isAbsent(putVal(key, TOMBSTONE, tid));
+    }
+
+
+    /**
+     * Number of keys in the map. This is a scan of the table and it is only
+     * accurate when there are no concurrent modifications or resizes.
+     */
+    uint64_t size() {
+        uint64_t count = 0;
+        Table* tab = head.load();
+        for (uint64_t i = 0; i < tab->capacity; i++) {
+            uint64_t val = tab->slots[i].val.load();
+            if (!isAbsent(val) && val != MOVED) count++;
+        }
+        return count;
+    }
+
+
+    // Memory used by the current table divided by the number of keys
+    double bytesPerEntry() {
+        const uint64_t lsize = size();
+        if (lsize == 0) return 0;
+        return (double)(sizeof(Table) + head.load()->capacity*sizeof(Slot))/lsize;
+    }
+};
+
+#endif /* _LF_HASH_MAP_H_ */
@@ -32,8 +32,10 @@
 #include <map>
 #include <iterator>
 #include <atomic>
+#include <thread>
 #include "LeftRightClassic.h"
 #include "RIAtomicCounter.h"
+#include "MapFindBatch.h"
 
 /**
  * A std::map protected with a Left-Right Classic variant, using
@@ -50,6 +52,30 @@ template<typename Key, typename Value, class RI = RIAtomicCounter>
 class LRClassicMap {
 
 private:
+    /*
+     * Builds m1 and m2 from the same (sorted) range, in parallel if there is
+     * more than one core. With a single core it's faster to build one of them
+     * and copy it, because the copy constructor of std::map copies the tree
+     * structure without comparisons or rebalancing.
+     */
+    template<typename ForwardIt>
+    static void buildTwo(ForwardIt first, ForwardIt last, std::map<Key,Value>& m1, std::map<Key,Value>& m2) {
+        if (std::thread::hardware_concurrency() > 1) {
+            std::thread th([&first,&last,&m2] () {
+                std::map<Key,Value> tmp(first, last);
+                m2.swap(tmp);
+            });
+            std::map<Key,Value> tmp(first, last);
+            m1.swap(tmp);
+            th.join();
+        } else {
+            std::map<Key,Value> tmp1(first, last);
+            std::map<Key,Value> tmp2(tmp1);
+            m1.swap(tmp1);
+            m2.swap(tmp2);
+        }
+    }
+
     static const int READS_ON_LEFT=0;
     static const int READS_ON_RIGHT=1;
 
@@ -64,6 +90,16 @@ public:
         _lrc = new LeftRight::LeftRightClassic<RI>();
     }
 
+    /**
+     * Bulk-load constructor. The range must be sorted by key, which makes the
+     * construction of each std::map O(n) instead of O(n log n), and the two
+     * instances are built in parallel, one of them on a new thread (see buildTwo()).
+     */
+    template<typename ForwardIt>
+    LRClassicMap(ForwardIt first, ForwardIt last) : LRClassicMap() {
+        buildTwo(first, last, _mapLeft, _mapRight);
+    }
+
     ~LRClassicMap() {
         _mapLeft.clear();
         _mapRight.clear();
@@ -85,6 +121,54 @@ public:
     }
 
 
+    /**
+     * Looks up a single key with find() and copies its value into 'out' inside
+     * the critical section. Returns true if the key was found.
+     */
+    bool findCopy(const Key& key, Value& out) {
+        const int lvi = _lrc->arrive();
+        const std::map<Key,Value>& m = (_leftRight.load() == READS_ON_LEFT) ? _mapLeft : _mapRight;
+        auto it = m.find(key);
+        const bool found = (it != m.end());
+        if (found) out = it->second;
+        _lrc->depart(lvi);
+        return found;
+    }
+
+
+    /**
+     * Looks up n keys with a single arrive()/depart() and copies the values of
+     * the keys that were found into out[]. The walks on the tree are
+     * interleaved, see mapFindBatch().
+     * Returns the number of keys found, found[i] tells whether keys[i] was.
+     */
+    int findBatch(const Key* keys, const int n, Value* out, bool* found) {
+        const int lvi = _lrc->arrive();
+        if (_leftRight.load() == READS_ON_LEFT) {
+            const int ret = mapFindBatch(_mapLeft, keys, n, out, found);
+            _lrc->depart(lvi);
+            return ret;
+        } else {
+            const int ret = mapFindBatch(_mapRight, keys, n, out, found);
+            _lrc->depart(lvi);
+            return ret;
+        }
+    }
+
+
+    /**
+     * Calls func(key, value) for each entry, in key order, with a single
+     * arrive()/depart(). Writers will wait for it to finish, so keep func short.
+     */
+    template<typename F>
+    void forEach(F func) {
+        const int lvi = _lrc->arrive();
+        const std::map<Key,Value>& m = (_leftRight.load() == READS_ON_LEFT) ? _mapLeft : _mapRight;
+        for (auto& kv : m) func(kv.first, kv.second);
+        _lrc->depart(lvi);
+    }
+
+
     auto size() const {
         const int lvi = _lrc->arrive();
         if (_leftRight.load() == READS_ON_LEFT) {
@@ -140,6 +224,35 @@ public:
             return ret;
         }
     }
+
+
+    /**
+     * Replaces the whole contents of the map with the (sorted) range.
+     * The two new instances are built in O(n) before taking the writersMutex,
+     * in parallel (see buildTwo()), and then each one is swapped in with an O(1) swap() using
+     * the usual Left-Right pattern, so that readers see either all the old
+     * entries or all the new ones. The old entries are destroyed after the
+     * writersMutex has been released.
+     */
+    template<typename ForwardIt>
+    void replaceAll(ForwardIt first, ForwardIt last) {
+        std::map<Key,Value> newLeft;
+        std::map<Key,Value> newRight;
+        buildTwo(first, last, newLeft, newRight);
+        _lrc->writersLock();
+        if (_leftRight.load(std::memory_order_relaxed) == READS_ON_LEFT) {
+            _mapRight.swap(newRight);
+            _leftRight.store(READS_ON_RIGHT);
+            _lrc->toggleVersionAndWait();
+            _mapLeft.swap(newLeft);
+        } else {
+            _mapLeft.swap(newLeft);
+            _leftRight.store(READS_ON_LEFT);
+            _lrc->toggleVersionAndWait();
+            _mapRight.swap(newRight);
+        }
+        _lrc->writersUnlock();
+    }
 };
 
 #endif
@@ -0,0 +1,323 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _LEFT_RIGHT_SNAPSHOT_MAP_H_
+#define _LEFT_RIGHT_SNAPSHOT_MAP_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "LRClassicMap.h"
+
+
+/**
+ * <h1> Left-Right Map with an mmap-able snapshot </h1>
+ *
+ * A map that starts by serving reads from a read-only snapshot file, mapped
+ * with mmap(), and switches to a LRClassicMap (promotion) when the first
+ * write arrives. Loading the snapshot is O(1), the pages are brought in by
+ * the kernel as the lookups touch them, so the first read can be done a few
+ * milliseconds after the process starts, instead of after the minutes it
+ * takes to rebuild the maps from a database dump.
+ *
+ * The snapshot file has a 64 byte header followed by the keys and then by the
+ * values, both in Eytzinger order (the layout of a binary heap: the children
+ * of entry k are 2k and 2k+1) and with no pointers, so it can be mapped at any
+ * address. A lookup is a branch-free walk down the implicit tree, where the
+ * first levels are shared by all lookups and stay in cache, and we prefetch
+ * four levels ahead, which are 16 consecutive entries.
+ * See "Array Layouts for Comparison-Based Searching" by Khuong and Morin.
+ * Key and Value must be trivially copyable, and the file is only readable on
+ * a machine with the same endianness and type sizes as the one that wrote it.
+ *
+ * Promotion builds the LRClassicMap from the snapshot with the bulk-load
+ * constructor, on the thread doing the first write (or on a background thread
+ * if startBackgroundPromotion() is called), while the readers carry on with
+ * the snapshot. After that, all operations go to the LRClassicMap.
+ * The mapping is kept until the destructor because there may still be readers
+ * on it. Its pages are clean file pages, so the kernel can drop them.
+ *
+ * find()      - Wait-Free Population Oblivious before promotion, progress of LRClassicMap::findBatch() after
+ * insert()    - Blocking
+ * erase()     - Blocking
+ * promote()   - Blocking
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename Key, typename Value, class RI = RIAtomicCounter>
+class LRSnapshotMap {
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "LRSnapshotMap needs trivially copyable keys and values");
+
+private:
+    static const uint64_t SNAPSHOT_MAGIC = 0x3130504E53414643ULL;  // "CFSNAP01"
+    static const uint64_t SNAPSHOT_ALIGN = 64;
+
+    struct Header {
+        uint64_t magic;
+        uint64_t numEntries;
+        uint32_t keySize;
+        uint32_t valueSize;
+        uint64_t keysOffset;     // Offset of keys[0] from the start of the file. keys[0] is not used
+        uint64_t valuesOffset;   // Offset of values[0] from the start of the file. values[0] is not used
+        uint64_t fileSize;
+        uint64_t padding[2];
+    };
+
+    // The snapshot, immutable once loaded
+    void*        _mapping { MAP_FAILED };
+    size_t       _mappingSize { 0 };
+    const Key*   _keys { nullptr };
+    const Value* _values { nullptr };
+    uint64_t     _numEntries { 0 };
+
+    // The promoted map, nullptr until the first write (or explicit promotion)
+    std::atomic<LRClassicMap<Key,Value,RI>*> _map { nullptr };
+    std::mutex   _promoteMutex;
+    std::thread  _promoteThread;
+
+
+    static uint64_t alignUp(uint64_t x) { return (x + SNAPSHOT_ALIGN - 1) & ~(SNAPSHOT_ALIGN - 1); }
+
+    // Fills the Eytzinger arrays from the sorted arrays, with an in-order traversal of the implicit tree
+    static uint64_t eytzingerFill(const Key* sKeys, const Value* sValues, Key* eKeys, Value* eValues, const uint64_t n, uint64_t i, const uint64_t k) {
+        if (k <= n) {
+            i = eytzingerFill(sKeys, sValues, eKeys, eValues, n, i, 2*k);
+            eKeys[k] = sKeys[i];
+            eValues[k] = sValues[i];
+            i++;
+            i = eytzingerFill(sKeys, sValues, eKeys, eValues, n, i, 2*k+1);
+        }
+        return i;
+    }
+
+    // The inverse of eytzingerFill(), appends the snapshot's entries to 'sorted' in key order
+    void inOrder(std::vector<std::pair<Key,Value>>& sorted, const uint64_t k) const {
+        if (k <= _numEntries) {
+            inOrder(sorted, 2*k);
+            sorted.push_back(std::make_pair(_keys[k], _values[k]));
+            inOrder(sorted, 2*k+1);
+        }
+    }
+
+    bool snapshotFind(const Key& key, Value& value) const {
+        uint64_t k = 1;
+        while (k <= _numEntries) {
+            __builtin_prefetch(_keys + 16*k);
+            k = 2*k + (_keys[k] < key);
+        }
+        // Remove the trailing right turns (and the last left turn) to get the index of the lower bound
+        k >>= __builtin_ffsll(~k);
+        if (k == 0 || key < _keys[k]) return false;
+        value = _values[k];
+        return true;
+    }
+
+    // Writes the sorted arrays to a new file, which is then renamed to path, so that a crash never leaves a partial snapshot
+    static void writeSorted(const std::vector<Key>& sKeys, const std::vector<Value>& sValues, const std::string& path) {
+        const uint64_t n = sKeys.size();
+        std::vector<Key> eKeys(n+1);
+        std::vector<Value> eValues(n+1);
+        eytzingerFill(sKeys.data(), sValues.data(), eKeys.data(), eValues.data(), n, 0, 1);
+        Header h {};
+        h.magic = SNAPSHOT_MAGIC;
+        h.numEntries = n;
+        h.keySize = sizeof(Key);
+        h.valueSize = sizeof(Value);
+        h.keysOffset = alignUp(sizeof(Header));
+        h.valuesOffset = alignUp(h.keysOffset + (n+1)*sizeof(Key));
+        h.fileSize = h.valuesOffset + (n+1)*sizeof(Value);
+        const std::string tmpPath = path + ".tmp";
+        FILE* f = fopen(tmpPath.c_str(), "wb");
+        if (f == nullptr) throw std::runtime_error("LRSnapshotMap: could not create " + tmpPath);
+        static const char zeros[SNAPSHOT_ALIGN] = { 0 };
+        bool ok = fwrite(&h, sizeof(Header), 1, f) == 1;
+        ok = ok && fwrite(zeros, 1, h.keysOffset - sizeof(Header), f) == h.keysOffset - sizeof(Header);
+        ok = ok && fwrite(eKeys.data(), sizeof(Key), n+1, f) == n+1;
+        ok = ok && fwrite(zeros, 1, h.valuesOffset - h.keysOffset - (n+1)*sizeof(Key), f) == h.valuesOffset - h.keysOffset - (n+1)*sizeof(Key);
+        ok = ok && fwrite(eValues.data(), sizeof(Value), n+1, f) == n+1;
+        ok = (fflush(f) == 0) && ok;
+        ok = (fsync(fileno(f)) == 0) && ok;
+        ok = (fclose(f) == 0) && ok;
+        if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+            unlink(tmpPath.c_str());
+            throw std::runtime_error("LRSnapshotMap: could not write " + path);
+        }
+    }
+
+public:
+    /**
+     * Empty map, already promoted
+     */
+    LRSnapshotMap() {
+        _map.store(new LRClassicMap<Key,Value,RI>());
+    }
+
+    /**
+     * Maps the snapshot file at path. Throws std::runtime_error if the file
+     * can't be mapped or was not written by writeSnapshot() for these types.
+     */
+    LRSnapshotMap(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("LRSnapshotMap: could not open " + path);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Header)) {
+            close(fd);
+            throw std::runtime_error("LRSnapshotMap: " + path + " is not a snapshot");
+        }
+        _mappingSize = st.st_size;
+        _mapping = mmap(nullptr, _mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);  // The mapping keeps its own reference to the file
+        if (_mapping == MAP_FAILED) throw std::runtime_error("LRSnapshotMap: could not mmap " + path);
+        const Header* h = (const Header*)_mapping;
+        if (h->magic != SNAPSHOT_MAGIC || h->keySize != sizeof(Key) || h->valueSize != sizeof(Value) ||
+            h->fileSize != _mappingSize || h->keysOffset % SNAPSHOT_ALIGN != 0 || h->valuesOffset % SNAPSHOT_ALIGN != 0 ||
+            h->keysOffset + (h->numEntries+1)*sizeof(Key) > h->valuesOffset ||
+            h->valuesOffset + (h->numEntries+1)*sizeof(Value) > _mappingSize) {
+            munmap(_mapping, _mappingSize);
+            throw std::runtime_error("LRSnapshotMap: " + path + " is not a snapshot for this map type");
+        }
+        _numEntries = h->numEntries;
+        _keys = (const Key*)((const char*)_mapping + h->keysOffset);
+        _values = (const Value*)((const char*)_mapping + h->valuesOffset);
+    }
+
+    ~LRSnapshotMap() {
+        if (_promoteThread.joinable()) _promoteThread.join();
+        delete _map.load();
+        if (_mapping != MAP_FAILED) munmap(_mapping, _mappingSize);
+    }
+
+    static std::string className() { return "LRSnapshotMap"; }
+
+
+    /**
+     * Writes the current instance of a LRClassicMap to a snapshot file.
+     * The entries are copied inside a single read critical section.
+     */
+    static void writeSnapshot(LRClassicMap<Key,Value,RI>& map, const std::string& path) {
+        std::vector<Key> sKeys;
+        std::vector<Value> sValues;
+        map.forEach([&sKeys,&sValues] (const Key& key, const Value& value) {
+            sKeys.push_back(key);
+            sValues.push_back(value);
+        });
+        writeSorted(sKeys, sValues, path);
+    }
+
+    /**
+     * Writes the current contents of this map to a snapshot file
+     */
+    void writeSnapshot(const std::string& path) {
+        LRClassicMap<Key,Value,RI>* m = _map.load();
+        if (m != nullptr) {
+            writeSnapshot(*m, path);
+            return;
+        }
+        std::vector<std::pair<Key,Value>> sorted;
+        sorted.reserve(_numEntries);
+        inOrder(sorted, 1);
+        std::vector<Key> sKeys(_numEntries);
+        std::vector<Value> sValues(_numEntries);
+        for (uint64_t i = 0; i < _numEntries; i++) {
+            sKeys[i] = sorted[i].first;
+            sValues[i] = sorted[i].second;
+        }
+        writeSorted(sKeys, sValues, path);
+    }
+
+
+    /**
+     * Builds the LRClassicMap from the snapshot, if it wasn't already, and
+     * returns it. Readers keep using the snapshot until it's done.
+     */
+    LRClassicMap<Key,Value,RI>* promote() {
+        LRClassicMap<Key,Value,RI>* m = _map.load();
+        if (m != nullptr) return m;
+        std::lock_guard<std::mutex> lock(_promoteMutex);
+        m = _map.load();
+        if (m != nullptr) return m;
+        std::vector<std::pair<Key,Value>> sorted;
+        sorted.reserve(_numEntries);
+        inOrder(sorted, 1);
+        m = new LRClassicMap<Key,Value,RI>(sorted.begin(), sorted.end());
+        _map.store(m);
+        return m;
+    }
+
+    /**
+     * Starts promote() on a new thread, for when writes are expected soon.
+     * Must be called at most once.
+     */
+    void startBackgroundPromotion() {
+        _promoteThread = std::thread([this] () { promote(); });
+    }
+
+    bool isPromoted() { return _map.load() != nullptr; }
+
+
+    /**
+     * Copies the value of key into 'value' and returns true if key is in the map
+     */
+    bool find(const Key& key, Value& value) {
+        LRClassicMap<Key,Value,RI>* m = _map.load();
+        if (m == nullptr) return snapshotFind(key, value);
+        bool found;
+        m->findBatch(&key, 1, &value, &found);
+        return found;
+    }
+
+    uint64_t size() {
+        LRClassicMap<Key,Value,RI>* m = _map.load();
+        if (m == nullptr) return _numEntries;
+        return m->size();
+    }
+
+    auto insert(std::pair<Key,Value> val) {
+        return promote()->insert(val);
+    }
+
+    auto erase(const Key& key) {
+        return promote()->erase(key);
+    }
+};
+
+#endif /* _LEFT_RIGHT_SNAPSHOT_MAP_H_ */
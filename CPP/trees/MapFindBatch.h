@@ -0,0 +1,137 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _MAP_FIND_BATCH_H_
+#define _MAP_FIND_BATCH_H_
+
+#include <map>
+
+
+/**
+ * <h1> Batched lookups on a std::map with interleaved tree walks </h1>
+ *
+ * Looks up n keys in a std::map and copies the value of each key that is
+ * found into out[i], setting found[i] accordingly. Returns the number of keys
+ * that were found.
+ *
+ * Each lookup in a large tree is a chain of dependent cache misses, one per
+ * level, and doing them one after the other means the CPU waits for each miss
+ * on its own. Here we keep up to min(n, FIND_BATCH_WIDTH) walks in flight and
+ * advance them round-robin, one level at a time: after moving a walk down to
+ * a child we prefetch the child and go on to the next walk, so that by the time
+ * we come back to it, the node is (hopefully) in the cache.
+ * This is the AMAC technique (Asynchronous Memory Access Chaining) described in
+ * "Asynchronous Memory Access Chaining" by Kocberber, Falsafi and Grot, VLDB 2015.
+ *
+ * To walk the tree we need its nodes, which std::map doesn't expose, so this
+ * uses the red-black tree layout of libstdc++ (_Rb_tree_node_base) directly.
+ * For other standard libraries it falls back to calling find() for each key.
+ *
+ * This function does no synchronization, so it should be called inside a
+ * read-only critical section, like in LRClassicMap::findBatch().
+ *
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+static const int FIND_BATCH_WIDTH = 16;
+
+template<typename Key, typename Value, typename Compare, typename Alloc>
+int mapFindBatch(const std::map<Key,Value,Compare,Alloc>& m, const Key* keys, const int n, Value* out, bool* found) {
+    int numFound = 0;
+#ifdef __GLIBCXX__
+    typedef const std::_Rb_tree_node_base* NodeBase;
+    typedef const std::_Rb_tree_node<typename std::map<Key,Value,Compare,Alloc>::value_type>* Node;
+    const Compare comp = m.key_comp();
+    const NodeBase root = m.end()._M_node->_M_parent;
+    NodeBase nodes[FIND_BATCH_WIDTH];
+    int ikeys[FIND_BATCH_WIDTH];
+    // No point in sweeping more slots than there are keys
+    const int width = (n < FIND_BATCH_WIDTH) ? n : FIND_BATCH_WIDTH;
+    int nextKey = 0;
+    int numActive = 0;
+    for (int is = 0; is < width; is++) {
+        if (nextKey < n) {
+            nodes[is] = root;
+            ikeys[is] = nextKey++;
+            numActive++;
+        } else {
+            ikeys[is] = -1;
+        }
+    }
+    if (root != nullptr) __builtin_prefetch(static_cast<Node>(root)->_M_valptr());
+    while (numActive > 0) {
+        for (int is = 0; is < width; is++) {
+            const int ikey = ikeys[is];
+            if (ikey < 0) continue;
+            NodeBase x = nodes[is];
+            bool done = (x == nullptr);
+            if (done) {
+                found[ikey] = false;
+            } else {
+                const auto* kv = static_cast<Node>(x)->_M_valptr();
+                if (comp(keys[ikey], kv->first)) {
+                    x = x->_M_left;
+                } else if (comp(kv->first, keys[ikey])) {
+                    x = x->_M_right;
+                } else {
+                    out[ikey] = kv->second;
+                    found[ikey] = true;
+                    numFound++;
+                    done = true;
+                }
+            }
+            if (!done) {
+                // Still walking down, prefetch the child and move on to the next walk
+                nodes[is] = x;
+                if (x != nullptr) __builtin_prefetch(static_cast<Node>(x)->_M_valptr());
+                continue;
+            }
+            // This walk is done, reuse the slot for the next key, if there is one
+            if (nextKey < n) {
+                nodes[is] = root;
+                ikeys[is] = nextKey++;
+            } else {
+                ikeys[is] = -1;
+                numActive--;
+            }
+        }
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        auto it = m.find(keys[i]);
+        found[i] = (it != m.end());
+        if (found[i]) {
+            out[i] = it->second;
+            numFound++;
+        }
+    }
+#endif
+    return numFound;
+}
+
+#endif /* _MAP_FIND_BATCH_H_ */
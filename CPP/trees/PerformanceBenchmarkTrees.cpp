@@ -8,6 +8,7 @@
 #include <iostream>
 #include <stdlib.h>
 #include <vector>
+#include <string>
 #include <algorithm>  // used by std::sort
 #include "PerformanceBenchmarkTrees.h"
 
@@ -20,18 +21,18 @@ PerformanceBenchmarkTrees::PerformanceBenchmarkTrees(int numThreads, int numMili
 
     std::cout << "Filling up data structures...\n";
     for (int i = 0; i < numElements; i++) udarray[i].a = i;
+    // The Left-Right based ones can be bulk-loaded from a sorted range
+    std::vector<std::pair<int,UserData>> sortedPairs;
+    for (int i = 0; i < numElements; i++) sortedPairs.push_back(std::make_pair(i,udarray[i]));
+    lrcAtomicCounterMap.replaceAll(sortedPairs.begin(), sortedPairs.end());
+    lrcDCLCMap.replaceAll(sortedPairs.begin(), sortedPairs.end());
+    lrcLambda.replaceAll(sortedPairs.begin(), sortedPairs.end());
     for (int i = 0; i < numElements; i++) {
         UserData& udp = udarray[i];
-        lrcAtomicCounterMap.insert( std::pair<int,UserData>(i,udp) );
-        lrcDCLCMap.insert( std::pair<int,UserData>(i,udp) );
         rwlockPthreadMap.insert( std::pair<int,UserData>(i,udp) );
         //rwlockSMMap.insert( std::pair<int,UserData>(i,udp) ); // This causes weird bugs
         cowLockMap.insert( std::pair<int,UserData>(i,udp) );
-        // Lambdas are tricky
-        std::function<bool(std::map<int,UserData>*,std::pair<int,UserData>)> insertLambda =
-            [](std::map<int,UserData>* _map, std::pair<int,UserData> _pair) { _map->insert(_pair); return true; };
-        auto ipair = std::make_pair(i,udarray[i]);
-        lrcLambda.applyMutation<bool,std::pair<int,UserData>>( ipair, insertLambda );
+        lfHashMap.insert(i, udp.a, 0);
 
         // TODO: Add new data structures here
     }
@@ -52,8 +53,12 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
 	std::cout << "##### " << test_case_names[testCase] << "  numRuns=" << _numRuns << "   Writes=" << writePercentage << "%   ##### \n";
 	std::vector<long long> arrayReadOps(_numRuns);
 	std::vector<long long> arrayWriteOps(_numRuns);
+	std::vector<CPUAccounting> arrayCPU(_numRuns);
+	std::vector<ThroughputSampler::Summary> arraySummary(_numRuns);
 
 	for (int irun = 0; irun < _numRuns; irun++) {
+        arrayCPU[irun].start();
+        sampler.start(std::chrono::milliseconds(10), std::chrono::milliseconds(_numMilis));
         for (int i = 0; i < _numThreads; i++ ) _workerThread[i] = new WorkerThread(this, testCase, i, writePerMil, false);
 
         std::chrono::milliseconds dura(_numMilis);
@@ -62,13 +67,17 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
         // Tell the worker threads to stop and join up with the other threads
         for (int i = 0; i < _numThreads; i++) _workerThread[i]->quit.store(true);
         for (int i = 0; i < _numThreads; i++) _workerThread[i]->th->join();
+        arrayCPU[irun].stop();
+        sampler.stop();
+        arraySummary[irun] = sampler.summary();
         std::atomic_thread_fence(std::memory_order_seq_cst);
 
-        // Measure the number of performed operations
+        // Measure the number of performed operations and the CPU time used to do them
         arrayReadOps[irun]  = 0;
         arrayWriteOps[irun] = 0;
         for (int i = 0; i < _numThreads; i++) arrayReadOps[irun]  += _workerThread[i]->aNumReadOps.load();
         for (int i = 0; i < _numThreads; i++) arrayWriteOps[irun] += _workerThread[i]->aNumWriteOps.load();
+        for (int i = 0; i < _numThreads; i++) arrayCPU[irun].addThread(_workerThread[i]->cpuDelta);
 
         std::atomic_thread_fence(std::memory_order_seq_cst);
         for (int i = 0; i < _numThreads; i++) delete _workerThread[i];
@@ -78,6 +87,7 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
     int medianRun = _numRuns/2;
     long long medianReads = 0;
     long long medianWrites = 0;
+    int medianIndex = 0;
     if (arrayReadOps[0] != 0) {
         std::vector<long long> s(arrayReadOps);
         std::sort(s.begin(), s.end());
@@ -85,6 +95,7 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
             if (arrayReadOps[irun] == s[medianRun]) {
                 medianReads = arrayReadOps[irun];
                 medianWrites = arrayWriteOps[irun];
+                medianIndex = irun;
                 break;
             }
         }
@@ -95,6 +106,7 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
             if (arrayWriteOps[irun] == s[medianRun]) {
                 medianReads = arrayReadOps[irun];
                 medianWrites = arrayWriteOps[irun];
+                medianIndex = irun;
                 break;
             }
         }
@@ -102,11 +114,47 @@ void PerformanceBenchmarkTrees::singleTest(test_case_enum_t testCase, int writeP
 
     std::cout << "Read Ops/sec = " << (1000LL*medianReads/_numMilis) << "   ";
     std::cout << "Write Ops/sec = " << (1000LL*medianWrites/_numMilis) << "\n";
+    arrayCPU[medianIndex].print(medianReads+medianWrites, _numMilis/1000.);
+    arraySummary[medianIndex].print();
+    // For the hash map the read ops are lookups, and the footprint depends on the resizes and tombstones
+    if (testCase == TC_TREES_LFHASHMAP) std::cout << "Bytes per entry = " << lfHashMap.bytesPerEntry() << "\n";
     // Add the results to the database
     addRun(testCase, writePerMil, _numThreads, (1000LL*(medianReads+medianWrites)/_numMilis));
 }
 
 
+/*
+ * Soak test: a single run of numMinutes, sampled every 100 ms, to look for
+ * long-run degradation, like the RSS going up because retired nodes are never
+ * reclaimed. Shows a progress line every minute, and at the end the summary
+ * and the whole time series in csv format.
+ */
+void PerformanceBenchmarkTrees::soakTest(test_case_enum_t testCase, int writePerMil, int numMinutes) {
+    double writePercentage = writePerMil == 0 ? 0 : writePerMil/10.;
+    std::cout << "##### " << test_case_names[testCase] << "  Soak for " << numMinutes << " minutes   Writes=" << writePercentage << "%   ##### \n";
+    sampler.start(std::chrono::milliseconds(100), std::chrono::minutes(numMinutes));
+    for (int i = 0; i < _numThreads; i++ ) _workerThread[i] = new WorkerThread(this, testCase, i, writePerMil, false);
+
+    uint64_t prevTotal = 0;
+    for (int iminute = 1; iminute <= numMinutes; iminute++) {
+        std::this_thread::sleep_for(std::chrono::minutes(1));
+        const uint64_t total = sampler.total();
+        std::cout << "minute " << iminute << "   Ops/sec = " << (total-prevTotal)/60 << "   RSS = " << ThroughputSampler::readRSSKB() << " KB\n";
+        prevTotal = total;
+    }
+
+    // Tell the worker threads to stop and join up with the other threads
+    for (int i = 0; i < _numThreads; i++) _workerThread[i]->quit.store(true);
+    for (int i = 0; i < _numThreads; i++) _workerThread[i]->th->join();
+    sampler.stop();
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (int i = 0; i < _numThreads; i++) delete _workerThread[i];
+
+    sampler.summary().print();
+    sampler.printTimeSeries();
+}
+
+
 /*
  * Dedicated tests with 2 threads reserved for Writers and the remaining ones for Readers
  */
@@ -360,6 +408,7 @@ void someTests(void) {
         TC_TREES_RWL_PT,
         TC_TREES_LRCLASSIC_ATOMIC, TC_TREES_LRCLASSIC_DCLC,
         TC_TREES_COWLOCK_LRC_ATOMIC,
+        TC_TREES_LFHASHMAP,
     };
     int durationMiliseconds = 10000; // 10 seconds per test
     int numRuns = 1;   // Should be 5 for final benchmarks
@@ -388,9 +437,41 @@ void someTests(void) {
 }
 
 
+/*
+ * Soak tests, numMinutes per data structure
+ */
+void soakTests(const int numMinutes) {
+    test_case_enum_t testList[] = {
+        TC_TREES_LRCLASSIC_ATOMIC,
+        TC_TREES_COWLOCK_LRC_ATOMIC,
+        TC_TREES_LFHASHMAP,
+    };
+    const int numThreads = 4;
+    for (unsigned int itest = 0; itest < sizeof(testList)/sizeof(test_case_enum_t); itest++) {
+        PerformanceBenchmarkTrees pf(numThreads, 0, 1);
+        std::cout << "Number of items = " << numElements << "  and number of threads = " << numThreads << "\n";
+        pf.soakTest(testList[itest], 100, numMinutes);
+        std::cout << "\n";
+    }
+}
+
+
 
-int main(void) {
-    someTests();
+int main(int argc, char *argv[]) {
+    if (argc == 1) {
+        someTests();
+    } else if (std::string(argv[1]) == "soak") {
+        // Soak tests: ./trees soak [minutes], the default is one hour per data structure
+        const int numMinutes = (argc > 2) ? std::stoi(argv[2]) : 60;
+        if (numMinutes < 1) {
+            std::cout << "Usage: trees [soak [minutes]]\n";
+            return 1;
+        }
+        soakTests(numMinutes);
+    } else {
+        std::cout << "Usage: trees [soak [minutes]]\n";
+        return 1;
+    }
     //cppcon2015Mixed();
     //cppcon2015Dedicated();
     //cppcon2015Latency(); // WARNING: set numElements to 10000
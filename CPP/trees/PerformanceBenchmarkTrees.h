@@ -24,6 +24,9 @@
 #include "RWLockSharedMutexMap.h"
 #include "COWLockMap.h"
 #include "LeftRightClassicLambda.h"
+#include "LFHashMap.h"
+#include "CPUAccounting.hpp"
+#include "ThroughputSampler.hpp"
 //#include "CRWWPSharedMutex.h"
 
 #define MAX_RUNS  10
@@ -64,6 +67,8 @@ public:
     //LeftRight::LeftRightClassicLambda<std::map<int,UserData>>   lrcLambda {std::map<int,UserData>{}, std::map<int,UserData>{}};
     LeftRight::LeftRightClassicLambda<std::map<int,UserData>>   lrcLambda;
     COWLockMap<int,UserData> cowLockMap;
+    LFHashMap lfHashMap;
+    ThroughputSampler sampler;  // Counts the operations of all workers for the time series
 
     // Forward declaration
     class WorkerThread;
@@ -78,7 +83,8 @@ public:
         long numOps;
         long numReadOps;
         long numWriteOps;
-        std::thread * const th = new std::thread(&WorkerThread::run, this);
+        CPUSample cpuDelta;                 // CPU time and context switches spent in run()
+        std::thread * th = nullptr;         // Started last in the constructor, run() uses all the other members
         PerformanceBenchmarkTrees * const pbl;
         const test_case_enum_t testCase = TC_TREES_MAX;
         const int tidx;
@@ -102,6 +108,7 @@ public:
             numReadOps = 0;
             numWriteOps = 0;
             resetHistograms();
+            th = new std::thread(&WorkerThread::run, this);
         }
 
         ~WorkerThread() {
@@ -143,6 +150,7 @@ public:
             numOps            = 0;
             numReadOps        = 0;
             numWriteOps       = 0;
+            const CPUSample cpuStart = CPUSample::thread();
 
             //auto nadaLambda = [](auto _map, auto _key) { return _map->find(_key) != _map->end(); };
             std::function<bool(std::map<int,UserData>*,int)> findLambda =
@@ -202,6 +210,10 @@ public:
                         pbl->cowLockMap.find(i1);
                         pbl->cowLockMap.find(i2);
                         break;
+                    case TC_TREES_LFHASHMAP:
+                        pbl->lfHashMap.contains(i1, tidx);
+                        pbl->lfHashMap.contains(i2, tidx);
+                        break;
                     case TC_TREES_MAX:
                         std::cout << "ERROR\n";
                         break;
@@ -281,6 +293,20 @@ public:
                             storeAddLinearLatency(diff.count());
                         }
                         break;
+                    case TC_TREES_LFHASHMAP:
+                        if (measureLatency) startBeats = std::chrono::steady_clock::now();
+                        pbl->lfHashMap.erase(i1, tidx);
+                        if (measureLatency) {
+                            auto diff = std::chrono::steady_clock::now()-startBeats;
+                            storeRemoveLinearLatency(diff.count());
+                            startBeats = std::chrono::steady_clock::now();
+                        }
+                        pbl->lfHashMap.insert(i1, udarray[i1].a, tidx);
+                        if (measureLatency) {
+                            auto diff = std::chrono::steady_clock::now()-startBeats;
+                            storeAddLinearLatency(diff.count());
+                        }
+                        break;
                     case TC_TREES_MAX:
                         std::cout << "ERROR\n";
                         break;
@@ -293,10 +319,12 @@ public:
                     numWriteOps+=2;
 					numOps+=2;
 				}
+				pbl->sampler.add(tidx, 2);
 			}
 			aNumOps.store(numOps);
 			aNumReadOps.store(numReadOps);
 			aNumWriteOps.store(numWriteOps);
+			cpuDelta = CPUSample::thread() - cpuStart;
 			//std::cout << " numWriteOps=" << numWriteOps << "\n";
 		}
 
@@ -318,6 +346,7 @@ public:
 	void singleTest(test_case_enum_t testCase, int writePerMil);
 	void dedicatedTest(test_case_enum_t testCase);
 	void singleLatencyTest(test_case_enum_t testCase);
+	void soakTest(test_case_enum_t testCase, int writePerMil, int numMinutes);
 	void addRun(test_case_enum_t testCase, int writePerMil, int numThreads, long opsPerSec);
 	void saveDB(int writePerMil);
 
@@ -0,0 +1,16 @@
+/*
+ * SnapshotBenchmark.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkSnapshot.h"
+
+
+
+int main(void) {
+    BenchmarkSnapshot::allTests();
+    return 0;
+}
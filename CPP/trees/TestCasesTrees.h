@@ -40,6 +40,7 @@ enum test_case_enum_t {
     TC_TREES_LRCLASSIC_PER_THREAD,
     TC_TREES_LRCLASSIC_LAMBDA,
     TC_TREES_COWLOCK_LRC_ATOMIC, // Copy-On-Write with Left-Right Classic (RIAtomicCounter)
+    TC_TREES_LFHASHMAP,          // Lock-Free linear probing hash map (not a tree, but same API)
     TC_TREES_MAX
 };
 
@@ -53,7 +54,8 @@ static std::string test_case_names[] = {
     "LRClassicMap (RIDCLC)                ",
     "LRClassicMap (RIEntryPerThread)      ",
     "LRCLambda (RIAtomicCounter+std::map) ",
-    "COWLockMap (LRC+RIAtomicCounter)     "
+    "COWLockMap (LRC+RIAtomicCounter)     ",
+    "LFHashMap                            "
 };
 
 #endif /* _TEST_CASES_H_ */
@@ -2,5 +2,17 @@
 @rem compile > a.txt 2>&1
 
 @rem For std::shared_mutex
-g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../locks -I../leftright PerformanceBenchmarkTrees.cpp -o trees.exe -lstdc++ -lpthread
+g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../usdt -I../metrics -I../locks -I../leftright -I../queues PerformanceBenchmarkTrees.cpp -o trees.exe -lstdc++ -lpthread
 
+
+@rem Batched lookups
+g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../usdt FindBatchBenchmark.cpp -o findbatch.exe -lpthread
+
+@rem Bulk loading
+g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../usdt BulkLoadBenchmark.cpp -o bulkload.exe -lpthread
+
+@rem Snapshots (needs mmap, so not for MinGW)
+g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../usdt SnapshotBenchmark.cpp -o snapshot.exe -lpthread
+
+@rem Index and reverse index in a Left-Right group
+g++ -Wall -O3 -std=c++14 -I../leftright -I../readindicators -I../usdt GroupBenchmark.cpp -o group.exe -lpthread
@@ -0,0 +1,280 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _BENCHMARK_UNIVERSAL_H_
+#define _BENCHMARK_UNIVERSAL_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <iostream>
+#include "CRWWPFlatCombining.hpp"
+#include "LeftRightFlatCombining.hpp"
+#include "CXMutation.hpp"
+#include "TL2SkipListSet.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * A sequential set on top of std::set, with the interface that the
+ * *Set wrappers of the universal constructs expect.
+ */
+template<typename K>
+class StdSet {
+    std::set<K> set;
+
+public:
+    static std::string className() { return "std::set"; }
+
+    bool add(K* key) { return set.insert(*key).second; }
+
+    bool remove(K* key) { return set.erase(*key) > 0; }
+
+    bool contains(K* key) { return set.count(*key) > 0; }
+};
+
+
+/**
+ * This is a micro-benchmark for the universal constructs, with a std::set
+ * as the sequential object.
+ */
+class BenchmarkUniversal {
+
+private:
+    int numThreads;
+
+public:
+    BenchmarkUniversal(int numThreads) {
+        this->numThreads = numThreads;
+    }
+
+
+    /**
+     * When doing "updates" we execute a random removal and if the removal is successful we do an add() of the
+     * same item immediately after. This keeps the size of the data structure equal to the original size (minus
+     * MAX_THREADS items at most) which gives more deterministic results.
+     */
+    template<typename S>
+    long long benchmark(const int updateRatio, const seconds testLengthSeconds, const int numRuns, const int numElements) {
+        long long ops[numThreads][numRuns];
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        S* set = nullptr;
+
+        // The keys must live for as long as the set because the lambdas capture a pointer to them
+        uint64_t* keys = new uint64_t[numElements];
+        for (int i = 0; i < numElements; i++) keys[i] = i;
+
+        // Can either be a Reader or a Writer
+        auto rw_lambda = [this,&updateRatio,&quit,&startFlag,&set,&keys,&numElements](long long *ops, const int tid) {
+            long long numOps = 0;
+            uint64_t seed = tid+1234567890123456781ULL;
+            while (!startFlag.load()) { } // spin
+            while (!quit.load()) {
+                seed = randomLong(seed);
+                auto ix = (unsigned int)(seed%numElements);
+                seed = randomLong(seed);
+                auto ratio = seed%10000;  // Ratios are in per-10k units
+                if (ratio < (uint64_t)updateRatio) {
+                    // I'm a Writer
+                    if (set->remove(&keys[ix], tid)) set->add(&keys[ix], tid);
+                } else {
+                    // I'm a Reader
+                    set->contains(&keys[ix], tid);
+                    seed = randomLong(seed);
+                    ix = (unsigned int)(seed%numElements);
+                    set->contains(&keys[ix], tid);
+                }
+                numOps+=2;
+            }
+            *ops = numOps;
+        };
+
+        for (int irun = 0; irun < numRuns; irun++) {
+            set = new S(numThreads);
+            // Add all the keys to the set
+            for (int i = 0; i < numElements; i++) set->add(&keys[i], 0);
+            if (irun == 0) cout << "##### " << set->className() << " #####  \n";
+            thread rwThreads[numThreads];
+            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, &ops[tid][irun], tid);
+            startFlag.store(true);
+            this_thread::sleep_for(testLengthSeconds);
+            quit.store(true);
+            for (int tid = 0; tid < numThreads; tid++) rwThreads[tid].join();
+            quit.store(false);
+            startFlag.store(false);
+            // Every remove() was followed by an add() so all the keys must still be there
+            for (int i = 0; i < numElements; i++) {
+                if (!set->contains(&keys[i], 0)) cout << "ERROR: key " << keys[i] << " is missing\n";
+            }
+            delete set;
+        }
+
+        delete[] keys;
+
+        // Accounting
+        vector<long long> agg(numRuns);
+        for (int irun = 0; irun < numRuns; irun++) {
+            agg[irun] = 0;
+            for (int tid = 0; tid < numThreads; tid++) {
+                agg[irun] += ops[tid][irun];
+            }
+        }
+
+        // Compute the median, max and min. numRuns must be an odd number
+        sort(agg.begin(),agg.end());
+        auto maxops = agg[numRuns-1];
+        auto minops = agg[0];
+        auto medianops = agg[numRuns/2];
+        auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
+        medianops /= testLengthSeconds.count();
+
+        std::cout << "Ops/sec = " << medianops << "   delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
+        return medianops;
+    }
+
+
+    /**
+     * An imprecise but fast random number generator
+     */
+    static uint64_t randomLong(uint64_t x) {
+        x ^= x >> 12; // a
+        x ^= x << 25; // b
+        x ^= x >> 27; // c
+        return x * 2685821657736338717LL;
+    }
+
+
+public:
+
+    static void allThroughputTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        vector<int> ratioList = { 10000, 5000, 1000, 100, 0 }; // per-10k ratio: 100%, 50%, 10%, 1%, 0%
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int numElements = 1000;
+        const int NUM_CLASSES = 4;
+        std::string classNames[NUM_CLASSES] = {
+            CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className(),
+            LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className(),
+            CXMutationSet<StdSet<uint64_t>,uint64_t>::className(),
+            TL2SkipListSet<uint64_t>::className()
+        };
+        long long ops[NUM_CLASSES][ratioList.size()][threadList.size()];
+
+        for (unsigned iratio = 0; iratio < ratioList.size(); iratio++) {
+            auto ratio = ratioList[iratio];
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                auto nThreads = threadList[ithread];
+                BenchmarkUniversal bench(nThreads);
+                std::cout << "\n----- Universal Constructs Benchmark   numElements=" << numElements << "   ratio=" << ratio/100. << "%   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                ops[0][iratio][ithread] = bench.benchmark<CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>>(ratio, testLength, numRuns, numElements);
+                ops[1][iratio][ithread] = bench.benchmark<LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>>(ratio, testLength, numRuns, numElements);
+                ops[2][iratio][ithread] = bench.benchmark<CXMutationSet<StdSet<uint64_t>,uint64_t>>(ratio, testLength, numRuns, numElements);
+                ops[3][iratio][ithread] = bench.benchmark<TL2SkipListSet<uint64_t>>(ratio, testLength, numRuns, numElements);
+            }
+        }
+
+        // Show results in .csv format
+        cout << "\n\nResults in ops per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s,  numElements=" << numElements << "\n";
+        for (unsigned iratio = 0; iratio < ratioList.size(); iratio++) {
+            cout << "\nUpdate ratio: " << ratioList[iratio]/100. << "%\n";
+            cout << "Threads, ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << classNames[ic] << ", ";
+            cout << "\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][iratio][ithread] << ", ";
+                cout << "\n";
+            }
+        }
+    }
+
+
+    /**
+     * Disjoint-access parallelism: with a large set, two random updates
+     * rarely touch the same nodes, so the STM can commit them in parallel,
+     * while the universal constructs always apply the updates one at a time.
+     * We also show the percentage of aborted transactions of the STM.
+     */
+    static void disjointAccessTests() {
+        vector<int> threadList = { 1, 2, 4, 8, 16, 32, 64 };
+        vector<int> ratioList = { 5000, 1000 }; // per-10k ratio: 50%, 10%
+        const int numRuns = 5;
+        const seconds testLength = 10s;
+        const int numElements = 100000;
+        const int NUM_CLASSES = 3;
+        std::string classNames[NUM_CLASSES] = {
+            CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className(),
+            LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>::className(),
+            TL2SkipListSet<uint64_t>::className()
+        };
+        long long ops[NUM_CLASSES][ratioList.size()][threadList.size()];
+        double abortPct[ratioList.size()][threadList.size()];
+
+        for (unsigned iratio = 0; iratio < ratioList.size(); iratio++) {
+            auto ratio = ratioList[iratio];
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                auto nThreads = threadList[ithread];
+                BenchmarkUniversal bench(nThreads);
+                std::cout << "\n----- Disjoint Access Benchmark   numElements=" << numElements << "   ratio=" << ratio/100. << "%   numThreads=" << nThreads << "   numRuns=" << numRuns << "   length=" << testLength.count() << "s -----\n";
+                ops[0][iratio][ithread] = bench.benchmark<CRWWPFlatCombiningSet<StdSet<uint64_t>,uint64_t>>(ratio, testLength, numRuns, numElements);
+                ops[1][iratio][ithread] = bench.benchmark<LeftRightFlatCombiningSet<StdSet<uint64_t>,uint64_t>>(ratio, testLength, numRuns, numElements);
+                const long commitsBefore = tl2::getNumCommits();
+                const long abortsBefore = tl2::getNumAborts();
+                ops[2][iratio][ithread] = bench.benchmark<TL2SkipListSet<uint64_t>>(ratio, testLength, numRuns, numElements);
+                const long commits = tl2::getNumCommits() - commitsBefore;
+                const long aborts = tl2::getNumAborts() - abortsBefore;
+                abortPct[iratio][ithread] = (commits+aborts == 0) ? 0 : (100.*aborts)/(commits+aborts);
+                std::cout << "TL2 aborts = " << abortPct[iratio][ithread] << "%\n";
+            }
+        }
+
+        // Show results in .csv format
+        cout << "\n\nResults in ops per second for numRuns=" << numRuns << ",  length=" << testLength.count() << "s,  numElements=" << numElements << "\n";
+        for (unsigned iratio = 0; iratio < ratioList.size(); iratio++) {
+            cout << "\nUpdate ratio: " << ratioList[iratio]/100. << "%\n";
+            cout << "Threads, ";
+            for (int ic = 0; ic < NUM_CLASSES; ic++) cout << classNames[ic] << ", ";
+            cout << "TL2 aborts (%)\n";
+            for (unsigned ithread = 0; ithread < threadList.size(); ithread++) {
+                cout << threadList[ithread] << ", ";
+                for (int ic = 0; ic < NUM_CLASSES; ic++) cout << ops[ic][iratio][ithread] << ", ";
+                cout << abortPct[iratio][ithread] << "\n";
+            }
+        }
+    }
+};
+
+#endif
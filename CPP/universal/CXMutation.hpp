@@ -0,0 +1,464 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _CX_MUTATION_H_
+#define _CX_MUTATION_H_
+
+#include <atomic>
+#include <stdexcept>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include "RIStaticPerThread.hpp"
+#include "HazardPointers.hpp"
+
+// Hook for the stress tests to widen the window between the ticket check and
+// the publishing CAS. Empty in normal builds.
+#ifndef CX_PUBLISH_YIELD
+#define CX_PUBLISH_YIELD()
+#endif
+
+/**
+ * <h1> CX Mutation </h1>
+ *
+ * A wait-free universal construct for any sequential object C that can be
+ * copy-constructed and copy-assigned.
+ * There is a pool of 2*maxThreads replicas of C, each one protected by a
+ * strong try reader-writer lock, and one of them is the current replica
+ * (curComb) which is the one readers use.
+ * Each mutation is placed in a node and enqueued on a wait-free queue (the
+ * enqueue of CRTurnQueue), and the order of the nodes in the queue is the
+ * order in which the mutations are applied. Then, whichever thread grabs the
+ * exclusive try-lock of a replica that is not the current one brings that
+ * replica up to date by applying the mutations in the queue (or by copying
+ * the current replica if it is too far behind), downgrades to a shared lock
+ * and makes it the current replica with a CAS.
+ *
+ * Like on the Left-Right, each mutation is applied more than once, on each
+ * replica that passes by it, which means the mutations must be deterministic.
+ * The lambdas are copied into the node because a lagging replica may apply
+ * a mutation long after the thread that did it has returned, so anything the
+ * lambda captures by reference (or pointer) must outlive the CXMutation.
+ *
+ * There are 2*maxThreads replicas because a thread holds at most two locks
+ * at a time (an exclusive or shared lock on the replica it is updating and a
+ * shared lock on the current replica it is copying from or replacing), which
+ * means that there is always at least one replica whose exclusive try-lock
+ * will succeed.
+ *
+ * Nodes of the queue are reclaimed once they are more than LOG_WINDOW nodes
+ * behind the current replica and no thread has announced it is traversing
+ * from them. A replica that falls out of the window is re-copied from the
+ * current one. The tail of the queue and the caller's own node are protected
+ * with Hazard Pointers, like on CRTurnQueue.
+ *
+ * applyMutation() - Wait-Free bounded by O(maxThreads + LOG_WINDOW)
+ * applyRead()     - Wait-Free bounded by O(maxThreads)
+ *
+ * The result type R must be trivially copyable (it is stored in a std::atomic).
+ *
+ * CX paper: https://github.com/pramalhe/CX
+ * CRTurnQueue paper: https://github.com/pramalhe/ConcurrencyFreaks/tree/master/papers/crturnqueue-2016.pdf
+ *
+ * <p>
+ * @author Andreia Correia
+ * @author Pedro Ramalhete
+ */
+template<typename C, typename R = bool>
+class CXMutation {
+
+private:
+    struct Node {
+        std::function<R(C*)> mutation;
+        std::atomic<R> result;
+        std::atomic<uint64_t> ticket { 0 };
+        const int enqTid;
+        std::atomic<Node*> next { nullptr };
+
+        Node(std::function<R(C*)>& mutation, int tid) : mutation{mutation}, result{R{}}, enqTid{tid} { }
+        Node() : result{R{}}, enqTid{0} { }
+    };
+
+    /*
+     * Strong try reader-writer lock with one reader entry per thread.
+     * exclusiveTryLock() fails if there is another writer or any reader,
+     * sharedTryLock() fails if there is a writer. Neither of them ever waits.
+     */
+    class StrongTryRWLock {
+        RIStaticPerThread ri;
+        alignas(128) std::atomic<int> writer { UNLOCKED };
+
+    public:
+        StrongTryRWLock(const int maxThreads) : ri{maxThreads} { }
+
+        bool sharedTryLock(const int tid) {
+            ri.arrive(tid);
+            if (writer.load() == UNLOCKED) return true;
+            ri.depart(tid);
+            return false;
+        }
+
+        void sharedUnlock(const int tid) {
+            ri.depart(tid);
+        }
+
+        bool exclusiveTryLock(const int tid) {
+            if (writer.load() != UNLOCKED) return false;
+            int unlocked = UNLOCKED;
+            if (!writer.compare_exchange_strong(unlocked, tid)) return false;
+            if (ri.isEmpty()) return true;
+            writer.store(UNLOCKED, std::memory_order_release);
+            return false;
+        }
+
+        void exclusiveUnlock() {
+            writer.store(UNLOCKED, std::memory_order_release);
+        }
+
+        // Turns an exclusive lock into a shared lock without letting another writer in
+        void downgrade(const int tid) {
+            ri.arrive(tid);
+            writer.store(UNLOCKED, std::memory_order_release);
+        }
+    };
+
+    // A replica of the object and the last mutation (node) that was applied to it
+    struct Combined {
+        StrongTryRWLock lock;
+        C* obj { nullptr };
+        Node* head { nullptr };
+        alignas(128) std::atomic<uint64_t> headTicket { 0 };
+
+        Combined(const int maxThreads) : lock{maxThreads} { }
+    };
+
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(uint64_t);
+    static const int UNLOCKED = -1;
+    static const uint64_t NO_TICKET = UINT64_MAX;
+    static const uint64_t LOG_WINDOW = 4096;      // Number of nodes kept behind the current replica
+    static const uint64_t RECLAIM_PERIOD = 256;   // Try to reclaim once every RECLAIM_PERIOD mutations
+    const int maxThreads;
+    const int numReplicas;
+
+    alignas(128) std::atomic<Combined*> curComb;
+    alignas(128) std::atomic<Node*> tail;
+    alignas(128) std::atomic<Node*> enqueuers[MAX_THREADS];
+    // Ticket of the node from which each thread is traversing the queue
+    alignas(128) std::atomic<uint64_t>* announce;
+    // Nodes with a ticket lower than this one may have been reclaimed
+    alignas(128) std::atomic<uint64_t> reclaimedUpTo { 0 };
+    alignas(128) std::atomic<bool> reclaiming { false };
+    Node* logHead;                                // Only accessed by the thread holding 'reclaiming'
+    Combined* combs[2*MAX_THREADS];
+
+    HazardPointers<Node> hp {3, maxThreads};
+    const int kHpTail = 0;
+    const int kHpNext = 1;
+    const int kHpMyNode = 2;
+
+
+    /*
+     * Same as CRTurnQueue::enqueue(), except that the ticket of a node is
+     * assigned (by any thread) before the tail advances to it, thus all
+     * nodes up to and including the tail have their ticket set. The next
+     * node must be protected too because we write its ticket.
+     */
+    void enqueue(Node* myNode, const int tid) {
+        enqueuers[tid].store(myNode);
+        for (int i = 0; i < maxThreads; i++) {
+            if (enqueuers[tid].load() == nullptr) {
+                hp.clearOne(kHpTail, tid);
+                hp.clearOne(kHpNext, tid);
+                return; // Some thread did all the steps
+            }
+            Node* ltail = hp.protectPtr(kHpTail, tail.load(), tid);
+            if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
+            if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
+                Node* tmp = ltail;
+                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+            }
+            for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
+                Node* nodeToHelp = enqueuers[(j + ltail->enqTid) % maxThreads].load();
+                if (nodeToHelp == nullptr) continue;
+                Node* nodenull = nullptr;
+                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                break;
+            }
+            Node* lnext = hp.protectPtr(kHpNext, ltail->next.load(), tid);
+            if (lnext != nullptr && ltail == tail.load()) { // Help a thread do step 3
+                lnext->ticket.store(ltail->ticket.load()+1);
+                tail.compare_exchange_strong(ltail, lnext);
+            }
+        }
+        enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
+        hp.clearOne(kHpTail, tid);
+        hp.clearOne(kHpNext, tid);
+    }
+
+
+    // Returns true if the current replica already contains the mutation with this ticket
+    bool isPublished(const uint64_t ticket) {
+        Combined* lcomb = curComb.load();
+        if (lcomb->headTicket.load() < ticket) return false;
+        return lcomb == curComb.load();
+    }
+
+
+    /*
+     * Publishes the ticket we are going to traverse from and checks that the
+     * corresponding node has not been reclaimed in the meantime.
+     * Returns false if the node may have been reclaimed.
+     */
+    bool announceTicket(const uint64_t ticket, const int tid) {
+        announce[tid*CLPAD].store(ticket);
+        return ticket >= reclaimedUpTo.load();
+    }
+
+
+    /*
+     * Makes the replica 'c', on which we hold an exclusive lock, a copy of
+     * the current replica. Returns false if it couldn't.
+     */
+    bool copyFromCurrent(Combined* c, const int tid) {
+        Combined* lcomb = curComb.load();
+        if (!lcomb->lock.sharedTryLock(tid)) return false;
+        if (lcomb != curComb.load() || !announceTicket(lcomb->headTicket.load(), tid)) {
+            lcomb->lock.sharedUnlock(tid);
+            return false;
+        }
+        if (c->obj == nullptr) {
+            c->obj = new C(*lcomb->obj);
+        } else {
+            *c->obj = *lcomb->obj;
+        }
+        c->head = lcomb->head;
+        c->headTicket.store(lcomb->headTicket.load());
+        lcomb->lock.sharedUnlock(tid);
+        return true;
+    }
+
+
+    /*
+     * Reclaims the nodes that are more than LOG_WINDOW behind the current
+     * replica and that no thread announced it is traversing from.
+     * Only one thread at a time does this, the others just give up.
+     */
+    void reclaim(const int tid) {
+        if (reclaiming.load() || reclaiming.exchange(true)) return;
+        const uint64_t curTicket = curComb.load()->headTicket.load();
+        if (curTicket > LOG_WINDOW) {
+            uint64_t minTicket = curTicket - LOG_WINDOW;
+            if (minTicket > reclaimedUpTo.load()) reclaimedUpTo.store(minTicket);
+            // Must scan the announcements only after the store on reclaimedUpTo
+            for (int i = 0; i < maxThreads; i++) {
+                const uint64_t t = announce[i*CLPAD].load();
+                if (t < minTicket) minTicket = t;
+            }
+            while (logHead->ticket.load() < minTicket) {
+                Node* lnext = logHead->next.load();
+                hp.retire(logHead, tid);
+                logHead = lnext;
+            }
+        }
+        reclaiming.store(false, std::memory_order_release);
+    }
+
+
+public:
+    CXMutation(C* instance, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads}, numReplicas{2*maxThreads} {
+        if (maxThreads > MAX_THREADS) throw std::invalid_argument("maxThreads must not exceed MAX_THREADS");
+        Node* sentinelNode = new Node();
+        for (int i = 0; i < numReplicas; i++) combs[i] = new Combined(maxThreads);
+        combs[0]->obj = instance;
+        combs[0]->head = sentinelNode;
+        logHead = sentinelNode;
+        curComb.store(combs[0], std::memory_order_relaxed);
+        tail.store(sentinelNode, std::memory_order_relaxed);
+        announce = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int i = 0; i < maxThreads; i++) {
+            enqueuers[i].store(nullptr, std::memory_order_relaxed);
+            announce[i*CLPAD].store(NO_TICKET, std::memory_order_relaxed);
+        }
+    }
+
+
+    ~CXMutation() {
+        for (int i = 0; i < numReplicas; i++) {
+            delete combs[i]->obj;
+            delete combs[i];
+        }
+        while (logHead != nullptr) {
+            Node* lnext = logHead->next.load();
+            delete logHead;
+            logHead = lnext;
+        }
+        delete[] announce;
+    }
+
+
+    static std::string className() { return "CXMutation"; }
+
+
+    /**
+     * Steps when uncontended:
+     * 1. Enqueue a node with the mutation;
+     * 2. Exclusive try-lock a replica that is not the current one;
+     * 3. Apply the mutations in the queue from the replica's head up to our node;
+     * 4. Downgrade to a shared lock and CAS curComb to our replica;
+     *
+     * Progress: Wait-Free bounded by O(maxThreads + LOG_WINDOW)
+     */
+    R applyMutation(std::function<R(C*)>& mutativeFunc, const int tid) {
+        Node* myNode = hp.protectPtr(kHpMyNode, new Node(mutativeFunc, tid), tid);
+        enqueue(myNode, tid);
+        const uint64_t myTicket = myNode->ticket.load();
+
+        while (!isPublished(myTicket)) {
+            for (int i = 0; i < numReplicas; i++) {
+                Combined* c = combs[i];
+                if (c == curComb.load() || !c->lock.exclusiveTryLock(tid)) continue;
+                // Now that we have the lock, the replica can't become the current one
+                if (c == curComb.load()) {
+                    c->lock.exclusiveUnlock();
+                    continue;
+                }
+                if (c->head == nullptr || !announceTicket(c->headTicket.load(), tid)) {
+                    if (!copyFromCurrent(c, tid)) {
+                        announce[tid*CLPAD].store(NO_TICKET, std::memory_order_release);
+                        c->lock.exclusiveUnlock();
+                        continue;
+                    }
+                }
+                // Apply the mutations up to and including our own
+                uint64_t lticket = c->headTicket.load();
+                while (lticket < myTicket) {
+                    Node* lnext = c->head->next.load();
+                    lnext->result.store(lnext->mutation(c->obj));
+                    c->head = lnext;
+                    c->headTicket.store(++lticket);
+                }
+                announce[tid*CLPAD].store(NO_TICKET, std::memory_order_release);
+                // Publish the replica, unless a newer one has already been published.
+                // We hold a shared lock on the current replica while comparing its
+                // ticket, otherwise it could be exclusively locked, advanced and
+                // published again in the meantime, and our CAS would (ABA) replace
+                // it with our older replica.
+                c->lock.downgrade(tid);
+                while (true) {
+                    Combined* lcomb = curComb.load();
+                    if (!lcomb->lock.sharedTryLock(tid)) continue;
+                    if (lcomb != curComb.load()) {
+                        lcomb->lock.sharedUnlock(tid);
+                        continue;
+                    }
+                    CX_PUBLISH_YIELD();
+                    Combined* tmp = lcomb;
+                    const bool done = (lcomb->headTicket.load() >= lticket) || curComb.compare_exchange_strong(tmp, c);
+                    lcomb->lock.sharedUnlock(tid);
+                    if (done) break;
+                }
+                c->lock.sharedUnlock(tid);
+                break;
+            }
+        }
+
+        R result = myNode->result.load();
+        hp.clearOne(kHpMyNode, tid);
+        if (myTicket % RECLAIM_PERIOD == 0) reclaim(tid);
+        return result;
+    }
+
+
+    /**
+     * Reads from the current replica. If a writer gets in the way too many
+     * times, the read is enqueued as if it was a mutation.
+     *
+     * Progress: Wait-Free bounded by O(maxThreads)
+     */
+    R applyRead(std::function<R(C*)>& readFunc, const int tid) {
+        for (int i = 0; i < maxThreads; i++) {
+            Combined* lcomb = curComb.load();
+            if (!lcomb->lock.sharedTryLock(tid)) continue;
+            if (lcomb != curComb.load()) {
+                lcomb->lock.sharedUnlock(tid);
+                continue;
+            }
+            R result = readFunc(lcomb->obj);
+            lcomb->lock.sharedUnlock(tid);
+            return result;
+        }
+        return applyMutation(readFunc, tid);
+    }
+};
+
+
+// This class can be used to simplify the usage of sets/multisets with CXMutation.
+// For generic code you don't need it (and can't use it), but it can serve as an example of how to use lambdas.
+// C must be a set/multiset where the keys are of type CKey, and the keys must outlive the set.
+template<typename C, typename CKey>
+class CXMutationSet {
+private:
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    CXMutation<C> cx{new C(), maxThreads};
+
+public:
+    CXMutationSet(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} { }
+
+    static std::string className() { return "CXMutation-" + C::className(); }
+
+    // Progress-condition: wait-free
+    bool add(CKey* key, const int tid) {
+        std::function<bool(C*)> addFunc = [key] (C* set) { return set->add(key); };
+        return cx.applyMutation(addFunc, tid);
+    }
+
+    // Progress-condition: wait-free
+    bool remove(CKey* key, const int tid) {
+        std::function<bool(C*)> removeFunc = [key] (C* set) { return set->remove(key); };
+        return cx.applyMutation(removeFunc, tid);
+    }
+
+    // Progress-condition: wait-free
+    bool contains(CKey* key, const int tid) {
+        std::function<bool(C*)> containsFunc = [key] (C* set) { return set->contains(key); };
+        return cx.applyRead(containsFunc, tid);
+    }
+
+    // Progress-condition: wait-free
+    void addAll(CKey** keys, const int size, const int tid) {
+        std::function<bool(C*)> addFunc = [keys,size] (C* set) {
+            for (int i = 0; i < size; i++) set->add(keys[i]);
+            return true;
+        };
+        cx.applyMutation(addFunc, tid);
+    }
+};
+
+#endif /* _CX_MUTATION_H_ */
@@ -0,0 +1,482 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TL2_STM_H_
+#define _TL2_STM_H_
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+/**
+ * <h1> TL2 Software Transactional Memory </h1>
+ *
+ * A small word-based STM in the style of TL2, to compare with the universal
+ * constructs, which serialize all the writers. Here, transactions that touch
+ * disjoint words can commit in parallel.
+ *
+ * - There is a global version clock;
+ * - Each word is mapped (by address) to one of NUM_ORECS ownership records,
+ *   which hold the version of the last commit that wrote to the stripe, or
+ *   the owner's slot with the lowest bit set while a commit holds it;
+ * - A transaction reads the clock when it starts (rv) and each read checks
+ *   that the orec of the word is unlocked and not newer than rv, which means
+ *   a transaction never sees an inconsistent state. The orec goes into the
+ *   read-set;
+ * - Writes are buffered in the write-set and read back from there;
+ * - On commit, the orecs of the write-set are locked, the clock is
+ *   incremented to get wv, the read-set is validated (unless wv == rv+1),
+ *   the write-set is written back and the orecs are released with wv;
+ * - Any conflict aborts the transaction, which is then restarted by
+ *   atomically().
+ *
+ * Usage:
+ *   tl2::tmtype<uint64_t> a {0}, b {0};
+ *   tl2::atomically([&] { a = a + 1; b = b + 1; return true; });
+ *
+ * Only the tmtype<T> variables are transactional, and T must be trivially
+ * copyable and at most 8 bytes, like a pointer or an integer.
+ * Objects must be allocated with tmNew() and deleted with tmDelete() inside
+ * transactions: an allocation is undone if the transaction aborts, and a
+ * deletion is deferred until all the transactions that started before the
+ * commit are over, because they could still be reading the object.
+ *
+ * A transaction that throws an exception other than an abort is rolled back
+ * and the exception is propagated. Nested calls to atomically() are
+ * flattened into the outermost transaction.
+ *
+ * atomically() progress: Obstruction-Free for read-only transactions,
+ * Blocking (on the orecs locked by a committing transaction) otherwise.
+ *
+ * Transactional Locking II, by Dave Dice, Ori Shalev and Nir Shavit:
+ * https://people.csail.mit.edu/shanir/publications/Transactional_Locking.pdf
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+namespace tl2 {
+
+static const int MAX_THREADS = 128;
+static const int NUM_ORECS = 1 << 18;
+static const int CLPAD = 128/sizeof(std::atomic<uint64_t>);
+static const uint64_t IDLE = UINT64_MAX;
+
+// Thrown when a transaction has a conflict. Caught by atomically().
+struct AbortException { };
+
+
+class Transaction;
+
+struct STMGlobals {
+    alignas(128) std::atomic<uint64_t> clock { 0 };
+    alignas(128) std::atomic<uint64_t> orecs[NUM_ORECS];
+    // The rv of the transaction running on each slot, or IDLE
+    alignas(128) std::atomic<uint64_t> announce[MAX_THREADS*CLPAD];
+    alignas(128) std::atomic<bool> usedSlots[MAX_THREADS];
+    Transaction* txs[MAX_THREADS];
+
+    STMGlobals();
+    ~STMGlobals();
+
+    inline std::atomic<uint64_t>& orecOf(const void* addr) {
+        return orecs[((uintptr_t)addr >> 3) & (NUM_ORECS-1)];
+    }
+};
+
+inline STMGlobals& globals() {
+    static STMGlobals g;
+    return g;
+}
+
+
+/*
+ * The descriptor of a transaction. There is one per slot, and a thread
+ * keeps its slot until it exits. The descriptors live as long as the
+ * globals because the retired objects may outlive the thread.
+ */
+class Transaction {
+
+private:
+    struct WriteEntry {
+        std::atomic<uint64_t>* addr;
+        uint64_t value;
+    };
+
+    struct LockEntry {
+        std::atomic<uint64_t>* orec;
+        uint64_t prevValue;    // To validate the read-set and to undo the lock
+    };
+
+    struct Allocation {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t wv;
+    };
+
+    static const int RETIRE_THRESHOLD = 128;
+
+    const int slot;
+    uint64_t rv {0};
+    uint64_t writeBloom {0};     // One bit per (hashed) address of the write-set
+    std::vector<std::atomic<uint64_t>*> readSet;
+    std::vector<WriteEntry> writeSet;
+    std::vector<LockEntry> locks;
+    std::vector<Allocation> allocs;   // Undone on abort
+    std::vector<Allocation> frees;    // Retired on commit
+    std::vector<Allocation> retired;
+
+    static inline uint64_t bloomBit(const void* addr) {
+        return 1ULL << (((uintptr_t)addr >> 3) & 63);
+    }
+
+    inline uint64_t lockedWord() const { return ((uint64_t)slot << 1) | 1; }
+
+    void releaseLocks() {
+        for (auto& l : locks) l.orec->store(l.prevValue);
+        locks.clear();
+    }
+
+    // Deletes the retired objects that no running transaction can still be reading
+    void scanRetired() {
+        STMGlobals& g = globals();
+        uint64_t minRV = IDLE;
+        for (int i = 0; i < MAX_THREADS; i++) {
+            const uint64_t a = g.announce[i*CLPAD].load();
+            if (a < minRV) minRV = a;
+        }
+        unsigned keep = 0;
+        for (unsigned i = 0; i < retired.size(); i++) {
+            if (retired[i].wv <= minRV) {
+                retired[i].deleter(retired[i].ptr);
+            } else {
+                retired[keep++] = retired[i];
+            }
+        }
+        retired.resize(keep);
+    }
+
+public:
+    int nesting {0};
+    long numCommits {0};
+    long numAborts {0};
+
+    Transaction(const int slot) : slot{slot} { }
+
+    ~Transaction() {
+        // Called when the globals are destroyed, when there are no more transactions
+        for (auto& r : retired) r.deleter(r.ptr);
+    }
+
+    void begin() {
+        STMGlobals& g = globals();
+        // A reclaimer that misses our announce will see an rv at least as recent as the one we load next
+        g.announce[slot*CLPAD].store(g.clock.load());
+        rv = g.clock.load();
+    }
+
+    inline uint64_t read(const std::atomic<uint64_t>* addr) {
+        if (writeBloom & bloomBit(addr)) {
+            for (auto it = writeSet.rbegin(); it != writeSet.rend(); ++it) {
+                if (it->addr == addr) return it->value;
+            }
+        }
+        std::atomic<uint64_t>& orec = globals().orecOf(addr);
+        const uint64_t o1 = orec.load();
+        const uint64_t value = addr->load();
+        const uint64_t o2 = orec.load();
+        if (o1 != o2 || (o1 & 1) || (o1 >> 1) > rv) throw AbortException();
+        readSet.push_back(&orec);
+        return value;
+    }
+
+    inline void write(std::atomic<uint64_t>* addr, const uint64_t value) {
+        if (writeBloom & bloomBit(addr)) {
+            for (auto& w : writeSet) {
+                if (w.addr == addr) {
+                    w.value = value;
+                    return;
+                }
+            }
+        }
+        writeBloom |= bloomBit(addr);
+        writeSet.push_back({addr, value});
+    }
+
+    void addAllocation(void* ptr, void (*deleter)(void*)) {
+        allocs.push_back({ptr, deleter, 0});
+    }
+
+    void addFree(void* ptr, void (*deleter)(void*)) {
+        frees.push_back({ptr, deleter, 0});
+    }
+
+    // Throws AbortException if the read-set is no longer valid
+    void commit() {
+        STMGlobals& g = globals();
+        if (!writeSet.empty()) {
+            for (auto& w : writeSet) {
+                std::atomic<uint64_t>& orec = g.orecOf(w.addr);
+                uint64_t o = orec.load();
+                if (o == lockedWord()) continue;  // Two words of the write-set on the same stripe
+                if ((o & 1) || !orec.compare_exchange_strong(o, lockedWord())) throw AbortException();
+                locks.push_back({&orec, o});
+            }
+            const uint64_t wv = g.clock.fetch_add(1)+1;
+            if (wv != rv+1) {
+                for (auto orec : readSet) {
+                    const uint64_t o = orec->load();
+                    if (o == lockedWord()) {
+                        for (auto& l : locks) {
+                            if (l.orec == orec && (l.prevValue >> 1) > rv) throw AbortException();
+                        }
+                    } else if ((o & 1) || (o >> 1) > rv) {
+                        throw AbortException();
+                    }
+                }
+            }
+            for (auto& w : writeSet) w.addr->store(w.value);
+            for (auto& l : locks) l.orec->store(wv << 1);
+            locks.clear();
+            for (auto& f : frees) {
+                f.wv = wv;
+                retired.push_back(f);
+            }
+        }
+        g.announce[slot*CLPAD].store(IDLE);
+        numCommits++;
+        clear();
+        if (retired.size() >= RETIRE_THRESHOLD) scanRetired();
+    }
+
+    void rollback() {
+        releaseLocks();
+        for (auto& a : allocs) a.deleter(a.ptr);
+        globals().announce[slot*CLPAD].store(IDLE);
+        numAborts++;
+        clear();
+    }
+
+    void clear() {
+        readSet.clear();
+        writeSet.clear();
+        allocs.clear();
+        frees.clear();
+        writeBloom = 0;
+    }
+};
+
+
+inline STMGlobals::STMGlobals() {
+    for (int i = 0; i < NUM_ORECS; i++) orecs[i].store(0, std::memory_order_relaxed);
+    for (int i = 0; i < MAX_THREADS; i++) {
+        announce[i*CLPAD].store(IDLE, std::memory_order_relaxed);
+        usedSlots[i].store(false, std::memory_order_relaxed);
+        txs[i] = new Transaction(i);
+    }
+}
+
+inline STMGlobals::~STMGlobals() {
+    for (int i = 0; i < MAX_THREADS; i++) delete txs[i];
+}
+
+
+// Takes a free slot for the calling thread, and gives it back when the thread exits
+struct ThreadSlot {
+    int slot {-1};
+
+    ThreadSlot() {
+        STMGlobals& g = globals();
+        for (int i = 0; i < MAX_THREADS; i++) {
+            bool unused = false;
+            if (!g.usedSlots[i].load() && g.usedSlots[i].compare_exchange_strong(unused, true)) {
+                slot = i;
+                return;
+            }
+        }
+        throw std::runtime_error("There are more than tl2::MAX_THREADS threads using the STM");
+    }
+
+    ~ThreadSlot() {
+        globals().usedSlots[slot].store(false);
+    }
+};
+
+inline Transaction* myTx() {
+    static thread_local ThreadSlot ts;
+    return globals().txs[ts.slot];
+}
+
+
+/**
+ * A transactional variable. Loads and stores are transactional when they are
+ * done inside atomically(), otherwise they are plain atomic loads and stores,
+ * which is useful for initialization.
+ */
+template<typename T>
+class tmtype {
+    static_assert(sizeof(T) <= sizeof(uint64_t) && std::is_trivially_copyable<T>::value,
+                  "tmtype<T> needs a trivially copyable T of at most 8 bytes");
+
+    std::atomic<uint64_t> val;
+
+    static inline uint64_t toWord(const T& value) {
+        uint64_t word = 0;
+        std::memcpy(&word, &value, sizeof(T));
+        return word;
+    }
+
+    static inline T fromWord(const uint64_t word) {
+        T value;
+        std::memcpy(&value, &word, sizeof(T));
+        return value;
+    }
+
+public:
+    tmtype() : val{0} { }
+
+    tmtype(const T& initVal) : val{toWord(initVal)} { }
+
+    tmtype(const tmtype& other) = delete;
+
+    inline T load() const {
+        Transaction* tx = myTx();
+        if (tx->nesting == 0) return fromWord(val.load());
+        return fromWord(tx->read(&val));
+    }
+
+    inline void store(const T& newVal) {
+        Transaction* tx = myTx();
+        if (tx->nesting == 0) {
+            val.store(toWord(newVal));
+        } else {
+            tx->write(&val, toWord(newVal));
+        }
+    }
+
+    inline operator T() const { return load(); }
+
+    inline tmtype& operator=(const T& newVal) {
+        store(newVal);
+        return *this;
+    }
+
+    inline tmtype& operator=(const tmtype& other) {
+        store(other.load());
+        return *this;
+    }
+
+    // Plain store, for initializing an object that no other thread can see yet
+    inline void init(const T& newVal) { val.store(toWord(newVal), std::memory_order_relaxed); }
+
+    inline T operator->() const { return load(); }
+};
+
+
+/*
+ * Runs func() as a transaction until it commits, and returns what func()
+ * returns. The std::is_void overloads are there because C++14 has no if constexpr.
+ */
+template<typename F>
+auto runTx(F&& func, std::false_type) {
+    Transaction* tx = myTx();
+    if (tx->nesting > 0) return func();
+    for (int attempt = 0; ; attempt++) {
+        tx->begin();
+        tx->nesting = 1;
+        try {
+            auto ret = func();
+            tx->commit();
+            tx->nesting = 0;
+            return ret;
+        } catch (AbortException&) {
+            tx->nesting = 0;
+            tx->rollback();
+            if (attempt > 2) std::this_thread::yield();
+        } catch (...) {
+            tx->nesting = 0;
+            tx->rollback();
+            throw;
+        }
+    }
+}
+
+template<typename F>
+void runTx(F&& func, std::true_type) {
+    runTx([&func] () { func(); return true; }, std::false_type());
+}
+
+template<typename F>
+auto atomically(F&& func) {
+    return runTx(func, std::is_void<decltype(func())>());
+}
+
+
+// Allocates a T inside a transaction, the allocation is undone if the transaction aborts
+template<typename T, typename... Args>
+T* tmNew(Args&&... args) {
+    T* ptr = new T(std::forward<Args>(args)...);
+    Transaction* tx = myTx();
+    if (tx->nesting > 0) tx->addAllocation(ptr, [] (void* p) { delete static_cast<T*>(p); });
+    return ptr;
+}
+
+// Deletes a T once the transaction commits and no other transaction can be reading it
+template<typename T>
+void tmDelete(T* ptr) {
+    if (ptr == nullptr) return;
+    Transaction* tx = myTx();
+    if (tx->nesting > 0) {
+        tx->addFree(ptr, [] (void* p) { delete static_cast<T*>(p); });
+    } else {
+        delete ptr;
+    }
+}
+
+
+// Number of commits and aborts so far, of the threads that are using the STM
+inline long getNumCommits() {
+    long sum = 0;
+    for (int i = 0; i < MAX_THREADS; i++) sum += globals().txs[i]->numCommits;
+    return sum;
+}
+
+inline long getNumAborts() {
+    long sum = 0;
+    for (int i = 0; i < MAX_THREADS; i++) sum += globals().txs[i]->numAborts;
+    return sum;
+}
+
+}
+
+#endif /* _TL2_STM_H_ */
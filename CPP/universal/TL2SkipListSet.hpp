@@ -0,0 +1,152 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _TL2_SKIP_LIST_SET_H_
+#define _TL2_SKIP_LIST_SET_H_
+
+#include <string>
+#include <cstdint>
+#include "TL2STM.hpp"
+
+/**
+ * <h1> Skip List Set on top of the TL2 STM </h1>
+ *
+ * A sequential skip list where each operation is a transaction, with all the
+ * links being tl2::tmtype<Node*>.
+ * Unlike the sets in the universal constructs, two operations on distant keys
+ * touch different nodes and can commit concurrently.
+ * A skip list has less contention near the root than a balanced tree, where
+ * every rebalancing writes to the upper nodes, so it's a better showcase for
+ * the disjoint-access parallelism of the STM.
+ *
+ * Progress Condition of all methods: same as tl2::atomically()
+ *
+ * <p>
+ * @author Pedro Ramalhete
+ * @author Andreia Correia
+ */
+template<typename K>
+class TL2SkipListSet {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int MAX_LEVEL = 16;
+
+    struct Node {
+        const K key;
+        const int topLevel;
+        tl2::tmtype<Node*> next[MAX_LEVEL];
+
+        Node(const K& key, const int topLevel, Node** succs) : key{key}, topLevel{topLevel} {
+            // The node isn't reachable until the transaction commits, no need for transactional stores
+            for (int level = 0; level < topLevel; level++) next[level].init(succs[level]);
+        }
+    };
+
+    Node* head;
+
+    // Each level above zero has half the chances of the previous one
+    static int randomLevel() {
+        static thread_local uint64_t seed = 1234567890123456781ULL ^ (uint64_t)&seed;
+        seed ^= seed >> 12;
+        seed ^= seed << 25;
+        seed ^= seed >> 27;
+        const uint64_t r = seed * 2685821657736338717LL;
+        int level = 1;
+        while (level < MAX_LEVEL && (r & (1ULL << (level-1)))) level++;
+        return level;
+    }
+
+    // Fills preds[] and succs[] for all levels, and returns the node with the key or nullptr
+    Node* find(const K& key, Node** preds, Node** succs) {
+        Node* pred = head;
+        for (int level = MAX_LEVEL-1; level >= 0; level--) {
+            Node* curr = pred->next[level];
+            while (curr != nullptr && curr->key < key) {
+                pred = curr;
+                curr = pred->next[level];
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        Node* node = succs[0];
+        return (node != nullptr && !(key < node->key)) ? node : nullptr;
+    }
+
+public:
+    TL2SkipListSet(const int maxThreads=MAX_THREADS) {
+        Node* succs[MAX_LEVEL] = {};
+        head = new Node(K{}, MAX_LEVEL, succs);
+    }
+
+    // Must be called when no other thread is accessing the set
+    ~TL2SkipListSet() {
+        Node* node = head;
+        while (node != nullptr) {
+            Node* next = node->next[0];
+            delete node;
+            node = next;
+        }
+    }
+
+    static std::string className() { return "TL2-SkipList"; }
+
+    bool add(K* key, const int tid) {
+        return tl2::atomically([this,key] () {
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            if (find(*key, preds, succs) != nullptr) return false;
+            const int topLevel = randomLevel();
+            Node* newNode = tl2::tmNew<Node>(*key, topLevel, succs);
+            for (int level = 0; level < topLevel; level++) preds[level]->next[level] = newNode;
+            return true;
+        });
+    }
+
+    bool remove(K* key, const int tid) {
+        return tl2::atomically([this,key] () {
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            Node* node = find(*key, preds, succs);
+            if (node == nullptr) return false;
+            for (int level = 0; level < node->topLevel; level++) preds[level]->next[level] = node->next[level];
+            tl2::tmDelete(node);
+            return true;
+        });
+    }
+
+    bool contains(K* key, const int tid) {
+        return tl2::atomically([this,key] () {
+            Node* preds[MAX_LEVEL];
+            Node* succs[MAX_LEVEL];
+            return find(*key, preds, succs) != nullptr;
+        });
+    }
+};
+
+#endif /* _TL2_SKIP_LIST_SET_H_ */
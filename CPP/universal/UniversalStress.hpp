@@ -0,0 +1,188 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _UNIVERSAL_STRESS_H_
+#define _UNIVERSAL_STRESS_H_
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+#include "CRWWPFlatCombining.hpp"
+#include "LeftRightFlatCombining.hpp"
+#include "CXMutation.hpp"
+
+using namespace std;
+using namespace chrono;
+
+
+/**
+ * Stress tests for the universal constructs, with a counter as the
+ * sequential object. Each mutation increments the counter and returns the
+ * new value, so the counter is also the number of mutations that were applied.
+ * Linearizability means that:
+ * - Reads never go backwards: a read that starts after an applyMutation()
+ *   has returned must see that mutation, i.e. a value at least as large as
+ *   the largest value returned by a completed applyMutation();
+ * - Each thread sees the counter increase: a read never returns less than
+ *   the previous read (or mutation) done by the same thread;
+ * - No mutation is lost or applied twice: at the end, the counter is the total
+ *   number of mutations and each mutation returned a different value;
+ * On CXMutation, the mutation yields every few increments so that the replicas
+ * are published in many different orders, even with a single core. The
+ * yield() is deterministic, as all mutations applied by CXMutation must be.
+ */
+class UniversalStress {
+
+private:
+    struct Counter {
+        uint64_t value {0};
+        static std::string className() { return "Counter"; }
+    };
+
+    const int numWriters;
+    const int numReaders;
+
+    static const int MAX_VALUES = 1 << 24;   // Number of values checked for duplicates
+
+
+public:
+    UniversalStress(const int numWriters, const int numReaders) : numWriters{numWriters}, numReaders{numReaders} { }
+
+
+    // Returns the number of errors
+    template<typename U>
+    int monotonicReadsTest(const std::string& name, const seconds testLength) {
+        const int numThreads = numWriters + numReaders;
+        U* uc = new U(new Counter(), numThreads);
+        atomic<bool> quit = { false };
+        atomic<bool> startFlag = { false };
+        atomic<int> errors = { 0 };
+        atomic<uint64_t> completed = { 0 };          // Largest value returned by a completed mutation
+        atomic<long long> numMutations = { 0 };
+        atomic<long long> numReads = { 0 };
+        vector<atomic<bool>> seen(MAX_VALUES);
+        for (auto& b : seen) b.store(false, std::memory_order_relaxed);
+
+        std::function<uint64_t(Counter*)> incFunc = [] (Counter* c) {
+            if (c->value % 8 == 0) std::this_thread::yield();
+            return ++c->value;
+        };
+        std::function<uint64_t(Counter*)> readFunc = [] (Counter* c) { return c->value; };
+
+        auto checkRead = [&errors] (const uint64_t value, const uint64_t floor, uint64_t& last, const char* what) {
+            if (value < floor) {
+                cout << "ERROR: " << what << " returned " << value << " but a mutation that returned " << floor << " had already completed\n";
+                errors.fetch_add(1);
+            }
+            if (value < last) {
+                cout << "ERROR: " << what << " went backwards from " << last << " to " << value << "\n";
+                errors.fetch_add(1);
+            }
+            last = value;
+        };
+
+        auto writer_lambda = [&] (const int tid) {
+            long long lmut = 0, lreads = 0;
+            uint64_t last = 0;
+            while (!startFlag.load()) this_thread::yield();
+            while (!quit.load()) {
+                const uint64_t floor = completed.load();
+                const uint64_t v = uc->applyMutation(incFunc, tid);
+                lmut++;
+                if (v <= floor || v <= last) {
+                    cout << "ERROR: mutation returned " << v << " after " << std::max(floor, last) << " was already seen\n";
+                    errors.fetch_add(1);
+                }
+                last = v;
+                if (v < MAX_VALUES && seen[v].exchange(true)) {
+                    cout << "ERROR: value " << v << " was returned by two mutations\n";
+                    errors.fetch_add(1);
+                }
+                uint64_t c = completed.load();
+                while (c < v && !completed.compare_exchange_weak(c, v)) { }
+                // Read-your-writes, and the mutations of the other threads that have completed
+                const uint64_t rfloor = std::max(v, completed.load());
+                checkRead(uc->applyRead(readFunc, tid), rfloor, last, "applyRead() after applyMutation()");
+                lreads++;
+            }
+            numMutations.fetch_add(lmut);
+            numReads.fetch_add(lreads);
+        };
+
+        auto reader_lambda = [&] (const int tid) {
+            long long lreads = 0;
+            uint64_t last = 0;
+            while (!startFlag.load()) this_thread::yield();
+            while (!quit.load()) {
+                const uint64_t floor = completed.load();
+                checkRead(uc->applyRead(readFunc, tid), floor, last, "applyRead()");
+                lreads++;
+            }
+            numReads.fetch_add(lreads);
+        };
+
+        cout << "##### " << name << "   writers=" << numWriters << "   readers=" << numReaders << " #####\n";
+        vector<thread> threads;
+        for (int tid = 0; tid < numWriters; tid++) threads.push_back(thread(writer_lambda, tid));
+        for (int tid = numWriters; tid < numThreads; tid++) threads.push_back(thread(reader_lambda, tid));
+        startFlag.store(true);
+        this_thread::sleep_for(testLength);
+        quit.store(true);
+        for (auto& th : threads) th.join();
+
+        const uint64_t final = uc->applyRead(readFunc, 0);
+        if (final != (uint64_t)numMutations.load()) {
+            cout << "ERROR: counter is " << final << " after " << numMutations.load() << " mutations\n";
+            errors.fetch_add(1);
+        }
+        cout << "mutations = " << numMutations.load() << "   reads = " << numReads.load() << "   errors = " << errors.load() << "\n";
+        delete uc;
+        return errors.load();
+    }
+
+
+    static int allStressTests() {
+        const seconds testLength = 10s;
+        const int threadList[][2] = { {2, 1}, {4, 4}, {8, 2}, {16, 16} };   // {writers, readers}
+        int errors = 0;
+        for (auto& wr : threadList) {
+            UniversalStress stress(wr[0], wr[1]);
+            errors += stress.monotonicReadsTest<CXMutation<Counter,uint64_t>>("CXMutation", testLength);
+            errors += stress.monotonicReadsTest<CRWWPFlatCombining<Counter,uint64_t>>("CRWWPFlatCombining", testLength);
+            errors += stress.monotonicReadsTest<LeftRightFlatCombining<Counter,uint64_t>>("LeftRightFlatCombining", testLength);
+        }
+        cout << ((errors == 0) ? "All stress tests passed\n" : "Some stress tests FAILED\n");
+        return errors;
+    }
+};
+
+#endif /* _UNIVERSAL_STRESS_H_ */
@@ -0,0 +1,17 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Jun 19, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+#include "BenchmarkUniversal.hpp"
+
+
+
+int main(void) {
+    BenchmarkUniversal::allThroughputTests();
+    BenchmarkUniversal::disjointAccessTests();
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * stress.cpp
+ *
+ *  Created on: Oct 18, 2017
+ *      Author: pramalhe
+ */
+#include <thread>
+
+// Yield now and then between the ticket check and the CAS that publishes a
+// replica, otherwise it is very unlikely to be preempted there on machines with few cores.
+#define CX_PUBLISH_YIELD() { static thread_local int n = 0; if (++n % 16 == 0) std::this_thread::yield(); }
+
+#include "UniversalStress.hpp"
+
+
+
+int main(void) {
+    return (UniversalStress::allStressTests() == 0) ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/******************************************************************************
+ * Copyright (c) 2017, Pedro Ramalhete, Andreia Correia
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Concurrency Freaks nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ ******************************************************************************
+ */
+
+#ifndef _USDT_PROBES_H_
+#define _USDT_PROBES_H_
+
+/**
+ * <h1> USDT Probes </h1>
+ *
+ * Static tracepoints (User Statically-Defined Tracing) for the hot paths of
+ * the data structures, under the provider name "cf".
+ * When <sys/sdt.h> is available (package systemtap-sdt-dev on Debian/Ubuntu,
+ * systemtap-sdt-devel on Fedora) each probe is a single nop instruction
+ * plus a note in the ELF file, and the arguments are only evaluated into
+ * registers that are already live, so there is no measurable cost until a
+ * tracer like bpftrace, perf or SystemTap attaches to it.
+ * When <sys/sdt.h> is not available, or if CF_DISABLE_USDT is defined, the
+ * probes compile to nothing.
+ *
+ * Probes that measure a duration come in pairs, *_begin and *_end, and the
+ * tracer computes the latency, which means that we never read a clock on
+ * behalf of the probes. See the .bt scripts in this folder for examples.
+ *
+ * List the probes in a binary with:
+ *   bpftrace -l 'usdt:./bench:cf:*'
+ *
+ * This file is copied to each folder that uses it, like HazardPointers.hpp.
+ * The master copy is in CPP/usdt/
+ */
+
+#if !defined(CF_DISABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define CF_USDT_ENABLED
+#endif
+#endif
+
+#ifdef CF_USDT_ENABLED
+#define CF_PROBE0(name)                    DTRACE_PROBE(cf, name)
+#define CF_PROBE1(name, a1)                DTRACE_PROBE1(cf, name, a1)
+#define CF_PROBE2(name, a1, a2)            DTRACE_PROBE2(cf, name, a1, a2)
+#define CF_PROBE3(name, a1, a2, a3)        DTRACE_PROBE3(cf, name, a1, a2, a3)
+#define CF_PROBE4(name, a1, a2, a3, a4)    DTRACE_PROBE4(cf, name, a1, a2, a3, a4)
+#else
+#define CF_PROBE0(name)                    do { } while (0)
+#define CF_PROBE1(name, a1)                do { } while (0)
+#define CF_PROBE2(name, a1, a2)            do { } while (0)
+#define CF_PROBE3(name, a1, a2, a3)        do { } while (0)
+#define CF_PROBE4(name, a1, a2, a3, a4)    do { } while (0)
+#endif
+
+// Values of the 'kind' argument of the lock wait probes
+#define CF_LOCK_WAIT_READER_FOR_WRITER     0
+#define CF_LOCK_WAIT_WRITER_FOR_WRITER     1
+#define CF_LOCK_WAIT_WRITER_FOR_READERS    2
+
+#endif /* _USDT_PROBES_H_ */